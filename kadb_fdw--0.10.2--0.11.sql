@@ -0,0 +1,11 @@
+-- Error log of rejected messages
+
+CREATE TABLE kadb.error_log (
+    ftoid OID,
+    prt INTEGER,
+    off BIGINT,
+    time TIMESTAMPTZ,
+    error TEXT,
+    data BYTEA
+)
+DISTRIBUTED RANDOMLY;
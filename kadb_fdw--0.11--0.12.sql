@@ -0,0 +1,7 @@
+-- Set-based application of change events
+
+CREATE FUNCTION kadb.apply_changes(oid, regclass)
+RETURNS BIGINT
+EXECUTE ON MASTER
+AS '$libdir/kadb_fdw', 'kadb_apply_changes'
+LANGUAGE C STRICT VOLATILE;
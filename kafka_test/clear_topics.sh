@@ -9,3 +9,4 @@ COMMAND="docker exec -it $CONTAINER kafka-topics --bootstrap-server localhost:90
 $COMMAND --delete --topic kadb_fdw_test
 $COMMAND --delete --topic kadb_fdw_test_single_partition
 $COMMAND --delete --topic kadb_fdw_test_empty
+$COMMAND --delete --topic kadb_fdw_test_avro_nested
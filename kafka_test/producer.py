@@ -28,11 +28,86 @@ def conversion_hook(json_dict):
                 json_dict[key] = (key_date - unix_date).days
             except (TypeError, ValueError) as e:
                 pass
-        if type(value) == list:
-            json_dict[key] = array.array('B', value).tobytes()
 
     return json_dict
 
+
+def collect_named_types(schema, named_types):
+    """
+    Collect AVRO named types ('record', 'enum', 'fixed') defined in the given
+    schema into a dict of their names (and full names)
+    """
+    if type(schema) == list:
+        for branch in schema:
+            collect_named_types(branch, named_types)
+    if type(schema) != dict:
+        return
+    if schema.get("type") in ("record", "enum", "fixed") and "name" in schema:
+        named_types[schema["name"]] = schema
+        if "namespace" in schema:
+            named_types[schema["namespace"] + "." + schema["name"]] = schema
+    for field in schema.get("fields", []):
+        collect_named_types(field["type"], named_types)
+    for key in ("type", "items", "values"):
+        if type(schema.get(key)) in (dict, list):
+            collect_named_types(schema[key], named_types)
+
+
+def avro_type(schema, named_types):
+    """
+    Get the name of the AVRO type of the given schema, and its definition
+    """
+    while True:
+        if type(schema) == list:
+            return ("union", schema)
+        if type(schema) == str:
+            if schema not in named_types:
+                return (schema, schema)
+            schema = named_types[schema]
+        elif type(schema["type"]) == str and schema["type"] not in named_types:
+            return (schema["type"], schema)
+        else:
+            schema = schema["type"]
+
+
+def matches_avro_type(type_name, value):
+    """
+    Check whether the given JSON-encoded value may be of the given AVRO type
+    """
+    if type_name in ("array", "bytes", "fixed"):
+        return type(value) == list
+    if type_name in ("record", "map"):
+        return type(value) == dict
+    if type_name == "null":
+        return value is None
+    return value is not None and type(value) not in (list, dict)
+
+
+def convert_to_schema(schema, value, named_types):
+    """
+    Convert the given JSON-encoded value to Python types according to its AVRO
+    schema: lists of byte values are converted to AVRO 'bytes' and 'fixed',
+    and are left intact for AVRO arrays
+    """
+    (type_name, schema) = avro_type(schema, named_types)
+
+    if type_name == "union":
+        for branch in schema:
+            if matches_avro_type(avro_type(branch, named_types)[0], value):
+                return convert_to_schema(branch, value, named_types)
+        return value
+    if type_name in ("bytes", "fixed") and type(value) == list:
+        return array.array('B', value).tobytes()
+    if type_name == "array" and type(value) == list:
+        return [convert_to_schema(schema["items"], v, named_types) for v in value]
+    if type_name == "map" and type(value) == dict:
+        return {k: convert_to_schema(schema["values"], v, named_types) for (k, v) in value.items()}
+    if type_name == "record" and type(value) == dict:
+        for field in schema["fields"]:
+            if field["name"] in value:
+                value[field["name"]] = convert_to_schema(field["type"], value[field["name"]], named_types)
+    return value
+
 class MessageBytes(BytesIO):
     def __enter__(self):
         return self
@@ -71,6 +146,9 @@ def main():
 
     schema = json.loads(open(args.schema, "r").read())
     records = json.loads(open(args.data, "r").read(), object_hook=conversion_hook)
+    named_types = {}
+    collect_named_types(schema, named_types)
+    records = [convert_to_schema(schema, record, named_types) for record in records]
 
     producer = Producer({"bootstrap.servers": args.bootstrap_servers})
     producer.poll(0)
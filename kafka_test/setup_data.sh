@@ -17,3 +17,5 @@ BROKER="localhost:9092"
 
 ./producer.py -b $BROKER -s data/avro_schema.json -d data/avro_records.json -t kadb_fdw_test_avro
 ./producer.py -b $BROKER -s data/avro_schema.json -d data/avro_records.json -t kadb_fdw_test_avro
+
+./producer.py -b $BROKER -s data/avro_nested_schema.json -d data/avro_nested_records.json -t kadb_fdw_test_avro_nested
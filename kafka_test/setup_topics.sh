@@ -11,3 +11,4 @@ $COMMAND --create --topic kadb_fdw_test_single_partition --partitions 1
 $COMMAND --create --topic kadb_fdw_test_empty --partitions 1
 
 $COMMAND --create --topic kadb_fdw_test_avro --partitions 1
+$COMMAND --create --topic kadb_fdw_test_avro_nested --partitions 1
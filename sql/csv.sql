@@ -436,3 +436,1269 @@ ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (
     DROP csv_ignore_header
 );
 -- end_ignore
+
+
+-- Test: CSV with attributes not referenced by the query
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET csv_data_on_inject
+'not_a_number,one
+not_a_number_either,two'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_t ORDER BY t;
+
+SELECT count(*) FROM test_kadb_fdw_t;
+
+SELECT i FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV with a value cache
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t ALTER COLUMN t OPTIONS (ADD value_cache '2');
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET csv_data_on_inject
+'1,one
+2,two
+3,one
+4,three
+5,two
+6,three'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+SELECT t FROM test_kadb_fdw_t WHERE t = 'one' ORDER BY t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+
+ALTER FOREIGN TABLE test_kadb_fdw_t ALTER COLUMN t OPTIONS (DROP value_cache);
+-- end_ignore
+
+ALTER FOREIGN TABLE test_kadb_fdw_t ALTER COLUMN t OPTIONS (ADD value_cache '0');
+ALTER FOREIGN TABLE test_kadb_fdw_t ALTER COLUMN t OPTIONS (ADD value_cache '65537');
+
+
+-- Test: CSV with conditions evaluated by the deserializer
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET csv_data_on_inject
+'1,one
+2,
+3,one
+4,three
+,two'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t WHERE i > 2 ORDER BY i, t;
+SELECT i FROM test_kadb_fdw_t WHERE 2 >= i ORDER BY i;
+SELECT i, t FROM test_kadb_fdw_t WHERE t IS NULL ORDER BY i, t;
+SELECT i, t FROM test_kadb_fdw_t WHERE i IS NULL AND t IS NOT NULL ORDER BY i, t;
+SELECT i, t FROM test_kadb_fdw_t WHERE i <= 4 AND t <> 'one' ORDER BY i, t;
+SELECT i, t FROM test_kadb_fdw_t WHERE t = 'one' AND i + 1 = 4 ORDER BY i, t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV decoded ahead by worker threads
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_decode_threads '2', SET csv_data_on_inject
+'1,"one, two"
+2,"say ""hi"""
+3,  three  
+4,""
+,"five"'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+SELECT i FROM test_kadb_fdw_t WHERE t IS NULL ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (DROP k_decode_threads);
+-- end_ignore
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_decode_threads '65');
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_decode_threads '-1');
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v SMALLINT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of SMALLINT matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,32767,32767
+2,-32768,-32768
+3,+123,+123
+4,  7  ,  7  
+5,007,007
+6,-0,-0'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, v IS NOT DISTINCT FROM t::SMALLINT AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for SMALLINT overflow by one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,32768,32768'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for SMALLINT underflow by one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,-32769,-32769'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v INT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of INT matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,2147483647,2147483647
+2,-2147483648,-2147483648
+3,+42,+42
+4, -5, -5
+5,99 ,99 '
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, v IS NOT DISTINCT FROM t::INT AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for INT overflow by one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,2147483648,2147483648'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for INT underflow by one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,-2147483649,-2147483649'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v BIGINT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of BIGINT matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,9223372036854775807,9223372036854775807
+2,-9223372036854775808,-9223372036854775808
+3,999999999999999999,999999999999999999
+4,1000000000000000000,1000000000000000000
+5,+1,+1
+6, 3 , 3 '
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, v IS NOT DISTINCT FROM t::BIGINT AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for BIGINT overflow by one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,9223372036854775808,9223372036854775808'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for BIGINT underflow by one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,-9223372036854775809,-9223372036854775809'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+-- start_ignore
+SET extra_float_digits = 3;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v FLOAT8)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of DOUBLE PRECISION matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,0.1,0.1
+2,-1.5e10,-1.5e10
+3,1e22,1e22
+4,1e23,1e23
+5,1e-22,1e-22
+6,1e-23,1e-23
+7,123456789012345,123456789012345
+8,1234567890123456789,1234567890123456789
+9,0.12345678901234567,0.12345678901234567
+10,3.141592653589793,3.141592653589793
+11,1.,1.
+12,.5,.5
+13,1E+2,1E+2
+14,-0,-0
+15, 2.5 , 2.5 
+16,2.2250738585072014e-308,2.2250738585072014e-308
+17,4.9e-324,4.9e-324
+18,1.7976931348623157e308,1.7976931348623157e308
+19,NaN,NaN
+20,Infinity,Infinity
+21,-Infinity,-Infinity'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, v IS NOT DISTINCT FROM t::FLOAT8 AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v FLOAT4)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of REAL matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,0.1,0.1
+2,16777217,16777217
+3,0.333333333333333333,0.333333333333333333
+4,1e22,1e22
+5,1e-22,1e-22
+6,3.4028235e38,3.4028235e38
+7,1e-40,1e-40
+8,1.5e-45,1.5e-45
+9, -2.5, -2.5
+10,NaN,NaN
+11,Infinity,Infinity
+12,-Infinity,-Infinity'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, v IS NOT DISTINCT FROM t::FLOAT4 AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+-- start_ignore
+RESET extra_float_digits;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v BOOLEAN)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of BOOLEAN matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,t,t
+2,tr,tr
+3,tru,tru
+4,true,true
+5,TRUE,TRUE
+6,y,y
+7,ye,ye
+8,yes,yes
+9,on,on
+10,1,1
+11, true , true 
+12,f,f
+13,fa,fa
+14,fal,fal
+15,fals,fals
+16,false,false
+17,False,False
+18,n,n
+19,no,no
+20,of,of
+21,off,off
+22,0,0'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, v IS NOT DISTINCT FROM t::BOOLEAN AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for an invalid BOOLEAN
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,o,o'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+-- start_ignore
+SET DateStyle = 'ISO, YMD';
+SET TimeZone = 'America/New_York';
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v DATE)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of DATE matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,2020-02-29,2020-02-29
+2,0001-01-01,0001-01-01
+3,9999-12-31,9999-12-31
+4,0044-03-15 BC,0044-03-15 BC
+5,infinity,infinity
+6,-infinity,-infinity
+7, 2020-01-01, 2020-01-01
+8,20200101,20200101'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, v IS NOT DISTINCT FROM t::DATE AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for an invalid DATE
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,2021-02-29,2021-02-29'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v TIMESTAMP, p TIMESTAMP(2))
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of TIMESTAMP matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,2020-01-01 10:00:00,2020-01-01 10:00:00,2020-01-01 10:00:00
+2,2020-01-01T10:00:00.123456,2020-01-01T10:00:00.123456,2020-01-01T10:00:00.123456
+3,2020-01-01 10:00:00.125,2020-01-01 10:00:00.125,2020-01-01 10:00:00.125
+4,2020-01-01 10:00:00.5,2020-01-01 10:00:00.5,2020-01-01 10:00:00.5
+5,2021-03-14 02:30:00,2021-03-14 02:30:00,2021-03-14 02:30:00
+6,2020-01-01 10:00:00+03,2020-01-01 10:00:00+03,2020-01-01 10:00:00+03
+7,0044-03-15 12:00:00 BC,0044-03-15 12:00:00 BC,0044-03-15 12:00:00 BC
+8,infinity,infinity,infinity'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, p, v IS NOT DISTINCT FROM t::TIMESTAMP AND p IS NOT DISTINCT FROM t::TIMESTAMP(2) AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v TIMESTAMPTZ)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of TIMESTAMPTZ matches the generic one, in a time zone with DST
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,2020-01-01 10:00:00,2020-01-01 10:00:00
+2,2020-07-01 10:00:00.25,2020-07-01 10:00:00.25
+3,2021-03-14 02:30:00,2021-03-14 02:30:00
+4,2021-11-07 01:30:00,2021-11-07 01:30:00
+5,2020-06-01 12:00:00+03,2020-06-01 12:00:00+03
+6,2020-06-01T12:00:00Z,2020-06-01T12:00:00Z
+7,2020-01-01 00:00:00.5+05:30,2020-01-01 00:00:00.5+05:30
+8,2020-01-01 00:00:00-0330,2020-01-01 00:00:00-0330
+9,2020-01-01 00:00:00 +03,2020-01-01 00:00:00 +03
+10,2020-01-01 00:00:00 Europe/Moscow,2020-01-01 00:00:00 Europe/Moscow'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, v IS NOT DISTINCT FROM t::TIMESTAMPTZ AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+-- start_ignore
+RESET TimeZone;
+RESET DateStyle;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v NUMERIC, p NUMERIC(25,2))
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Fast input of NUMERIC matches the generic one
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,42,42,42
+2,-7,-7,-7
+3,+5,+5,+5
+4, 5 , 5 , 5 
+5,-0,-0,-0
+6,123456789012345678,123456789012345678,123456789012345678
+7,1234567890123456789012,1234567890123456789012,1234567890123456789012
+8,1.005,1.005,1.005
+9,1.004,1.004,1.004
+10,-2.5,-2.5,-2.5
+11,1e3,1e3,1e3
+12,NaN,NaN,NaN'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, t, v, p, v IS NOT DISTINCT FROM t::NUMERIC AND p IS NOT DISTINCT FROM t::NUMERIC(25,2) AS same FROM test_kadb_fdw_fast ORDER BY n;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_fast(n INT, t TEXT, v NUMERIC(4,2))
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'csv',
+    csv_attribute_trim_whitespace 'false',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: ERROR for NUMERIC that does not fit its typmod
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_fast OPTIONS (SET csv_data_on_inject
+'1,100,100'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT n, v FROM test_kadb_fdw_fast;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_fast;
+-- end_ignore
+
+
+-- Test: CSV in UTF8 encoding, with a terminating NUL byte
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_encoding 'UTF8', SET csv_data_on_inject
+'1,Привет
+2,"мир, world"
+3,'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV in WIN1251 encoding, converted to the database encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET k_encoding 'WIN1251', SET csv_data_on_inject
+'1,Привет
+2,"мир, world"
+3,'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV in UTF8 encoding, decoded ahead by worker threads
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_decode_threads '2', SET k_encoding 'UTF8', SET csv_data_on_inject
+'1,Привет
+2,"мир, world"
+3,'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV in WIN1251 encoding, with worker threads
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET k_encoding 'WIN1251', SET csv_data_on_inject
+'1,Привет
+2,"мир, world"
+3,'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for CSV with a character that has no equivalent in the database encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET csv_data_on_inject
+'1,И'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (DROP k_decode_threads, DROP k_encoding);
+-- end_ignore
+
+
+-- Test: CSV with LF and CRLF in quoted fields
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (
+    SET csv_data_on_inject
+E'1,"one\nLF"\r\n2,"two\r\nCRLF"\r\n3,three\r\n'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, replace(replace(t, E'\r', '<CR>'), E'\n', '<LF>') AS t FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV with escaped quotes across 16-byte blocks
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (
+    SET csv_data_on_inject
+'1,"aaaaaaaaaaaaa""bbbbbbbbbbbbbbbbbbbb"
+2,"aaaaaaaaaaaaaaa""bbbbbbbbbbbbbbbbbbbb"
+3,"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"""
+'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV with an unterminated quote at the end of a message
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (
+    SET csv_data_on_inject
+'1,one
+2,"two
+3,three'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, replace(replace(t, E'\r', '<CR>'), E'\n', '<LF>') AS t FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV with fields longer than 32 bytes
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (
+    SET csv_data_on_inject
+'1,   a long field which spans more than 32 bytes   
+2, "a long field, which spans more than 32 bytes"  
+'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, '[' || t || ']' AS t FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: CSV with fields longer than 32 bytes and disabled trimming
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (
+    ADD csv_attribute_trim_whitespace 'false',
+    SET csv_data_on_inject
+'1,   a long field which spans more than 32 bytes   
+2,"  a long field, which spans more than 32 bytes  "
+'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, '[' || t || ']' AS t FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (
+    DROP csv_attribute_trim_whitespace
+);
+-- end_ignore
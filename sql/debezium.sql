@@ -0,0 +1,218 @@
+-- Test 'debezium' deserialization and application of changes
+-- These tests do not require a Kafka instance. They can be run as common tests.
+
+-- start_matchignore
+-- m/^NOTICE:  Kafka-ADB: Offset for partition [0-9]* is not known, and is set to default value [0-9]*.*/
+-- end_matchignore
+
+-- start_ignore
+CREATE EXTENSION IF NOT EXISTS gp_inject_fault;
+
+DROP EXTENSION IF EXISTS kadb_fdw CASCADE;
+CREATE EXTENSION kadb_fdw;
+
+CREATE SERVER test_kadb_fdw_distribution_server
+FOREIGN DATA WRAPPER kadb_fdw
+OPTIONS (
+    k_brokers '0.0.0.0:9092'
+);
+-- end_ignore
+
+
+-- Test: Creation, update, and deletion
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(
+    op TEXT OPTIONS (debezium_column 'op'),
+    id INT OPTIONS (debezium_column 'key'),
+    name TEXT,
+    city TEXT OPTIONS (json_path 'address.city'),
+    off BIGINT OPTIONS (kafka_metadata 'offset')
+)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'debezium',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    json_data_on_inject '{"before": null, "after": {"id": 1, "name": "one", "address": {"city": "A"}}, "source": {"db": "test"}, "op": "c", "ts_ms": 1}
+{"before": {"id": 2, "name": "two", "address": null}, "after": {"id": 2, "name": "TWO", "address": null}, "source": {"db": "test"}, "op": "u", "ts_ms": 2}
+{"before": {"id": 3, "name": "three", "address": {"city": "C"}}, "after": null, "source": {"db": "test"}, "op": "d", "ts_ms": 3}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT op, id, name, city FROM test_kadb_fdw_t ORDER BY id;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Schema envelopes
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD debezium_schemas 'true');
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"schema": {"type": "struct", "optional": false}, "payload": {"before": null, "after": {"id": 4, "name": "four"}, "op": "r"}}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT op, id, name, city FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Tombstones
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (DROP debezium_schemas);
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject '');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT op, id, name, city FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Application of changes
+
+-- start_ignore
+CREATE TABLE test_kadb_fdw_target(id INT, name TEXT, city TEXT) DISTRIBUTED BY (id);
+INSERT INTO test_kadb_fdw_target VALUES (2, 'two', 'B'), (3, 'three', 'C'), (5, 'five', 'E');
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"before": null, "after": {"id": 1, "name": "one", "address": {"city": "A"}}, "source": {"db": "test"}, "op": "c", "ts_ms": 1}
+{"before": {"id": 2, "name": "two", "address": null}, "after": {"id": 2, "name": "TWO", "address": null}, "source": {"db": "test"}, "op": "u", "ts_ms": 2}
+{"before": {"id": 3, "name": "three", "address": {"city": "C"}}, "after": null, "source": {"db": "test"}, "op": "d", "ts_ms": 3}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT kadb.apply_changes('test_kadb_fdw_t'::regclass::oid, 'test_kadb_fdw_target');
+
+SELECT * FROM test_kadb_fdw_target ORDER BY id;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for a target that does not exist
+
+SELECT kadb.apply_changes('test_kadb_fdw_t'::regclass::oid, 0);
+
+
+-- Test: ERROR for a target that is not a table
+
+SELECT kadb.apply_changes('test_kadb_fdw_t'::regclass::oid, 'test_kadb_fdw_t');
+
+
+-- Test: ERROR for a target which the user cannot both insert into and delete from
+
+-- start_ignore
+CREATE ROLE test_kadb_fdw_role;
+GRANT USAGE ON SCHEMA kadb TO test_kadb_fdw_role;
+-- end_ignore
+
+GRANT INSERT ON test_kadb_fdw_target TO test_kadb_fdw_role;
+SET ROLE test_kadb_fdw_role;
+SELECT kadb.apply_changes('test_kadb_fdw_t'::regclass::oid, 'test_kadb_fdw_target');
+RESET ROLE;
+
+-- start_ignore
+REVOKE ALL ON test_kadb_fdw_target FROM test_kadb_fdw_role;
+REVOKE USAGE ON SCHEMA kadb FROM test_kadb_fdw_role;
+DROP ROLE test_kadb_fdw_role;
+-- end_ignore
+
+
+-- Test: ERROR for change events with NULL keys
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"before": null, "after": {"id": null, "name": "nobody", "address": null}, "source": {"db": "test"}, "op": "c", "ts_ms": 4}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT kadb.apply_changes('test_kadb_fdw_t'::regclass::oid, 'test_kadb_fdw_target');
+
+SELECT * FROM test_kadb_fdw_target ORDER BY id;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for a foreign table without key columns
+
+ALTER FOREIGN TABLE test_kadb_fdw_t ALTER COLUMN id OPTIONS (DROP debezium_column);
+
+SELECT kadb.apply_changes('test_kadb_fdw_t'::regclass::oid, 'test_kadb_fdw_target');
+
+
+-- Test: ERROR for an invalid part of a change event
+
+ALTER FOREIGN TABLE test_kadb_fdw_t ALTER COLUMN id OPTIONS (ADD debezium_column 'before');
+
+
+-- start_ignore
+DROP TABLE test_kadb_fdw_target;
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
@@ -0,0 +1,297 @@
+-- Test JSON deserialization
+-- These tests do not require a Kafka instance. They can be run as common tests.
+
+-- start_matchignore
+-- m/^NOTICE:  Kafka-ADB: Offset for partition [0-9]* is not known, and is set to default value [0-9]*.*/
+-- end_matchignore
+
+-- start_ignore
+CREATE EXTENSION IF NOT EXISTS gp_inject_fault;
+DROP EXTENSION IF EXISTS kadb_fdw CASCADE;
+CREATE EXTENSION kadb_fdw;
+
+CREATE SERVER test_kadb_fdw_distribution_server
+FOREIGN DATA WRAPPER kadb_fdw
+OPTIONS (
+    k_brokers '0.0.0.0:9092'
+);
+-- end_ignore
+
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+
+CREATE FOREIGN TABLE test_kadb_fdw_t(
+    i INT,
+    t TEXT,
+    n TEXT OPTIONS (json_path '$.nested.n'),
+    e INT OPTIONS (json_path 'nested.arr[1]'),
+    j JSONB OPTIONS (json_path 'nested')
+)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'json',
+
+    k_tuples_per_partition_on_inject '1',
+    json_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Single object
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"i": 1, "t": "one"}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Multiple objects (JSON Lines), different key order, unknown keys
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"i": 1, "t": "one"}
+{"t": "two", "unknown": {"a": [1, "]"]}, "i": 2}
+{"i": 3}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+SELECT i FROM test_kadb_fdw_t WHERE t IS NULL ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Nested values
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"i": 1, "nested": {"n": "first", "arr": [10, 20]}}
+{"i": 2, "nested": {"arr": [30]}}
+{"i": 3, "nested": null}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i, n, e, j FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Escape sequences and null values
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"i": 1, "t": "quote\"s and \\ \u0041"}
+{"i": null, "t": null}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t ORDER BY i, t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Invalid JSON
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"i": 1, "t": "one",}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: A record is not an object
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'[1, 2]'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: JSON in UTF8 encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_encoding 'UTF8', SET json_data_on_inject
+'{"i": 1, "t": "Привет, мир!"}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: JSON in WIN1251 encoding, converted to the database encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET k_encoding 'WIN1251', SET json_data_on_inject
+'{"i": 1, "t": "Привет, мир!"}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for JSON with a character that has no equivalent in the database encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET json_data_on_inject
+'{"i": 1, "t": "И"}'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_json', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (DROP k_encoding);
+-- end_ignore
+
+
+-- Test: Invalid JSON path
+
+CREATE FOREIGN TABLE test_kadb_fdw_t_invalid_path(i INT OPTIONS (json_path 'a..b'))
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    format 'json'
+);
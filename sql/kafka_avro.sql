@@ -126,3 +126,173 @@ ORDER BY ts_us_epoch;
 -- start_ignore
 RESET client_min_messages;
 -- end_ignore
+
+
+-- Test: Mapping by name
+
+-- start_ignore
+DROP FOREIGN TABLE IF EXISTS test_kadb_fdw_table;
+
+CREATE FOREIGN TABLE test_kadb_fdw_table(
+    bln BOOLEAN,
+    absent TEXT,
+    ts_us TIMESTAMP,
+    d DATE
+)
+SERVER test_kadb_fdw_server
+OPTIONS (
+    k_topic 'kadb_fdw_test_avro',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '5',
+    k_timeout_ms '2000',
+    avro_mapping 'name'
+);
+-- end_ignore
+
+-- start_ignore
+SET client_min_messages = WARNING;
+-- end_ignore
+
+SELECT
+    bln,
+    (absent IS NULL) AS absent,
+    to_char(ts_us, 'YYYY-MM-DD HH24:MI:SS.US') AS ts_us,
+    (EXTRACT(EPOCH FROM ts_us) * 1000000)::BIGINT AS ts_us_epoch,
+    to_char(d, 'YYYY-MM-DD') AS d
+FROM test_kadb_fdw_table
+ORDER BY ts_us_epoch;
+
+-- start_ignore
+RESET client_min_messages;
+-- end_ignore
+
+
+-- Test: Mapping by name, with a provided schema
+
+-- start_ignore
+DROP FOREIGN TABLE IF EXISTS test_kadb_fdw_table;
+
+CREATE FOREIGN TABLE test_kadb_fdw_table(
+    bln BOOLEAN,
+    absent TEXT,
+    ts_us TIMESTAMP,
+    d DATE
+)
+SERVER test_kadb_fdw_server
+OPTIONS (
+    k_topic 'kadb_fdw_test_avro',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '5',
+    k_timeout_ms '2000',
+    avro_mapping 'name',
+    avro_schema '{"name":"doc","type":"record","fields":[{"name":"d","type":"int","logicalType":"date"},{"name":"t_ms","type":"int","logicalType":"time-millis"},{"name":"t_us","type":"long","logicalType":"time-micros"},{"name":"ts_ms","type":"long","logicalType":"timestamp-millis"},{"name":"ts_us","type":"long","logicalType":"timestamp-micros"},{"name":"dur","type":{"name":"dur_fixed","type":"fixed","size":12,"logicalType":"duration"}},{"name":"dec_1","type":{"name":"dec_2_fixed","type":"fixed","size":6,"logicalType":"decimal"}},{"name":"dec_2","type":{"name":"dec_2_fixed","type":"bytes","logicalType":"decimal","precision":14,"scale":4}},{"name":"n","type":"null"},{"name":"b_bytes","type":"bytes"},{"name":"b_fixed","type":{"name":"b_fixed_fixed","type":"fixed","size":4}},{"name":"f","type":"float"},{"name":"dbl","type":"double"},{"name":"bln","type":"boolean"},{"name":"postgres_type","type":"string"}]}'
+);
+-- end_ignore
+
+-- start_ignore
+SET client_min_messages = WARNING;
+-- end_ignore
+
+SELECT
+    bln,
+    (absent IS NULL) AS absent,
+    to_char(ts_us, 'YYYY-MM-DD HH24:MI:SS.US') AS ts_us,
+    (EXTRACT(EPOCH FROM ts_us) * 1000000)::BIGINT AS ts_us_epoch,
+    to_char(d, 'YYYY-MM-DD') AS d
+FROM test_kadb_fdw_table
+ORDER BY ts_us_epoch;
+
+-- start_ignore
+RESET client_min_messages;
+-- end_ignore
+
+
+-- Test: Nested types
+
+-- start_ignore
+DROP FOREIGN TABLE IF EXISTS test_kadb_fdw_table;
+DROP TYPE IF EXISTS test_kadb_fdw_point;
+
+CREATE TYPE test_kadb_fdw_point AS (
+    label TEXT,
+    x DOUBLE PRECISION,
+    z INTEGER
+);
+
+CREATE FOREIGN TABLE test_kadb_fdw_table(
+    id INTEGER,
+    tags TEXT[],
+    numbers BIGINT[],
+    point test_kadb_fdw_point,
+    point_json JSONB,
+    attributes JSONB,
+    color TEXT
+)
+SERVER test_kadb_fdw_server
+OPTIONS (
+    k_topic 'kadb_fdw_test_avro_nested',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '5',
+    k_timeout_ms '2000'
+);
+-- end_ignore
+
+-- start_ignore
+SET client_min_messages = WARNING;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_table ORDER BY id;
+
+SELECT id, (point).label, (point).x, (point).z IS NULL AS z FROM test_kadb_fdw_table ORDER BY id;
+
+-- start_ignore
+RESET client_min_messages;
+DROP FOREIGN TABLE test_kadb_fdw_table;
+DROP TYPE test_kadb_fdw_point;
+-- end_ignore
+
+
+-- Test: Nested types, with a provided schema
+
+-- start_ignore
+DROP FOREIGN TABLE IF EXISTS test_kadb_fdw_table;
+DROP TYPE IF EXISTS test_kadb_fdw_point;
+
+CREATE TYPE test_kadb_fdw_point AS (
+    label TEXT,
+    x DOUBLE PRECISION,
+    z INTEGER
+);
+
+CREATE FOREIGN TABLE test_kadb_fdw_table(
+    id INTEGER,
+    tags TEXT[],
+    numbers BIGINT[],
+    point test_kadb_fdw_point,
+    point_json JSONB,
+    attributes JSONB,
+    color TEXT
+)
+SERVER test_kadb_fdw_server
+OPTIONS (
+    k_topic 'kadb_fdw_test_avro_nested',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '5',
+    k_timeout_ms '2000',
+    avro_schema '{"name":"nested_doc","type":"record","fields":[{"name":"id","type":"int"},{"name":"tags","type":{"type":"array","items":"string"}},{"name":"numbers","type":{"type":"array","items":["null","long"]}},{"name":"point","type":{"name":"point","type":"record","fields":[{"name":"x","type":"double"},{"name":"y","type":"double"},{"name":"label","type":"string"}]}},{"name":"point_json","type":"point"},{"name":"attributes","type":{"type":"map","values":"string"}},{"name":"color","type":{"name":"color","type":"enum","symbols":["RED","GREEN","BLUE"]}}]}'
+);
+-- end_ignore
+
+-- start_ignore
+SET client_min_messages = WARNING;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_table ORDER BY id;
+
+SELECT id, (point).label, (point).x, (point).z IS NULL AS z FROM test_kadb_fdw_table ORDER BY id;
+
+-- start_ignore
+RESET client_min_messages;
+DROP FOREIGN TABLE test_kadb_fdw_table;
+DROP TYPE test_kadb_fdw_point;
+-- end_ignore
@@ -0,0 +1,167 @@
+-- Test Kafka message metadata columns
+-- These tests do not require a Kafka instance. They can be run as common tests.
+
+-- start_matchignore
+-- m/^NOTICE:  Kafka-ADB: Offset for partition [0-9]* is not known, and is set to default value [0-9]*.*/
+-- end_matchignore
+
+-- start_ignore
+CREATE EXTENSION IF NOT EXISTS gp_inject_fault;
+
+DROP EXTENSION IF EXISTS kadb_fdw CASCADE;
+CREATE EXTENSION kadb_fdw;
+
+CREATE SERVER test_kadb_fdw_distribution_server
+FOREIGN DATA WRAPPER kadb_fdw
+OPTIONS (
+    k_brokers '0.0.0.0:9092'
+);
+-- end_ignore
+
+
+-- Test: Metadata columns mixed with content columns
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(
+    p INT OPTIONS (kafka_metadata 'partition'),
+    i INT,
+    o BIGINT OPTIONS (kafka_metadata 'offset'),
+    t TEXT,
+    k BYTEA OPTIONS (kafka_metadata 'key'),
+    ts TIMESTAMPTZ OPTIONS (kafka_metadata 'timestamp'),
+    h JSONB OPTIONS (kafka_metadata 'headers')
+)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'csv',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject '1,one'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT p, i, o, t, k IS NULL AS k_is_null, ts IS NULL AS ts_is_null, h IS NULL AS h_is_null FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
+
+
+-- Test: Metadata columns only
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(
+    o BIGINT OPTIONS (kafka_metadata 'offset'),
+    p BIGINT OPTIONS (kafka_metadata 'partition')
+)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'csv',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject '1,one'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT o, p FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
+
+
+-- Test: ERROR for a metadata column of an unsupported type
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(
+    i INT,
+    t TEXT,
+    p TEXT OPTIONS (kafka_metadata 'partition')
+)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'csv',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject '1,one'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i, t, p FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
+
+
+-- Test: ERROR for an invalid metadata kind
+
+CREATE FOREIGN TABLE test_kadb_fdw_t_invalid(i INT OPTIONS (kafka_metadata 'size'))
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    format 'csv'
+);
+
+
+-- Test: ERROR for a key format of a column which is not a key
+
+CREATE FOREIGN TABLE test_kadb_fdw_t_invalid(i INT OPTIONS (kafka_metadata 'offset', kafka_key_format 'text'))
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    format 'csv'
+);
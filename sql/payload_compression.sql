@@ -0,0 +1,226 @@
+-- Test decompression of payloads ('payload_compression')
+-- These tests do not require a Kafka instance. They can be run as common tests.
+
+-- start_matchignore
+-- m/^NOTICE:  Kafka-ADB: Offset for partition [0-9]* is not known, and is set to default value [0-9]*.*/
+-- end_matchignore
+
+-- start_ignore
+CREATE EXTENSION IF NOT EXISTS gp_inject_fault;
+
+DROP EXTENSION IF EXISTS kadb_fdw CASCADE;
+CREATE EXTENSION kadb_fdw;
+
+CREATE SERVER test_kadb_fdw_distribution_server
+FOREIGN DATA WRAPPER kadb_fdw
+OPTIONS (
+    k_brokers '0.0.0.0:9092'
+);
+-- end_ignore
+
+
+-- Test: Payloads compressed by gzip
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(i INT, t TEXT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'csv',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    payload_compression 'gzip',
+
+    k_tuples_per_partition_on_inject '1',
+    payload_data_on_inject 'H4sIAAAAAAAC/zPUyc9L5TLSKSnPBwCi0iI2CwAAAA=='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Concatenated gzip members
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET payload_compression 'gzip', SET payload_data_on_inject 'H4sIAAAAAAAC/zPUyc9L5QIALcCGowYAAAAfiwgAAAAAAAL/M9IpKc8HAAlfrBkFAAAA');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Payloads compressed by zstd
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET payload_compression 'zstd', SET payload_data_on_inject 'KLUv/QBYWQAAMSxvbmUKMix0d28=');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Payloads compressed by lz4
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET payload_compression 'lz4', SET payload_data_on_inject 'BCJNGGBAggsAAIAxLG9uZQoyLHR3bwAAAAA=');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Payloads compressed by snappy
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET payload_compression 'snappy', SET payload_data_on_inject 'CygxLG9uZQoyLHR3bw==');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: A payload larger than the initial buffer
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET payload_compression 'zstd', SET payload_data_on_inject 'KLUv/QBYRDgA6lnMCQ+wpTkMwwAQEREh0ufEwYGiAKYApgBt27bt//8zGAwGg8FgMBh3d3d3d2ZmZmZmVVVVVVVERERERDMzMzMzIiIiIiIREREREW3btu3//7Msy7Isy7Ls3d3d3Z2ZmZmZWVVVVVUVEREREdHMzMzMjIiIiIhIRERERETbtm37/z9JkiT53d3d3Z2ZmZmZWVVVVVUVEREREdHMzMzMjIiIiIhIRERERETbtm37/x8C4EMA8LOikWgIgAMzMzMzMyIiIiIiERERERFt27bt//+TSCQSiUQikUh3d3d3d2ZmZmZmVVVVVVVERERERDMzMzMzIiIiIiIREREREW3btu3//3M4HA6Hw+FwOHd3d3d3ZmZmZmZVVVVVVUREREREMzMzMzMiIiIiIhERERERbdu27f//UygUCoVCoVAod3d3d3dmZmZmZlVVVVVVREREREQzMzMzMyIiIiIiEREREREBZmZmZmZVVVVVVUREREREMzMzMzMiIiIiIhERERERbdu27f//83g8Ho/H4/F4d3d3d3dmZmZmZlVVVVVVREREREQzMzMzMyIiIiIiERERERFt27bt///TaDQajUaj0Wh3d3d3d2ZmZmZmVVVVVVVERERERDMzMzMzIiIiIiIREREREW3btu3//7NYLBaLxWKxWHd3d3d3ZmZmZmZVVVVVVUREREREAW3btm3btm3btm3btm3btm3btv////////////////////////////////+cc84555xzzjnnnHPOOeecc84555xzzjnnnHPOOeecc84555xzzjnnnHPOOeecc84555xzzjnnnHPOOeecc353d3d3F4TfpCOQ3RsDgx4n4UQfKsIYYxrDGMYYwzTGNMYYjTGGMYZhjDGMaQxjjGEaYwxjTNMYYxjTmMYYozHGMMY0jDGGMY1hjDFMY4xhjGEaYwxjGtMYY5rGGMYYkzHGMIYxjDGGaYwxjDFNY4xhTGMaY0zDGDOZtYQoamlU0tJZ0FJczhJfzNKplKVRIUtnGUtxEUt8CUunApZG5SudxSvFpSvxhSudylYaFa10lqwUF6zEl6t0KlZpVKrSWahSXKYSX6TSqUSlUYFKZ3lKcXFKfGlKp8KURmUpnUUpxSUp8QUpncpRGhWjdJaiFBeixJehdCpCaVSC0lmAUlx+El980qn0pFHhSWfZSXHRSXzJSaeCk0blJp3FJsWlJvGFJp3KTBoVmXSWmBQXmMSXl3QqLmlUWtJZWFJcVhJfVNKppKRRQUlnOUlxMUl8KUmnQpJGZSSdRSTFJSTxBSSdykcaFY90lo4UF47El410KhppVDLSWTBSXC4SXyzSqVSkUaFIZ5lIcZFIfIlIpwKRRuUhncUhxaUh8YUhncpCGhWFdJaEFBeElJRSLqUUpZRFKaUoZSlKKUVZSlFKKZVSSlGUUpZSSqWUspSyLKUUpSxFKaUoSilKKaVSSilKWcpSSlGWUlZCRJBMTkRESCaTUspSyqKUUpSyFKWUoiilKKWUSilFKWUpSillWUpRSlGWUspSlqKUUpSlFKWUUimlKKUoRSmlLEspSinlSogIyeREpAjJJClFWUopSlmKUkpRllKUUkqllKKUoiillKIspSyllEopZSllWUopilKKUkqplFKUUhallFKUpZSllEIppayEiCSZnIiIkEwmpZSllEUppShKKUoppVJKUUpZlFKKUpZSlFKKpZSilLIspZSlLEUppShLKUopilJKUcpSilJKuZRSlFKWlRARkskJERGSSVLKspRSlLIUpZSiLKUopShKKUUpS1FKKaVSSllKWZRSylKUspRSlKUUpZRSKaUopSxKKaVQSilLKYtSSlkJKUIyORERITlJSilLUYpSSlGWUpRSSqWUopSyKKUURSmlKKUsSylFKUtZSinLUopSSqGUUpRSFqWUopSlFKWUcimlKEUpKyEiJJMnIiIkk6QsZSmlKEspSimFUkpRSlmUUopSlqKUUkqllLIUpSillGUpZSmlVEopSimLUkpRilKUUkqplFKWUhallLISUoRkciIigmSSlFKWpRSllFIppSilLEopRSlKUUopylJKUUpZllKKUpaylFIspRSllEUppShlKUopRVlKKUopylJKUcpSVkJESCZPRERIJklZylJKoZRSlFIWpZSilKUopRRlKUUppShKKWUpS1FKKctSylJKqZRSlKIUpZSiLKUopZRFKaUsZSlKSUuVDnZc0ZNOQoWTvGySUDQJSya5gkmmXJIrliRKJWEKJUkIQQghEkJIQgiSEEIQghCEEAIhhCCEJAghBCEJIQghZEIIQQhBEkJIQhKCEEKQhBCEEBIhhOyRCbZEgi2JYEsg2JIHtogDW9LAVowwoAu6gHGMcYzxqqEOgRndnRsAF69eWQBfAF8AIiIiIiIiIiIiIiIiIiIiIiIiIhERERERERERERERERERERERERERERERERERERERERERERERERERERERERERERERERERbdu2bdu2bdu2bdu2bdu2bdu2bQNERERERERERERERERENDMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMzMjIiIiIiIiIiIiIiIiIiIiIiIiIiIiIiIiIiIiIiIiEmZmZmZmZmZmVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVVEREREREREREREREREREREREREREREREREREREREREREREREQU7N3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d3d2dmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZmZlZgvKoIvgb4t+/AxJIEPj///cfpBhjjDHGGGOMMcYYYxpjjDHGGGOMMcYYY4wxxhhjjDHGGGNMY4wxxjTGGGOMMcYYY4wxxhhjGGOMMYwxxhhjjDHGGGOMMcYYY4wxxhhjjDFmY4wxxhhjjDHGGGOMMcYYY4wxxhhjDGOMMcYYwxhjjDHGGGOMMcYYYxpjjDGmMcYYY4wxxhhjjDHGGGOMMcYYY4wxhjHGGGOMMcYYY4wxxhjTGMYYY4wxxhjTGGOMMcYYY4wxxhhjjDHGGGOMMcYYwxhjjDHGGGOMMY0xxhhjjDHGGGOMMcY0xjDGGGOMMcYYY4wxxhhjjDHGGGOMYYwxxhjTGGOMMcYYY4wxxhhjjDHGGGMaY4wxxhhjjDHGGMMYY4wxxhhjjDHGMI0xxhhjjDHGGGOMMcYYY4wxxhhjjDGNMcYYY4wxxhhjjDHGGGOMMcY0xhjGMMYYY4wxxhhjjDHGGGOMMcYYY4wxxpjGGGOMMcYYY4wxxhhjTGOMMcYYY4wxjDHGGGOMMcYwxhhjjDHGGGOMMcYYY0xjjDHGGGOMMcY0xhhjjDHGGGOMMcYYxhhjjDHGGGOMMcYYY4wxxhjDGGOMMaYxxhhjTGOMMcYYY4wxxhhjjDHGGGMMY4wxxhhjjDHGGGOMMUNDDQMu9wEtQA==');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT count(*), sum(i), min(length(t)) FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for a payload which is not compressed
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET payload_compression 'gzip', SET payload_data_on_inject 'MSxvbmUKMix0d28=');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for a truncated payload
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET payload_compression 'zstd', SET payload_data_on_inject 'KLUv/QBYWQAAMSxvbmUKMg==');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for an unknown compression
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET payload_compression 'brotli');
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
@@ -0,0 +1,127 @@
+-- Test 'pgbinary' deserialization
+-- These tests do not require a Kafka instance. They can be run as common tests.
+
+-- start_matchignore
+-- m/^NOTICE:  Kafka-ADB: Offset for partition [0-9]* is not known, and is set to default value [0-9]*.*/
+-- end_matchignore
+
+-- start_ignore
+CREATE EXTENSION IF NOT EXISTS gp_inject_fault;
+
+DROP EXTENSION IF EXISTS kadb_fdw CASCADE;
+CREATE EXTENSION kadb_fdw;
+
+CREATE SERVER test_kadb_fdw_distribution_server
+FOREIGN DATA WRAPPER kadb_fdw
+OPTIONS (
+    k_brokers '0.0.0.0:9092'
+);
+-- end_ignore
+
+
+-- Test: Tuples with a header and a trailer
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(i INT, t TEXT, b BOOLEAN, f DOUBLE PRECISION, a INT[])
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'pgbinary',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    pgbinary_data_on_inject 'UEdDT1BZCv8NCgAAAAAAAAAAAAAFAAAABAAAAAEAAAANSGVsbG8sINC80LjRgAAAAAEBAAAACD/4AAAAAAAAAAAAJAAAAAEAAAAAAAAAFwAAAAIAAAABAAAABAAAAAEAAAAEAAAAAgAFAAAABAAAAAL/////AAAAAQAAAAAIv9AAAAAAAAD///////8='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_pgbinary', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t ORDER BY i;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: A tuple without a header
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET pgbinary_data_on_inject 'AAUAAAAEAAAAAwAAAAlubyBoZWFkZXL/////AAAACAAAAAAAAAAA/////w==');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_pgbinary', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for a tuple with a wrong number of fields
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET pgbinary_data_on_inject 'UEdDT1BZCv8NCgAAAAAAAAAAAAACAAAABAAAAAQAAAAIb25seSB0d2///w==');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_pgbinary', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for a field in an incorrect binary format
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET pgbinary_data_on_inject 'AAUAAAACAAH/////////////////////');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_pgbinary', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT * FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
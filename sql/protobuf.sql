@@ -0,0 +1,285 @@
+-- Test Protobuf deserialization
+-- These tests do not require a Kafka instance. They can be run as common tests.
+
+-- start_matchignore
+-- m/^NOTICE:  Kafka-ADB: Offset for partition [0-9]* is not known, and is set to default value [0-9]*.*/
+-- end_matchignore
+
+-- start_ignore
+CREATE EXTENSION IF NOT EXISTS gp_inject_fault;
+DROP EXTENSION IF EXISTS kadb_fdw CASCADE;
+CREATE EXTENSION kadb_fdw;
+
+CREATE SERVER test_kadb_fdw_distribution_server
+FOREIGN DATA WRAPPER kadb_fdw
+OPTIONS (
+    k_brokers '0.0.0.0:9092'
+);
+-- end_ignore
+
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+
+CREATE FOREIGN TABLE test_kadb_fdw_t(
+    id INT,
+    name TEXT,
+    big BIGINT,
+    v INT[] OPTIONS (protobuf_field 'vals'),
+    kind TEXT,
+    nested JSONB OPTIONS (protobuf_field 'inner'),
+    counts JSONB,
+    at TIMESTAMP,
+    raw BYTEA OPTIONS (protobuf_field '9'),
+    items JSONB[]
+)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+    k_initial_offset '40',
+
+    format 'protobuf',
+    protobuf_message 'test.Record',
+    protobuf_descriptor_set
+    'Cv8BCh9nb29nbGUvcHJvdG9idWYvdGltZXN0YW1wLnByb3RvEg9nb29nbGUucHJvdG9idWYiOwoJ'
+    'VGltZXN0YW1wEhgKB3NlY29uZHMYASABKANSB3NlY29uZHMSFAoFbmFub3MYAiABKAVSBW5hbm9z'
+    'QoUBChNjb20uZ29vZ2xlLnByb3RvYnVmQg5UaW1lc3RhbXBQcm90b1ABWjJnb29nbGUuZ29sYW5n'
+    'Lm9yZy9wcm90b2J1Zi90eXBlcy9rbm93bi90aW1lc3RhbXBwYvgBAaICA0dQQqoCHkdvb2dsZS5Q'
+    'cm90b2J1Zi5XZWxsS25vd25UeXBlc2IGcHJvdG8zCpkECgxyZWNvcmQucHJvdG8SBHRlc3QaH2dv'
+    'b2dsZS9wcm90b2J1Zi90aW1lc3RhbXAucHJvdG8i2QMKBlJlY29yZBIOCgJpZBgBIAEoBVICaWQS'
+    'EgoEbmFtZRgCIAEoCVIEbmFtZRIVCgNiaWcYAyABKANIAFIDYmlniAEBEhIKBHZhbHMYBCADKAVS'
+    'BHZhbHMSJQoEa2luZBgFIAEoDjIRLnRlc3QuUmVjb3JkLktpbmRSBGtpbmQSKAoFaW5uZXIYBiAB'
+    'KAsyEi50ZXN0LlJlY29yZC5Jbm5lclIFaW5uZXISMAoGY291bnRzGAcgAygLMhgudGVzdC5SZWNv'
+    'cmQuQ291bnRzRW50cnlSBmNvdW50cxIqCgJhdBgIIAEoCzIaLmdvb2dsZS5wcm90b2J1Zi5UaW1l'
+    'c3RhbXBSAmF0EhAKA3JhdxgJIAEoDFIDcmF3EigKBWl0ZW1zGAogAygLMhIudGVzdC5SZWNvcmQu'
+    'SW5uZXJSBWl0ZW1zGiMKBUlubmVyEgwKAWEYASABKAlSAWESDAoBbhgCIAMoBVIBbho5CgtDb3Vu'
+    'dHNFbnRyeRIQCgNrZXkYASABKAlSA2tleRIUCgV2YWx1ZRgCIAEoBVIFdmFsdWU6AjgBIi0KBEtp'
+    'bmQSCwoHVU5LTk9XThAAEgsKB0NSRUFURUQQARILCgdERUxFVEVEEAJCBgoEX2JpZ2IGcHJvdG8z',
+
+    k_tuples_per_partition_on_inject '1',
+    protobuf_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Scalars, repeated fields, nested messages, and maps
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET protobuf_data_on_inject
+'CAESA29uZRj7//////////8BIgQBAqwCKAIyBwoBeBICAQI6BgoCazEQAUIMCICHtcMDEIDKte4BSgIBAg=='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_protobuf', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT id, name, big, v, kind FROM test_kadb_fdw_t ORDER BY id;
+SELECT id, nested, counts, at, raw FROM test_kadb_fdw_t ORDER BY id;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Absent fields and repeated map keys
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET protobuf_data_on_inject
+'CAISA3R3bygBOgUKAWIQAjoFCgFhEAM='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_protobuf', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT id, name, big, v, kind FROM test_kadb_fdw_t ORDER BY id;
+SELECT id, nested, counts, at, raw FROM test_kadb_fdw_t ORDER BY id;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Repeated nested messages
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET protobuf_data_on_inject
+'CANSBwoBeBICAQJSAwoBeQ=='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_protobuf', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT id, items FROM test_kadb_fdw_t ORDER BY id;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Empty message
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET protobuf_data_on_inject
+''
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_protobuf', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT id, name, big, v, kind FROM test_kadb_fdw_t ORDER BY id;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Truncated message
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET protobuf_data_on_inject
+'CA=='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_protobuf', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT id FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Unexpected wire type
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET protobuf_data_on_inject
+'DQEAAAA='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_protobuf', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT id FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: A column with no corresponding field
+
+ALTER FOREIGN TABLE test_kadb_fdw_t ADD COLUMN nope INT;
+
+-- start_ignore
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_protobuf', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT id FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+ALTER FOREIGN TABLE test_kadb_fdw_t DROP COLUMN nope;
+
+-- Test: Undefined message type
+
+CREATE FOREIGN TABLE test_kadb_fdw_t_invalid_message(i INT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    format 'protobuf',
+    protobuf_message 'test.Nope',
+    protobuf_descriptor_set
+    'Cv8BCh9nb29nbGUvcHJvdG9idWYvdGltZXN0YW1wLnByb3RvEg9nb29nbGUucHJvdG9idWYiOwoJ'
+    'VGltZXN0YW1wEhgKB3NlY29uZHMYASABKANSB3NlY29uZHMSFAoFbmFub3MYAiABKAVSBW5hbm9z'
+    'QoUBChNjb20uZ29vZ2xlLnByb3RvYnVmQg5UaW1lc3RhbXBQcm90b1ABWjJnb29nbGUuZ29sYW5n'
+    'Lm9yZy9wcm90b2J1Zi90eXBlcy9rbm93bi90aW1lc3RhbXBwYvgBAaICA0dQQqoCHkdvb2dsZS5Q'
+    'cm90b2J1Zi5XZWxsS25vd25UeXBlc2IGcHJvdG8zCpkECgxyZWNvcmQucHJvdG8SBHRlc3QaH2dv'
+    'b2dsZS9wcm90b2J1Zi90aW1lc3RhbXAucHJvdG8i2QMKBlJlY29yZBIOCgJpZBgBIAEoBVICaWQS'
+    'EgoEbmFtZRgCIAEoCVIEbmFtZRIVCgNiaWcYAyABKANIAFIDYmlniAEBEhIKBHZhbHMYBCADKAVS'
+    'BHZhbHMSJQoEa2luZBgFIAEoDjIRLnRlc3QuUmVjb3JkLktpbmRSBGtpbmQSKAoFaW5uZXIYBiAB'
+    'KAsyEi50ZXN0LlJlY29yZC5Jbm5lclIFaW5uZXISMAoGY291bnRzGAcgAygLMhgudGVzdC5SZWNv'
+    'cmQuQ291bnRzRW50cnlSBmNvdW50cxIqCgJhdBgIIAEoCzIaLmdvb2dsZS5wcm90b2J1Zi5UaW1l'
+    'c3RhbXBSAmF0EhAKA3JhdxgJIAEoDFIDcmF3EigKBWl0ZW1zGAogAygLMhIudGVzdC5SZWNvcmQu'
+    'SW5uZXJSBWl0ZW1zGiMKBUlubmVyEgwKAWEYASABKAlSAWESDAoBbhgCIAMoBVIBbho5CgtDb3Vu'
+    'dHNFbnRyeRIQCgNrZXkYASABKAlSA2tleRIUCgV2YWx1ZRgCIAEoBVIFdmFsdWU6AjgBIi0KBEtp'
+    'bmQSCwoHVU5LTk9XThAAEgsKB0NSRUFURUQQARILCgdERUxFVEVEEAJCBgoEX2JpZ2IGcHJvdG8z'
+);
+
+-- Test: Invalid field reference
+
+CREATE FOREIGN TABLE test_kadb_fdw_t_invalid_field(i INT OPTIONS (protobuf_field '0'))
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    format 'protobuf'
+);
@@ -0,0 +1,363 @@
+-- Test 'raw' deserialization
+-- These tests do not require a Kafka instance. They can be run as common tests.
+
+-- start_matchignore
+-- m/^NOTICE:  Kafka-ADB: Offset for partition [0-9]* is not known, and is set to default value [0-9]*.*/
+-- end_matchignore
+
+-- start_ignore
+CREATE EXTENSION IF NOT EXISTS gp_inject_fault;
+
+DROP EXTENSION IF EXISTS kadb_fdw CASCADE;
+CREATE EXTENSION kadb_fdw;
+
+CREATE SERVER test_kadb_fdw_distribution_server
+FOREIGN DATA WRAPPER kadb_fdw
+OPTIONS (
+    k_brokers '0.0.0.0:9092'
+);
+-- end_ignore
+
+
+-- Test: BYTEA, data with NUL bytes
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(r BYTEA)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'raw',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    raw_data_on_inject 'YQBi/w=='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT r FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: BYTEA, empty message
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET raw_data_on_inject '');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT r, r IS NULL AS is_null FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
+
+
+-- Test: TEXT
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(t TEXT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'raw',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    raw_data_on_inject 'SGVsbG8sINC80LjRgA=='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for TEXT with a NUL byte
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET raw_data_on_inject 'YQBi');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: TEXT with a terminating NUL byte
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET raw_data_on_inject 'YWJjAA==');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: TEXT in WIN1251 encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET raw_data_on_inject 'SGVsbG8sIOzo8A==', ADD k_encoding 'WIN1251');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for TEXT in UTF8 encoding with a NUL byte
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET raw_data_on_inject '0J/RgNC40LLQtdGCLCDQvNC40YAhAGFiYw==', SET k_encoding 'UTF8');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: TEXT in UTF8 encoding with a terminating NUL byte
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET raw_data_on_inject '0J/RgNC40LLQtdGCLCDQvNC40YAhAA==', SET k_encoding 'UTF8');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for TEXT invalid in UTF8 encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET raw_data_on_inject '0J/RgNC40LLQtdGCLCDQvNC40YAhIEhlbGxvLCB3b3JsZCH/');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for an unknown encoding
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET k_encoding 'no_such_encoding');
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
+
+
+-- Test: JSONB
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(j JSONB)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'raw',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    raw_data_on_inject 'eyJiIjogMSwgImEiOiBbMSwgMl19'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT j FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: JSONB, empty message
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET raw_data_on_inject '');
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT j, j IS NULL AS is_null FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
+
+
+-- Test: ERROR for a column of an unsupported type
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(i INT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'raw',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    raw_data_on_inject 'NDI='
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_raw', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
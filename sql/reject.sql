@@ -0,0 +1,199 @@
+-- Test rejection of messages that fail to be deserialized
+-- These tests do not require a Kafka instance. They can be run as common tests.
+
+-- start_matchignore
+-- m/^NOTICE:  Kafka-ADB: Offset for partition [0-9]* is not known, and is set to default value [0-9]*.*/
+-- m/^NOTICE:  Kafka-ADB: [0-9]* messages were rejected because of deserialization errors.*/
+-- end_matchignore
+
+-- start_ignore
+CREATE EXTENSION IF NOT EXISTS gp_inject_fault;
+
+DROP EXTENSION IF EXISTS kadb_fdw CASCADE;
+CREATE EXTENSION kadb_fdw;
+
+CREATE SERVER test_kadb_fdw_distribution_server
+FOREIGN DATA WRAPPER kadb_fdw
+OPTIONS (
+    k_brokers '0.0.0.0:9092'
+);
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_t(i INT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'csv',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    csv_data_on_inject 'abc'
+);
+-- end_ignore
+
+
+-- Test: ERROR for an invalid message, without a reject limit
+
+-- start_ignore
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for 'k_log_errors' without 'k_reject_limit'
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_log_errors 'true');
+
+-- start_ignore
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for a non-positive 'k_reject_limit'
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_reject_limit '0');
+
+
+-- Test: Invalid messages are rejected and logged
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (ADD k_reject_limit '1');
+
+-- start_ignore
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+SELECT prt, off, error, data IS NULL AS no_data FROM kadb.error_log
+WHERE ftoid = 'test_kadb_fdw_t'::regclass;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR when the reject limit is exceeded
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET k_tuples_per_partition_on_inject '2');
+
+-- start_ignore
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+
+-- Messages rejected by a failed SELECT are not logged
+SELECT count(*) FROM kadb.error_log
+WHERE ftoid = 'test_kadb_fdw_t'::regclass;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: A message which is too large after decompression is rejected
+
+-- A snappy payload whose header declares 2^30 bytes of content
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET k_tuples_per_partition_on_inject '1', SET k_reject_limit '5', ADD payload_compression 'snappy', ADD payload_data_on_inject 'gICAgAQ=');
+
+-- start_ignore
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_payload', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+SELECT prt, off, error FROM kadb.error_log
+WHERE ftoid = 'test_kadb_fdw_t'::regclass AND error LIKE '%decompressed%';
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Rejected messages are logged in batches
+
+ALTER FOREIGN TABLE test_kadb_fdw_t OPTIONS (SET k_seg_batch '300', SET k_tuples_per_partition_on_inject '300', SET k_reject_limit '1000', DROP payload_compression, DROP payload_data_on_inject);
+
+-- start_ignore
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_csv', 'skip', dbid)
+FROM gp_segment_configuration;
+
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_t;
+SELECT count(*) FROM kadb.error_log
+WHERE ftoid = 'test_kadb_fdw_t'::regclass AND error LIKE 'invalid input syntax%';
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_t;
+-- end_ignore
@@ -268,3 +268,174 @@ DROP FOREIGN TABLE test_kadb_fdw_text;
 SELECT gp_inject_fault('all', 'reset', dbid)
 FROM gp_segment_configuration;
 -- end_ignore
+
+
+-- Test: Normal SELECT, INT data, one line per tuple
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_text(i INT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'text',
+    text_lines 'true',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    text_data_on_inject E'1\n2\r\n\n3\n'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_text', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_text;
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_text;
+
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Normal SELECT, empty data, one line per tuple
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_text(i INT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'text',
+    text_lines 'true',
+
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    text_data_on_inject ''
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_text', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT i FROM test_kadb_fdw_text;
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_text;
+
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- start_ignore
+CREATE FOREIGN TABLE test_kadb_fdw_text(t TEXT)
+SERVER test_kadb_fdw_distribution_server
+OPTIONS (
+    format 'text',
+    k_topic 'test_topic',
+    k_consumer_group 'test_consumer_group',
+    k_seg_batch '3',
+    k_timeout_ms '1000',
+
+    k_tuples_per_partition_on_inject '1',
+    text_data_on_inject ''
+);
+-- end_ignore
+
+
+-- Test: Text in UTF8 encoding, with a terminating NUL byte
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_text OPTIONS (ADD k_encoding 'UTF8', SET text_data_on_inject
+'Привет, мир!'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_text', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_text;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: Text in WIN1251 encoding, converted to the database encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_text OPTIONS (SET k_encoding 'WIN1251', SET text_data_on_inject
+'Привет, мир!'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_text', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_text;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+
+-- Test: ERROR for text with a character that has no equivalent in the database encoding
+
+-- start_ignore
+ALTER FOREIGN TABLE test_kadb_fdw_text OPTIONS (SET text_data_on_inject
+'И'
+);
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_tuples', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_partition_1_per_segment', 'skip', dbid)
+FROM gp_segment_configuration;
+
+SELECT gp_inject_fault_infinite('kadb_fdw_inject_text', 'skip', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+SELECT t FROM test_kadb_fdw_text;
+
+-- start_ignore
+SELECT gp_inject_fault('all', 'reset', dbid)
+FROM gp_segment_configuration;
+-- end_ignore
+
+-- start_ignore
+DROP FOREIGN TABLE test_kadb_fdw_text;
+-- end_ignore
@@ -18,3 +18,4 @@ ALTER EXTENSION kadb_fdw UPDATE TO '0.9';
 ALTER EXTENSION kadb_fdw UPDATE TO '0.10';
 ALTER EXTENSION kadb_fdw UPDATE TO '0.10.1';
 ALTER EXTENSION kadb_fdw UPDATE TO '0.10.2';
+ALTER EXTENSION kadb_fdw UPDATE TO '0.11';
@@ -1,19 +1,31 @@
 #include "api.h"
 
 #include <nodes/parsenodes.h>
-#include <utils/faultinjector.h>
 
 #include "settings.h"
-#include "deserialization/avro_deserializer.h"
-#include "deserialization/csv_deserializer.h"
-#include "deserialization/text_deserializer.h"
 #include "deserialization/format.h"
+#include "deserialization/payload_compression.h"
+#include "deserialization/record_filter.h"
 
 
+/* The number of records 'deserialize()' allocates space for at first */
+#define DESERIALIZED_RECORDS_MIN_CAPACITY 8
+
 typedef struct DeserializationMetadataObject
 {
-	enum DeserializationFormat format;
+	const DeserializationFormatRoutine *format;
+	/* The state returned by 'format->prepare' */
 	void	   *data;
+	/* Conditions records must satisfy; NULL if there are none */
+	RecordFilter filter;
+	/* Decompressor of payloads; NULL if they are not compressed */
+	PayloadDecompressor decompressor;
+	/* Worker threads decoding messages ahead; NULL if there are none */
+	DecodePool	pool;
+	int			pool_threads;
+	/* The task which decoded the CURRENT message, or NULL */
+	DecodeTask	task;
+	TupleDesc	tupledesc;
 }	DeserializationMetadataObject;
 
 
@@ -25,70 +37,143 @@ prepare_deserialization(TupleDesc tupledesc, List *options)
 
 	DeserializationMetadata result = palloc(sizeof(DeserializationMetadataObject));
 
-	/* Deserialization format is validated when options are parsed */
+	result->tupledesc = tupledesc;
+
+	/*
+	 * Deserialization format is validated when options are parsed, but a
+	 * format registered by a library may be missing on segments
+	 */
 	result->format = resolve_deserialization_format(defGetString(get_option(options, KADB_SETTING_FORMAT)));
-	switch (result->format)
+	if (!PointerIsValid(result->format))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: Deserialization format '%s' is not known", defGetString(get_option(options, KADB_SETTING_FORMAT))), errhint("A library that registers a deserialization format must be loaded by every segment, e.g. by 'shared_preload_libraries'")));
+	result->data = result->format->prepare(tupledesc, options);
+	result->filter = prepare_record_filter(tupledesc, options);
+	result->decompressor = payload_decompressor_create(options);
+
+	DefElem    *decode_threads = get_option(options, KADB_SETTING_K_DECODE_THREADS);
+
+	result->pool = NULL;
+	result->pool_threads = 0;
+	result->task = NULL;
+
+	/*
+	 * Compressed payloads are not decoded ahead: they are decompressed into
+	 * a buffer reused for each message
+	 */
+	if (PointerIsValid(decode_threads) && defGetInt64(decode_threads) > 0 && PointerIsValid(result->format->prepare_decode) && !PointerIsValid(result->decompressor))
 	{
-		case AVRO:
-			initialize_libavro_for_postgres();
-			result->data = prepare_deserialization_metadata_avro(
-																 tupledesc,
-																 PointerIsValid(get_option(options, KADB_SETTING_AVRO_SCHEMA)) ? defGetString(get_option(options, KADB_SETTING_AVRO_SCHEMA)) : NULL
-				);
-			break;
-		case CSV:
-			result->data = prepare_deserialization_csv(tupledesc, options);
-			break;
-		case TEXT:
-			result->data = prepare_deserialization_text(tupledesc, options);
-			break;
-		default:
-			Assert(false);
-			break;
+		result->pool_threads = (int) defGetInt64(decode_threads);
+		result->pool = decode_pool_create(result->pool_threads);
 	}
 
 	return result;
 }
 
-List *
-deserialize(DeserializationMetadata metadata, void *data, size_t data_l)
+int
+get_decode_threads(DeserializationMetadata metadata)
+{
+	AssertArg(PointerIsValid(metadata));
+
+	return metadata->pool_threads;
+}
+
+DecodeTask
+decode_ahead(DeserializationMetadata metadata, void *data, size_t data_l)
+{
+	AssertArg(PointerIsValid(metadata));
+
+	if (!PointerIsValid(metadata->pool))
+		return NULL;
+
+	void	   *arg = metadata->format->prepare_decode(metadata->data, data, data_l);
+
+	if (!PointerIsValid(arg))
+		return NULL;
+	return decode_pool_submit(metadata->pool, metadata->format->decode, metadata->format->discard_decoded, arg);
+}
+
+void
+discard_decode_task(DeserializationMetadata metadata, DecodeTask task)
+{
+	AssertArg(PointerIsValid(metadata));
+
+	if (PointerIsValid(task))
+		decode_pool_release(metadata->pool, task);
+}
+
+void
+begin_deserialization(DeserializationMetadata metadata, void *data, size_t data_l, DecodeTask task)
 {
 	AssertArg(PointerIsValid(metadata));
-	AssertArg(metadata->format >= 0 && metadata->format < DESERIALIZATION_FORMAT_INVALID);
 
-	switch (metadata->format)
+	/* The result of decoding the previous message is not needed anymore */
+	discard_decode_task(metadata, metadata->task);
+	metadata->task = NULL;
+
+	if (!PointerIsValid(task))
 	{
-		case AVRO:
-			return deserialize_avro((AvroDeserializationMetadata) metadata->data, data, data_l);
-		case CSV:
-			return deserialize_csv((CSVDeserializationState) metadata->data, data, data_l);
-		case TEXT:
-			return deserialize_text((TextDeserializationState) metadata->data, data, data_l);
-		default:
-			Assert(false);
-			return NIL;
+		if (PointerIsValid(metadata->decompressor))
+			data = payload_decompress(metadata->decompressor, data, &data_l);
+		metadata->format->begin(metadata->data, data, data_l);
+		return;
 	}
+
+	metadata->task = task;
+	metadata->format->begin_decoded(metadata->data, decode_pool_wait(metadata->pool, task));
+}
+
+bool
+deserialize_next(DeserializationMetadata metadata, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(metadata));
+
+	while (metadata->format->next(metadata->data, values, nulls))
+	{
+		if (record_filter_passes(metadata->filter, values, nulls))
+			return true;
+	}
+	return false;
 }
 
 void
-finish_deserialization(DeserializationMetadata metadata)
+deserialize(DeserializationMetadata metadata, void *data, size_t data_l, DecodeTask task, KadbArena arena, DeserializedRecords * records)
 {
 	AssertArg(PointerIsValid(metadata));
-	AssertArg(metadata->format >= 0 && metadata->format < DESERIALIZATION_FORMAT_INVALID);
+	AssertArg(PointerIsValid(records));
 
-	switch (metadata->format)
+	records->natts = metadata->tupledesc->natts;
+	records->record_size = MAXALIGN((sizeof(Datum) + sizeof(bool)) * Max(records->natts, 1));
+	records->count = 0;
+	records->capacity = DESERIALIZED_RECORDS_MIN_CAPACITY;
+	records->records = kadb_arena_alloc(arena, records->record_size * records->capacity);
+
+	begin_deserialization(metadata, data, data_l, task);
+	while (true)
 	{
-		case AVRO:
-			break;
-		case CSV:
-			finish_deserialization_csv((CSVDeserializationState) metadata->data);
-			break;
-		case TEXT:
-			break;
-		default:
-			Assert(false);
+		/* The array is the last allocation in 'arena', so it usually grows in place */
+		if (records->count == records->capacity)
+		{
+			records->records = kadb_arena_realloc(arena, records->records, records->record_size * records->capacity, records->record_size * records->capacity * 2);
+			records->capacity *= 2;
+		}
+
+		if (!deserialize_next(metadata, DESERIALIZED_RECORD_VALUES(records, records->count), DESERIALIZED_RECORD_NULLS(records, records->count)))
 			break;
+		records->count += 1;
 	}
+}
+
+void
+finish_deserialization(DeserializationMetadata metadata)
+{
+	AssertArg(PointerIsValid(metadata));
+
+	if (PointerIsValid(metadata->format->finish))
+		metadata->format->finish(metadata->data);
+	if (PointerIsValid(metadata->pool))
+		decode_pool_destroy(metadata->pool);
+	if (PointerIsValid(metadata->decompressor))
+		payload_decompressor_destroy(metadata->decompressor);
 
 	pfree(metadata);
 }
@@ -8,28 +8,110 @@
 #include <postgres.h>
 #include <access/tupdesc.h>
 
+#include "utils/kadb_arena.h"
+#include "utils/kadb_decode_pool.h"
+
 
 /* Opaque binary object used to store deserialization metadata */
 typedef struct DeserializationMetadataObject *DeserializationMetadata;
 
+/*
+ * Records of a message deserialized completely, stored in a flat array. Each
+ * element is a record: 'natts' values followed by 'natts' nulls.
+ */
+typedef struct DeserializedRecords
+{
+	char	   *records;
+	/* The size of an element of 'records' */
+	Size		record_size;
+	int			natts;
+	int			count;
+	int			capacity;
+}	DeserializedRecords;
+
+/* Values and nulls of record 'i' of 'DeserializedRecords *records' */
+#define DESERIALIZED_RECORD_VALUES(records, i) ((Datum *) ((records)->records + (Size) (i) * (records)->record_size))
+#define DESERIALIZED_RECORD_NULLS(records, i) ((bool *) (DESERIALIZED_RECORD_VALUES(records, i) + (records)->natts))
+
 
 /**
  * Prepare 'DeserializationMetadata' and initialize the deserialization
  * implementation requested in 'options'.
  *
+ * Attributes not listed in the internal option
+ * 'KADB_SETTING__ATTRIBUTES_REQUIRED' (when it is present) are not converted
+ * and are always NULL in the resulting tuples.
+ *
+ * Records which do not satisfy the conditions in the internal option
+ * 'KADB_SETTING__EARLY_QUALS' (when it is present) are not produced.
+ *
+ * When 'KADB_SETTING_K_DECODE_THREADS' is set and the format supports it, a
+ * pool of worker threads is created to decode messages ahead.
+ *
  * This method calls 'elog(ERROR)' if an error is found in 'options'.
  */
 DeserializationMetadata prepare_deserialization(TupleDesc tupledesc, List *options);
 
 /**
- * Deserialize binary 'data' of length 'data_l'.
+ * @return the number of worker threads decoding messages ahead, or 0 if
+ * messages are not decoded ahead
+ */
+int			get_decode_threads(DeserializationMetadata metadata);
+
+/**
+ * Start to decode binary 'data' of length 'data_l' (a message) by a worker
+ * thread. 'data' must stay valid until the message is started by
+ * 'begin_deserialization()', or the task is discarded.
+ *
+ * @return a task to pass to 'begin_deserialization()' or
+ * 'discard_decode_task()', or NULL if the message is not decoded ahead
+ */
+DecodeTask	decode_ahead(DeserializationMetadata metadata, void *data, size_t data_l);
+
+/**
+ * Discard a 'task' returned by 'decode_ahead()' whose message is not going to
+ * be deserialized. 'task' may be NULL.
+ */
+void		discard_decode_task(DeserializationMetadata metadata, DecodeTask task);
+
+/**
+ * Start to deserialize binary 'data' of length 'data_l' (a message). Its
+ * records are then produced one at a time by 'deserialize_next()'.
+ *
+ * 'data' must stay valid until all records are produced, or until the next
+ * message is started. Memory the deserializer needs for the whole message is
+ * allocated in CurrentMemoryContext; it must not be reset before that either.
+ *
+ * @param task the result of 'decode_ahead()' for the same 'data', or NULL
+ *
+ * This method calls 'elog(ERROR)' if a parse error happens.
+ */
+void		begin_deserialization(DeserializationMetadata metadata, void *data, size_t data_l, DecodeTask task);
+
+/**
+ * Deserialize the next record of the message into 'values' and 'nulls', which
+ * have an element for each attribute of 'tupledesc' given to
+ * 'prepare_deserialization()'.
+ *
+ * Datums are allocated by palloc in CurrentMemoryContext, which may be reset
+ * after each record. Records discarded by early quals are allocated there too.
  *
  * This method calls 'elog(ERROR)' if a parse error happens.
  *
- * @return a list of HeapTuples, allocated by palloc in CurrentMemoryContext.
- * @return NIL (empty list) if 'data' is NULL or 'data_l' is 0
+ * @return 'false' if there are no more records in the message
+ */
+bool		deserialize_next(DeserializationMetadata metadata, Datum *values, bool *nulls);
+
+/**
+ * Deserialize binary 'data' of length 'data_l' completely into 'records'.
+ * 'task' is the same as for 'begin_deserialization()'.
+ *
+ * The array of records is allocated in 'arena'; Datums are allocated by palloc
+ * in CurrentMemoryContext. Both must not be reset until the records are used.
+ *
+ * This method calls 'elog(ERROR)' if a parse error happens.
  */
-List	   *deserialize(DeserializationMetadata metadata, void *data, size_t data_l);
+void		deserialize(DeserializationMetadata metadata, void *data, size_t data_l, DecodeTask task, KadbArena arena, DeserializedRecords * records);
 
 /**
  * Finish the deserialization: close all opened structures, release memory, etc.
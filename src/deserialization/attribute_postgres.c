@@ -1,11 +1,529 @@
 #include "attribute_postgres.h"
 
+#include <limits.h>
+
+#include <catalog/pg_type.h>
+#include <pgtime.h>
+#include <utils/date.h>
+#include <utils/datetime.h>
+#include <utils/timestamp.h>
+
+#include "settings.h"
+
+
+/*
+ * Specialized input functions.
+ *
+ * Each function accepts only a canonical, unambiguous form of a value, for
+ * which the result is exactly the same as the one of the type's input
+ * function. For anything else (whitespace, special values, values that
+ * require rounding or are out of range, etc.) the generic input function is
+ * called, which also reports errors.
+ */
+
+/* The maximum number of decimal digits that always fit in a uint64 */
+#define FAST_INPUT_MAX_INTEGER_DIGITS 18
+/* The maximum number of significant digits that always fit in a double */
+#define FAST_INPUT_MAX_FLOAT_DIGITS 15
+/* The maximum power of ten that is exactly representable by a double */
+#define FAST_INPUT_MAX_EXACT_POWER_OF_10 22
+/* The maximum number of fractional digits of a timestamp (microseconds) */
+#define FAST_INPUT_MAX_FSEC_DIGITS 6
+/* The maximum hours of a time zone displacement accepted by PostgreSQL */
+#define FAST_INPUT_MAX_TZDISP_HOUR 15
+
+static const double exact_powers_of_10[FAST_INPUT_MAX_EXACT_POWER_OF_10 + 1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+/**
+ * Parse exactly 'n' decimal digits at 'p'.
+ */
+static inline bool
+parse_fixed_digits(const char *p, int n, int *result)
+{
+	int			value = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		if (p[i] < '0' || p[i] > '9')
+			return false;
+		value = value * 10 + (p[i] - '0');
+	}
+	*result = value;
+	return true;
+}
+
+/**
+ * Parse an optionally signed decimal integer of at most
+ * FAST_INPUT_MAX_INTEGER_DIGITS digits.
+ */
+static bool
+parse_integer(const char *value, size_t value_l, int64 *result)
+{
+	const char *p = value;
+	const char *end = value + value_l;
+	bool		is_negative = false;
+	uint64		accumulator = 0;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		is_negative = *p == '-';
+		p += 1;
+	}
+	if (p == end || end - p > FAST_INPUT_MAX_INTEGER_DIGITS)
+		return false;
+
+	for (; p < end; p++)
+	{
+		if (*p < '0' || *p > '9')
+			return false;
+		accumulator = accumulator * 10 + (*p - '0');
+	}
+
+	*result = is_negative ? -(int64) accumulator : (int64) accumulator;
+	return true;
+}
+
+static bool
+fast_int2in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	int64		parsed;
+
+	if (!parse_integer(value, value_l, &parsed) || parsed < SHRT_MIN || parsed > SHRT_MAX)
+		return false;
+	*result = Int16GetDatum((int16) parsed);
+	return true;
+}
+
+static bool
+fast_int4in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	int64		parsed;
+
+	if (!parse_integer(value, value_l, &parsed) || parsed < INT_MIN || parsed > INT_MAX)
+		return false;
+	*result = Int32GetDatum((int32) parsed);
+	return true;
+}
+
+static bool
+fast_int8in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	int64		parsed;
+
+	if (!parse_integer(value, value_l, &parsed))
+		return false;
+	*result = Int64GetDatum(parsed);
+	return true;
+}
+
+/**
+ * Parse a decimal floating-point number.
+ *
+ * Only numbers with at most FAST_INPUT_MAX_FLOAT_DIGITS significant digits
+ * and a small decimal exponent are accepted. Both the significand and the
+ * power of ten are then exact doubles, and a single multiplication or
+ * division gives the correctly rounded result, i.e. the same as 'strtod()'.
+ */
+static bool
+parse_float(const char *value, size_t value_l, double *result)
+{
+	const char *p = value;
+	const char *end = value + value_l;
+	bool		is_negative = false;
+	uint64		significand = 0;
+	int			significant_digits = 0;
+	int			digits = 0;
+	int			exponent = 0;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		is_negative = *p == '-';
+		p += 1;
+	}
+
+	for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+	{
+		significand = significand * 10 + (*p - '0');
+		if (significand != 0)
+			significant_digits += 1;
+	}
+	if (p < end && *p == '.')
+	{
+		for (p += 1; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+		{
+			significand = significand * 10 + (*p - '0');
+			if (significand != 0)
+				significant_digits += 1;
+			exponent -= 1;
+		}
+	}
+	if (digits == 0 || significant_digits > FAST_INPUT_MAX_FLOAT_DIGITS)
+		return false;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		int			explicit_exponent;
+		int			exponent_digits = 0;
+		bool		exponent_is_negative = false;
+
+		p += 1;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			exponent_is_negative = *p == '-';
+			p += 1;
+		}
+		for (explicit_exponent = 0; p < end && *p >= '0' && *p <= '9' && exponent_digits < 3; p++, exponent_digits++)
+			explicit_exponent = explicit_exponent * 10 + (*p - '0');
+		if (exponent_digits == 0)
+			return false;
+		exponent += exponent_is_negative ? -explicit_exponent : explicit_exponent;
+	}
+	if (p != end)
+		return false;
+
+	double		parsed = (double) significand;
+
+	if (significand != 0)
+	{
+		if (exponent < -FAST_INPUT_MAX_EXACT_POWER_OF_10 || exponent > FAST_INPUT_MAX_EXACT_POWER_OF_10)
+			return false;
+		if (exponent < 0)
+			parsed /= exact_powers_of_10[-exponent];
+		else
+			parsed *= exact_powers_of_10[exponent];
+	}
+
+	*result = is_negative ? -parsed : parsed;
+	return true;
+}
+
+static bool
+fast_float4in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	double		parsed;
+
+	/* 'float4in()' parses a double and then narrows it */
+	if (!parse_float(value, value_l, &parsed))
+		return false;
+	*result = Float4GetDatum((float4) parsed);
+	return true;
+}
+
+static bool
+fast_float8in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	double		parsed;
+
+	if (!parse_float(value, value_l, &parsed))
+		return false;
+	*result = Float8GetDatum(parsed);
+	return true;
+}
+
+static bool
+fast_boolin(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	if (value_l == 1)
+	{
+		if (value[0] == 't' || value[0] == '1')
+			*result = BoolGetDatum(true);
+		else if (value[0] == 'f' || value[0] == '0')
+			*result = BoolGetDatum(false);
+		else
+			return false;
+		return true;
+	}
+	if (value_l == 4 && memcmp(value, "true", 4) == 0)
+	{
+		*result = BoolGetDatum(true);
+		return true;
+	}
+	if (value_l == 5 && memcmp(value, "false", 5) == 0)
+	{
+		*result = BoolGetDatum(false);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Parse an ISO 8601 date 'YYYY-MM-DD' at the start of 'value'.
+ *
+ * @return the Julian day number, or -1 if the date is not valid
+ */
+static int
+parse_iso_date(const char *value)
+{
+	int			year;
+	int			month;
+	int			day;
+
+	if (value[4] != '-' || value[7] != '-' ||
+		!parse_fixed_digits(value, 4, &year) ||
+		!parse_fixed_digits(value + 5, 2, &month) ||
+		!parse_fixed_digits(value + 8, 2, &day))
+		return -1;
+	if (year < 1 || month < 1 || month > MONTHS_PER_YEAR || day < 1 || day > day_tab[isleap(year)][month - 1])
+		return -1;
+	return date2j(year, month, day);
+}
+
+static bool
+fast_date_in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	int			julian;
+
+	if (value_l != 10 || (julian = parse_iso_date(value)) < 0)
+		return false;
+	*result = DateADTGetDatum((DateADT) (julian - POSTGRES_EPOCH_JDATE));
+	return true;
+}
+
+#ifdef HAVE_INT64_TIMESTAMP
+/**
+ * Parse an ISO 8601 timestamp 'YYYY-MM-DD HH:MM:SS[.ffffff]' (a 'T' may be
+ * used instead of a space) at the start of 'value'.
+ *
+ * @param result set to the timestamp in local time
+ * @param tm set to the fields of the timestamp
+ * @param end set to the next byte after the timestamp
+ *
+ * @return 'false' if the timestamp is not valid
+ */
+static bool
+parse_iso_timestamp(const char *value, size_t value_l, int32 attypmod, Timestamp *result, struct pg_tm * tm, const char **end)
+{
+	/* The length of 'YYYY-MM-DD HH:MM:SS' */
+	const size_t seconds_l = 19;
+	int			julian;
+	int			fsec = 0;
+	int			fsec_digits = 0;
+
+	if (value_l < seconds_l || (julian = parse_iso_date(value)) < 0)
+		return false;
+	if ((value[10] != ' ' && value[10] != 'T') || value[13] != ':' || value[16] != ':' ||
+		!parse_fixed_digits(value + 11, 2, &tm->tm_hour) ||
+		!parse_fixed_digits(value + 14, 2, &tm->tm_min) ||
+		!parse_fixed_digits(value + 17, 2, &tm->tm_sec))
+		return false;
+	if (tm->tm_hour >= HOURS_PER_DAY || tm->tm_min >= MINS_PER_HOUR || tm->tm_sec >= SECS_PER_MINUTE)
+		return false;
+
+	const char *p = value + seconds_l;
+	const char *value_end = value + value_l;
+
+	if (p < value_end && *p == '.')
+	{
+		for (p += 1; p < value_end && *p >= '0' && *p <= '9'; p++)
+		{
+			if (++fsec_digits > FAST_INPUT_MAX_FSEC_DIGITS)
+				return false;
+			fsec = fsec * 10 + (*p - '0');
+		}
+		if (fsec_digits == 0)
+			return false;
+		for (int i = fsec_digits; i < FAST_INPUT_MAX_FSEC_DIGITS; i++)
+			fsec *= 10;
+	}
+
+	/* Values that must be rounded to the precision of the type */
+	if (attypmod >= 0 && fsec_digits > attypmod)
+		return false;
+
+	j2date(julian, &tm->tm_year, &tm->tm_mon, &tm->tm_mday);
+	*end = p;
+
+	*result = ((Timestamp) (julian - POSTGRES_EPOCH_JDATE) * SECS_PER_DAY +
+			   tm->tm_hour * SECS_PER_HOUR + tm->tm_min * SECS_PER_MINUTE + tm->tm_sec) * USECS_PER_SEC + fsec;
+	return true;
+}
+
+/**
+ * Parse a time zone displacement: 'Z', '+HH', '+HHMM', or '+HH:MM' (or the
+ * same with '-').
+ *
+ * @return 'false' if 'value' is not a displacement
+ */
+static bool
+parse_tz_displacement(const char *value, size_t value_l, int *seconds_east)
+{
+	int			hours;
+	int			minutes = 0;
+
+	if (value_l == 1 && value[0] == 'Z')
+	{
+		*seconds_east = 0;
+		return true;
+	}
+	if (value_l < 3 || (value[0] != '+' && value[0] != '-') || !parse_fixed_digits(value + 1, 2, &hours))
+		return false;
+	if (value_l == 5)
+	{
+		if (!parse_fixed_digits(value + 3, 2, &minutes))
+			return false;
+	}
+	else if (value_l == 6)
+	{
+		if (value[3] != ':' || !parse_fixed_digits(value + 4, 2, &minutes))
+			return false;
+	}
+	else if (value_l != 3)
+		return false;
+	if (hours > FAST_INPUT_MAX_TZDISP_HOUR || minutes >= MINS_PER_HOUR)
+		return false;
+
+	*seconds_east = (hours * SECS_PER_HOUR + minutes * SECS_PER_MINUTE) * (value[0] == '-' ? -1 : 1);
+	return true;
+}
+
+static bool
+fast_timestamp_in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	Timestamp	timestamp;
+	struct pg_tm tm;
+	const char *end;
+
+	if (!parse_iso_timestamp(value, value_l, attypmod, &timestamp, &tm, &end) || end != value + value_l)
+		return false;
+	*result = TimestampGetDatum(timestamp);
+	return true;
+}
+
+static bool
+fast_timestamptz_in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	Timestamp	timestamp;
+	struct pg_tm tm;
+	const char *end;
+	int			seconds_east;
+
+	if (!parse_iso_timestamp(value, value_l, attypmod, &timestamp, &tm, &end))
+		return false;
+
+	if (end == value + value_l)
+	{
+		/* No explicit time zone: the session one is used */
+		tm.tm_isdst = -1;
+		seconds_east = -DetermineTimeZoneOffset(&tm, session_timezone);
+	}
+	else if (!parse_tz_displacement(end, value + value_l - end, &seconds_east))
+		return false;
+
+	*result = TimestampTzGetDatum((TimestampTz) (timestamp - (Timestamp) seconds_east * USECS_PER_SEC));
+	return true;
+}
+#endif
+
+static bool
+fast_numeric_in(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	int64		parsed;
+
+	/* Only integers are handled; the result is the same as of 'numeric_in()' */
+	if (!parse_integer(value, value_l, &parsed))
+		return false;
+	*result = DirectFunctionCall1(int8_numeric, Int64GetDatum(parsed));
+	if (attypmod >= (int32) VARHDRSZ)
+		*result = DirectFunctionCall2(numeric, *result, Int32GetDatum(attypmod));
+	return true;
+}
+
+static bool
+fast_textin(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	/* Input functions see values as C strings */
+	*result = PointerGetDatum(cstring_to_text_with_len(value, strnlen(value, value_l)));
+	return true;
+}
+
+static bool
+fast_varcharin(const char *value, size_t value_l, int32 attypmod, Datum *result)
+{
+	size_t		length = strnlen(value, value_l);
+
+	/* Values that may need to be truncated */
+	if (attypmod >= (int32) VARHDRSZ && length > (size_t) (attypmod - VARHDRSZ))
+		return false;
+	*result = PointerGetDatum(cstring_to_text_with_len(value, length));
+	return true;
+}
+
+void
+set_fast_input_function(FunctionCallCompleteData * fcd, Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+			fcd->fast_iofunc = fast_int2in;
+			break;
+		case INT4OID:
+			fcd->fast_iofunc = fast_int4in;
+			break;
+		case INT8OID:
+			fcd->fast_iofunc = fast_int8in;
+			break;
+		case FLOAT4OID:
+			fcd->fast_iofunc = fast_float4in;
+			break;
+		case FLOAT8OID:
+			fcd->fast_iofunc = fast_float8in;
+			break;
+		case BOOLOID:
+			fcd->fast_iofunc = fast_boolin;
+			break;
+		case DATEOID:
+			fcd->fast_iofunc = fast_date_in;
+			break;
+#ifdef HAVE_INT64_TIMESTAMP
+		case TIMESTAMPOID:
+			fcd->fast_iofunc = fast_timestamp_in;
+			break;
+		case TIMESTAMPTZOID:
+			fcd->fast_iofunc = fast_timestamptz_in;
+			break;
+#endif
+		case NUMERICOID:
+			fcd->fast_iofunc = fast_numeric_in;
+			break;
+		case TEXTOID:
+			fcd->fast_iofunc = fast_textin;
+			break;
+		case VARCHAROID:
+			fcd->fast_iofunc = fast_varcharin;
+			break;
+		default:
+			fcd->fast_iofunc = NULL;
+	}
+}
+
+
+/**
+ * Check whether the attribute 'attnum' is referenced by the query, according
+ * to 'options'.
+ */
+static bool
+is_attribute_required(List *options, AttrNumber attnum)
+{
+	DefElem    *attributes_required = get_option(options, KADB_SETTING__ATTRIBUTES_REQUIRED);
+
+	/* No option means all attributes are required */
+	if (!PointerIsValid(attributes_required))
+		return true;
+
+	return list_member_int((List *) attributes_required->arg, attnum);
+}
 
 void
-fill_attribute_deserialization_info(AttributeDeserializationInfo * adi, TupleDesc tupledesc, size_t i)
+fill_attribute_deserialization_info(AttributeDeserializationInfo * adi, TupleDesc tupledesc, size_t i, List *options)
 {
 	adi->is_dropped = tupledesc->attrs[i]->attisdropped;
-	if (adi->is_dropped)
+	adi->is_skipped = adi->is_dropped || !is_attribute_required(options, (AttrNumber) (i + 1));
+	adi->value_cache = NULL;
+	if (adi->is_skipped)
 		return;
 
 	Oid			tmp_fn_oid;
@@ -13,4 +531,24 @@ fill_attribute_deserialization_info(AttributeDeserializationInfo * adi, TupleDes
 	getTypeInputInfo(tupledesc->attrs[i]->atttypid, &tmp_fn_oid, &adi->io_fn_textual.typioparam);
 	fmgr_info(tmp_fn_oid, &adi->io_fn_textual.iofunc);
 	adi->io_fn_textual.attypmod = tupledesc->attrs[i]->atttypmod;
+	set_fast_input_function(&adi->io_fn_textual, tupledesc->attrs[i]->atttypid);
+
+	/* Binary input function is looked up, but not required to be present */
+	int16		typlen;
+	bool		typbyval;
+	char		typalign;
+	char		typdelim;
+
+	get_type_io_data(tupledesc->attrs[i]->atttypid, IOFunc_receive, &typlen, &typbyval, &typalign, &typdelim, &adi->io_fn_binary.typioparam, &tmp_fn_oid);
+	if (OidIsValid(tmp_fn_oid))
+		fmgr_info(tmp_fn_oid, &adi->io_fn_binary.iofunc);
+	else
+		adi->io_fn_binary.iofunc.fn_oid = InvalidOid;
+	adi->io_fn_binary.attypmod = tupledesc->attrs[i]->atttypmod;
+	adi->io_fn_binary.fast_iofunc = NULL;
+
+	DefElem    *value_cache_option = get_column_option(options, (AttrNumber) (i + 1), KADB_SETTING_VALUE_CACHE);
+
+	if (PointerIsValid(value_cache_option))
+		adi->value_cache = create_value_cache((int) defGetInt64(value_cache_option), (AttrNumber) (i + 1), tupledesc->attrs[i]->attbyval, tupledesc->attrs[i]->attlen);
 }
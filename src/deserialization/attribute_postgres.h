@@ -12,6 +12,17 @@
 #include <utils/faultinjector.h>
 #include <utils/lsyscache.h>
 
+#include "deserialization/value_cache.h"
+
+
+/**
+ * A specialized input function for a textual 'value' of length 'value_l',
+ * which need not be null-terminated.
+ *
+ * @return 'false' if 'value' is not in a form the function handles; the
+ * generic input function must be called then (it also reports errors)
+ */
+typedef bool (*FastInputFunction) (const char *value, size_t value_l, int32 attypmod, Datum *result);
 
 /**
  * A complete set of data to call an input function.
@@ -21,30 +32,72 @@ typedef struct FunctionCallCompleteData
 	FmgrInfo	iofunc;
 	Oid			typioparam;
 	int32		attypmod;
+	/* A specialized input function, or NULL if the type has none */
+	FastInputFunction fast_iofunc;
 }	FunctionCallCompleteData;
 
 /**
  * A structure to hold a description of a single tuple attribute.
  *
  * The fields in this structure are extracted from 'TupleDesc'; its presence
- * solves two problems:
- * 1. 'iofunc' and 'typioparam' are obtained by a lengthy function call
+ * solves three problems:
+ * 1. 'iofunc' and 'typioparam' of both input functions are obtained by a
+ * lengthy function call
  * 2. Dropped columns can be handled properly
+ * 3. Attributes not referenced by the query can be skipped
  */
 typedef struct AttributeDeserializationInfo
 {
 	/* Dropped attribute, does not require decoding */
 	bool		is_dropped;
+
+	/*
+	 * Attribute is not converted and is always NULL. Set for dropped
+	 * attributes and for attributes not referenced by the query (which are
+	 * still present in the serialized data)
+	 */
+	bool		is_skipped;
 	/* Textual input function */
 	FunctionCallCompleteData io_fn_textual;
+
+	/*
+	 * Binary input ('typreceive') function. 'iofunc.fn_oid' is InvalidOid if
+	 * the type has none
+	 */
+	FunctionCallCompleteData io_fn_binary;
+	/* A cache of results of the input function, or NULL if it is not enabled */
+	ValueCache	value_cache;
 }	AttributeDeserializationInfo;
 
 
 /**
  * Fill the given 'adi' with appropriate data (from 'tupledesc' and extracted
  * from the database).
+ *
+ * @param options FOREIGN TABLE options; used to determine whether the
+ * attribute is required by the query, and whether its values are cached
+ *
+ * @note The value cache is allocated in CurrentMemoryContext
  */
-void		fill_attribute_deserialization_info(AttributeDeserializationInfo * adi, TupleDesc tupledesc, size_t i);
+void		fill_attribute_deserialization_info(AttributeDeserializationInfo * adi, TupleDesc tupledesc, size_t i, List *options);
+
+/**
+ * Set 'fcd->fast_iofunc' to a specialized input function for type 'typid',
+ * if there is one.
+ */
+void		set_fast_input_function(FunctionCallCompleteData * fcd, Oid typid);
+
+/**
+ * Convert a textual 'value' of length 'value_l' (not necessarily
+ * null-terminated) by the specialized input function of 'fcd'.
+ *
+ * @return 'false' if the generic input function must be called instead
+ */
+static inline bool
+fast_input_function_call(const FunctionCallCompleteData * fcd, const char *value, size_t value_l, Datum *result)
+{
+	return PointerIsValid(fcd->fast_iofunc) && fcd->fast_iofunc(value, value_l, fcd->attypmod, result);
+}
 
 
 #endif   /* //
@@ -4,6 +4,7 @@
 #ifdef __APPLE__
 #include <libkern/OSByteOrder.h>
 #define le32toh(x) OSSwapLittleToHostInt32(x)
+#define le64toh(x) OSSwapLittleToHostInt64(x)
 #else
 #include <endian.h>
 #endif
@@ -15,16 +16,25 @@
 #include <avro.h>
 
 #include <access/htup_details.h>
+#include <funcapi.h>
+#include <miscadmin.h>
 #include <pgtime.h>
+#include <utils/array.h>
 #include <utils/builtins.h>
 #include <utils/faultinjector.h>
+#include <utils/jsonb.h>
 #include <utils/lsyscache.h>
 #include <utils/timestamp.h>
+#include <utils/typcache.h>
 #include <utils/datetime.h>
 
+#include "settings.h"
 #include "deserialization/attribute_postgres.h"
+#include "utils/kadb_arena.h"
 
 
+#define STREQ(a, b) (strcmp(a, b) == 0)
+
 /* The size of a buffer to use for 'strftime' calls */
 #define STRFTIME_BUFFER_SIZE 128
 
@@ -42,6 +52,18 @@
 /* A mask to extract a byte (e.g. from an integer) */
 #define BYTE ((unsigned char)0xffU)
 
+/* The initial value of CRC-64-AVRO (Rabin) fingerprint */
+#define AVRO_FINGERPRINT_EMPTY UINT64CONST(0xc15d213aa4d7a795)
+
+/* An index of an AVRO field absent in the schema */
+#define AVRO_FIELD_ABSENT (-1)
+
+/* The magic bytes AVRO Object Container Files start with */
+#define AVRO_OCF_MAGIC "Obj\x01"
+#define AVRO_OCF_MAGIC_SIZE (4)
+/* The size of the synchronization marker of AVRO Object Container Files */
+#define AVRO_OCF_SYNC_SIZE (16)
+
 
 /**
  * AVRO "logical" types supported by Kafka-ADB.
@@ -57,36 +79,206 @@ typedef enum AvroLogicalType
 	AVRO_LT_TIME,				/* Both time-millis and time-micros */
 	AVRO_LT_TIMESTAMP_3,		/* timestamp-millis */
 	AVRO_LT_TIMESTAMP_6,		/* timestamp-micros */
-	AVRO_LT_DURATION
+	AVRO_LT_DURATION,
+	AVRO_CT_ARRAY,				/* 'array' into a PostgreSQL array */
+	AVRO_CT_RECORD,				/* 'record' into a PostgreSQL composite type */
+	AVRO_CT_JSONB				/* 'record', 'map', 'array', 'enum' into JSONB */
 }	AvroLogicalType;
 
 /**
  * 'AttributeDeserializationInfo' with extra fields for AVRO types' resolution.
+ *
+ * Elements of arrays and attributes of composite types are described by
+ * nested instances of this structure.
  */
 typedef struct AvroAttributeDeserializationInfo
 {
 	AttributeDeserializationInfo adi;
 	AvroLogicalType expected_logical_type;
 	avro_type_t expected_primitive_type;
+
+	/* AVRO_CT_ARRAY: array element */
+	struct AvroAttributeDeserializationInfo *element;
+	Oid			element_typid;
+	int16		element_typlen;
+	bool		element_typbyval;
+	char		element_typalign;
+
+	/* AVRO_CT_RECORD: composite type and its attributes */
+	TupleDesc	composite_tupledesc;
+	struct AvroAttributeDeserializationInfo *composite_attributes;
 }	AvroAttributeDeserializationInfo;
 
+/**
+ * What a compiled decode op does with an AVRO value.
+ */
+typedef enum AvroDecodeAction
+{
+	AVRO_DECODE_SKIP,			/* Skip the value */
+	AVRO_DECODE_DIRECT,			/* Decode the value from the binary encoding */
+	AVRO_DECODE_LIBAVRO			/* Decode the value by libavro, then translate */
+}	AvroDecodeAction;
+
+/**
+ * A compiled decode op: an instruction to decode a single AVRO value of a
+ * known schema from AVRO binary encoding into an attribute.
+ *
+ * The ops of a record are executed in the order of its fields.
+ */
+typedef struct AvroDecodeOp
+{
+	AvroDecodeAction action;
+	avro_schema_t schema;
+	avro_type_t type;
+
+	/* The attribute the value is written to (not for AVRO_DECODE_SKIP) */
+	int			attribute;
+	AvroAttributeDeserializationInfo *adi;
+	/* The index of the AVRO field the value belongs to */
+	int			field;
+
+	/* AVRO_UNION: an op for each branch */
+	struct AvroDecodeOp *branches;
+	size_t		branches_count;
+
+	/* AVRO_DECODE_LIBAVRO: the class of 'value' */
+	avro_value_iface_t *iface;
+	/* AVRO_DECODE_LIBAVRO: a value to read into; valid during one message */
+	avro_value_t value;
+}	AvroDecodeOp;
+
+/**
+ * A reader of AVRO binary encoding.
+ */
+typedef struct AvroBinaryReader
+{
+	const char *p;
+	const char *end;
+}	AvroBinaryReader;
+
+/**
+ * How records of the CURRENT message are read.
+ */
+typedef enum AvroMessageReading
+{
+	/* There are no (more) records */
+	AVRO_MESSAGE_READING_NONE,
+	/* By the compiled decode ops */
+	AVRO_MESSAGE_READING_COMPILED,
+	/* By libavro file reader */
+	AVRO_MESSAGE_READING_LIBAVRO,
+#ifdef FAULT_INJECTOR
+	/* A single dummy record is produced */
+	AVRO_MESSAGE_READING_DUMMY
+#endif
+}	AvroMessageReading;
+
 /* Definition is in the header */
 struct AvroDeserializationMetadataObject
 {
 	TupleDesc	tupledesc;
 	bool		is_schema_provided;
 	avro_schema_t schema;
+	/* A value to read records into; created for each message, in the arena */
 	avro_value_t value;
 	AvroAttributeDeserializationInfo *adis;
+
+	/* Map attributes to AVRO fields by name (rather than by position) */
+	bool		is_mapping_by_name;
+
+	/*
+	 * AVRO field index for each attribute, or AVRO_FIELD_ABSENT. Resolved
+	 * once per schema fingerprint
+	 */
+	int		   *field_indexes;
+	/* The fingerprint of the schema 'field_indexes' are resolved for */
+	uint64		field_indexes_fingerprint;
+	bool		field_indexes_are_resolved;
+
+	/*
+	 * Decode ops compiled for the provided 'schema', one for each field of
+	 * the record. NULL if the schema is not provided, or cannot be compiled
+	 */
+	AvroDecodeOp *ops;
+	size_t		ops_count;
+	/* Ops with AVRO_DECODE_LIBAVRO action */
+	List	   *libavro_ops;
+	/* A reader used by AVRO_DECODE_LIBAVRO ops; valid during one message */
+	avro_reader_t libavro_reader;
+	/* A buffer for textual representations of values */
+	StringInfoData buffer;
+
+	/* An arena for libavro and GNU MP allocations; reset for each message */
+	KadbArena	arena;
+
+	/* How records of the CURRENT message are read */
+	AvroMessageReading reading;
+	/* AVRO_MESSAGE_READING_COMPILED: the rest of the message */
+	AvroBinaryReader message;
+	/* AVRO_MESSAGE_READING_COMPILED: the sync marker of the message */
+	char		sync[AVRO_OCF_SYNC_SIZE];
+	/* AVRO_MESSAGE_READING_COMPILED: the rest of the current block */
+	AvroBinaryReader block;
+	bool		block_is_open;
+	int64_t		block_records_left;
+	/* AVRO_MESSAGE_READING_LIBAVRO: a stream over the message, and its reader */
+	FILE	   *message_fp;
+	avro_file_reader_t file_reader;
 };
 
 
+/*
+ * The arena libavro and GNU MP allocate memory in during
+ * 'begin_deserialization_avro()' and 'deserialize_next_avro()'.
+ * NULL at other times, when memory is allocated by palloc() in
+ * CurrentMemoryContext.
+ *
+ * Memory allocated in the arena is released when the next message is
+ * deserialized. Objects allocated outside the arena keep being (re)allocated
+ * in their memory contexts.
+ */
+static KadbArena avro_arena = NULL;
+
+/**
+ * Allocate 'size' bytes for libavro or GNU MP.
+ */
+static void *
+avro_arena_alloc(size_t size)
+{
+	if (PointerIsValid(avro_arena))
+		return kadb_arena_alloc(avro_arena, size);
+	return palloc(size);
+}
+
+/**
+ * Reallocate 'ptr' of 'old_size' bytes for libavro or GNU MP.
+ */
+static void *
+avro_arena_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+	if (PointerIsValid(avro_arena) && kadb_arena_contains(avro_arena, ptr))
+		return kadb_arena_realloc(avro_arena, ptr, old_size, new_size);
+	return repalloc(ptr, new_size);
+}
+
+/**
+ * Free 'ptr' of 'size' bytes for libavro or GNU MP.
+ */
+static void
+avro_arena_free(void *ptr, size_t size)
+{
+	if (PointerIsValid(avro_arena) && kadb_arena_contains(avro_arena, ptr))
+		kadb_arena_free(avro_arena, ptr, size);
+	else
+		pfree(ptr);
+}
+
 /**
  * An implementation of 'avro_allocator_t' for PostgreSQL.
  *
- * palloc() in CurrentMemoryContext is used to allocate memory. This behaviour
- * is ASSUMED by this module: some memory, when it is expected to be allocated
- * in a short-living context, is not freed.
+ * Memory is allocated in 'avro_arena' or by palloc() in CurrentMemoryContext.
+ * This behaviour is ASSUMED by this module: some memory, when it is expected
+ * to be allocated in a short-living context, is not freed.
  */
 static void *
 avro_postgres_allocator(void *user_data, void *ptr, size_t osize, size_t nsize)
@@ -95,20 +287,16 @@ avro_postgres_allocator(void *user_data, void *ptr, size_t osize, size_t nsize)
 	if (nsize == 0)
 	{
 		if (PointerIsValid(ptr))
-			pfree(ptr);
+			avro_arena_free(ptr, osize);
 		return NULL;
 	}
 	/* malloc */
-	if (osize == 0)
+	if (osize == 0 || !PointerIsValid(ptr))
 	{
-		return palloc(nsize);
+		return avro_arena_alloc(nsize);
 	}
 	/* realloc */
-	void	   *result = palloc(nsize);
-
-	memcpy(result, ptr, osize);
-	pfree(ptr);
-	return result;
+	return avro_arena_realloc(ptr, osize, nsize);
 }
 
 /**
@@ -117,7 +305,7 @@ avro_postgres_allocator(void *user_data, void *ptr, size_t osize, size_t nsize)
 static void *
 gmp_postgres_alloc(size_t size)
 {
-	return palloc(size);
+	return avro_arena_alloc(size);
 }
 
 /**
@@ -126,7 +314,7 @@ gmp_postgres_alloc(size_t size)
 static void *
 gmp_postgres_realloc(void *ptr, size_t old_size, size_t new_size)
 {
-	return repalloc(ptr, new_size);
+	return avro_arena_realloc(ptr, old_size, new_size);
 }
 
 /**
@@ -135,7 +323,7 @@ gmp_postgres_realloc(void *ptr, size_t old_size, size_t new_size)
 static void
 gmp_postgres_free(void *ptr, size_t size)
 {
-	pfree(ptr);
+	avro_arena_free(ptr, size);
 }
 
 void
@@ -145,19 +333,19 @@ initialize_libavro_for_postgres(void)
 	mp_set_memory_functions(gmp_postgres_alloc, gmp_postgres_realloc, gmp_postgres_free);
 }
 
+static void fill_nested_avro_attribute_deserialization_info(AvroAttributeDeserializationInfo * adi, Oid typoid, int32 typmod);
+
 /**
  * Convert a Postgres type to an AVRO type.
  *
- * If an unknown type is found, an error is reported by elog.
+ * Unknown types are expected to be received as AVRO 'string's.
  *
- * @param att is used to extract Postgres type information
+ * @param typoid, typmod Postgres type information
  * @param adi is filled with expected AVRO type data
  */
 static void
-convert_postgres_type_to_avro_type(Form_pg_attribute att, AvroAttributeDeserializationInfo * adi)
+convert_postgres_type_to_avro_type(Oid typoid, int32 typmod, AvroAttributeDeserializationInfo * adi)
 {
-	Oid			typoid = att->atttypid;
-
 	adi->expected_logical_type = AVRO_LT_PRIMITIVE;
 	adi->expected_primitive_type = AVRO_STRING;
 
@@ -198,8 +386,6 @@ convert_postgres_type_to_avro_type(Form_pg_attribute att, AvroAttributeDeseriali
 			break;
 		case TIMESTAMPOID:
 			{
-				int32		typmod = att->atttypmod;
-
 				if (typmod == -1)		/* TIMESTAMP */
 					adi->expected_logical_type = AVRO_LT_TIMESTAMP_6;
 				else if (typmod <= 3)	/* TIMESTAMP(N) */
@@ -213,11 +399,67 @@ convert_postgres_type_to_avro_type(Form_pg_attribute att, AvroAttributeDeseriali
 			adi->expected_logical_type = AVRO_LT_DURATION;
 			adi->expected_primitive_type = AVRO_FIXED;
 			break;
+		case JSONBOID:
+			adi->expected_logical_type = AVRO_CT_JSONB;
+			break;
 		default:
-			break;				/* AVRO_STRING for unknown types */
+			{
+				Oid			element_typid = get_element_type(typoid);
+
+				if (OidIsValid(element_typid))
+				{
+					adi->expected_logical_type = AVRO_CT_ARRAY;
+					adi->element_typid = element_typid;
+					get_typlenbyvalalign(element_typid, &adi->element_typlen, &adi->element_typbyval, &adi->element_typalign);
+					adi->element = (AvroAttributeDeserializationInfo *) palloc(sizeof(AvroAttributeDeserializationInfo));
+					fill_nested_avro_attribute_deserialization_info(adi->element, element_typid, typmod);
+				}
+				else if (type_is_rowtype(typoid))
+				{
+					adi->expected_logical_type = AVRO_CT_RECORD;
+					adi->composite_tupledesc = lookup_rowtype_tupdesc_copy(typoid, typmod);
+					adi->composite_attributes = (AvroAttributeDeserializationInfo *) palloc(sizeof(AvroAttributeDeserializationInfo) * adi->composite_tupledesc->natts);
+					for (int i = 0; i < adi->composite_tupledesc->natts; i++)
+					{
+						Form_pg_attribute att = adi->composite_tupledesc->attrs[i];
+
+						if (att->attisdropped)
+						{
+							MemSet(&adi->composite_attributes[i], 0, sizeof(AvroAttributeDeserializationInfo));
+							adi->composite_attributes[i].adi.is_dropped = true;
+							adi->composite_attributes[i].adi.is_skipped = true;
+							continue;
+						}
+						fill_nested_avro_attribute_deserialization_info(&adi->composite_attributes[i], att->atttypid, att->atttypmod);
+					}
+				}
+				/* AVRO_STRING for other types */
+			}
+			break;
 	}
 }
 
+/**
+ * Fill 'adi' describing an element of an array or an attribute of a composite
+ * type of type 'typoid'.
+ */
+static void
+fill_nested_avro_attribute_deserialization_info(AvroAttributeDeserializationInfo * adi, Oid typoid, int32 typmod)
+{
+	check_stack_depth();
+
+	MemSet(adi, 0, sizeof(AvroAttributeDeserializationInfo));
+
+	Oid			tmp_fn_oid;
+
+	getTypeInputInfo(typoid, &tmp_fn_oid, &adi->adi.io_fn_textual.typioparam);
+	fmgr_info(tmp_fn_oid, &adi->adi.io_fn_textual.iofunc);
+	adi->adi.io_fn_textual.attypmod = typmod;
+	set_fast_input_function(&adi->adi.io_fn_textual, typoid);
+
+	convert_postgres_type_to_avro_type(typoid, typmod, adi);
+}
+
 /**
  * Fill 'metadata->value' using 'metadata->schema'.
  *
@@ -234,8 +476,240 @@ schema_to_value(AvroDeserializationMetadata metadata)
 		elog(ERROR, "Kafka-ADB: Failed to resolve AVRO schema: %s [%d]", strerror(err), err);
 }
 
+/**
+ * Calculate CRC-64-AVRO (Rabin) fingerprint of names of fields of the given
+ * record 'schema'.
+ *
+ * Only field names affect the mapping of attributes to fields, thus other
+ * parts of the schema are not fingerprinted.
+ */
+static uint64
+fingerprint_record_field_names(avro_schema_t schema)
+{
+	static uint64 table[256];
+	static bool table_is_initialized = false;
+
+	if (!table_is_initialized)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			uint64		fp = (uint64) i;
+
+			for (int j = 0; j < 8; j++)
+				fp = (fp >> 1) ^ (AVRO_FINGERPRINT_EMPTY & -(fp & 1));
+			table[i] = fp;
+		}
+		table_is_initialized = true;
+	}
+
+	uint64		result = AVRO_FINGERPRINT_EMPTY;
+	size_t		fields_count = avro_schema_record_size(schema);
+
+	for (size_t f = 0; f < fields_count; f++)
+	{
+		const char *name = avro_schema_record_field_name(schema, f);
+
+		/* The terminating '\0' is fingerprinted as a separator */
+		do
+		{
+			result = (result >> 8) ^ table[(result ^ (uint64) (unsigned char) *name) & BYTE];
+		} while (*(name++) != '\0');
+	}
+
+	return result;
+}
+
+/**
+ * Resolve 'metadata->field_indexes' by position: attributes, except dropped
+ * ones, correspond to AVRO fields in order.
+ */
+static void
+resolve_field_indexes_by_position(AvroDeserializationMetadata metadata)
+{
+	int			avro_i = 0;
+
+	for (int i = 0; i < metadata->tupledesc->natts; i++)
+	{
+		if (metadata->adis[i].adi.is_dropped)
+		{
+			metadata->field_indexes[i] = AVRO_FIELD_ABSENT;
+			continue;
+		}
+		metadata->field_indexes[i] = avro_i;
+		avro_i += 1;
+	}
+	metadata->field_indexes_are_resolved = true;
+}
+
+/**
+ * Resolve 'metadata->field_indexes' by name for the given record 'schema',
+ * unless they are already resolved for a schema with the same fingerprint.
+ *
+ * Attributes with no AVRO field of the same name are mapped to
+ * AVRO_FIELD_ABSENT. AVRO fields with no attribute are ignored.
+ */
+static void
+resolve_field_indexes_by_name(AvroDeserializationMetadata metadata, avro_schema_t schema)
+{
+	if (!is_avro_record(schema))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: AVRO schema must be a record to map fields by name")));
+
+	uint64		fingerprint = fingerprint_record_field_names(schema);
+
+	if (metadata->field_indexes_are_resolved && metadata->field_indexes_fingerprint == fingerprint)
+		return;
+
+	for (int i = 0; i < metadata->tupledesc->natts; i++)
+	{
+		metadata->field_indexes[i] = AVRO_FIELD_ABSENT;
+		if (metadata->adis[i].adi.is_dropped)
+			continue;
+		metadata->field_indexes[i] = avro_schema_record_field_get_index(schema, NameStr(metadata->tupledesc->attrs[i]->attname));
+		if (metadata->field_indexes[i] < 0)
+			metadata->field_indexes[i] = AVRO_FIELD_ABSENT;
+	}
+	metadata->field_indexes_fingerprint = fingerprint;
+	metadata->field_indexes_are_resolved = true;
+
+	elog(DEBUG1, "Kafka-ADB: AVRO fields are mapped by name for schema with fingerprint %016" PRIx64, fingerprint);
+}
+
+/**
+ * Check whether a value of AVRO 'schema' (not a union) can be decoded into an
+ * attribute described by 'adi' directly, without libavro. This is the case for
+ * all type combinations the generic path (see
+ * 'translate_avro_value_to_postgres_datum()') converts from scalars.
+ */
+static bool
+is_avro_value_decodable_directly(AvroAttributeDeserializationInfo * adi, avro_schema_t schema)
+{
+	avro_type_t type = avro_typeof(schema);
+
+	if (type == AVRO_NULL)
+		return true;
+
+	switch (adi->expected_logical_type)
+	{
+		case AVRO_LT_PRIMITIVE:
+			if (adi->expected_primitive_type == AVRO_STRING)
+				return type == AVRO_STRING || type == AVRO_ENUM;
+			return type == adi->expected_primitive_type;
+		case AVRO_CT_BYTES:
+		case AVRO_LT_DECIMAL:
+			return type == AVRO_BYTES || type == AVRO_FIXED;
+		case AVRO_LT_DATE:
+			return type == AVRO_INT32;
+		case AVRO_LT_TIME:
+			return type == AVRO_INT32 || type == AVRO_INT64;
+		case AVRO_LT_TIMESTAMP_3:
+		case AVRO_LT_TIMESTAMP_6:
+			return type == AVRO_INT64;
+		case AVRO_LT_DURATION:
+			return type == AVRO_FIXED && avro_schema_fixed_size(schema) == 12;
+		case AVRO_CT_ARRAY:
+		case AVRO_CT_RECORD:
+		case AVRO_CT_JSONB:
+			return type == AVRO_STRING;
+		default:
+			return false;
+	}
+}
+
+/**
+ * Compile an 'op' to decode a value of AVRO 'schema' into 'attribute' (or to
+ * skip it, if 'attribute' is AVRO_FIELD_ABSENT).
+ */
+static void
+compile_avro_decode_op(AvroDeserializationMetadata metadata, AvroDecodeOp * op, avro_schema_t schema, int attribute, int field)
+{
+	check_stack_depth();
+
+	while (is_avro_link(schema))
+		schema = avro_schema_link_target(schema);
+
+	MemSet(op, 0, sizeof(AvroDecodeOp));
+	op->schema = schema;
+	op->type = avro_typeof(schema);
+	op->attribute = attribute;
+	op->field = field;
+
+	if (attribute == AVRO_FIELD_ABSENT)
+	{
+		op->action = AVRO_DECODE_SKIP;
+		return;
+	}
+	op->adi = &metadata->adis[attribute];
+
+	if (op->type == AVRO_UNION)
+	{
+		op->action = AVRO_DECODE_DIRECT;
+		op->branches_count = avro_schema_union_size(schema);
+		op->branches = (AvroDecodeOp *) palloc(sizeof(AvroDecodeOp) * Max(op->branches_count, 1));
+		for (size_t b = 0; b < op->branches_count; b++)
+			compile_avro_decode_op(metadata, &op->branches[b], avro_schema_union_branch(schema, (int) b), attribute, field);
+		return;
+	}
+
+	if (is_avro_value_decodable_directly(op->adi, schema))
+	{
+		op->action = AVRO_DECODE_DIRECT;
+		return;
+	}
+
+	/* Complex values, and values of types that do not match, are left to libavro */
+	op->action = AVRO_DECODE_LIBAVRO;
+	op->iface = avro_generic_class_from_schema(schema);
+	if (!PointerIsValid(op->iface))
+		elog(ERROR, "Kafka-ADB: Failed to resolve AVRO schema: %s", avro_strerror());
+	metadata->libavro_ops = lappend(metadata->libavro_ops, op);
+}
+
+/**
+ * Compile 'metadata->schema' and the tuple descriptor into decode ops.
+ *
+ * 'metadata->ops' is left NULL if the schema is not a record, or some
+ * attribute refers to a field absent in it. Such a schema is processed by
+ * libavro, which reports the error.
+ */
+static void
+compile_avro_decoder(AvroDeserializationMetadata metadata)
+{
+	metadata->ops = NULL;
+	metadata->ops_count = 0;
+	metadata->libavro_ops = NIL;
+
+	if (!is_avro_record(metadata->schema))
+		return;
+
+	size_t		fields_count = avro_schema_record_size(metadata->schema);
+	int		   *attributes = (int *) palloc(sizeof(int) * Max(fields_count, 1));
+
+	for (size_t f = 0; f < fields_count; f++)
+		attributes[f] = AVRO_FIELD_ABSENT;
+	for (int i = 0; i < metadata->tupledesc->natts; i++)
+	{
+		int			avro_i = metadata->field_indexes[i];
+
+		if (metadata->adis[i].adi.is_skipped || avro_i == AVRO_FIELD_ABSENT)
+			continue;
+		if ((size_t) avro_i >= fields_count)
+		{
+			pfree(attributes);
+			return;
+		}
+		attributes[avro_i] = i;
+	}
+
+	metadata->ops = (AvroDecodeOp *) palloc(sizeof(AvroDecodeOp) * Max(fields_count, 1));
+	metadata->ops_count = fields_count;
+	for (size_t f = 0; f < fields_count; f++)
+		compile_avro_decode_op(metadata, &metadata->ops[f], avro_schema_record_field_get_by_index(metadata->schema, (int) f), attributes[f], (int) f);
+
+	pfree(attributes);
+}
+
 AvroDeserializationMetadata
-prepare_deserialization_metadata_avro(TupleDesc tupledesc, const char *json)
+prepare_deserialization_metadata_avro(TupleDesc tupledesc, const char *json, List *options)
 {
 	Assert(PointerIsValid(tupledesc));
 
@@ -251,21 +725,61 @@ prepare_deserialization_metadata_avro(TupleDesc tupledesc, const char *json)
 		result->is_schema_provided = true;
 		if ((err = avro_schema_from_json(json, 0, &result->schema, NULL)))
 			elog(ERROR, "Kafka-ADB: Failed to parse AVRO schema: %s [%d]", strerror(err), err);
-		schema_to_value(result);
 	}
 
-	result->adis = (AvroAttributeDeserializationInfo *) palloc(sizeof(AvroAttributeDeserializationInfo) * tupledesc->natts);
+	result->adis = (AvroAttributeDeserializationInfo *) palloc0(sizeof(AvroAttributeDeserializationInfo) * tupledesc->natts);
 	for (int i = 0; i < tupledesc->natts; i++)
 	{
-		fill_attribute_deserialization_info(&result->adis[i].adi, tupledesc, i);
-		if (result->adis[i].adi.is_dropped)
+		fill_attribute_deserialization_info(&result->adis[i].adi, tupledesc, i, options);
+		if (result->adis[i].adi.is_skipped)
 			continue;
-		convert_postgres_type_to_avro_type(tupledesc->attrs[i], &result->adis[i]);
+		convert_postgres_type_to_avro_type(tupledesc->attrs[i]->atttypid, tupledesc->attrs[i]->atttypmod, &result->adis[i]);
 	}
 
+	DefElem    *mapping_option = get_option(options, KADB_SETTING_AVRO_MAPPING);
+
+	result->is_mapping_by_name = PointerIsValid(mapping_option) && strcmp(defGetString(mapping_option), KADB_AVRO_MAPPING_NAME) == 0;
+	result->field_indexes = (int *) palloc(sizeof(int) * tupledesc->natts);
+	result->field_indexes_are_resolved = false;
+	if (!result->is_mapping_by_name)
+		resolve_field_indexes_by_position(result);
+	else if (result->is_schema_provided)
+		resolve_field_indexes_by_name(result, result->schema);
+
+	result->ops = NULL;
+	result->libavro_ops = NIL;
+	if (result->is_schema_provided)
+		compile_avro_decoder(result);
+	initStringInfo(&result->buffer);
+	result->arena = kadb_arena_create(CurrentMemoryContext);
+
+	result->reading = AVRO_MESSAGE_READING_NONE;
+	result->block_is_open = false;
+	result->block_records_left = 0;
+	result->message_fp = NULL;
+
 	return result;
 }
 
+/**
+ * Get the symbol of an AVRO 'value' of complex type 'enum'.
+ *
+ * @return 0 on success, an error code otherwise
+ */
+static int
+get_avro_enum_symbol(avro_value_t * value, const char **result)
+{
+	int			err;
+	int			symbol_index;
+
+	if ((err = avro_value_get_enum(value, &symbol_index)))
+		return err;
+	*result = avro_schema_enum_get(avro_value_get_schema(value), symbol_index);
+	if (!PointerIsValid(*result))
+		return EINVAL;
+	return 0;
+}
+
 /**
  * Convert an AVRO 'value' of primitive type to a string representation, written
  * in 'buff'.
@@ -282,7 +796,10 @@ translate_avro_value_of_primitive_type(avro_value_t value, AvroAttributeDeserial
 				const char *result;
 				size_t		result_l;
 
-				err = avro_value_get_string(&value, &result, &result_l);
+				if (avro_value_get_type(&value) == AVRO_ENUM)
+					err = get_avro_enum_symbol(&value, &result);
+				else
+					err = avro_value_get_string(&value, &result, &result_l);
 				if (!err)
 					appendStringInfoString(buff, result);
 			}
@@ -338,7 +855,7 @@ translate_avro_value_of_primitive_type(avro_value_t value, AvroAttributeDeserial
 	}
 
 	if (err)
-		elog(ERROR, "Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err);
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
 }
 
 /**
@@ -370,7 +887,7 @@ translate_avro_value_bytes(avro_value_t value, AvroAttributeDeserializationInfo
 			elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", actual_type);
 	}
 	if (err)
-		elog(ERROR, "Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err);
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
 
 	if (result_l == 0)
 	{
@@ -424,7 +941,7 @@ translate_avro_value_of_lt_date(avro_value_t value, AvroAttributeDeserialization
 	int			err = avro_value_get_int(&value, &result);
 
 	if (err)
-		elog(ERROR, "Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err);
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
 
 	epoch_days_to_date_string(result, buff);
 }
@@ -493,7 +1010,7 @@ translate_avro_value_of_lt_time(avro_value_t value, AvroAttributeDeserialization
 
 				err = avro_value_get_int(&value, &result);
 				if (err)
-					elog(ERROR, "Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err);
+					ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
 				fracseconds_to_time_string(result, MILLISECONDS_IN_SECOND, MILLISECONDS_IN_SECOND_LOG10, buff);
 			}
 			break;
@@ -504,7 +1021,7 @@ translate_avro_value_of_lt_time(avro_value_t value, AvroAttributeDeserialization
 
 				err = avro_value_get_long(&value, &result);
 				if (err)
-					elog(ERROR, "Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err);
+					ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
 				fracseconds_to_time_string(result, MICROSECONDS_IN_SECOND, MICROSECONDS_IN_SECOND_LOG10, buff);
 			}
 			break;
@@ -553,12 +1070,34 @@ epoch_useconds_to_timestamp_string(int64_t useconds, StringInfo buff)
 
 	if (timestamp2tm(useconds, NULL, &tm, &tm_fsec, NULL, NULL) < 0)
 	{
-		elog(ERROR, "Kafka-ADB: Failed to convert AVRO value '%" PRId64 "' to a PostgreSQL timestamp", useconds);
+		ereport(ERROR, (errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE), errmsg("Kafka-ADB: Failed to convert AVRO value '%" PRId64 "' to a PostgreSQL timestamp", useconds)));
 	}
 
 	appendStringInfo(buff, "%04d-%02d-%02d %02d:%02d:%02d.%06d", tm.tm_year, tm.tm_mon, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (int) tm_fsec);
 }
 
+/**
+ * Print the timestamp represented by 'fracseconds' (milliseconds or
+ * microseconds, as expected by 'adi') since the Epoch into 'buff'.
+ */
+static void
+epoch_fracseconds_to_timestamp_string(int64_t fracseconds, AvroAttributeDeserializationInfo * adi, StringInfo buff)
+{
+	switch (adi->expected_logical_type)
+	{
+		case AVRO_LT_TIMESTAMP_3:
+			fracseconds *= MICROSECONDS_IN_MILLISECOND;
+			break;
+		case AVRO_LT_TIMESTAMP_6:
+			break;
+		default:
+			Assert(false);
+			elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", adi->expected_logical_type);
+	}
+
+	epoch_useconds_to_timestamp_string(fracseconds, buff);
+}
+
 /**
  * Convert an AVRO 'value' of logical types 'timestamp-millis' and
  * 'timestamp-micros' to a string representation, written in 'buff'.
@@ -592,21 +1131,27 @@ translate_avro_value_of_lt_timestamp(avro_value_t value, AvroAttributeDeserializ
 	int			err = avro_value_get_long(&value, &result);
 
 	if (err)
-		elog(ERROR, "Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err);
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
 
-	switch (adi->expected_logical_type)
-	{
-		case AVRO_LT_TIMESTAMP_3:
-			result *= MICROSECONDS_IN_MILLISECOND;
-			break;
-		case AVRO_LT_TIMESTAMP_6:
-			break;
-		default:
-			Assert(false);
-			elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", adi->expected_logical_type);
-	}
+	epoch_fracseconds_to_timestamp_string(result, adi, buff);
+}
+
+/**
+ * Print the duration represented by 'fixed' of length 'fixed_l' into 'buff',
+ * in PostgreSQL 'INTERVAL' format.
+ */
+static void
+duration_to_string(const char *fixed, size_t fixed_l, StringInfo buff)
+{
+	if (fixed_l != 12)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to convert AVRO 'duration': Provided 'fixed' of length %lu (expected 12)", fixed_l)));
+
+	/* 'endian.h' enables to make no assumptions about endianness on the host */
+	uint32_t	months = le32toh(*(uint32_t *) fixed);
+	uint32_t	days = le32toh(*(uint32_t *) (fixed + sizeof(uint32_t)));
+	uint32_t	milliseconds = le32toh(*(uint32_t *) (fixed + 2 * sizeof(uint32_t)));
 
-	epoch_useconds_to_timestamp_string(result, buff);
+	appendStringInfo(buff, "@ %u month %u day %u millisecond", months, days, milliseconds);
 }
 
 /**
@@ -638,16 +1183,9 @@ translate_avro_value_of_lt_duration(avro_value_t value, AvroAttributeDeserializa
 	int			err = avro_value_get_fixed(&value, (const void **) &result, &result_l);
 
 	if (err)
-		elog(ERROR, "Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err);
-	if (result_l != 12)
-		elog(ERROR, "Kafka-ADB: Failed to convert AVRO 'duration': Provided 'fixed' of length %lu (expected 12)", result_l);
-
-	/* 'endian.h' enables to make no assumptions about endianness on the host */
-	uint32_t	months = le32toh(*(uint32_t *) result);
-	uint32_t	days = le32toh(*(uint32_t *) (result + sizeof(uint32_t)));
-	uint32_t	milliseconds = le32toh(*(uint32_t *) (result + 2 * sizeof(uint32_t)));
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
 
-	appendStringInfo(buff, "@ %u month %u day %u millisecond", months, days, milliseconds);
+	duration_to_string(result, result_l, buff);
 }
 
 /**
@@ -717,48 +1255,12 @@ twos_complement_to_human_readable_decimal_abs(const void *twos_complement, size_
 }
 
 /**
- * Convert an AVRO 'value' of logical type 'decimal' to a string
- * representation, written in 'buff'.
- *
- * == AVRO specification ==
- *
- * The decimal logical type represents an arbitrary-precision signed decimal
- * number of the form unscaled × 10-scale.
- *
- * A decimal logical type annotates Avro bytes or fixed types. The byte array
- * must contain the two's-complement representation of the unscaled integer
- * value in big-endian byte order.
- *
- * @note It is not possible to extract 'scale' using libavro-c. Thus we obtain
- * scale from the FOREIGN TABLE definition.
+ * Print the decimal represented by 'twos_complement' of length 'result_l' into
+ * 'buff', using the scale expected by 'adi'.
  */
 static void
-translate_avro_value_of_lt_decimal(avro_value_t value, AvroAttributeDeserializationInfo * adi, StringInfo buff, int avro_attid)
+decimal_to_string(const void *twos_complement, size_t result_l, AvroAttributeDeserializationInfo * adi, StringInfo buff, int avro_attid)
 {
-	Assert(adi->expected_logical_type == AVRO_LT_DECIMAL);
-
-	const void *twos_complement;
-	size_t		result_l;
-
-	avro_type_t actual_type = avro_value_get_type(&value);
-
-	int			err;
-
-	switch (actual_type)
-	{
-		case AVRO_FIXED:
-			err = avro_value_get_fixed(&value, &twos_complement, &result_l);
-			break;
-		case AVRO_BYTES:
-			err = avro_value_get_bytes(&value, &twos_complement, &result_l);
-			break;
-		default:
-			Assert(false);
-			elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", actual_type);
-	}
-	if (err)
-		elog(ERROR, "Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err);
-
 	if (result_l == 0)
 	{
 		elog(WARNING, "Kafka-ADB: DECIMAL of zero length received in AVRO attribute %d; converted to '0'", avro_attid);
@@ -816,6 +1318,352 @@ translate_avro_value_of_lt_decimal(avro_value_t value, AvroAttributeDeserializat
 	pfree(result);
 }
 
+/**
+ * Convert an AVRO 'value' of logical type 'decimal' to a string
+ * representation, written in 'buff'.
+ *
+ * == AVRO specification ==
+ *
+ * The decimal logical type represents an arbitrary-precision signed decimal
+ * number of the form unscaled × 10-scale.
+ *
+ * A decimal logical type annotates Avro bytes or fixed types. The byte array
+ * must contain the two's-complement representation of the unscaled integer
+ * value in big-endian byte order.
+ *
+ * @note It is not possible to extract 'scale' using libavro-c. Thus we obtain
+ * scale from the FOREIGN TABLE definition.
+ */
+static void
+translate_avro_value_of_lt_decimal(avro_value_t value, AvroAttributeDeserializationInfo * adi, StringInfo buff, int avro_attid)
+{
+	Assert(adi->expected_logical_type == AVRO_LT_DECIMAL);
+
+	const void *twos_complement;
+	size_t		result_l;
+
+	avro_type_t actual_type = avro_value_get_type(&value);
+
+	int			err;
+
+	switch (actual_type)
+	{
+		case AVRO_FIXED:
+			err = avro_value_get_fixed(&value, &twos_complement, &result_l);
+			break;
+		case AVRO_BYTES:
+			err = avro_value_get_bytes(&value, &twos_complement, &result_l);
+			break;
+		default:
+			Assert(false);
+			elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", actual_type);
+	}
+	if (err)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
+
+	decimal_to_string(twos_complement, result_l, adi, buff, avro_attid);
+}
+
+static void translate_avro_value_to_postgres_datum(AvroAttributeDeserializationInfo * adi, avro_value_t * value, Datum *result, bool *is_null, int avro_attid);
+
+/**
+ * Convert an AVRO 'value' of complex type 'array' to a one-dimensional
+ * Postgres array.
+ */
+static Datum
+translate_avro_array_to_postgres_array(avro_value_t * value, AvroAttributeDeserializationInfo * adi, int avro_attid)
+{
+	int			err;
+	size_t		elements_count;
+
+	if (avro_value_get_type(value) != AVRO_ARRAY)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: AVRO type of attribute %d (#%d) does not match the expected one (array)", avro_attid, avro_value_get_type(value))));
+	if ((err = avro_value_get_size(value, &elements_count)))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
+
+	Datum	   *values = (Datum *) palloc(sizeof(Datum) * (elements_count + 1));
+	bool	   *nulls = (bool *) palloc(sizeof(bool) * (elements_count + 1));
+
+	for (size_t i = 0; i < elements_count; i++)
+	{
+		avro_value_t element_value;
+
+		if ((err = avro_value_get_by_index(value, i, &element_value, NULL)))
+			ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
+		translate_avro_value_to_postgres_datum(adi->element, &element_value, &values[i], &nulls[i], avro_attid);
+	}
+
+	int			dims[1] = {(int) elements_count};
+	int			lbs[1] = {1};
+	ArrayType  *result = construct_md_array(
+										values, nulls,
+										1, dims, lbs,
+										adi->element_typid,
+										adi->element_typlen,
+										adi->element_typbyval,
+										adi->element_typalign
+	);
+
+	pfree(values);
+	pfree(nulls);
+
+	return PointerGetDatum(result);
+}
+
+/**
+ * Convert an AVRO 'value' of complex type 'record' to a Postgres composite
+ * type value. Record fields are mapped to attributes of the composite type by
+ * name; attributes with no corresponding field are NULL.
+ */
+static Datum
+translate_avro_record_to_postgres_composite(avro_value_t * value, AvroAttributeDeserializationInfo * adi, int avro_attid)
+{
+	if (avro_value_get_type(value) != AVRO_RECORD)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: AVRO type of attribute %d (#%d) does not match the expected one (record)", avro_attid, avro_value_get_type(value))));
+
+	TupleDesc	tupledesc = adi->composite_tupledesc;
+	Datum	   *values = (Datum *) palloc(sizeof(Datum) * tupledesc->natts);
+	bool	   *nulls = (bool *) palloc(sizeof(bool) * tupledesc->natts);
+
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		avro_value_t field_value;
+
+		if (adi->composite_attributes[i].adi.is_skipped || avro_value_get_by_name(value, NameStr(tupledesc->attrs[i]->attname), &field_value, NULL))
+		{
+			nulls[i] = true;
+			continue;
+		}
+		translate_avro_value_to_postgres_datum(&adi->composite_attributes[i], &field_value, &values[i], &nulls[i], avro_attid);
+	}
+
+	HeapTuple	result = heap_form_tuple(tupledesc, values, nulls);
+
+	pfree(values);
+	pfree(nulls);
+
+	return HeapTupleGetDatum(result);
+}
+
+/**
+ * Push an AVRO 'value' to JSONB parse 'state' as 'token' ('WJB_VALUE' or
+ * 'WJB_ELEM' for values inside containers).
+ *
+ * Logical types are not interpreted: their underlying primitive values are
+ * pushed. 'bytes' and 'fixed' are pushed as strings in PostgreSQL 'BYTEA'
+ * format.
+ */
+static JsonbValue *
+push_avro_value_to_jsonb(JsonbParseState **state, int token, avro_value_t * value, int avro_attid)
+{
+	int			err = 0;
+	JsonbValue	scalar;
+	JsonbValue *result = NULL;
+
+	check_stack_depth();
+
+	switch (avro_value_get_type(value))
+	{
+		case AVRO_UNION:
+			{
+				avro_value_t branch;
+
+				if ((err = avro_value_get_current_branch(value, &branch)))
+					break;
+				return push_avro_value_to_jsonb(state, token, &branch, avro_attid);
+			}
+		case AVRO_RECORD:
+		case AVRO_MAP:
+		case AVRO_ARRAY:
+			{
+				bool		is_array = avro_value_get_type(value) == AVRO_ARRAY;
+				size_t		count;
+
+				if ((err = avro_value_get_size(value, &count)))
+					break;
+				pushJsonbValue(state, is_array ? WJB_BEGIN_ARRAY : WJB_BEGIN_OBJECT, NULL);
+				for (size_t i = 0; i < count; i++)
+				{
+					avro_value_t child;
+					const char *name;
+
+					if ((err = avro_value_get_by_index(value, i, &child, &name)))
+						break;
+					if (!is_array)
+					{
+						JsonbValue	key;
+
+						key.type = jbvString;
+						key.val.string.val = (char *) name;
+						key.val.string.len = strlen(name);
+						pushJsonbValue(state, WJB_KEY, &key);
+					}
+					push_avro_value_to_jsonb(state, is_array ? WJB_ELEM : WJB_VALUE, &child, avro_attid);
+				}
+				if (err)
+					break;
+				return pushJsonbValue(state, is_array ? WJB_END_ARRAY : WJB_END_OBJECT, NULL);
+			}
+		case AVRO_NULL:
+			scalar.type = jbvNull;
+			break;
+		case AVRO_BOOLEAN:
+			{
+				int			v;
+
+				err = avro_value_get_boolean(value, &v);
+				scalar.type = jbvBool;
+				scalar.val.boolean = (bool) v;
+			}
+			break;
+		case AVRO_INT32:
+			{
+				int32_t		v;
+
+				err = avro_value_get_int(value, &v);
+				scalar.type = jbvNumeric;
+				scalar.val.numeric = DatumGetNumeric(DirectFunctionCall1(int4_numeric, Int32GetDatum(v)));
+			}
+			break;
+		case AVRO_INT64:
+			{
+				int64_t		v;
+
+				err = avro_value_get_long(value, &v);
+				scalar.type = jbvNumeric;
+				scalar.val.numeric = DatumGetNumeric(DirectFunctionCall1(int8_numeric, Int64GetDatum(v)));
+			}
+			break;
+		case AVRO_FLOAT:
+			{
+				float		v;
+
+				err = avro_value_get_float(value, &v);
+				scalar.type = jbvNumeric;
+				scalar.val.numeric = DatumGetNumeric(DirectFunctionCall1(float4_numeric, Float4GetDatum(v)));
+			}
+			break;
+		case AVRO_DOUBLE:
+			{
+				double		v;
+
+				err = avro_value_get_double(value, &v);
+				scalar.type = jbvNumeric;
+				scalar.val.numeric = DatumGetNumeric(DirectFunctionCall1(float8_numeric, Float8GetDatum(v)));
+			}
+			break;
+		case AVRO_STRING:
+			{
+				const char *v;
+				size_t		v_l;
+
+				err = avro_value_get_string(value, &v, &v_l);
+				scalar.type = jbvString;
+				scalar.val.string.val = (char *) v;
+				/* The size reported by libavro includes the terminating NUL */
+				scalar.val.string.len = v_l > 0 ? v_l - 1 : 0;
+			}
+			break;
+		case AVRO_ENUM:
+			{
+				const char *v;
+
+				err = get_avro_enum_symbol(value, &v);
+				scalar.type = jbvString;
+				scalar.val.string.val = (char *) v;
+				scalar.val.string.len = err ? 0 : strlen(v);
+			}
+			break;
+		case AVRO_BYTES:
+		case AVRO_FIXED:
+			{
+				AvroAttributeDeserializationInfo bytes_adi;
+				StringInfoData buff;
+
+				bytes_adi.expected_logical_type = AVRO_CT_BYTES;
+				initStringInfo(&buff);
+				translate_avro_value_bytes(*value, &bytes_adi, &buff, avro_attid);
+				scalar.type = jbvString;
+				scalar.val.string.val = buff.data;
+				scalar.val.string.len = buff.len;
+			}
+			break;
+		default:
+			ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: AVRO type of attribute %d (#%d) cannot be converted to JSONB", avro_attid, avro_value_get_type(value))));
+	}
+	if (err)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", avro_attid, strerror(err), err)));
+
+	if (!PointerIsValid(*state))
+	{
+		/* A scalar at the top level is represented by a raw scalar array */
+		JsonbValue	array;
+
+		array.type = jbvArray;
+		array.val.array.rawScalar = true;
+		array.val.array.nElems = 1;
+		pushJsonbValue(state, WJB_BEGIN_ARRAY, &array);
+		pushJsonbValue(state, WJB_ELEM, &scalar);
+		return pushJsonbValue(state, WJB_END_ARRAY, NULL);
+	}
+
+	result = pushJsonbValue(state, token, &scalar);
+	return result;
+}
+
+/**
+ * Convert an AVRO 'value' of any type to a Postgres JSONB value, without
+ * building an intermediate JSON text.
+ */
+static Datum
+translate_avro_value_to_jsonb(avro_value_t * value, int avro_attid)
+{
+	JsonbParseState *state = NULL;
+	JsonbValue *result = push_avro_value_to_jsonb(&state, WJB_ELEM, value, avro_attid);
+
+	return PointerGetDatum(JsonbValueToJsonb(result));
+}
+
+/**
+ * Convert 'data' of length 'data_l' to a Postgres Datum object using the
+ * textual input function of 'adi'.
+ *
+ * @param buff a buffer to NUL-terminate 'data' in, if necessary. 'data' may
+ * point to its contents
+ */
+static void
+input_avro_attribute_string(AvroAttributeDeserializationInfo * adi, const char *data, size_t data_l, StringInfo buff, Datum *result, int avro_attid)
+{
+	if (value_cache_lookup(adi->adi.value_cache, data, data_l, result))
+		return;
+
+	PG_TRY();
+	{
+		if (!fast_input_function_call(&adi->adi.io_fn_textual, data, data_l, result))
+		{
+			if (data != buff->data)
+			{
+				resetStringInfo(buff);
+				appendBinaryStringInfo(buff, data, data_l);
+			}
+			*result = InputFunctionCall(
+										&adi->adi.io_fn_textual.iofunc,
+										buff->data,
+										adi->adi.io_fn_textual.typioparam,
+										adi->adi.io_fn_textual.attypmod
+				);
+		}
+	}
+	PG_CATCH();
+	{
+		elog(WARNING, "Kafka-ADB: Conversion to PostgreSQL type failed for AVRO attribute %d '%.*s'", avro_attid, (int) data_l, data);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	value_cache_insert(adi->adi.value_cache, data, data_l, *result);
+}
+
 /**
  * Convert an AVRO 'value' to a Postgres Datum object.
  */
@@ -852,12 +1700,37 @@ translate_avro_value_to_postgres_datum(AvroAttributeDeserializationInfo * adi, a
 		actual_value = *value;
 	}
 
+	/*
+	 * Complex types are converted natively. AVRO 'string's are still accepted
+	 * for them: such values are passed to the textual input function
+	 */
+	if (actual_type != AVRO_STRING)
+	{
+		switch (adi->expected_logical_type)
+		{
+			case AVRO_CT_ARRAY:
+				*result = translate_avro_array_to_postgres_array(&actual_value, adi, avro_attid);
+				return;
+			case AVRO_CT_RECORD:
+				*result = translate_avro_record_to_postgres_composite(&actual_value, adi, avro_attid);
+				return;
+			case AVRO_CT_JSONB:
+				*result = translate_avro_value_to_jsonb(&actual_value, avro_attid);
+				return;
+			default:
+				break;
+		}
+	}
+
 	/* Check the parsed schema matches the data, when possible */
 	if (adi->expected_logical_type == AVRO_LT_PRIMITIVE)
 	{
-		if (adi->expected_primitive_type != actual_type)
+		/* AVRO 'enum's are converted to their symbols */
+		bool		is_enum_to_string = adi->expected_primitive_type == AVRO_STRING && actual_type == AVRO_ENUM;
+
+		if (adi->expected_primitive_type != actual_type && !is_enum_to_string)
 		{
-			elog(ERROR, "Kafka-ADB: AVRO primitive type of attribute %d (#%d) does not match the expected one (#%d)", avro_attid, actual_type, adi->expected_primitive_type);
+			ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: AVRO primitive type of attribute %d (#%d) does not match the expected one (#%d)", avro_attid, actual_type, adi->expected_primitive_type)));
 		}
 	}
 
@@ -868,6 +1741,9 @@ translate_avro_value_to_postgres_datum(AvroAttributeDeserializationInfo * adi, a
 	switch (adi->expected_logical_type)
 	{
 		case AVRO_LT_PRIMITIVE:
+		case AVRO_CT_ARRAY:
+		case AVRO_CT_RECORD:
+		case AVRO_CT_JSONB:
 			translate_avro_value_of_primitive_type(actual_value, adi, &buff, avro_attid);
 			break;
 		case AVRO_CT_BYTES:
@@ -894,134 +1770,815 @@ translate_avro_value_to_postgres_datum(AvroAttributeDeserializationInfo * adi, a
 			elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", adi->expected_logical_type);
 	}
 
-	PG_TRY();
-	{
-		*result = InputFunctionCall(
-									&adi->adi.io_fn_textual.iofunc,
-									buff.data,
-									adi->adi.io_fn_textual.typioparam,
-									adi->adi.io_fn_textual.attypmod
-			);
-	}
-	PG_CATCH();
-	{
-		elog(WARNING, "Kafka-ADB: Conversion to PostgreSQL type failed for AVRO attribute %d '%s'", avro_attid, buff.data);
-		PG_RE_THROW();
-	}
-	PG_END_TRY();
+	input_avro_attribute_string(adi, buff.data, buff.len, &buff, result, avro_attid);
 	pfree(buff.data);
 }
 
-#ifdef FAULT_INJECTOR
 /**
- * A method to replace the actual deserialization in tests
+ * Report AVRO binary data the compiled decoder fails to process.
  */
-static List *
-deserialize_dummy(AvroDeserializationMetadata ds_metadata)
+static void
+report_malformed_avro(void)
 {
-	Datum	   *values = (Datum *) palloc(sizeof(Datum) * ds_metadata->tupledesc->natts);
-	bool	   *nulls = (bool *) palloc0(sizeof(bool) * ds_metadata->tupledesc->natts);
-
-	for (int i = 0; i < ds_metadata->tupledesc->natts; i++)
-	{
-		switch (ds_metadata->tupledesc->attrs[i]->atttypid)
-		{
-			case INT4OID:
-				values[i] = Int32GetDatum(42);
-				nulls[i] = false;
-				break;
-			case INT8OID:
-				values[i] = Int64GetDatum(42);
-				nulls[i] = false;
-				break;
-			default:
-				nulls[i] = true;
-		}
-	}
+	ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to deserialize AVRO: Malformed or truncated binary data")));
+}
 
-	return list_make1(heap_form_tuple(ds_metadata->tupledesc, values, nulls));
+/**
+ * Read 'size' bytes.
+ *
+ * @return false if there is not enough data
+ */
+static inline bool
+avro_try_read_fixed(AvroBinaryReader * reader, size_t size, const char **result)
+{
+	if ((size_t) (reader->end - reader->p) < size)
+		return false;
+	*result = reader->p;
+	reader->p += size;
+	return true;
 }
-#endif
 
-List *
-deserialize_avro(AvroDeserializationMetadata ds_metadata, void *data, size_t data_l)
+/**
+ * Read a zigzag-encoded variable-length 'long'.
+ *
+ * @return false if the data is malformed
+ */
+static inline bool
+avro_try_read_long(AvroBinaryReader * reader, int64_t *result)
 {
-	Assert(PointerIsValid(ds_metadata));
-	Assert(PointerIsValid(ds_metadata->tupledesc));
+	uint64_t	value = 0;
+	int			shift = 0;
+	unsigned char byte;
 
-#ifdef FAULT_INJECTOR
-	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_tuples") == FaultInjectorTypeSkip)
-		return deserialize_dummy(ds_metadata);
-#endif
+	do
+	{
+		if (reader->p >= reader->end || shift > 63)
+			return false;
+		byte = (unsigned char) *(reader->p++);
+		value |= (uint64_t) (byte & ~FIRST_BIT_OF_BYTE) << shift;
+		shift += 7;
+	} while (byte & FIRST_BIT_OF_BYTE);
+
+	*result = (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+	return true;
+}
 
-	if (!PointerIsValid(data) || data_l < 1)
-		return NIL;
+/**
+ * Read length-prefixed 'bytes' (or 'string').
+ *
+ * @return false if the data is malformed
+ */
+static inline bool
+avro_try_read_bytes(AvroBinaryReader * reader, const char **result, size_t *result_l)
+{
+	int64_t		length;
 
-	int			err;
+	if (!avro_try_read_long(reader, &length) || length < 0)
+		return false;
+	*result_l = (size_t) length;
+	return avro_try_read_fixed(reader, *result_l, result);
+}
 
-	/* Apply libavro to the received buffer */
-	FILE	   *data_fp = fmemopen(data, data_l, "r");
-	avro_file_reader_t reader;
+static inline const char *
+avro_read_fixed(AvroBinaryReader * reader, size_t size)
+{
+	const char *result;
 
-	if ((err = avro_file_reader_fp(data_fp, "Postgres", false, &reader)))
-		elog(ERROR, "Kafka-ADB: Failed to read received AVRO bytes: %s [%d]", strerror(err), err);
+	if (!avro_try_read_fixed(reader, size, &result))
+		report_malformed_avro();
+	return result;
+}
 
-	/* Prepare schema, if necessary */
-	if (!ds_metadata->is_schema_provided)
+static inline int64_t
+avro_read_long(AvroBinaryReader * reader)
+{
+	int64_t		result;
+
+	if (!avro_try_read_long(reader, &result))
+		report_malformed_avro();
+	return result;
+}
+
+static inline int32_t
+avro_read_int(AvroBinaryReader * reader)
+{
+	int64_t		result = avro_read_long(reader);
+
+	if (result < INT32_MIN || result > INT32_MAX)
+		report_malformed_avro();
+	return (int32_t) result;
+}
+
+static inline const char *
+avro_read_bytes(AvroBinaryReader * reader, size_t *result_l)
+{
+	const char *result;
+
+	if (!avro_try_read_bytes(reader, &result, result_l))
+		report_malformed_avro();
+	return result;
+}
+
+/**
+ * Skip a value of AVRO 'schema'.
+ */
+static void
+skip_avro_value(AvroBinaryReader * reader, avro_schema_t schema)
+{
+	size_t		length;
+
+	check_stack_depth();
+
+	switch (avro_typeof(schema))
 	{
-		/*
-		 * These variables are allocated by palloc in the current context.
-		 * They are freed before the next 'deserialize_avro()' call is made.
-		 */
-		ds_metadata->schema = avro_file_reader_get_writer_schema(reader);
-		schema_to_value(ds_metadata);
+		case AVRO_NULL:
+			break;
+		case AVRO_BOOLEAN:
+			avro_read_fixed(reader, 1);
+			break;
+		case AVRO_INT32:
+		case AVRO_INT64:
+		case AVRO_ENUM:
+			avro_read_long(reader);
+			break;
+		case AVRO_FLOAT:
+			avro_read_fixed(reader, sizeof(float));
+			break;
+		case AVRO_DOUBLE:
+			avro_read_fixed(reader, sizeof(double));
+			break;
+		case AVRO_STRING:
+		case AVRO_BYTES:
+			avro_read_bytes(reader, &length);
+			break;
+		case AVRO_FIXED:
+			avro_read_fixed(reader, (size_t) avro_schema_fixed_size(schema));
+			break;
+		case AVRO_RECORD:
+			for (size_t f = 0; f < avro_schema_record_size(schema); f++)
+				skip_avro_value(reader, avro_schema_record_field_get_by_index(schema, (int) f));
+			break;
+		case AVRO_ARRAY:
+		case AVRO_MAP:
+			{
+				bool		is_map = is_avro_map(schema);
+				avro_schema_t items = is_map ? avro_schema_map_values(schema) : avro_schema_array_items(schema);
+				int64_t		count;
+
+				/* Items are written in blocks, terminated by an empty one */
+				while ((count = avro_read_long(reader)) != 0)
+				{
+					if (count < 0)
+					{
+						/* The block size in bytes is known */
+						int64_t		size = avro_read_long(reader);
+
+						if (size < 0)
+							report_malformed_avro();
+						avro_read_fixed(reader, (size_t) size);
+						continue;
+					}
+					/* 'null' items take no space */
+					if (!is_map && is_avro_null(items))
+						continue;
+					for (int64_t i = 0; i < count; i++)
+					{
+						if (is_map)
+							avro_read_bytes(reader, &length);
+						skip_avro_value(reader, items);
+					}
+				}
+			}
+			break;
+		case AVRO_UNION:
+			{
+				int64_t		branch = avro_read_long(reader);
+
+				if (branch < 0 || (size_t) branch >= avro_schema_union_size(schema))
+					report_malformed_avro();
+				skip_avro_value(reader, avro_schema_union_branch(schema, (int) branch));
+			}
+			break;
+		case AVRO_LINK:
+			skip_avro_value(reader, avro_schema_link_target(schema));
+			break;
+		default:
+			elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", avro_typeof(schema));
 	}
-	avro_value_t *tuple_value = &ds_metadata->value;
+}
+
+/**
+ * Execute a compiled decode 'op', writing the result into 'values' and
+ * 'nulls'.
+ */
+static void
+decode_avro_value(AvroDeserializationMetadata metadata, AvroBinaryReader * reader, AvroDecodeOp * op, Datum *values, bool *nulls)
+{
+	switch (op->action)
+	{
+		case AVRO_DECODE_SKIP:
+			skip_avro_value(reader, op->schema);
+			return;
+		case AVRO_DECODE_LIBAVRO:
+			{
+				const char *start = reader->p;
+				int			err;
 
-	/* Iterate over records received in AVRO OCF format */
-	List	   *result = NIL;
-	Datum	   *values = (Datum *) palloc(sizeof(Datum) * ds_metadata->tupledesc->natts);
-	bool	   *nulls = (bool *) palloc(sizeof(bool) * ds_metadata->tupledesc->natts);
+				skip_avro_value(reader, op->schema);
+				avro_reader_memory_set_source(metadata->libavro_reader, start, reader->p - start);
+				avro_value_reset(&op->value);
+				if ((err = avro_value_read(metadata->libavro_reader, &op->value)))
+					ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to deserialize AVRO: %s [%d]", avro_strerror(), err)));
+				translate_avro_value_to_postgres_datum(op->adi, &op->value, &values[op->attribute], &nulls[op->attribute], op->field);
+			}
+			return;
+		case AVRO_DECODE_DIRECT:
+			break;
+	}
 
-	while (true)
+	AvroAttributeDeserializationInfo *adi = op->adi;
+	Datum	   *result = &values[op->attribute];
+	StringInfo	buff = &metadata->buffer;
+
+	nulls[op->attribute] = false;
+	resetStringInfo(buff);
+
+	switch (op->type)
 	{
-		err = avro_file_reader_read_value(reader, tuple_value);
-		if (err == EOF)
+		case AVRO_NULL:
+			nulls[op->attribute] = true;
+			return;
+		case AVRO_UNION:
+			{
+				int64_t		branch = avro_read_long(reader);
+
+				if (branch < 0 || (size_t) branch >= op->branches_count)
+					report_malformed_avro();
+				decode_avro_value(metadata, reader, &op->branches[branch], values, nulls);
+			}
+			return;
+		case AVRO_BOOLEAN:
+			*result = BoolGetDatum(*avro_read_fixed(reader, 1) != 0);
+			return;
+		case AVRO_INT32:
+			{
+				int32_t		value = avro_read_int(reader);
+
+				if (adi->expected_logical_type == AVRO_LT_PRIMITIVE)
+				{
+					*result = Int32GetDatum(value);
+					return;
+				}
+				if (adi->expected_logical_type == AVRO_LT_DATE)
+					epoch_days_to_date_string(value, buff);
+				else
+					fracseconds_to_time_string(value, MILLISECONDS_IN_SECOND, MILLISECONDS_IN_SECOND_LOG10, buff);
+			}
+			break;
+		case AVRO_INT64:
+			{
+				int64_t		value = avro_read_long(reader);
+
+				if (adi->expected_logical_type == AVRO_LT_PRIMITIVE)
+				{
+					*result = Int64GetDatum(value);
+					return;
+				}
+				if (adi->expected_logical_type == AVRO_LT_TIME)
+					fracseconds_to_time_string(value, MICROSECONDS_IN_SECOND, MICROSECONDS_IN_SECOND_LOG10, buff);
+				else
+					epoch_fracseconds_to_timestamp_string(value, adi, buff);
+			}
 			break;
-		else if (err)
-			elog(ERROR, "Kafka-ADB: Failed to deserialize AVRO: %s [%d]", avro_strerror(), err);
+		case AVRO_FLOAT:
+			{
+				uint32_t	bits;
+				float		value;
 
-		/* Translate attributes: AVRO -> C -> Postgres */
-		int			avro_i = 0;
+				memcpy(&bits, avro_read_fixed(reader, sizeof(bits)), sizeof(bits));
+				bits = le32toh(bits);
+				memcpy(&value, &bits, sizeof(value));
+				*result = Float4GetDatum(value);
+			}
+			return;
+		case AVRO_DOUBLE:
+			{
+				uint64_t	bits;
+				double		value;
 
-		for (int i = 0; i < ds_metadata->tupledesc->natts; i++)
-		{
-			AvroAttributeDeserializationInfo *adi = &ds_metadata->adis[i];
+				memcpy(&bits, avro_read_fixed(reader, sizeof(bits)), sizeof(bits));
+				bits = le64toh(bits);
+				memcpy(&value, &bits, sizeof(value));
+				*result = Float8GetDatum(value);
+			}
+			return;
+		case AVRO_STRING:
+			{
+				size_t		value_l;
+				const char *value = avro_read_bytes(reader, &value_l);
 
-			if (adi->adi.is_dropped)
+				/* libavro strings end at the first NUL */
+				input_avro_attribute_string(adi, value, strnlen(value, value_l), buff, result, op->field);
+			}
+			return;
+		case AVRO_ENUM:
 			{
-				nulls[i] = true;
-				continue;
+				int64_t		index = avro_read_long(reader);
+				const char *symbol = (index >= 0 && index <= INT32_MAX) ? avro_schema_enum_get(op->schema, (int) index) : NULL;
+
+				if (!PointerIsValid(symbol))
+					ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to retrieve AVRO attribute %d: %s [%d]", op->field, strerror(EINVAL), EINVAL)));
+				input_avro_attribute_string(adi, symbol, strlen(symbol), buff, result, op->field);
+			}
+			return;
+		case AVRO_BYTES:
+		case AVRO_FIXED:
+			{
+				size_t		value_l;
+				const char *value;
+
+				if (op->type == AVRO_BYTES)
+					value = avro_read_bytes(reader, &value_l);
+				else
+				{
+					value_l = (size_t) avro_schema_fixed_size(op->schema);
+					value = avro_read_fixed(reader, value_l);
+				}
+
+				switch (adi->expected_logical_type)
+				{
+					case AVRO_CT_BYTES:
+						{
+							bytea	   *bytes = (bytea *) palloc(VARHDRSZ + value_l);
+
+							SET_VARSIZE(bytes, VARHDRSZ + value_l);
+							memcpy(VARDATA(bytes), value, value_l);
+							*result = PointerGetDatum(bytes);
+						}
+						return;
+					case AVRO_LT_DECIMAL:
+						decimal_to_string(value, value_l, adi, buff, op->field);
+						break;
+					case AVRO_LT_DURATION:
+						duration_to_string(value, value_l, buff);
+						break;
+					default:
+						Assert(false);
+						elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", adi->expected_logical_type);
+				}
 			}
+			break;
+		default:
+			Assert(false);
+			elog(ERROR, "Kafka-ADB: Failed assertion: Unexpected %d", op->type);
+	}
+
+	input_avro_attribute_string(adi, buff->data, buff->len, buff, result, op->field);
+}
+
+/**
+ * Read the header of an AVRO Object Container File.
+ *
+ * @param sync the synchronization marker of the file is written here
+ *
+ * @return false if the compiled decoder cannot process the file: the header is
+ * malformed, or the data blocks are compressed
+ */
+static bool
+read_avro_container_header(AvroBinaryReader * reader, char *sync)
+{
+	const char *magic;
+	const char *sync_read;
+	int64_t		count;
+
+	if (!avro_try_read_fixed(reader, AVRO_OCF_MAGIC_SIZE, &magic) || memcmp(magic, AVRO_OCF_MAGIC, AVRO_OCF_MAGIC_SIZE) != 0)
+		return false;
+
+	/* File metadata is a map of 'bytes' */
+	while (true)
+	{
+		if (!avro_try_read_long(reader, &count))
+			return false;
+		if (count == 0)
+			break;
+		if (count < 0)
+		{
+			int64_t		size;
+
+			if (!avro_try_read_long(reader, &size))
+				return false;
+			count = -count;
+		}
+		for (int64_t i = 0; i < count; i++)
+		{
+			const char *key;
+			size_t		key_l;
+			const char *value;
+			size_t		value_l;
+
+			if (!avro_try_read_bytes(reader, &key, &key_l) || !avro_try_read_bytes(reader, &value, &value_l))
+				return false;
+			if (key_l == strlen("avro.codec") && memcmp(key, "avro.codec", key_l) == 0 && !(value_l == strlen("null") && memcmp(value, "null", value_l) == 0))
+				return false;
+		}
+	}
+
+	if (!avro_try_read_fixed(reader, AVRO_OCF_SYNC_SIZE, &sync_read))
+		return false;
+	memcpy(sync, sync_read, AVRO_OCF_SYNC_SIZE);
+	return true;
+}
+
+/**
+ * Start to read records of 'data' of length 'data_l' in AVRO Object Container
+ * File format with the compiled decode ops.
+ *
+ * @return false if the compiled decoder cannot process 'data' (see
+ * 'read_avro_container_header()')
+ */
+static bool
+begin_avro_message_compiled(AvroDeserializationMetadata ds_metadata, const char *data, size_t data_l)
+{
+	ds_metadata->message.p = data;
+	ds_metadata->message.end = data + data_l;
+	if (!read_avro_container_header(&ds_metadata->message, ds_metadata->sync))
+		return false;
+
+	ds_metadata->block_is_open = false;
+	ds_metadata->block_records_left = 0;
+
+	/*
+	 * libavro values keep memory allocated in the arena, thus they are
+	 * created for each message
+	 */
+	if (ds_metadata->libavro_ops != NIL)
+	{
+		ListCell   *it;
+
+		ds_metadata->libavro_reader = avro_reader_memory(NULL, 0);
+		foreach(it, ds_metadata->libavro_ops)
+		{
+			AvroDecodeOp *op = (AvroDecodeOp *) lfirst(it);
+			int			err;
+
+			if ((err = avro_generic_value_new(op->iface, &op->value)))
+				elog(ERROR, "Kafka-ADB: Failed to resolve AVRO schema: %s [%d]", strerror(err), err);
+		}
+	}
 
-			avro_value_t attribute_value;
+	ds_metadata->reading = AVRO_MESSAGE_READING_COMPILED;
+	return true;
+}
+
+/**
+ * Read the next record of the CURRENT message with the compiled decode ops.
+ */
+static bool
+next_avro_record_compiled(AvroDeserializationMetadata ds_metadata, Datum *values, bool *nulls)
+{
+	AvroBinaryReader *reader = &ds_metadata->message;
+	AvroBinaryReader *block = &ds_metadata->block;
 
-			if ((err = avro_value_get_by_index(tuple_value, avro_i, &attribute_value, NULL)))
-				elog(ERROR, "Kafka-ADB: Failed to read AVRO value: %s [%d]", strerror(err), err);
-			translate_avro_value_to_postgres_datum(adi, &attribute_value, &values[i], &nulls[i], avro_i);
-			avro_i += 1;
+	while (ds_metadata->block_records_left == 0)
+	{
+		if (ds_metadata->block_is_open)
+		{
+			if (block->p != block->end || memcmp(avro_read_fixed(reader, AVRO_OCF_SYNC_SIZE), ds_metadata->sync, AVRO_OCF_SYNC_SIZE) != 0)
+				report_malformed_avro();
+			ds_metadata->block_is_open = false;
+		}
+		if (reader->p >= reader->end)
+		{
+			ds_metadata->reading = AVRO_MESSAGE_READING_NONE;
+			return false;
 		}
 
-		/* Form the tuple */
-		result = lappend(result, heap_form_tuple(ds_metadata->tupledesc, values, nulls));
+		int64_t		count = avro_read_long(reader);
+		int64_t		size = avro_read_long(reader);
+
+		if (count < 0 || size < 0)
+			report_malformed_avro();
+
+		block->p = avro_read_fixed(reader, (size_t) size);
+		block->end = reader->p;
+		ds_metadata->block_is_open = true;
+		ds_metadata->block_records_left = count;
 	}
 
-	pfree(values);
-	pfree(nulls);
+	memset(nulls, true, sizeof(bool) * ds_metadata->tupledesc->natts);
+	for (size_t f = 0; f < ds_metadata->ops_count; f++)
+		decode_avro_value(ds_metadata, block, &ds_metadata->ops[f], values, nulls);
+	ds_metadata->block_records_left -= 1;
 
-	avro_value_reset(tuple_value);
-	avro_file_reader_close(reader);
-	fclose(data_fp);
+	return true;
+}
+
+/**
+ * Start to read records of 'data' of length 'data_l' in AVRO Object Container
+ * File format with libavro.
+ */
+static void
+begin_avro_message_libavro(AvroDeserializationMetadata ds_metadata, void *data, size_t data_l)
+{
+	int			err;
+
+	/* Apply libavro to the received buffer */
+	ds_metadata->message_fp = fmemopen(data, data_l, "r");
+	if ((err = avro_file_reader_fp(ds_metadata->message_fp, "Postgres", false, &ds_metadata->file_reader)))
+	{
+		fclose(ds_metadata->message_fp);
+		ds_metadata->message_fp = NULL;
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to read received AVRO bytes: %s [%d]", strerror(err), err)));
+	}
+
+	/* Prepare schema, if necessary */
+	if (!ds_metadata->is_schema_provided)
+	{
+		ds_metadata->schema = avro_file_reader_get_writer_schema(ds_metadata->file_reader);
+		if (ds_metadata->is_mapping_by_name)
+			resolve_field_indexes_by_name(ds_metadata, ds_metadata->schema);
+	}
+	schema_to_value(ds_metadata);
+
+	ds_metadata->reading = AVRO_MESSAGE_READING_LIBAVRO;
+}
+
+/**
+ * Close libavro file reader of the CURRENT message, if it is open.
+ */
+static void
+end_avro_message_libavro(AvroDeserializationMetadata ds_metadata)
+{
+	if (!PointerIsValid(ds_metadata->message_fp))
+		return;
+
+	avro_file_reader_close(ds_metadata->file_reader);
+	fclose(ds_metadata->message_fp);
+	ds_metadata->message_fp = NULL;
+}
+
+/**
+ * Read the next record of the CURRENT message with libavro.
+ */
+static bool
+next_avro_record_libavro(AvroDeserializationMetadata ds_metadata, Datum *values, bool *nulls)
+{
+	avro_value_t *tuple_value = &ds_metadata->value;
+	int			err = avro_file_reader_read_value(ds_metadata->file_reader, tuple_value);
+
+	if (err == EOF)
+	{
+		end_avro_message_libavro(ds_metadata);
+		ds_metadata->reading = AVRO_MESSAGE_READING_NONE;
+		return false;
+	}
+	else if (err)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to deserialize AVRO: %s [%d]", avro_strerror(), err)));
+
+	/* Translate attributes: AVRO -> C -> Postgres */
+	for (int i = 0; i < ds_metadata->tupledesc->natts; i++)
+	{
+		AvroAttributeDeserializationInfo *adi = &ds_metadata->adis[i];
+		int			avro_i = ds_metadata->field_indexes[i];
+
+		if (adi->adi.is_skipped || avro_i == AVRO_FIELD_ABSENT)
+		{
+			nulls[i] = true;
+			continue;
+		}
+
+		avro_value_t attribute_value;
+
+		if ((err = avro_value_get_by_index(tuple_value, avro_i, &attribute_value, NULL)))
+			ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to read AVRO value: %s [%d]", strerror(err), err)));
+		translate_avro_value_to_postgres_datum(adi, &attribute_value, &values[i], &nulls[i], avro_i);
+	}
+
+	return true;
+}
+
+#ifdef FAULT_INJECTOR
+/**
+ * A method to replace the actual deserialization in tests
+ */
+static void
+deserialize_dummy(AvroDeserializationMetadata ds_metadata, Datum *values, bool *nulls)
+{
+	for (int i = 0; i < ds_metadata->tupledesc->natts; i++)
+	{
+		switch (ds_metadata->tupledesc->attrs[i]->atttypid)
+		{
+			case INT4OID:
+				values[i] = Int32GetDatum(42);
+				nulls[i] = false;
+				break;
+			case INT8OID:
+				values[i] = Int64GetDatum(42);
+				nulls[i] = false;
+				break;
+			default:
+				nulls[i] = true;
+		}
+	}
+}
+#endif
+
+/**
+ * Start to read records of AVRO 'data' of length 'data_l'.
+ *
+ * @note This function is called when 'avro_arena' is active. The reader of
+ * the previous message is closed first, and then the arena is reset
+ */
+static void
+begin_avro_message(AvroDeserializationMetadata ds_metadata, void *data, size_t data_l)
+{
+	end_avro_message_libavro(ds_metadata);
+	ds_metadata->reading = AVRO_MESSAGE_READING_NONE;
+
+	/*
+	 * Memory allocated by libavro and GNU MP for the previous message is
+	 * released at once. Datums are allocated by palloc, not in the arena.
+	 */
+	kadb_arena_reset(ds_metadata->arena);
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_tuples") == FaultInjectorTypeSkip)
+	{
+		ds_metadata->reading = AVRO_MESSAGE_READING_DUMMY;
+		return;
+	}
+#endif
+
+	if (!PointerIsValid(data) || data_l < 1)
+		return;
+
+	if (PointerIsValid(ds_metadata->ops) && begin_avro_message_compiled(ds_metadata, (const char *) data, data_l))
+		return;
+	begin_avro_message_libavro(ds_metadata, data, data_l);
+}
+
+/**
+ * Read the next record of the CURRENT message.
+ *
+ * @note This function is called when 'avro_arena' is active
+ */
+static bool
+next_avro_record(AvroDeserializationMetadata ds_metadata, Datum *values, bool *nulls)
+{
+	switch (ds_metadata->reading)
+	{
+		case AVRO_MESSAGE_READING_NONE:
+			return false;
+		case AVRO_MESSAGE_READING_COMPILED:
+			return next_avro_record_compiled(ds_metadata, values, nulls);
+		case AVRO_MESSAGE_READING_LIBAVRO:
+			return next_avro_record_libavro(ds_metadata, values, nulls);
+#ifdef FAULT_INJECTOR
+		case AVRO_MESSAGE_READING_DUMMY:
+			deserialize_dummy(ds_metadata, values, nulls);
+			ds_metadata->reading = AVRO_MESSAGE_READING_NONE;
+			return true;
+#endif
+	}
+	Assert(false);
+	return false;
+}
+
+void
+begin_deserialization_avro(AvroDeserializationMetadata ds_metadata, void *data, size_t data_l)
+{
+	Assert(PointerIsValid(ds_metadata));
+	Assert(PointerIsValid(ds_metadata->tupledesc));
+
+	avro_arena = ds_metadata->arena;
+	PG_TRY();
+	{
+		begin_avro_message(ds_metadata, data, data_l);
+	}
+	PG_CATCH();
+	{
+		avro_arena = NULL;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	avro_arena = NULL;
+}
+
+bool
+deserialize_next_avro(AvroDeserializationMetadata ds_metadata, Datum *values, bool *nulls)
+{
+	Assert(PointerIsValid(ds_metadata));
+
+	if (ds_metadata->reading == AVRO_MESSAGE_READING_NONE)
+		return false;
+
+	bool		result;
+
+	avro_arena = ds_metadata->arena;
+	PG_TRY();
+	{
+		result = next_avro_record(ds_metadata, values, nulls);
+	}
+	PG_CATCH();
+	{
+		avro_arena = NULL;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	avro_arena = NULL;
 
 	return result;
 }
+
+void
+finish_deserialization_avro(AvroDeserializationMetadata ds_metadata)
+{
+	Assert(PointerIsValid(ds_metadata));
+
+	avro_arena = ds_metadata->arena;
+	end_avro_message_libavro(ds_metadata);
+	avro_arena = NULL;
+
+	kadb_arena_report_stats(ds_metadata->arena, "avro", DEBUG1);
+	kadb_arena_destroy(ds_metadata->arena);
+	ds_metadata->arena = NULL;
+}
+
+
+/*
+ * Callbacks of the format
+ */
+
+/**
+ * Parse (change types, if necessary) and validate settings for AVRO
+ * deserialization format.
+ */
+static void
+validate_options_avro(List *options, bool check_required)
+{
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+		const char *key = option->defname;
+
+		if (STREQ(key, KADB_SETTING_AVRO_MAPPING))
+		{
+			char	   *value = defGetString(option);
+
+			if (!STREQ(value, KADB_AVRO_MAPPING_POSITION) && !STREQ(value, KADB_AVRO_MAPPING_NAME))
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be one of '%s', '%s'", key, KADB_AVRO_MAPPING_POSITION, KADB_AVRO_MAPPING_NAME)));
+		}
+	}
+}
+
+static void *
+prepare_avro(TupleDesc tupledesc, List *options)
+{
+	DefElem    *schema = get_option(options, KADB_SETTING_AVRO_SCHEMA);
+
+	initialize_libavro_for_postgres();
+	return prepare_deserialization_metadata_avro(tupledesc, PointerIsValid(schema) ? defGetString(schema) : NULL, options);
+}
+
+static void
+begin_avro(void *state, void *data, size_t data_l)
+{
+	begin_deserialization_avro((AvroDeserializationMetadata) state, data, data_l);
+}
+
+static bool
+next_avro(void *state, Datum *values, bool *nulls)
+{
+	return deserialize_next_avro((AvroDeserializationMetadata) state, values, nulls);
+}
+
+static void
+finish_avro(void *state)
+{
+	finish_deserialization_avro((AvroDeserializationMetadata) state);
+}
+
+static const char *const AvroOptions[] = {
+	KADB_SETTING_AVRO_SCHEMA,
+	KADB_SETTING_AVRO_MAPPING,
+	NULL
+};
+
+const DeserializationFormatRoutine AvroDeserializationFormat = {
+	.api_version = KADB_DESERIALIZATION_FORMAT_API_VERSION,
+	.name = "avro",
+	.options = AvroOptions,
+	.column_options = NULL,
+	.validate_options = validate_options_avro,
+	.prepare = prepare_avro,
+	.begin = begin_avro,
+	.next = next_avro,
+	.finish = finish_avro,
+	.estimate_cost = NULL,
+	.prepare_decode = NULL,
+	.decode = NULL,
+	.begin_decoded = NULL,
+	.discard_decoded = NULL
+};
@@ -10,6 +10,8 @@
 #include <access/htup.h>
 #include <access/tupdesc.h>
 
+#include "deserialization/format.h"
+
 
 /* Opaque binary object used by deserializer to store a resolved AVRO schema. */
 typedef struct AvroDeserializationMetadataObject *AvroDeserializationMetadata;
@@ -29,21 +31,37 @@ void		initialize_libavro_for_postgres(void);
  * @param json may be NULL, if no schema is provided by user. In this case,
  * schema is taken from each incoming message independently.
  *
+ * @param options FOREIGN TABLE options
+ *
  * @note 'tupledesc' is not copied. It must be allocated in a
  * sufficiently-long-living memory context.
  */
-AvroDeserializationMetadata prepare_deserialization_metadata_avro(TupleDesc tupledesc, const char *json);
+AvroDeserializationMetadata prepare_deserialization_metadata_avro(TupleDesc tupledesc, const char *json, List *options);
 
 /**
- * Deserialize binary 'data' of length 'data_l'.
- *
- * @return a list of HeapTuples, allocated by palloc in CurrentMemoryContext
- * @return NIL (empty list) if 'data' is NULL or 'data_l' is 0
+ * Start to deserialize binary 'data' of length 'data_l'. A message with NULL
+ * 'data' or 'data_l' of 0 produces no records.
  *
  * @note 'data' is expected to be in Object Container File format
  */
-List	   *deserialize_avro(AvroDeserializationMetadata ds_metadata, void *data, size_t data_l);
+void		begin_deserialization_avro(AvroDeserializationMetadata ds_metadata, void *data, size_t data_l);
+
+/**
+ * Deserialize the next record into 'values' and 'nulls'.
+ *
+ * @return 'false' if there are no more records in the message
+ */
+bool		deserialize_next_avro(AvroDeserializationMetadata ds_metadata, Datum *values, bool *nulls);
+
+/**
+ * Finish AVRO deserialization: close the reader of the last message, and
+ * release memory libavro and GNU MP allocated for it.
+ */
+void		finish_deserialization_avro(AvroDeserializationMetadata ds_metadata);
+
 
+/* Callbacks of the format */
+extern const DeserializationFormatRoutine AvroDeserializationFormat;
 
 #endif   /* //
 								 * KADB_FDW_DESERIALIZATION_AVRO_DESERIALIZER_I
@@ -1,201 +1,496 @@
 #include "csv_deserializer.h"
 
-#include <stdlib.h>
-
-#include <csv.h>
-
 #include <access/htup.h>
-#include <utils/memutils.h>
+#include <lib/stringinfo.h>
+#include <optimizer/cost.h>
 #include <utils/faultinjector.h>
 
 #include "settings.h"
 #include "deserialization/attribute_postgres.h"
+#include "deserialization/message_encoding.h"
+#include "utils/kadb_simd.h"
+
+
+#define STREQ(a, b) (strcmp(a, b) == 0)
+
+#define CSV_DEFAULT_QUOTE '"'
+#define CSV_DEFAULT_DELIMITER ','
+
+/* Record terminators; any of them ends a record */
+#define CSV_CR '\r'
+#define CSV_LF '\n'
+
+#define CSV_IS_TERMINATOR(c) ((c) == CSV_CR || (c) == CSV_LF)
+#define CSV_IS_SPACE(c) ((c) == ' ' || (c) == '\t')
 
 
 /* Deserialization directives obtained from 'options' */
 typedef struct CSVDeserializationSettings
 {
-	/* Ignore the first tuple in each pass of deserialization */
+	/* Quote character */
+	char		quote;
+	/* Delimiter character */
+	char		delimiter;
+	/* Trim whitespace at the start and the end of non-quoted fields */
+	bool		trim_whitespace;
+	/* Ignore the first record of each message */
 	bool		ignore_header;
-	/* Do not form HeapTuple from the next tuple */
-	bool		ignore_one_tuple;
 	/* String denoting NULL */
 	char	   *null_string;
+	size_t		null_string_l;
 }	CSVDeserializationSettings;
 
 /**
- * Data used by the deserialization process on-the-fly.
+ * How a field ended.
+ */
+typedef enum CSVFieldEnd
+{
+	CSV_FIELD_END_DELIMITER,
+	CSV_FIELD_END_RECORD,
+	CSV_FIELD_END_DATA
+}	CSVFieldEnd;
+
+/**
+ * The result of 'scan_field()'.
+ */
+typedef enum CSVScanResult
+{
+	/* A field was found; the record continues */
+	CSV_SCAN_FIELD,
+	/* A field was found; it is the last one of its record */
+	CSV_SCAN_LAST_FIELD,
+	/* There are no more fields in the data */
+	CSV_SCAN_END
+}	CSVScanResult;
+
+/**
+ * A growable null-terminated buffer of bytes. It is allocated by palloc in
+ * the backend, and by malloc in worker threads.
+ */
+typedef struct CSVBuffer
+{
+	char	   *data;
+	size_t		len;
+	size_t		size;
+	bool		use_malloc;
+	/* malloc failed; the contents are incomplete */
+	bool		is_failed;
+}	CSVBuffer;
+
+/**
+ * A splitter of CSV data into fields.
+ *
+ * It does not reference memory of the backend, and does not call PostgreSQL
+ * functions when its buffer uses malloc, so it can be used in worker threads.
+ */
+typedef struct CSVScanner
+{
+	char		quote;
+	char		delimiter;
+	bool		trim_whitespace;
+	/* Bytes that end a non-quoted field */
+	ByteSet		unquoted_stops;
+	/* Bytes that end a run of ordinary bytes in a quoted field */
+	ByteSet		quoted_stops;
+	/* Unescaped value of the last quoted field */
+	CSVBuffer	buffer;
+
+	/* The rest of the data */
+	const char *p;
+	const char *end;
+	/* Whether the current record contains at least one (completed) field */
+	bool		record_begun;
+}	CSVScanner;
+
+/* Flags of a field in 'CSVDecodeTask' */
+/* The field is the last one of its record */
+#define CSV_DECODED_LAST 0x01
+/* The value is in 'values' of the task rather than in the message */
+#define CSV_DECODED_UNESCAPED 0x02
+
+/**
+ * A field found by a worker thread.
+ */
+typedef struct CSVDecodedField
+{
+	/* The offset of the value in the message, or in 'values' */
+	size_t		offset;
+	size_t		length;
+	int			flags;
+}	CSVDecodedField;
+
+/**
+ * A message split into fields by a worker thread. Allocated by malloc.
  */
-typedef struct CSVDeserializationMetadata
+typedef struct CSVDecodeTask
+{
+	CSVScanner	scanner;
+	/* The message; it is a copy owned by the task if 'data_copy' is set */
+	const char *data;
+	size_t		data_l;
+	char	   *data_copy;
+
+	CSVDecodedField *fields;
+	size_t		fields_count;
+	size_t		fields_size;
+	/* Null-terminated unescaped values of quoted fields */
+	char	   *values;
+	size_t		values_l;
+	size_t		values_size;
+	/* malloc failed; the message is parsed by the backend */
+	bool		is_failed;
+}	CSVDecodeTask;
+
+/* See definition in the header */
+typedef struct CSVDeserializationStateObject
 {
 	/* Deserialization instructions for each attribute */
 	AttributeDeserializationInfo *adis;
-	/* "Iterator" over 'adis' */
-	size_t		adis_i;
-	/* Datums for the CURRENT record */
-	Datum	   *datums;
-	/* Null mask for the CURRENT record */
-	bool	   *nulls;
 	/* Tuple descriptor */
 	TupleDesc	tupledesc;
 	/* Settings altering the deserialization process */
 	CSVDeserializationSettings settings;
-	/* RESULTING tuples */
-	List	   *result;
+	/* The encoding of messages, or NULL if it is not set */
+	MessageEncoding encoding;
+
+	/* The splitter of the CURRENT message, when it is parsed by the backend */
+	CSVScanner	scanner;
+	/* Null-terminated value of the CURRENT field */
+	StringInfoData field;
+
+	/* The CURRENT message split into fields by a worker thread, or NULL */
+	const CSVDecodeTask *decoded;
+	/* "Iterator" over 'decoded->fields' */
+	size_t		decoded_i;
+
+	/* "Iterator" over 'adis' */
+	int			adis_i;
+	/* Datums for the CURRENT record; provided by 'deserialize_next_csv()' */
+	Datum	   *datums;
+	/* Null mask for the CURRENT record; provided the same way */
+	bool	   *nulls;
+	/* Whether the first field of the CURRENT record is NULL, if not skipped */
+	bool		first_field_is_null;
+	/* Do not return the CURRENT record */
+	bool		ignore_one_tuple;
+	/* The CURRENT record is complete and is to be returned */
+	bool		record_is_ready;
 #ifdef FAULT_INJECTOR
 	/* Raw data to use for tests */
 	char	   *data;
 	size_t		data_l;
 #endif
-}	CSVDeserializationMetadata;
-
-/* See definition in the header */
-typedef struct CSVDeserializationStateObject
-{
-	CSVDeserializationMetadata *metadata;
-	struct csv_parser *parser;
 }	CSVDeserializationStateObject;
 
 
 /**
  * Set 'settings' using values from 'options'.
+ *
+ * Validity of each option MUST be checked at planning stage.
  */
 static void
 set_deserialization_settings(CSVDeserializationSettings * settings, List *options)
 {
+	DefElem    *quote = get_option(options, KADB_SETTING_CSV_QUOTE);
+	DefElem    *delimiter = get_option(options, KADB_SETTING_CSV_DELIMITER);
+	DefElem    *trim_whitespace = get_option(options, KADB_SETTING_CSV_ATTRIBUTE_TRIM_WHITESPACE);
+	DefElem    *ignore_header = get_option(options, KADB_SETTING_CSV_IGNORE_HEADER);
+	DefElem    *null_string = get_option(options, KADB_SETTING_CSV_NULL_STRING);
+
+	settings->quote = PointerIsValid(quote) ? defGetString(quote)[0] : CSV_DEFAULT_QUOTE;
+	settings->delimiter = PointerIsValid(delimiter) ? defGetString(delimiter)[0] : CSV_DEFAULT_DELIMITER;
+	settings->trim_whitespace = PointerIsValid(trim_whitespace) ? defGetBoolean(trim_whitespace) : true;
+	settings->ignore_header = PointerIsValid(ignore_header) ? defGetBoolean(ignore_header) : false;
+
 	settings->null_string = NULL;
-	if (PointerIsValid(get_option(options, KADB_SETTING_CSV_NULL_STRING)))
+	settings->null_string_l = 0;
+	if (PointerIsValid(null_string))
 	{
-		char	   *null_string = defGetString(get_option(options, KADB_SETTING_CSV_NULL_STRING));
-
-		settings->null_string = palloc(strlen(null_string) + 1);
-		strcpy(settings->null_string, null_string);
+		settings->null_string = pstrdup(defGetString(null_string));
+		settings->null_string_l = strlen(settings->null_string);
 	}
-
-	settings->ignore_header = PointerIsValid(get_option(options, KADB_SETTING_CSV_IGNORE_HEADER)) ?
-		defGetBoolean(get_option(options, KADB_SETTING_CSV_IGNORE_HEADER)) :
-		false;
 }
 
 /**
- * Form an instance of 'CSVDeserializationMetadata' using 'tupledesc'.
+ * Make sure 'buffer' has room for 'extra' more bytes and a terminating NUL.
+ *
+ * @return 'false' if malloc failed
  */
-static CSVDeserializationMetadata *
-make_csv_deserialization_metadata(TupleDesc tupledesc, List *options)
+static bool
+buffer_reserve(CSVBuffer * buffer, size_t extra)
 {
-	CSVDeserializationMetadata *result = palloc(sizeof(CSVDeserializationMetadata));
+	if (buffer->is_failed)
+		return false;
+	if (buffer->len + extra < buffer->size)
+		return true;
 
-	result->adis = (AttributeDeserializationInfo *) palloc(sizeof(AttributeDeserializationInfo) * tupledesc->natts);
-	for (int i = 0; i < tupledesc->natts; i++)
+	size_t		size = Max(buffer->size, 64);
+	char	   *data;
+
+	while (size <= buffer->len + extra)
+		size *= 2;
+
+	if (!buffer->use_malloc)
+		data = PointerIsValid(buffer->data) ? repalloc(buffer->data, size) : palloc(size);
+	else if (!PointerIsValid(data = realloc(buffer->data, size)))
 	{
-		fill_attribute_deserialization_info(&result->adis[i], tupledesc, i);
+		buffer->is_failed = true;
+		return false;
 	}
 
-	result->adis_i = 0;
+	buffer->data = data;
+	buffer->size = size;
+	return true;
+}
 
-	result->datums = palloc(sizeof(Datum) * tupledesc->natts);
-	result->nulls = palloc(sizeof(bool) * tupledesc->natts);
+/**
+ * Append 'bytes' of length 'bytes_l' to 'buffer'.
+ */
+static inline void
+buffer_append(CSVBuffer * buffer, const char *bytes, size_t bytes_l)
+{
+	if (!buffer_reserve(buffer, bytes_l))
+		return;
+	memcpy(buffer->data + buffer->len, bytes, bytes_l);
+	buffer->len += bytes_l;
+	buffer->data[buffer->len] = '\0';
+}
 
-	result->tupledesc = tupledesc;
+static inline void
+buffer_append_char(CSVBuffer * buffer, char c)
+{
+	buffer_append(buffer, &c, 1);
+}
 
-	result->result = NIL;
+static inline void
+buffer_reset(CSVBuffer * buffer)
+{
+	buffer->len = 0;
+	if (PointerIsValid(buffer->data))
+		buffer->data[0] = '\0';
+}
 
-	set_deserialization_settings(&result->settings, options);
+/**
+ * Initialize 'scanner' with the given 'settings'. Its buffer is allocated
+ * by malloc if 'use_malloc' is set.
+ */
+static void
+init_scanner(CSVScanner * scanner, const CSVDeserializationSettings * settings, bool use_malloc)
+{
+	char		unquoted_stops[] = {settings->delimiter, CSV_CR, CSV_LF};
 
-#ifdef FAULT_INJECTOR
-	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_csv") == FaultInjectorTypeSkip)
-	{
-		char	   *inject_data = defGetString(get_option(options, KADB_SETTING_CSV_DATA_ON_INJECT));
+	scanner->quote = settings->quote;
+	scanner->delimiter = settings->delimiter;
+	scanner->trim_whitespace = settings->trim_whitespace;
+	byte_set_init(&scanner->unquoted_stops, unquoted_stops, lengthof(unquoted_stops));
+	byte_set_init(&scanner->quoted_stops, &settings->quote, 1);
 
-		result->data_l = strlen(inject_data) + 1;
-		result->data = palloc(result->data_l);
-		strcpy(result->data, inject_data);
-	}
-#endif
+	memset(&scanner->buffer, 0, sizeof(scanner->buffer));
+	scanner->buffer.use_malloc = use_malloc;
+	/* The buffer then grows in the memory context it is allocated in */
+	if (!use_malloc)
+		buffer_reserve(&scanner->buffer, 0);
 
-	return result;
+	scanner->p = scanner->end = NULL;
+	scanner->record_begun = false;
 }
 
 /**
- * 'realloc()' implementation for libcsv csv_parser that uses correct memory
- * context for allocation.
+ * Start to split 'data' of length 'data_l'.
  */
-static void *
-csv_postgres_realloc(void *ptr, size_t size)
+static void
+reset_scanner(CSVScanner * scanner, const char *data, size_t data_l)
+{
+	scanner->p = data;
+	scanner->end = data + data_l;
+	scanner->record_begun = false;
+}
+
+/**
+ * Get the end of a field from the byte '*p' which ends it.
+ */
+static inline CSVFieldEnd
+field_end(const CSVScanner * scanner, const char *p, const char *end)
+{
+	if (p == end)
+		return CSV_FIELD_END_DATA;
+	if (*p == scanner->delimiter)
+		return CSV_FIELD_END_DELIMITER;
+	return CSV_FIELD_END_RECORD;
+}
+
+/**
+ * Scan a non-quoted field which starts at 'scanner->p'.
+ *
+ * The value is a span of the data.
+ *
+ * @return the end of the field. 'scanner->p' is set to the next byte after it
+ */
+static CSVFieldEnd
+scan_unquoted_field(CSVScanner * scanner, const char **value, size_t *value_l)
 {
-	void	   *volatile result = NULL;
+	const char *start = scanner->p;
+	const char *end = scanner->end;
+	const char *stop = byte_set_find(&scanner->unquoted_stops, start, end);
+	const char *value_end = stop;
 
-	MemoryContext oldcontext = MemoryContextSwitchTo(PortalContext);
+	/* Leading whitespace is skipped by the caller */
+	if (scanner->trim_whitespace)
+	{
+		while (value_end > start && CSV_IS_SPACE(value_end[-1]))
+			value_end -= 1;
+	}
+
+	*value = start;
+	*value_l = value_end - start;
 
-	PG_TRY();
+	scanner->p = stop < end ? stop + 1 : end;
+	return field_end(scanner, stop, end);
+}
+
+/**
+ * Scan a quoted field whose opening quote is right before 'scanner->p'.
+ *
+ * The unescaped value is stored in 'scanner->buffer'.
+ *
+ * A pair of quotes in a quoted field is an escaped quote. Contrary to strict
+ * CSV, a quote that is not followed by a delimiter or a terminator (possibly
+ * after whitespace) is a part of the value, and the field remains quoted.
+ *
+ * @return the end of the field. 'scanner->p' is set to the next byte after it
+ */
+static CSVFieldEnd
+scan_quoted_field(CSVScanner * scanner, const char **value, size_t *value_l)
+{
+	CSVBuffer  *field = &scanner->buffer;
+	const char *it = scanner->p;
+	const char *end = scanner->end;
+
+	buffer_reset(field);
+	for (;;)
 	{
-		do
+		const char *quote = byte_set_find(&scanner->quoted_stops, it, end);
+
+		buffer_append(field, it, quote - it);
+		if (quote == end)
+		{
+			/* Unterminated quoted field: take everything up to the end */
+			*value = field->data;
+			*value_l = field->len;
+			scanner->p = end;
+			return CSV_FIELD_END_DATA;
+		}
+
+		/*
+		 * The quote might close the field. It is kept, together with the
+		 * whitespace after it, until this is known.
+		 */
+		size_t		tentative = 1;
+
+		buffer_append_char(field, scanner->quote);
+		it = quote + 1;
+		for (;;)
 		{
-			/* free */
-			if (size == 0)
+			if (it == end || *it == scanner->delimiter || CSV_IS_TERMINATOR(*it))
+			{
+				if (!field->is_failed)
+				{
+					field->len -= tentative;
+					field->data[field->len] = '\0';
+				}
+				*value = field->data;
+				*value_l = field->len;
+				scanner->p = it < end ? it + 1 : end;
+				return field_end(scanner, it, end);
+			}
+
+			char		c = *it++;
+
+			if (scanner->trim_whitespace && CSV_IS_SPACE(c))
 			{
-				if (PointerIsValid(ptr))
-					pfree(ptr);
-				break;
+				buffer_append_char(field, c);
+				tentative += 1;
+				continue;
 			}
-			/* malloc */
-			if (!PointerIsValid(ptr))
+			if (c == scanner->quote && tentative > 1)
 			{
-				result = palloc(size);
-				break;
+				/* Only the last quote might close the field now */
+				buffer_append_char(field, c);
+				tentative = 1;
+				continue;
 			}
-			/* realloc */
-			result = repalloc(ptr, size);
+			/* An escaped quote is kept; so is anything else */
+			if (c != scanner->quote)
+				buffer_append_char(field, c);
+			break;
 		}
-		while (false);
 	}
-	PG_CATCH();
-	{
-		MemoryContextSwitchTo(oldcontext);
-		PG_RE_THROW();
-	}
-	PG_END_TRY();
-	MemoryContextSwitchTo(oldcontext);
-
-	return result;
 }
 
 /**
- * A method that returns 'false' for any input.
+ * Find the next field of the data.
+ *
+ * Fields are located by vectorized search of special bytes; conventions
+ * (including the handling of malformed data) are the ones of libcsv, which
+ * was used formerly. Empty lines are skipped.
  *
- * Currently used to prevent libcsv from trimming whitespace.
+ * @param value set to the value of the field, or NULL for an empty field
+ * @param is_unescaped set to 'true' if the value is in 'scanner->buffer'
  */
-static int
-ignore_character_func(unsigned char c)
+static CSVScanResult
+scan_field(CSVScanner * scanner, const char **value, size_t *value_l, bool *is_unescaped)
 {
-	return (int) false;
-}
+	*value = NULL;
+	*value_l = 0;
+	*is_unescaped = false;
 
-/**
- * Allocate and prepare 'struct csv_parser' according to the given 'options'.
- */
-static struct csv_parser *
-make_prepare_csv_parser(List *options)
-{
-	struct csv_parser *result = palloc(sizeof(struct csv_parser));
+	while (scanner->p < scanner->end)
+	{
+		char		c = *scanner->p;
 
-	csv_init(result, (unsigned char) (CSV_APPEND_NULL | CSV_EMPTY_IS_NULL));
+		if (scanner->trim_whitespace && CSV_IS_SPACE(c) && c != scanner->delimiter)
+		{
+			scanner->p += 1;
+			continue;
+		}
+		if (CSV_IS_TERMINATOR(c))
+		{
+			scanner->p += 1;
+			/* Empty lines are skipped */
+			if (!scanner->record_begun)
+				continue;
+			scanner->record_begun = false;
+			return CSV_SCAN_LAST_FIELD;
+		}
+		if (c == scanner->delimiter)
+		{
+			scanner->p += 1;
+			scanner->record_begun = true;
+			return CSV_SCAN_FIELD;
+		}
 
-	csv_set_realloc_func(result, csv_postgres_realloc);
-	csv_set_free_func(result, pfree);
+		CSVFieldEnd field_end;
 
-	/* Validity of each option MUST be checked at planning stage. */
-	if (PointerIsValid(get_option(options, KADB_SETTING_CSV_QUOTE)))
-		csv_set_quote(result, (unsigned char) defGetString(get_option(options, KADB_SETTING_CSV_QUOTE))[0]);
-	if (PointerIsValid(get_option(options, KADB_SETTING_CSV_DELIMITER)))
-		csv_set_delim(result, (unsigned char) defGetString(get_option(options, KADB_SETTING_CSV_DELIMITER))[0]);
-	if (
-		PointerIsValid(get_option(options, KADB_SETTING_CSV_ATTRIBUTE_TRIM_WHITESPACE))
-		&& false == defGetBoolean(get_option(options, KADB_SETTING_CSV_ATTRIBUTE_TRIM_WHITESPACE))
-		)
-		csv_set_space_func(result, ignore_character_func);
+		if (c == scanner->quote)
+		{
+			scanner->p += 1;
+			field_end = scan_quoted_field(scanner, value, value_l);
+			*is_unescaped = true;
+		}
+		else
+			field_end = scan_unquoted_field(scanner, value, value_l);
 
-	return result;
+		scanner->record_begun = (field_end == CSV_FIELD_END_DELIMITER);
+		return scanner->record_begun ? CSV_SCAN_FIELD : CSV_SCAN_LAST_FIELD;
+	}
+
+	/* The data ends right after a delimiter */
+	if (scanner->record_begun)
+	{
+		scanner->record_begun = false;
+		return CSV_SCAN_LAST_FIELD;
+	}
+	return CSV_SCAN_END;
 }
 
 CSVDeserializationState
@@ -203,76 +498,133 @@ prepare_deserialization_csv(TupleDesc tupledesc, List *options)
 {
 	CSVDeserializationState result = palloc(sizeof(CSVDeserializationStateObject));
 
-	result->metadata = make_csv_deserialization_metadata(tupledesc, options);
-	result->parser = make_prepare_csv_parser(options);
+	result->adis = (AttributeDeserializationInfo *) palloc(sizeof(AttributeDeserializationInfo) * tupledesc->natts);
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		fill_attribute_deserialization_info(&result->adis[i], tupledesc, i, options);
+	}
+	result->tupledesc = tupledesc;
+
+	set_deserialization_settings(&result->settings, options);
+	result->encoding = prepare_message_encoding(options);
+
+	init_scanner(&result->scanner, &result->settings, false);
+	initStringInfo(&result->field);
+
+	result->decoded = NULL;
+	result->decoded_i = 0;
+	result->adis_i = 0;
+	result->datums = NULL;
+	result->nulls = NULL;
+	result->record_is_ready = false;
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_csv") == FaultInjectorTypeSkip)
+	{
+		char	   *inject_data = defGetString(get_option(options, KADB_SETTING_CSV_DATA_ON_INJECT));
+
+		result->data_l = strlen(inject_data) + 1;
+		result->data = palloc(result->data_l);
+		strcpy(result->data, inject_data);
+	}
+#endif
 
 	return result;
 }
 
 /**
- * A callback called by libcsv when a field is parsed.
+ * Check whether a field 'value' of length 'value_l' denotes NULL.
+ *
+ * A field is compared as a C string, i.e. up to its first null byte.
  */
-static void
-csv_field_callback(void *value, size_t value_l, void *metadata_ptr)
+static inline bool
+field_is_null(CSVDeserializationState state, const char *value, size_t value_l)
 {
-	CSVDeserializationMetadata *metadata = (CSVDeserializationMetadata *) metadata_ptr;
+	const CSVDeserializationSettings *settings = &state->settings;
 
-	if (metadata->adis_i >= (size_t) metadata->tupledesc->natts)
-		elog(ERROR, "Kafka-ADB: CSV contains more fields than there are attributes in the FOREIGN TABLE");
+	/* Empty fields (both quoted and non-quoted) are NULLs */
+	if (value_l == 0 || value[0] == '\0')
+		return true;
+	return PointerIsValid(settings->null_string) &&
+		value_l >= settings->null_string_l &&
+		memcmp(value, settings->null_string, settings->null_string_l) == 0 &&
+		(value_l == settings->null_string_l || value[settings->null_string_l] == '\0');
+}
 
-	if (metadata->settings.ignore_one_tuple)
+/**
+ * Process a field 'value' of length 'value_l'.
+ *
+ * Unless 'is_terminated' is set, 'value' is copied to 'state->field' when the
+ * generic input function is called, to null-terminate it.
+ */
+static void
+process_field(CSVDeserializationState state, const char *value, size_t value_l, bool is_terminated)
+{
+	if (state->adis_i >= state->tupledesc->natts)
+		ereport(ERROR, (errcode(ERRCODE_BAD_COPY_FILE_FORMAT), errmsg("Kafka-ADB: CSV contains more fields than there are attributes in the FOREIGN TABLE")));
+
+	if (state->ignore_one_tuple)
 		return;
 
-	/* Parser MUST null-terminate 'value', so this cast is safe */
-	char	   *value_str = (char *) value;
+	AttributeDeserializationInfo *adi = &state->adis[state->adis_i];
 
 	/* Various NULL conditions */
-	if (
-		metadata->adis[metadata->adis_i].is_dropped ||
-		!PointerIsValid(value) ||
-		strlen(value_str) == 0
-		)
+	if (adi->is_dropped || field_is_null(state, value, value_l))
 	{
-		metadata->nulls[metadata->adis_i] = true;
-		metadata->adis_i += 1;
+		if (state->adis_i == 0)
+			state->first_field_is_null = true;
+		state->nulls[state->adis_i] = true;
+		state->adis_i += 1;
 		return;
 	}
 
-	elog(DEBUG2, "Kafka-ADB: CSV field %lu: strlen=%lu, l=%lu, last_byte=%d", metadata->adis_i, strlen(value_str), value_l, (int) value_str[value_l - 1]);
+	if (state->adis_i == 0)
+		state->first_field_is_null = false;
+
+	/* Attributes not referenced by the query are not converted */
+	if (adi->is_skipped)
+	{
+		state->nulls[state->adis_i] = true;
+		state->adis_i += 1;
+		return;
+	}
 
-	/* Check NULL */
-	if (PointerIsValid(metadata->settings.null_string))
+	state->nulls[state->adis_i] = false;
+	if (value_cache_lookup(adi->value_cache, value, value_l, &state->datums[state->adis_i]))
 	{
-		if (0 == strcmp(value_str, metadata->settings.null_string))
+		state->adis_i += 1;
+		return;
+	}
+	if (!fast_input_function_call(&adi->io_fn_textual, value, value_l, &state->datums[state->adis_i]))
+	{
+		if (!is_terminated)
 		{
-			metadata->nulls[metadata->adis_i] = true;
-			metadata->adis_i += 1;
-			return;
+			resetStringInfo(&state->field);
+			appendBinaryStringInfo(&state->field, value, value_l);
+			value = state->field.data;
 		}
-	}
 
-	/* TODO: An error callback can be added here */
-	metadata->nulls[metadata->adis_i] = false;
-	metadata->datums[metadata->adis_i] = InputFunctionCall(
-					  &metadata->adis[metadata->adis_i].io_fn_textual.iofunc,
-														   value_str,
-				   metadata->adis[metadata->adis_i].io_fn_textual.typioparam,
-					  metadata->adis[metadata->adis_i].io_fn_textual.attypmod
-		);
-	metadata->adis_i += 1;
+		/* TODO: An error callback can be added here */
+		state->datums[state->adis_i] = InputFunctionCall(
+														 &adi->io_fn_textual.iofunc,
+														 (char *) value,
+														 adi->io_fn_textual.typioparam,
+														 adi->io_fn_textual.attypmod
+			);
+	}
+	value_cache_insert(adi->value_cache, value, value_l, state->datums[state->adis_i]);
+	state->adis_i += 1;
 }
 
 /**
- * A callback called by libcsv when a whole record has been parsed.
+ * Process the end of a record.
  */
 static void
-csv_record_callback(int finish_char, void *metadata_ptr)
+process_record(CSVDeserializationState state)
 {
-	CSVDeserializationMetadata *metadata = (CSVDeserializationMetadata *) metadata_ptr;
-
-	if (metadata->settings.ignore_one_tuple)
+	if (state->ignore_one_tuple)
 	{
-		metadata->settings.ignore_one_tuple = false;
+		state->ignore_one_tuple = false;
 		return;
 	}
 
@@ -281,74 +633,392 @@ csv_record_callback(int finish_char, void *metadata_ptr)
 	/*
 	 * Known limitation: NULLs are ignored in tables with a single column
 	 */
-	if (metadata->adis_i == 1 && metadata->nulls[0])
+	if (state->adis_i == 1 && state->first_field_is_null)
 	{
-		metadata->adis_i = 0;
+		state->adis_i = 0;
 		return;
 	}
 
 	/* Fill missing fields with NULLs */
-	for (; metadata->adis_i < (size_t) metadata->tupledesc->natts; metadata->adis_i++)
+	for (; state->adis_i < state->tupledesc->natts; state->adis_i++)
 	{
-		metadata->nulls[metadata->adis_i] = true;
+		state->nulls[state->adis_i] = true;
 	}
 
-	metadata->result = lappend(metadata->result, heap_form_tuple(metadata->tupledesc, metadata->datums, metadata->nulls));
+	state->record_is_ready = true;
 
-	/* Set to 0 for the next iteration */
-	metadata->adis_i = 0;
+	/* Set to 0 for the next record */
+	state->adis_i = 0;
 }
 
-List *
-deserialize_csv(CSVDeserializationState state, void *data, size_t data_l)
+/**
+ * Split the rest of the CURRENT message into fields and process them, until
+ * a record to return is complete or the message ends.
+ */
+static void
+parse_csv_record(CSVDeserializationState state)
 {
-	AssertArg(PointerIsValid(state));
-	Assert(PointerIsValid(state->metadata));
-	Assert(PointerIsValid(state->parser));
+	while (!state->record_is_ready)
+	{
+		const char *value;
+		size_t		value_l;
+		bool		is_unescaped;
+		CSVScanResult scanned = scan_field(&state->scanner, &value, &value_l, &is_unescaped);
+
+		if (scanned == CSV_SCAN_END)
+			break;
+		process_field(state, value, value_l, is_unescaped);
+		if (scanned == CSV_SCAN_LAST_FIELD)
+			process_record(state);
+	}
+}
+
+/**
+ * Process fields of the CURRENT message split by a worker thread, until a
+ * record to return is complete or the message ends.
+ */
+static void
+replay_csv_record(CSVDeserializationState state)
+{
+	const CSVDecodeTask *decoded = state->decoded;
+
+	while (!state->record_is_ready && state->decoded_i < decoded->fields_count)
+	{
+		const CSVDecodedField *field = &decoded->fields[state->decoded_i++];
+		const char *value = NULL;
+
+		if (field->length > 0)
+			value = ((field->flags & CSV_DECODED_UNESCAPED) ? decoded->values : decoded->data) + field->offset;
+
+		process_field(state, value, field->length, (field->flags & CSV_DECODED_UNESCAPED) != 0);
+		if (field->flags & CSV_DECODED_LAST)
+			process_record(state);
+	}
+}
+
+/**
+ * Substitute the data of a message when fault injection is enabled.
+ *
+ * @return 'true' if the data is substituted
+ */
+static bool
+substitute_injected_data(CSVDeserializationState state, void **data, size_t *data_l)
+{
+	bool		result = false;
 
 #ifdef FAULT_INJECTOR
 	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_csv") == FaultInjectorTypeSkip)
 	{
-		data = state->metadata->data;
-		data_l = state->metadata->data_l;
+		*data = state->data;
+		*data_l = state->data_l;
+		result = true;
 	}
 #endif
 
-	if (!PointerIsValid(data) || data_l < 1)
-		return NIL;
+	if (!PointerIsValid(*data))
+		*data_l = 0;
+	return result;
+}
 
-	state->metadata->settings.ignore_one_tuple = state->metadata->settings.ignore_header;
+/**
+ * Prepare to process records of the CURRENT message from its start.
+ */
+static void
+start_message(CSVDeserializationState state)
+{
+	state->adis_i = 0;
+	state->ignore_one_tuple = state->settings.ignore_header;
+}
+
+void
+begin_deserialization_csv(CSVDeserializationState state, void *data, size_t data_l)
+{
+	AssertArg(PointerIsValid(state));
+
+	substitute_injected_data(state, &data, &data_l);
+	data = to_database_encoding(state->encoding, data, &data_l);
+
+	state->decoded = NULL;
+	reset_scanner(&state->scanner, (const char *) data, data_l);
+	start_message(state);
+}
+
+bool
+deserialize_next_csv(CSVDeserializationState state, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(state));
 
-	if (data_l != csv_parse(
-							state->parser,
-							data, data_l,
-					 csv_field_callback, csv_record_callback, state->metadata
-							))
+	state->datums = values;
+	state->nulls = nulls;
+	state->record_is_ready = false;
+
+	if (PointerIsValid(state->decoded))
+		replay_csv_record(state);
+	else
+		parse_csv_record(state);
+
+	return state->record_is_ready;
+}
+
+void
+finish_deserialization_csv(CSVDeserializationState state)
+{
+	AssertArg(PointerIsValid(state));
+
+	/* All fields are freed by context destruction */
+}
+
+
+/*
+ * Callbacks of the format
+ */
+
+/**
+ * Parse (change types, if necessary) and validate settings for CSV
+ * deserialization format.
+ */
+static void
+validate_options_csv(List *options, bool check_required)
+{
+	ListCell   *it;
+
+	foreach(it, options)
 	{
-		int			err = csv_error(state->parser);
+		DefElem    *option = (DefElem *) lfirst(it);
+		const char *key = option->defname;
 
-		elog(ERROR, "Kafka-ADB: Failed to deserialize CSV: %s [%d]", csv_strerror(err), err);
+		if (
+			STREQ(key, KADB_SETTING_CSV_DELIMITER)
+			|| STREQ(key, KADB_SETTING_CSV_QUOTE)
+			)
+		{
+			char	   *value = defGetString(option);
+
+			if (strnlen(value, 2) != 1)
+			{
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be a single character", key)));
+			}
+		}
+		else if (STREQ(key, KADB_SETTING_CSV_IGNORE_HEADER))
+		{
+			defGetBoolean(option);
+		}
+		else if (STREQ(key, KADB_SETTING_CSV_ATTRIBUTE_TRIM_WHITESPACE))
+		{
+			defGetBoolean(option);
+		}
 	}
+}
 
-	if (csv_fini(state->parser, csv_field_callback, csv_record_callback, state->metadata))
+/**
+ * Append a field found by 'decode_csv()' to 'task'.
+ *
+ * @return 'false' if malloc failed
+ */
+static bool
+append_decoded_field(CSVDecodeTask * task, const char *value, size_t value_l, bool is_unescaped, bool is_last)
+{
+	if (task->fields_count == task->fields_size)
 	{
-		int			err = csv_error(state->parser);
+		size_t		size = Max(task->fields_size * 2, 16);
+		CSVDecodedField *fields = realloc(task->fields, sizeof(CSVDecodedField) * size);
+
+		if (!PointerIsValid(fields))
+			return false;
+		task->fields = fields;
+		task->fields_size = size;
+	}
+
+	CSVDecodedField *field = &task->fields[task->fields_count++];
 
-		elog(ERROR, "Kafka-ADB: Failed to deserialize CSV: %s [%d]", csv_strerror(err), err);
+	field->length = value_l;
+	field->flags = is_last ? CSV_DECODED_LAST : 0;
+	field->offset = 0;
+	if (value_l == 0)
+		return true;
+	if (!is_unescaped)
+	{
+		field->offset = value - task->data;
+		return true;
 	}
 
-	List	   *result = state->metadata->result;
+	/* The value is in the buffer of the scanner, which is reused */
+	if (task->values_l + value_l + 1 > task->values_size)
+	{
+		size_t		size = Max(task->values_size, 256);
+		char	   *values;
+
+		while (size < task->values_l + value_l + 1)
+			size *= 2;
+		if (!PointerIsValid(values = realloc(task->values, size)))
+			return false;
+		task->values = values;
+		task->values_size = size;
+	}
+	memcpy(task->values + task->values_l, value, value_l);
+	task->values[task->values_l + value_l] = '\0';
+	field->offset = task->values_l;
+	field->flags |= CSV_DECODED_UNESCAPED;
+	task->values_l += value_l + 1;
+	return true;
+}
+
+/**
+ * Allocate a task to split a message into fields in a worker thread.
+ *
+ * Messages whose encoding must be converted are deserialized by the backend:
+ * fields can only be located after the conversion.
+ */
+static void *
+prepare_decode_csv(void *state_, void *data, size_t data_l)
+{
+	CSVDeserializationState state = (CSVDeserializationState) state_;
+
+	if (!is_validation_only(state->encoding))
+		return NULL;
+
+	/* When NULL is returned, the message is deserialized by 'begin' */
+	CSVDecodeTask *result = calloc(1, sizeof(CSVDecodeTask));
+
+	if (!PointerIsValid(result))
+		return NULL;
+
+	if (substitute_injected_data(state, &data, &data_l))
+	{
+		/* Injected data is allocated by palloc */
+		if (!PointerIsValid(result->data_copy = malloc(data_l + 1)))
+		{
+			free(result);
+			return NULL;
+		}
+		memcpy(result->data_copy, data, data_l);
+		data = result->data_copy;
+	}
+	result->data = (const char *) data;
+	result->data_l = data_l;
+	init_scanner(&result->scanner, &state->settings, true);
 
-	state->metadata->result = NIL;
 	return result;
 }
 
-void
-finish_deserialization_csv(CSVDeserializationState state)
+/**
+ * Split a message into fields. Runs in a worker thread.
+ */
+static void
+decode_csv(void *arg)
 {
-	AssertArg(PointerIsValid(state));
-	Assert(PointerIsValid(state->parser));
+	CSVDecodeTask *task = (CSVDecodeTask *) arg;
+	CSVScanner *scanner = &task->scanner;
 
-	csv_free(state->parser);
-	/* Other fields are freed by context destruction */
+	reset_scanner(scanner, task->data, task->data_l);
+	for (;;)
+	{
+		const char *value;
+		size_t		value_l;
+		bool		is_unescaped;
+		CSVScanResult scanned = scan_field(scanner, &value, &value_l, &is_unescaped);
+
+		if (scanned == CSV_SCAN_END)
+			break;
+		if (scanner->buffer.is_failed || !append_decoded_field(task, value, value_l, is_unescaped, scanned == CSV_SCAN_LAST_FIELD))
+		{
+			task->is_failed = true;
+			break;
+		}
+	}
+
+	free(scanner->buffer.data);
+	scanner->buffer.data = NULL;
 }
+
+static void
+begin_decoded_csv(void *state_, void *arg)
+{
+	CSVDeserializationState state = (CSVDeserializationState) state_;
+	CSVDecodeTask *task = (CSVDecodeTask *) arg;
+	size_t		data_l = task->data_l;
+
+	/* Only validates the data: it is not changed */
+	to_database_encoding(state->encoding, (void *) task->data, &data_l);
+
+	state->decoded = NULL;
+	if (task->is_failed)
+		reset_scanner(&state->scanner, task->data, data_l);
+	else
+	{
+		state->decoded = task;
+		state->decoded_i = 0;
+	}
+	start_message(state);
+}
+
+static void
+discard_decoded_csv(void *arg)
+{
+	CSVDecodeTask *task = (CSVDecodeTask *) arg;
+
+	free(task->fields);
+	free(task->values);
+	free(task->data_copy);
+	free(task->scanner.buffer.data);
+	free(task);
+}
+
+static void *
+prepare_csv(TupleDesc tupledesc, List *options)
+{
+	return prepare_deserialization_csv(tupledesc, options);
+}
+
+static void
+begin_csv(void *state, void *data, size_t data_l)
+{
+	begin_deserialization_csv((CSVDeserializationState) state, data, data_l);
+}
+
+static bool
+next_csv(void *state, Datum *values, bool *nulls)
+{
+	return deserialize_next_csv((CSVDeserializationState) state, values, nulls);
+}
+
+static void
+finish_csv(void *state)
+{
+	finish_deserialization_csv((CSVDeserializationState) state);
+}
+
+/**
+ * Values are parsed from text before they are converted by input functions.
+ */
+static Cost
+estimate_cost_csv(List *options, int natts)
+{
+	return 2 * cpu_operator_cost * natts;
+}
+
+static const char *const CSVOptions[] = {
+	KADB_SETTING_CSV_QUOTE,
+	KADB_SETTING_CSV_DELIMITER,
+	KADB_SETTING_CSV_NULL_STRING,
+	KADB_SETTING_CSV_IGNORE_HEADER,
+	KADB_SETTING_CSV_ATTRIBUTE_TRIM_WHITESPACE,
+	NULL
+};
+
+const DeserializationFormatRoutine CSVDeserializationFormat = {
+	.api_version = KADB_DESERIALIZATION_FORMAT_API_VERSION,
+	.name = "csv",
+	.options = CSVOptions,
+	.column_options = NULL,
+	.validate_options = validate_options_csv,
+	.prepare = prepare_csv,
+	.begin = begin_csv,
+	.next = next_csv,
+	.finish = finish_csv,
+	.estimate_cost = estimate_cost_csv,
+	.prepare_decode = prepare_decode_csv,
+	.decode = decode_csv,
+	.begin_decoded = begin_decoded_csv,
+	.discard_decoded = discard_decoded_csv
+};
@@ -9,6 +9,8 @@
 
 #include <access/tupdesc.h>
 
+#include "deserialization/format.h"
+
 
 /* An opaque struct to store CSV deserialization runtime state */
 typedef struct CSVDeserializationStateObject *CSVDeserializationState;
@@ -20,12 +22,16 @@ typedef struct CSVDeserializationStateObject *CSVDeserializationState;
 CSVDeserializationState prepare_deserialization_csv(TupleDesc tupledesc, List *options);
 
 /**
- * Deserialize binary 'data' of length 'data_l' from CSV format.
+ * Start to deserialize binary 'data' of length 'data_l' from CSV format.
+ */
+void		begin_deserialization_csv(CSVDeserializationState state, void *data, size_t data_l);
+
+/**
+ * Deserialize the next record into 'values' and 'nulls'.
  *
- * @return a list of HeapTuples, allocated by palloc in CurrentMemoryContext,
- * or NIL if 'data' is empty
+ * @return 'false' if there are no more records in the message
  */
-List	   *deserialize_csv(CSVDeserializationState state, void *data, size_t data_l);
+bool		deserialize_next_csv(CSVDeserializationState state, Datum *values, bool *nulls);
 
 /**
  * Finish CSV deserialization and free the memory allocated to assist the
@@ -34,6 +40,9 @@ List	   *deserialize_csv(CSVDeserializationState state, void *data, size_t data_
 void		finish_deserialization_csv(CSVDeserializationState state);
 
 
+/* Callbacks of the format */
+extern const DeserializationFormatRoutine CSVDeserializationFormat;
+
 #endif   /* //
 								 * KADB_FDW_DESERIALIZATION_CSV_DESERIALIZER_IN
 								 * CLUDED */
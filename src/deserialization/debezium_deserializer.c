@@ -0,0 +1,264 @@
+#include "debezium_deserializer.h"
+
+#include <commands/defrem.h>
+#include <nodes/makefuncs.h>
+
+#include "settings.h"
+#include "deserialization/json_deserializer.h"
+
+
+#define STREQ(a, b) (strcmp(a, b) == 0)
+
+/* The key of the schema envelope which contains the change event */
+#define DEBEZIUM_KEY_PAYLOAD "payload"
+/* The key of the operation of a change event */
+#define DEBEZIUM_KEY_OP "op"
+/* The keys of the images of the row before and after the change */
+#define DEBEZIUM_KEY_BEFORE "before"
+#define DEBEZIUM_KEY_AFTER "after"
+
+
+typedef struct DebeziumDeserializationStateObject
+{
+	/*
+	 * Events are parsed as JSON records of 'natts' attributes of the foreign
+	 * table, followed by one hidden attribute for each key attribute: the
+	 * value of that attribute in the 'before' image
+	 */
+	JsonDeserializationState json;
+	int			natts;
+	int		   *key_attributes;
+	int			key_attributes_count;
+
+	/* Values and nulls of all (including hidden) attributes */
+	Datum	   *values;
+	bool	   *nulls;
+}	DebeziumDeserializationStateObject;
+
+
+/**
+ * @return the options of attribute 'i' (starting at 0) in 'options'
+ */
+static List *
+get_attribute_options(List *options, int i)
+{
+	DefElem    *column_options = get_option(options, KADB_SETTING__COLUMN_OPTIONS);
+
+	if (!PointerIsValid(column_options) || i >= list_length((List *) column_options->arg))
+		return NIL;
+	return (List *) list_nth((List *) column_options->arg, i);
+}
+
+/**
+ * @return whether attribute 'i' (starting at 0) has 'debezium_column' OPTION
+ * with the given 'value'
+ */
+static bool
+is_debezium_column(List *options, int i, const char *value)
+{
+	DefElem    *debezium_column = get_column_option(options, i + 1, KADB_SETTING_DEBEZIUM_COLUMN);
+
+	return PointerIsValid(debezium_column) && STREQ(defGetString(debezium_column), value);
+}
+
+/**
+ * @return the JSON path of attribute 'i' (starting at 0) in the given 'image'
+ * of the row. 'prefix' is the path of the change event
+ */
+static List *
+get_image_path(List *prefix, const char *image, TupleDesc tupledesc, int i, List *options)
+{
+	DefElem    *path_option = get_column_option(options, i + 1, KADB_SETTING_JSON_PATH);
+	List	   *result = lappend(list_copy(prefix), makeString(pstrdup(image)));
+
+	if (PointerIsValid(path_option))
+		return list_concat(result, parse_json_path(defGetString(path_option)));
+	return lappend(result, makeString(pstrdup(NameStr(tupledesc->attrs[i]->attname))));
+}
+
+DebeziumDeserializationState
+prepare_deserialization_debezium(TupleDesc tupledesc, List *options)
+{
+	DebeziumDeserializationState result = palloc(sizeof(DebeziumDeserializationStateObject));
+	DefElem    *schemas = get_option(options, KADB_SETTING_DEBEZIUM_SCHEMAS);
+	DefElem    *attributes_required = get_option(options, KADB_SETTING__ATTRIBUTES_REQUIRED);
+	List	   *prefix = NIL;
+
+	if (PointerIsValid(schemas) && defGetBoolean(schemas))
+		prefix = list_make1(makeString(pstrdup(DEBEZIUM_KEY_PAYLOAD)));
+
+	result->natts = tupledesc->natts;
+	result->key_attributes = palloc(sizeof(int) * Max(tupledesc->natts, 1));
+	result->key_attributes_count = 0;
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		if (!tupledesc->attrs[i]->attisdropped && is_debezium_column(options, i, KADB_DEBEZIUM_COLUMN_KEY))
+			result->key_attributes[result->key_attributes_count++] = i;
+	}
+
+	/*
+	 * Build the tuple descriptor, column options, and required attributes of
+	 * the JSON records, with hidden attributes appended
+	 */
+	int			json_natts = tupledesc->natts + result->key_attributes_count;
+	TupleDesc	json_tupledesc = CreateTemplateTupleDesc(json_natts, false);
+	List	   *json_paths = NIL;
+	List	   *json_column_options = NIL;
+	List	   *json_attributes_required = NIL;
+
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		TupleDescCopyEntry(json_tupledesc, i + 1, tupledesc, i + 1);
+		if (is_debezium_column(options, i, KADB_DEBEZIUM_COLUMN_OP))
+			json_paths = lappend(json_paths, lappend(list_copy(prefix), makeString(pstrdup(DEBEZIUM_KEY_OP))));
+		else
+			json_paths = lappend(json_paths, get_image_path(prefix, DEBEZIUM_KEY_AFTER, tupledesc, i, options));
+		json_column_options = lappend(json_column_options, get_attribute_options(options, i));
+		if (PointerIsValid(attributes_required) && list_member_int((List *) attributes_required->arg, i + 1))
+			json_attributes_required = lappend_int(json_attributes_required, i + 1);
+	}
+	for (int k = 0; k < result->key_attributes_count; k++)
+	{
+		int			i = result->key_attributes[k];
+
+		TupleDescCopyEntry(json_tupledesc, tupledesc->natts + k + 1, tupledesc, i + 1);
+		json_paths = lappend(json_paths, get_image_path(prefix, DEBEZIUM_KEY_BEFORE, tupledesc, i, options));
+		json_column_options = lappend(json_column_options, get_attribute_options(options, i));
+		if (PointerIsValid(attributes_required) && list_member_int((List *) attributes_required->arg, i + 1))
+			json_attributes_required = lappend_int(json_attributes_required, tupledesc->natts + k + 1);
+	}
+
+	/* Early quals are evaluated on records of 'tupledesc', not by the JSON deserializer */
+	List	   *json_options = NIL;
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+
+		if (STREQ(option->defname, KADB_SETTING__COLUMN_OPTIONS) || STREQ(option->defname, KADB_SETTING__ATTRIBUTES_REQUIRED) || STREQ(option->defname, KADB_SETTING__EARLY_QUALS))
+			continue;
+		json_options = lappend(json_options, option);
+	}
+	json_options = lappend(json_options, makeDefElem(KADB_SETTING__COLUMN_OPTIONS, (Node *) json_column_options));
+	if (PointerIsValid(attributes_required))
+		json_options = lappend(json_options, makeDefElem(KADB_SETTING__ATTRIBUTES_REQUIRED, (Node *) json_attributes_required));
+
+	result->json = prepare_deserialization_json_paths(json_tupledesc, json_options, json_paths);
+	result->values = palloc0(sizeof(Datum) * Max(json_natts, 1));
+	result->nulls = palloc(sizeof(bool) * Max(json_natts, 1));
+
+	return result;
+}
+
+void
+begin_deserialization_debezium(DebeziumDeserializationState state, void *data, size_t data_l)
+{
+	AssertArg(PointerIsValid(state));
+
+	begin_deserialization_json(state->json, data, data_l);
+}
+
+bool
+deserialize_next_debezium(DebeziumDeserializationState state, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(state));
+
+	if (!deserialize_next_json(state->json, state->values, state->nulls))
+		return false;
+
+	memcpy(values, state->values, sizeof(Datum) * state->natts);
+	memcpy(nulls, state->nulls, sizeof(bool) * state->natts);
+
+	/* A deletion has no 'after' image; its key is in the 'before' one */
+	for (int k = 0; k < state->key_attributes_count; k++)
+	{
+		int			i = state->key_attributes[k];
+
+		if (nulls[i] && !state->nulls[state->natts + k])
+		{
+			values[i] = state->values[state->natts + k];
+			nulls[i] = false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * Callbacks of the format
+ */
+
+/**
+ * Parse (change types, if necessary) and validate settings for DEBEZIUM
+ * deserialization format.
+ */
+static void
+validate_options_debezium(List *options, bool check_required)
+{
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+
+		if (STREQ(option->defname, KADB_SETTING_DEBEZIUM_SCHEMAS))
+			defGetBoolean(option);
+	}
+}
+
+static void *
+prepare_debezium(TupleDesc tupledesc, List *options)
+{
+	return prepare_deserialization_debezium(tupledesc, options);
+}
+
+static void
+begin_debezium(void *state, void *data, size_t data_l)
+{
+	begin_deserialization_debezium((DebeziumDeserializationState) state, data, data_l);
+}
+
+static bool
+next_debezium(void *state, Datum *values, bool *nulls)
+{
+	return deserialize_next_debezium((DebeziumDeserializationState) state, values, nulls);
+}
+
+/**
+ * Events are parsed as JSON records.
+ */
+static Cost
+estimate_cost_debezium(List *options, int natts)
+{
+	return JsonDeserializationFormat.estimate_cost(options, natts);
+}
+
+static const char *const DebeziumOptions[] = {
+	KADB_SETTING_DEBEZIUM_SCHEMAS,
+	NULL
+};
+
+static const char *const DebeziumColumnOptions[] = {
+	KADB_SETTING_JSON_PATH,
+	KADB_SETTING_DEBEZIUM_COLUMN,
+	NULL
+};
+
+const DeserializationFormatRoutine DebeziumDeserializationFormat = {
+	.api_version = KADB_DESERIALIZATION_FORMAT_API_VERSION,
+	.name = "debezium",
+	.options = DebeziumOptions,
+	.column_options = DebeziumColumnOptions,
+	.validate_options = validate_options_debezium,
+	.prepare = prepare_debezium,
+	.begin = begin_debezium,
+	.next = next_debezium,
+	.finish = NULL,
+	.estimate_cost = estimate_cost_debezium,
+	.prepare_decode = NULL,
+	.decode = NULL,
+	.begin_decoded = NULL,
+	.discard_decoded = NULL
+};
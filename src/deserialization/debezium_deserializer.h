@@ -0,0 +1,54 @@
+#ifndef KADB_FDW_DESERIALIZATION_DEBEZIUM_DESERIALIZER_INCLUDED
+#define KADB_FDW_DESERIALIZATION_DEBEZIUM_DESERIALIZER_INCLUDED
+
+/*
+ * Debezium change event deserialization implementation.
+ *
+ * A message is a change event of a Debezium connector, serialized by the JSON
+ * converter of Kafka Connect: an object with the operation ('op') and the
+ * images of the changed row before and after the change ('before', 'after').
+ * If 'debezium_schemas' OPTION is set, the event is the 'payload' of a schema
+ * envelope. Each event is a record; tombstones (empty messages) produce no
+ * records.
+ *
+ * Columns are filled from the 'after' image, located by 'json_path' column
+ * OPTION relative to the image. A column with 'debezium_column' 'op' is the
+ * operation; columns with 'debezium_column' 'key' are filled from the 'before'
+ * image when there is no 'after' image (i.e. for deletions).
+ */
+
+#include <postgres.h>
+
+#include <access/tupdesc.h>
+
+#include "deserialization/format.h"
+
+
+/* An opaque struct to store DEBEZIUM deserialization runtime state */
+typedef struct DebeziumDeserializationStateObject *DebeziumDeserializationState;
+
+
+/**
+ * Prepare to deserialize Debezium change events.
+ */
+DebeziumDeserializationState prepare_deserialization_debezium(TupleDesc tupledesc, List *options);
+
+/**
+ * Start to deserialize binary 'data' of length 'data_l' (a change event).
+ */
+void		begin_deserialization_debezium(DebeziumDeserializationState state, void *data, size_t data_l);
+
+/**
+ * Deserialize the next record into 'values' and 'nulls'.
+ *
+ * @return 'false' if there are no more records in the message
+ */
+bool		deserialize_next_debezium(DebeziumDeserializationState state, Datum *values, bool *nulls);
+
+/* Callbacks of the format */
+extern const DeserializationFormatRoutine DebeziumDeserializationFormat;
+
+
+#endif   /* //
+								 * KADB_FDW_DESERIALIZATION_DEBEZIUM_DESERIALIZER_I
+								 * NCLUDED */
@@ -1,21 +1,115 @@
 #include "format.h"
 
+#include "deserialization/avro_deserializer.h"
+#include "deserialization/csv_deserializer.h"
+#include "deserialization/debezium_deserializer.h"
+#include "deserialization/json_deserializer.h"
+#include "deserialization/pgbinary_deserializer.h"
+#include "deserialization/protobuf_deserializer.h"
+#include "deserialization/raw_deserializer.h"
+#include "deserialization/text_deserializer.h"
+
 
 #define STRCASEEQ(a, b) (pg_strcasecmp(a, b) == 0)
 
 
-enum DeserializationFormat
+/**
+ * Formats supported by Kafka-ADB itself. They take precedence over registered
+ * formats with the same name.
+ */
+static const DeserializationFormatRoutine *BuiltinDeserializationFormats[] = {
+	&AvroDeserializationFormat,
+	&CSVDeserializationFormat,
+	&TextDeserializationFormat,
+	&JsonDeserializationFormat,
+	&ProtobufDeserializationFormat,
+	&RawDeserializationFormat,
+	&PgBinaryDeserializationFormat,
+	&DebeziumDeserializationFormat
+};
+
+
+/**
+ * @return a list of formats registered by other libraries
+ */
+static List *
+get_registered_formats(void)
+{
+	return *(List **) find_rendezvous_variable(KADB_DESERIALIZATION_FORMATS_RENDEZVOUS);
+}
+
+/**
+ * Check whether 'option' is present in NULL-terminated list 'options', which
+ * may be NULL itself.
+ */
+static bool
+is_option_in_list(const char *option, const char *const * options)
+{
+	if (!PointerIsValid(options))
+		return false;
+
+	for (; PointerIsValid(*options); options++)
+	{
+		if (strcmp(option, *options) == 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Check whether 'option' belongs to 'routine'.
+ */
+static bool
+is_routine_option(const DeserializationFormatRoutine * routine, const char *option, bool is_column_option)
+{
+	return is_option_in_list(option, is_column_option ? routine->column_options : routine->options);
+}
+
+const DeserializationFormatRoutine *
 resolve_deserialization_format(const char *name)
 {
 	if (!PointerIsValid(name))
-		return DESERIALIZATION_FORMAT_INVALID;
+		return NULL;
+
+	for (size_t i = 0; i < lengthof(BuiltinDeserializationFormats); i++)
+	{
+		if (STRCASEEQ(name, BuiltinDeserializationFormats[i]->name))
+			return BuiltinDeserializationFormats[i];
+	}
+
+	ListCell   *it;
+
+	foreach(it, get_registered_formats())
+	{
+		const DeserializationFormatRoutine *routine = (const DeserializationFormatRoutine *) lfirst(it);
+
+		if (!STRCASEEQ(name, routine->name))
+			continue;
+
+		if (routine->api_version != KADB_DESERIALIZATION_FORMAT_API_VERSION)
+			ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED), errmsg("Kafka-ADB: Deserialization format '%s' is built for API version %d, but version %d is required", routine->name, routine->api_version, KADB_DESERIALIZATION_FORMAT_API_VERSION)));
+		return routine;
+	}
+
+	return NULL;
+}
+
+bool
+is_deserialization_format_option(const char *option, bool is_column_option)
+{
+	for (size_t i = 0; i < lengthof(BuiltinDeserializationFormats); i++)
+	{
+		if (is_routine_option(BuiltinDeserializationFormats[i], option, is_column_option))
+			return true;
+	}
+
+	ListCell   *it;
 
-	if (STRCASEEQ(name, "avro"))
-		return AVRO;
-	if (STRCASEEQ(name, "csv"))
-		return CSV;
-	if (STRCASEEQ(name, "text"))
-		return TEXT;
+	foreach(it, get_registered_formats())
+	{
+		if (is_routine_option((const DeserializationFormatRoutine *) lfirst(it), option, is_column_option))
+			return true;
+	}
 
-	return DESERIALIZATION_FORMAT_INVALID;
+	return false;
 }
@@ -2,29 +2,179 @@
 #define KADB_FDW_DESERIALIZATION_FORMAT_INCLUDED
 
 /*
- * Resolution of deserialization formats.
+ * Registry of deserialization formats.
+ *
+ * A format is described by 'DeserializationFormatRoutine': a set of callbacks
+ * to validate options, deserialize messages, and estimate the cost of doing
+ * so. Built-in formats are always present. Other shared libraries may add
+ * formats by calling 'register_deserialization_format()' from their
+ * '_PG_init()'; this header is self-contained for that purpose, and does not
+ * require the library to be linked with Kafka-ADB.
  */
 
 #include <postgres.h>
 
+#include <access/tupdesc.h>
+#include <fmgr.h>
+#include <nodes/pg_list.h>
+#include <utils/memutils.h>
+
+
+/*
+ * Version of 'DeserializationFormatRoutine'. Formats registered with another
+ * version are rejected when they are used.
+ */
+#define KADB_DESERIALIZATION_FORMAT_API_VERSION 2
+
+/* The name of the rendezvous variable that holds the list of registered formats */
+#define KADB_DESERIALIZATION_FORMATS_RENDEZVOUS "kadb_fdw_deserialization_formats"
+
 
 /**
- * Deserialization formats supported by Kafka-ADB
+ * Callbacks of a deserialization format.
+ *
+ * The state returned by 'prepare' is passed to all other callbacks of a scan.
+ * 'begin', 'next', and 'finish' are called on segments only.
  */
-enum DeserializationFormat
+typedef struct DeserializationFormatRoutine
 {
-	AVRO,
-	CSV,
-	TEXT,
-	DESERIALIZATION_FORMAT_INVALID
-}	DeserializationFormat;
+	/* Must be KADB_DESERIALIZATION_FORMAT_API_VERSION */
+	int			api_version;
+	/* The value of 'format' OPTION (case-insensitive) */
+	const char *name;
+
+	/*
+	 * NULL-terminated lists of names of FOREIGN TABLE OPTIONs and column
+	 * OPTIONs of the format. May be NULL
+	 */
+	const char *const *options;
+	const char *const *column_options;
+
+	/**
+	 * Parse (change types, if necessary) and validate FOREIGN TABLE 'options'.
+	 * 'check_required' is 'true' if the completeness of the set of 'options'
+	 * must be checked. May be NULL.
+	 *
+	 * Errors are reported by 'ereport(ERROR)'.
+	 */
+	void		(*validate_options) (List *options, bool check_required);
+
+	/**
+	 * Prepare to deserialize records of 'tupledesc' with the given FOREIGN
+	 * TABLE 'options' (including internal ones). Memory is allocated in
+	 * CurrentMemoryContext, which lives until the end of the scan.
+	 *
+	 * @return the state of the format
+	 */
+	void	   *(*prepare) (TupleDesc tupledesc, List *options);
+
+	/**
+	 * Start to deserialize binary 'data' of length 'data_l' (a message).
+	 * 'data' may be NULL.
+	 */
+	void		(*begin) (void *state, void *data, size_t data_l);
+
+	/**
+	 * Deserialize the next record of the message into 'values' and 'nulls'.
+	 * Datums are allocated in CurrentMemoryContext.
+	 *
+	 * @return 'false' if there are no more records in the message
+	 */
+	bool		(*next) (void *state, Datum *values, bool *nulls);
+
+	/**
+	 * Finish deserialization and release resources of the 'state'. May be
+	 * NULL.
+	 */
+	void		(*finish) (void *state);
+
+	/**
+	 * Estimate the CPU cost of deserializing a single record of 'natts'
+	 * attributes with the given FOREIGN TABLE 'options'. May be NULL, in which
+	 * case the cost of an operator for each attribute is assumed.
+	 */
+	Cost		(*estimate_cost) (List *options, int natts);
+
+	/*
+	 * Optional callbacks to decode messages in worker threads, ahead of
+	 * 'begin' (see 'k_decode_threads' OPTION). Either all or none of them
+	 * must be set.
+	 */
+
+	/**
+	 * Prepare to decode binary 'data' of length 'data_l' (a message) in a
+	 * worker thread. 'data' may be NULL. Called in the backend.
+	 *
+	 * @return the argument of 'decode', allocated by malloc, or NULL if the
+	 * message is to be deserialized by 'begin'
+	 */
+	void	   *(*prepare_decode) (void *state, void *data, size_t data_l);
 
+	/**
+	 * Decode a message prepared by 'prepare_decode' into its 'arg'. Called in
+	 * a worker thread: must not call any PostgreSQL functions (including
+	 * palloc and ereport), and must not access memory other than 'arg' and
+	 * the message.
+	 */
+	void		(*decode) (void *arg);
+
+	/**
+	 * Start to deserialize a message decoded by 'decode' into 'arg'. Records
+	 * are then produced by 'next'. 'arg' stays valid until the next message
+	 * is started, or until 'finish'.
+	 */
+	void		(*begin_decoded) (void *state, void *arg);
+
+	/**
+	 * Release 'arg' of 'decode'. May be called in any thread: must not call
+	 * any PostgreSQL functions.
+	 */
+	void		(*discard_decoded) (void *arg);
+}	DeserializationFormatRoutine;
+
+
+/**
+ * Register a deserialization format. 'routine' is not copied, and must be
+ * allocated statically.
+ *
+ * Formats registered by libraries take effect for Kafka-ADB in the same
+ * process, no matter which library is loaded first. A format with the name of
+ * a built-in format is never used.
+ */
+static inline void
+register_deserialization_format(const DeserializationFormatRoutine * routine)
+{
+	List	  **formats = (List **) find_rendezvous_variable(KADB_DESERIALIZATION_FORMATS_RENDEZVOUS);
+	ListCell   *it;
+
+	AssertArg(PointerIsValid(routine) && PointerIsValid(routine->name));
+
+	foreach(it, *formats)
+	{
+		if (pg_strcasecmp(((const DeserializationFormatRoutine *) lfirst(it))->name, routine->name) == 0)
+			ereport(ERROR, (errcode(ERRCODE_DUPLICATE_OBJECT), errmsg("Kafka-ADB: Deserialization format '%s' is already registered", routine->name)));
+	}
+
+	MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	*formats = lappend(*formats, (void *) routine);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/**
+ * @return the format with the given 'name' (case-insensitive), or NULL if
+ * there is none.
+ *
+ * A format registered with a different version of
+ * 'DeserializationFormatRoutine' is reported by 'ereport(ERROR)'.
+ */
+const DeserializationFormatRoutine *resolve_deserialization_format(const char *name);
 
 /**
- * @return a value of 'DeserializationFormat', or
- * 'DESERIALIZATION_FORMAT_INVALID' if no format matches the given 'name'.
+ * Check whether 'option' is an OPTION of any known format: a FOREIGN TABLE
+ * OPTION, or a column OPTION if 'is_column_option' is 'true'.
  */
-enum DeserializationFormat resolve_deserialization_format(const char *name);
+bool		is_deserialization_format_option(const char *option, bool is_column_option);
 
 
 #endif   /* KADB_FDW_DESERIALIZATION_FORMAT_INCLUDED */
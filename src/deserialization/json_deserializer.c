@@ -0,0 +1,991 @@
+#include "json_deserializer.h"
+
+#include <catalog/pg_type.h>
+#include <mb/pg_wchar.h>
+#include <miscadmin.h>
+#include <optimizer/cost.h>
+#include <utils/builtins.h>
+#include <utils/faultinjector.h>
+#include <utils/jsonb.h>
+
+#include "settings.h"
+#include "deserialization/attribute_postgres.h"
+#include "deserialization/message_encoding.h"
+#include "utils/kadb_simd.h"
+
+
+/* The maximum length of a number converted to JSONB without allocation */
+#define NUMBER_BUFFER_SIZE 64
+
+/* Report invalid JSON at the current position of JsonScanner 's' */
+#define JSON_ERROR(s, message) ereport(ERROR, (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION), errmsg("Kafka-ADB: Invalid JSON: %s (at byte %ld of the message)", (message), (long) ((s)->p - (s)->start))))
+
+
+/**
+ * A node of a tree of JSON paths of all attributes.
+ *
+ * The tree is traversed along with the parsed JSON record. Values with no
+ * corresponding node are skipped.
+ */
+typedef struct JsonPathNode
+{
+	/* Key of an object member; NULL for an array element */
+	char	   *key;
+	int			key_l;
+	/* Index of an array element; used when 'key' is NULL */
+	int			index;
+	/* Attributes (starting at 0) whose values are at this node */
+	int		   *attributes;
+	int			attributes_count;
+	/* Whether any of 'attributes' is of type JSONB */
+	bool		has_jsonb_attribute;
+	/* Nested nodes */
+	struct JsonPathNode **children;
+	int			children_count;
+}	JsonPathNode;
+
+/**
+ * A position in the JSON message being parsed.
+ */
+typedef struct JsonScanner
+{
+	/* The start of the message, used to report errors */
+	const char *start;
+	/* Current position */
+	const char *p;
+	const char *end;
+}	JsonScanner;
+
+/**
+ * A JSON literal (a value which is not a string, an object, or an array).
+ */
+typedef enum JsonLiteral
+{
+	JSON_LITERAL_NUMBER,
+	JSON_LITERAL_TRUE,
+	JSON_LITERAL_FALSE,
+	JSON_LITERAL_NULL
+}	JsonLiteral;
+
+/* See definition in the header */
+struct JsonDeserializationStateObject
+{
+	TupleDesc	tupledesc;
+	/* Deserialization instructions for each attribute */
+	AttributeDeserializationInfo *adis;
+	/* Whether each attribute is of type JSONB */
+	bool	   *is_jsonb;
+	/* The root of the tree of JSON paths; corresponds to a record */
+	JsonPathNode *root;
+	/* Bytes to search for when skipping objects and arrays */
+	ByteSet		structural_bytes;
+	/* Bytes to search for when scanning strings */
+	ByteSet		string_bytes;
+	/* Datums for the CURRENT record; provided by 'deserialize_next_json()' */
+	Datum	   *values;
+	/* Null mask for the CURRENT record; provided the same way */
+	bool	   *nulls;
+	/* The position in the CURRENT message */
+	JsonScanner scanner;
+	/* The encoding of messages, or NULL if it is not set */
+	MessageEncoding encoding;
+#ifdef FAULT_INJECTOR
+	/* Raw data to use for tests */
+	char	   *data;
+	size_t		data_l;
+#endif
+};
+
+
+List *
+parse_json_path(const char *path)
+{
+	List	   *result = NIL;
+	const char *p = path;
+	bool		expect_key = true;
+
+	if (*p == '$')
+	{
+		p++;
+		expect_key = false;
+	}
+
+	while (true)
+	{
+		if (expect_key)
+		{
+			const char *key = p;
+
+			while (*p != '\0' && *p != '.' && *p != '[')
+				p++;
+			if (p == key)
+				break;
+			result = lappend(result, makeString(pnstrdup(key, p - key)));
+			expect_key = false;
+			continue;
+		}
+
+		if (*p == '\0')
+			return result;
+		if (*p == '.')
+		{
+			p++;
+			expect_key = true;
+			continue;
+		}
+		if (*p == '[')
+		{
+			const char *index = ++p;
+
+			while (*p >= '0' && *p <= '9')
+				p++;
+			if (p == index || *p != ']' || p - index > 9)
+				break;
+			result = lappend(result, makeInteger(atoi(index)));
+			p++;
+			continue;
+		}
+		break;
+	}
+
+	ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION value '%s' is not a valid JSON path", KADB_SETTING_JSON_PATH, path)));
+	return NIL;
+}
+
+/**
+ * Find a child of 'node' corresponding to path 'step' ('String' for a key,
+ * 'Integer' for an index). Create a new one if there is no such child.
+ */
+static JsonPathNode *
+get_json_path_child(JsonPathNode * node, Value *step)
+{
+	for (int i = 0; i < node->children_count; i++)
+	{
+		JsonPathNode *child = node->children[i];
+
+		if (IsA(step, String) && PointerIsValid(child->key) && strcmp(child->key, strVal(step)) == 0)
+			return child;
+		if (IsA(step, Integer) && !PointerIsValid(child->key) && child->index == intVal(step))
+			return child;
+	}
+
+	JsonPathNode *result = palloc0(sizeof(JsonPathNode));
+
+	if (IsA(step, String))
+	{
+		result->key = pstrdup(strVal(step));
+		result->key_l = strlen(result->key);
+	}
+	else
+		result->index = intVal(step);
+
+	if (node->children_count == 0)
+		node->children = palloc(sizeof(JsonPathNode *));
+	else
+		node->children = repalloc(node->children, sizeof(JsonPathNode *) * (node->children_count + 1));
+	node->children[node->children_count] = result;
+	node->children_count += 1;
+
+	return result;
+}
+
+JsonDeserializationState
+prepare_deserialization_json(TupleDesc tupledesc, List *options)
+{
+	return prepare_deserialization_json_paths(tupledesc, options, NIL);
+}
+
+JsonDeserializationState
+prepare_deserialization_json_paths(TupleDesc tupledesc, List *options, List *paths)
+{
+	JsonDeserializationState result = palloc(sizeof(struct JsonDeserializationStateObject));
+
+	result->tupledesc = tupledesc;
+	result->adis = (AttributeDeserializationInfo *) palloc(sizeof(AttributeDeserializationInfo) * tupledesc->natts);
+	result->is_jsonb = (bool *) palloc0(sizeof(bool) * tupledesc->natts);
+	result->root = palloc0(sizeof(JsonPathNode));
+	result->values = NULL;
+	result->nulls = NULL;
+	result->scanner.start = result->scanner.p = result->scanner.end = NULL;
+	result->encoding = prepare_message_encoding(options);
+
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		fill_attribute_deserialization_info(&result->adis[i], tupledesc, i, options);
+		if (result->adis[i].is_skipped)
+			continue;
+
+		List	   *path;
+
+		if (paths != NIL)
+			path = (List *) list_nth(paths, i);
+		else
+		{
+			DefElem    *path_option = get_column_option(options, i + 1, KADB_SETTING_JSON_PATH);
+
+			path = PointerIsValid(path_option) ?
+				parse_json_path(defGetString(path_option)) :
+				list_make1(makeString(pstrdup(NameStr(tupledesc->attrs[i]->attname))));
+		}
+
+		JsonPathNode *node = result->root;
+		ListCell   *it;
+
+		foreach(it, path)
+		{
+			node = get_json_path_child(node, (Value *) lfirst(it));
+		}
+
+		if (node->attributes_count == 0)
+			node->attributes = palloc(sizeof(int));
+		else
+			node->attributes = repalloc(node->attributes, sizeof(int) * (node->attributes_count + 1));
+		node->attributes[node->attributes_count] = i;
+		node->attributes_count += 1;
+
+		result->is_jsonb[i] = tupledesc->attrs[i]->atttypid == JSONBOID;
+		if (result->is_jsonb[i])
+			node->has_jsonb_attribute = true;
+	}
+
+	byte_set_init(&result->structural_bytes, "\"{}[]", 5);
+	byte_set_init(&result->string_bytes, "\"\\", 2);
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_json") == FaultInjectorTypeSkip)
+	{
+		char	   *inject_data = defGetString(get_option(options, KADB_SETTING_JSON_DATA_ON_INJECT));
+
+		result->data_l = strlen(inject_data);
+		result->data = pstrdup(inject_data);
+	}
+#endif
+
+	return result;
+}
+
+static inline void
+skip_whitespace(JsonScanner * s)
+{
+	while (s->p < s->end && (*s->p == ' ' || *s->p == '\n' || *s->p == '\r' || *s->p == '\t'))
+		s->p++;
+}
+
+/**
+ * Scan a string starting at the current position (an opening quote) of 's'.
+ * On return, 's' points after the closing quote.
+ *
+ * @param content_end is set to the end of the string contents
+ * @param has_escapes is set to 'true' if the string contains escape sequences
+ *
+ * @return the start of the string contents
+ */
+static const char *
+scan_string(JsonDeserializationState state, JsonScanner * s, const char **content_end, bool *has_escapes)
+{
+	const char *content = s->p + 1;
+	const char *p = content;
+
+	*has_escapes = false;
+	while (true)
+	{
+		p = byte_set_find(&state->string_bytes, p, s->end);
+		if (p >= s->end)
+		{
+			s->p = s->end;
+			JSON_ERROR(s, "unterminated string");
+		}
+		if (*p == '"')
+			break;
+		/* A backslash; skip the escaped character */
+		*has_escapes = true;
+		p += 2;
+	}
+
+	*content_end = p;
+	s->p = p + 1;
+	return content;
+}
+
+/**
+ * Parse 4 hexadecimal digits of a '\uXXXX' escape sequence at 'p'.
+ */
+static pg_wchar
+parse_unicode_escape(JsonScanner * s, const char *p)
+{
+	pg_wchar	result = 0;
+
+	if (s->end - p < 4)
+		JSON_ERROR(s, "invalid unicode escape sequence");
+
+	for (int i = 0; i < 4; i++)
+	{
+		char		c = p[i];
+
+		result <<= 4;
+		if (c >= '0' && c <= '9')
+			result += c - '0';
+		else if (c >= 'a' && c <= 'f')
+			result += c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			result += c - 'A' + 10;
+		else
+			JSON_ERROR(s, "invalid unicode escape sequence");
+	}
+
+	return result;
+}
+
+/**
+ * Unescape string contents ['start', 'end').
+ *
+ * Unicode escapes are processed the same way PostgreSQL processes them in
+ * JSONB input.
+ *
+ * @return a palloc'd NUL-terminated string; its length is put in 'result_l'
+ */
+static char *
+unescape_string(JsonScanner * s, const char *start, const char *end, int *result_l)
+{
+	/* The unescaped string is never longer than the escaped one */
+	char	   *result = palloc(end - start + 1);
+	char	   *out = result;
+
+	for (const char *p = start; p < end; p++)
+	{
+		if (*p != '\\')
+		{
+			*(out++) = *p;
+			continue;
+		}
+
+		p++;
+		switch (*p)
+		{
+			case '"':
+			case '\\':
+			case '/':
+				*(out++) = *p;
+				break;
+			case 'b':
+				*(out++) = '\b';
+				break;
+			case 'f':
+				*(out++) = '\f';
+				break;
+			case 'n':
+				*(out++) = '\n';
+				break;
+			case 'r':
+				*(out++) = '\r';
+				break;
+			case 't':
+				*(out++) = '\t';
+				break;
+			case 'u':
+				{
+					pg_wchar	code = parse_unicode_escape(s, p + 1);
+
+					p += 4;
+					if (code >= 0xd800 && code <= 0xdbff)
+					{
+						/* A high surrogate must be followed by a low one */
+						if (end - p < 7 || p[1] != '\\' || p[2] != 'u')
+							JSON_ERROR(s, "unicode low surrogate must follow a high surrogate");
+
+						pg_wchar	low = parse_unicode_escape(s, p + 3);
+
+						if (low < 0xdc00 || low > 0xdfff)
+							JSON_ERROR(s, "unicode low surrogate must follow a high surrogate");
+						code = ((code & 0x3ff) << 10) + 0x10000 + (low & 0x3ff);
+						p += 6;
+					}
+					else if (code >= 0xdc00 && code <= 0xdfff)
+						JSON_ERROR(s, "unicode low surrogate must follow a high surrogate");
+
+					if (code == 0)
+						JSON_ERROR(s, "\\u0000 cannot be converted to text");
+
+					if (GetDatabaseEncoding() == PG_UTF8)
+					{
+						unicode_to_utf8(code, (unsigned char *) out);
+						out += pg_utf_mblen((unsigned char *) out);
+					}
+					else if (code <= 0x007f)
+						*(out++) = (char) code;
+					else
+						JSON_ERROR(s, "unicode escape values cannot be used for code point values above 007F when the server encoding is not UTF8");
+				}
+				break;
+			default:
+				JSON_ERROR(s, "invalid escape sequence");
+		}
+	}
+
+	*out = '\0';
+	*result_l = out - result;
+	return result;
+}
+
+/**
+ * Check 'literal' of length 'literal_l' is a valid JSON number.
+ */
+static bool
+is_json_number(const char *literal, size_t literal_l)
+{
+	const char *p = literal;
+	const char *end = literal + literal_l;
+
+	if (p < end && *p == '-')
+		p++;
+	if (p >= end || *p < '0' || *p > '9')
+		return false;
+	if (*p == '0')
+		p++;
+	else
+	{
+		while (p < end && *p >= '0' && *p <= '9')
+			p++;
+	}
+	if (p < end && *p == '.')
+	{
+		const char *fraction = ++p;
+
+		while (p < end && *p >= '0' && *p <= '9')
+			p++;
+		if (p == fraction)
+			return false;
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		if (p < end && (*p == '+' || *p == '-'))
+			p++;
+
+		const char *exponent = p;
+
+		while (p < end && *p >= '0' && *p <= '9')
+			p++;
+		if (p == exponent)
+			return false;
+	}
+
+	return p == end;
+}
+
+/**
+ * Scan a literal starting at the current position of 's'. On return, 's'
+ * points after the literal.
+ *
+ * @return the kind of the literal
+ */
+static JsonLiteral
+scan_literal(JsonScanner * s)
+{
+	const char *start = s->p;
+
+	while (s->p < s->end && ((*s->p >= '0' && *s->p <= '9') || (*s->p >= 'a' && *s->p <= 'z') || (*s->p >= 'A' && *s->p <= 'Z') || *s->p == '-' || *s->p == '+' || *s->p == '.'))
+		s->p++;
+
+	size_t		literal_l = s->p - start;
+
+	if (literal_l == 4 && memcmp(start, "true", 4) == 0)
+		return JSON_LITERAL_TRUE;
+	if (literal_l == 5 && memcmp(start, "false", 5) == 0)
+		return JSON_LITERAL_FALSE;
+	if (literal_l == 4 && memcmp(start, "null", 4) == 0)
+		return JSON_LITERAL_NULL;
+	if (!is_json_number(start, literal_l))
+	{
+		s->p = start;
+		JSON_ERROR(s, "unexpected token");
+	}
+	return JSON_LITERAL_NUMBER;
+}
+
+/**
+ * Skip a value starting at the current position of 's'.
+ *
+ * Objects and arrays are skipped by searching for structural characters only;
+ * their contents are not validated.
+ */
+static void
+skip_value(JsonDeserializationState state, JsonScanner * s)
+{
+	const char *content_end;
+	bool		has_escapes;
+
+	switch (*s->p)
+	{
+		case '"':
+			scan_string(state, s, &content_end, &has_escapes);
+			break;
+		case '{':
+		case '[':
+			{
+				int			depth = 0;
+				const char *p = s->p;
+
+				while (true)
+				{
+					p = byte_set_find(&state->structural_bytes, p, s->end);
+					if (p >= s->end)
+					{
+						s->p = s->end;
+						JSON_ERROR(s, "unterminated object or array");
+					}
+					if (*p == '"')
+					{
+						s->p = p;
+						scan_string(state, s, &content_end, &has_escapes);
+						p = s->p;
+						continue;
+					}
+					if (*p == '{' || *p == '[')
+						depth += 1;
+					else
+						depth -= 1;
+					p++;
+					if (depth == 0)
+						break;
+				}
+				s->p = p;
+			}
+			break;
+		default:
+			scan_literal(s);
+			break;
+	}
+}
+
+/**
+ * Push a 'scalar' to JSONB parse state 'jb' as 'token'. A scalar at the top
+ * level is represented by a raw scalar array.
+ */
+static JsonbValue *
+push_jsonb_scalar(JsonbParseState **jb, int token, JsonbValue *scalar)
+{
+	if (PointerIsValid(*jb))
+		return pushJsonbValue(jb, token, scalar);
+
+	JsonbValue	array;
+
+	array.type = jbvArray;
+	array.val.array.rawScalar = true;
+	array.val.array.nElems = 1;
+	pushJsonbValue(jb, WJB_BEGIN_ARRAY, &array);
+	pushJsonbValue(jb, WJB_ELEM, scalar);
+	return pushJsonbValue(jb, WJB_END_ARRAY, NULL);
+}
+
+static JsonbValue *parse_value(JsonDeserializationState state, JsonScanner * s, JsonPathNode * node, JsonbParseState **jb, int token);
+
+/**
+ * Parse an object starting at the current position of 's'.
+ *
+ * @param node a node of the tree of JSON paths corresponding to the object, or
+ * NULL
+ * @param jb JSONB parse state to push the object to, or NULL
+ *
+ * @return the result of the last push to 'jb'
+ */
+static JsonbValue *
+parse_object(JsonDeserializationState state, JsonScanner * s, JsonPathNode * node, JsonbParseState **jb)
+{
+	s->p++;
+	if (PointerIsValid(jb))
+		pushJsonbValue(jb, WJB_BEGIN_OBJECT, NULL);
+
+	skip_whitespace(s);
+	if (s->p < s->end && *s->p == '}')
+	{
+		s->p++;
+		return PointerIsValid(jb) ? pushJsonbValue(jb, WJB_END_OBJECT, NULL) : NULL;
+	}
+
+	while (true)
+	{
+		skip_whitespace(s);
+		if (s->p >= s->end || *s->p != '"')
+			JSON_ERROR(s, "object key expected");
+
+		const char *key_end;
+		bool		has_escapes;
+		const char *key = scan_string(state, s, &key_end, &has_escapes);
+		int			key_l = key_end - key;
+
+		if (has_escapes)
+			key = unescape_string(s, key, key_end, &key_l);
+
+		JsonPathNode *child = NULL;
+
+		if (PointerIsValid(node))
+		{
+			for (int i = 0; i < node->children_count; i++)
+			{
+				JsonPathNode *candidate = node->children[i];
+
+				if (PointerIsValid(candidate->key) && candidate->key_l == key_l && memcmp(candidate->key, key, key_l) == 0)
+				{
+					child = candidate;
+					break;
+				}
+			}
+		}
+
+		if (PointerIsValid(jb))
+		{
+			JsonbValue	jb_key;
+
+			jb_key.type = jbvString;
+			jb_key.val.string.val = (char *) key;
+			jb_key.val.string.len = key_l;
+			pushJsonbValue(jb, WJB_KEY, &jb_key);
+		}
+
+		skip_whitespace(s);
+		if (s->p >= s->end || *s->p != ':')
+			JSON_ERROR(s, "':' expected");
+		s->p++;
+
+		parse_value(state, s, child, jb, WJB_VALUE);
+
+		skip_whitespace(s);
+		if (s->p < s->end && *s->p == ',')
+		{
+			s->p++;
+			continue;
+		}
+		if (s->p < s->end && *s->p == '}')
+		{
+			s->p++;
+			break;
+		}
+		JSON_ERROR(s, "',' or '}' expected");
+	}
+
+	return PointerIsValid(jb) ? pushJsonbValue(jb, WJB_END_OBJECT, NULL) : NULL;
+}
+
+/**
+ * Parse an array starting at the current position of 's'.
+ *
+ * Parameters and the result are the same as the ones of 'parse_object()'.
+ */
+static JsonbValue *
+parse_array(JsonDeserializationState state, JsonScanner * s, JsonPathNode * node, JsonbParseState **jb)
+{
+	s->p++;
+	if (PointerIsValid(jb))
+		pushJsonbValue(jb, WJB_BEGIN_ARRAY, NULL);
+
+	skip_whitespace(s);
+	if (s->p < s->end && *s->p == ']')
+	{
+		s->p++;
+		return PointerIsValid(jb) ? pushJsonbValue(jb, WJB_END_ARRAY, NULL) : NULL;
+	}
+
+	for (int index = 0;; index++)
+	{
+		JsonPathNode *child = NULL;
+
+		if (PointerIsValid(node))
+		{
+			for (int i = 0; i < node->children_count; i++)
+			{
+				JsonPathNode *candidate = node->children[i];
+
+				if (!PointerIsValid(candidate->key) && candidate->index == index)
+				{
+					child = candidate;
+					break;
+				}
+			}
+		}
+
+		parse_value(state, s, child, jb, WJB_ELEM);
+
+		skip_whitespace(s);
+		if (s->p < s->end && *s->p == ',')
+		{
+			s->p++;
+			continue;
+		}
+		if (s->p < s->end && *s->p == ']')
+		{
+			s->p++;
+			break;
+		}
+		JSON_ERROR(s, "',' or ']' expected");
+	}
+
+	return PointerIsValid(jb) ? pushJsonbValue(jb, WJB_END_ARRAY, NULL) : NULL;
+}
+
+/**
+ * Parse a value starting at the current position of 's', and set the values of
+ * attributes of 'node' (if any) in 'state'.
+ *
+ * A JSONB attribute is built in the same pass, unless it is nested in another
+ * JSONB attribute (in this case, the text of the value is passed to the input
+ * function).
+ *
+ * @param node a node of the tree of JSON paths corresponding to the value, or
+ * NULL
+ * @param jb JSONB parse state to push the value to, or NULL
+ * @param token a token to push a scalar value to 'jb' with
+ *
+ * @return the result of the last push to 'jb'
+ */
+static JsonbValue *
+parse_value(JsonDeserializationState state, JsonScanner * s, JsonPathNode * node, JsonbParseState **jb, int token)
+{
+	check_stack_depth();
+
+	skip_whitespace(s);
+	if (s->p >= s->end)
+		JSON_ERROR(s, "unexpected end of data");
+
+	if (PointerIsValid(node) && node->attributes_count == 0 && node->children_count == 0)
+		node = NULL;
+
+	/* The value is not needed at all */
+	if (!PointerIsValid(node) && !PointerIsValid(jb))
+	{
+		skip_value(state, s);
+		return NULL;
+	}
+
+	JsonbParseState *own_jb = NULL;
+	bool		builds_own_jsonb = false;
+
+	if (PointerIsValid(node) && node->has_jsonb_attribute && !PointerIsValid(jb))
+	{
+		jb = &own_jb;
+		builds_own_jsonb = true;
+	}
+
+	const char *value_start = s->p;
+	JsonbValue *result = NULL;
+	bool		is_null = false;
+	bool		is_string = false;
+	char	   *string = NULL;
+	int			string_l = 0;
+	JsonbValue	scalar;
+
+	switch (*s->p)
+	{
+		case '{':
+			result = parse_object(state, s, node, jb);
+			break;
+		case '[':
+			result = parse_array(state, s, node, jb);
+			break;
+		case '"':
+			{
+				const char *content_end;
+				bool		has_escapes;
+				const char *content = scan_string(state, s, &content_end, &has_escapes);
+
+				is_string = true;
+				if (has_escapes)
+					string = unescape_string(s, content, content_end, &string_l);
+				else
+				{
+					string = (char *) content;
+					string_l = content_end - content;
+				}
+
+				if (PointerIsValid(jb))
+				{
+					scalar.type = jbvString;
+					scalar.val.string.val = string;
+					scalar.val.string.len = string_l;
+					result = push_jsonb_scalar(jb, token, &scalar);
+				}
+			}
+			break;
+		default:
+			{
+				JsonLiteral literal = scan_literal(s);
+
+				is_null = literal == JSON_LITERAL_NULL;
+				if (!PointerIsValid(jb))
+					break;
+
+				switch (literal)
+				{
+					case JSON_LITERAL_NULL:
+						scalar.type = jbvNull;
+						break;
+					case JSON_LITERAL_TRUE:
+					case JSON_LITERAL_FALSE:
+						scalar.type = jbvBool;
+						scalar.val.boolean = literal == JSON_LITERAL_TRUE;
+						break;
+					case JSON_LITERAL_NUMBER:
+						{
+							char		buffer[NUMBER_BUFFER_SIZE];
+							size_t		number_l = s->p - value_start;
+							char	   *number = number_l < NUMBER_BUFFER_SIZE ? buffer : palloc(number_l + 1);
+
+							memcpy(number, value_start, number_l);
+							number[number_l] = '\0';
+							scalar.type = jbvNumeric;
+							scalar.val.numeric = DatumGetNumeric(DirectFunctionCall3(numeric_in, CStringGetDatum(number), ObjectIdGetDatum(InvalidOid), Int32GetDatum(-1)));
+						}
+						break;
+				}
+				result = push_jsonb_scalar(jb, token, &scalar);
+			}
+			break;
+	}
+
+	if (!PointerIsValid(node) || node->attributes_count == 0)
+		return result;
+
+	/* Set the values of attributes */
+	Datum		jsonb = builds_own_jsonb && !is_null ? PointerGetDatum(JsonbValueToJsonb(result)) : (Datum) 0;
+
+	for (int i = 0; i < node->attributes_count; i++)
+	{
+		int			attribute = node->attributes[i];
+		AttributeDeserializationInfo *adi = &state->adis[attribute];
+
+		state->nulls[attribute] = is_null;
+		if (is_null)
+			continue;
+
+		if (state->is_jsonb[attribute] && builds_own_jsonb)
+		{
+			state->values[attribute] = jsonb;
+			continue;
+		}
+
+		/*
+		 * Strings are passed to input functions unquoted. Other values
+		 * (including objects and arrays) are passed as JSON text
+		 */
+		const char *text_start = (is_string && !state->is_jsonb[attribute]) ? string : value_start;
+		size_t		text_l = (is_string && !state->is_jsonb[attribute]) ? string_l : (size_t) (s->p - value_start);
+
+		if (value_cache_lookup(adi->value_cache, text_start, text_l, &state->values[attribute]))
+			continue;
+
+		if (!fast_input_function_call(&adi->io_fn_textual, text_start, text_l, &state->values[attribute]))
+		{
+			char	   *text = pnstrdup(text_start, text_l);
+
+			state->values[attribute] = InputFunctionCall(
+														 &adi->io_fn_textual.iofunc,
+														 text,
+														 adi->io_fn_textual.typioparam,
+														 adi->io_fn_textual.attypmod
+				);
+			pfree(text);
+		}
+		value_cache_insert(adi->value_cache, text_start, text_l, state->values[attribute]);
+	}
+
+	return result;
+}
+
+void
+begin_deserialization_json(JsonDeserializationState state, void *data, size_t data_l)
+{
+	AssertArg(PointerIsValid(state));
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_json") == FaultInjectorTypeSkip)
+	{
+		data = state->data;
+		data_l = state->data_l;
+	}
+#endif
+
+	if (!PointerIsValid(data))
+		data_l = 0;
+	data = to_database_encoding(state->encoding, data, &data_l);
+
+	state->scanner.start = (const char *) data;
+	state->scanner.p = (const char *) data;
+	state->scanner.end = (const char *) data + data_l;
+}
+
+bool
+deserialize_next_json(JsonDeserializationState state, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(state));
+
+	JsonScanner *s = &state->scanner;
+
+	skip_whitespace(s);
+	if (s->p >= s->end)
+		return false;
+	if (*s->p != '{')
+		JSON_ERROR(s, "a record must be an object");
+
+	state->values = values;
+	state->nulls = nulls;
+	for (int i = 0; i < state->tupledesc->natts; i++)
+		state->nulls[i] = true;
+
+	parse_value(state, s, state->root, NULL, WJB_VALUE);
+
+	return true;
+}
+
+
+/*
+ * Callbacks of the format
+ */
+
+static void *
+prepare_json(TupleDesc tupledesc, List *options)
+{
+	return prepare_deserialization_json(tupledesc, options);
+}
+
+static void
+begin_json(void *state, void *data, size_t data_l)
+{
+	begin_deserialization_json((JsonDeserializationState) state, data, data_l);
+}
+
+static bool
+next_json(void *state, Datum *values, bool *nulls)
+{
+	return deserialize_next_json((JsonDeserializationState) state, values, nulls);
+}
+
+/**
+ * Values are parsed from text before they are converted by input functions.
+ */
+static Cost
+estimate_cost_json(List *options, int natts)
+{
+	return 2 * cpu_operator_cost * natts;
+}
+
+static const char *const JsonColumnOptions[] = {
+	KADB_SETTING_JSON_PATH,
+	NULL
+};
+
+const DeserializationFormatRoutine JsonDeserializationFormat = {
+	.api_version = KADB_DESERIALIZATION_FORMAT_API_VERSION,
+	.name = "json",
+	.options = NULL,
+	.column_options = JsonColumnOptions,
+	.validate_options = NULL,
+	.prepare = prepare_json,
+	.begin = begin_json,
+	.next = next_json,
+	.finish = NULL,
+	.estimate_cost = estimate_cost_json,
+	.prepare_decode = NULL,
+	.decode = NULL,
+	.begin_decoded = NULL,
+	.discard_decoded = NULL
+};
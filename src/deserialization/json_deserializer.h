@@ -0,0 +1,69 @@
+#ifndef KADB_FDW_DESERIALIZATION_JSON_DESERIALIZER_INCLUDED
+#define KADB_FDW_DESERIALIZATION_JSON_DESERIALIZER_INCLUDED
+
+/*
+ * JSON deserialization implementation.
+ *
+ * A message contains one or more JSON objects, separated by whitespace (e.g.
+ * JSON Lines). Each object is a record (tuple).
+ *
+ * Each attribute is extracted from a record by a path (by default, the name of
+ * the attribute, i.e. a top-level key). Values not referenced by any path are
+ * skipped without being parsed.
+ */
+
+#include <postgres.h>
+
+#include <access/tupdesc.h>
+
+#include "deserialization/format.h"
+
+
+/* An opaque struct to store JSON deserialization runtime state */
+typedef struct JsonDeserializationStateObject *JsonDeserializationState;
+
+
+/**
+ * Parse a JSON path: '$' (the record itself), optionally followed by a
+ * sequence of '.key' and '[index]' steps. The leading '$' may be omitted, in
+ * which case the path must start with a key.
+ *
+ * Errors are reported by 'ereport(ERROR)'.
+ *
+ * @return a list of steps: 'String' for keys and 'Integer' for indexes
+ */
+List	   *parse_json_path(const char *path);
+
+/**
+ * Prepare to deserialize JSON data.
+ */
+JsonDeserializationState prepare_deserialization_json(TupleDesc tupledesc, List *options);
+
+/**
+ * Prepare to deserialize JSON data, locating attributes by the given 'paths'
+ * instead of 'json_path' column OPTIONs.
+ *
+ * @param paths a list of paths (as returned by 'parse_json_path()') of each
+ * attribute of 'tupledesc'
+ */
+JsonDeserializationState prepare_deserialization_json_paths(TupleDesc tupledesc, List *options, List *paths);
+
+/**
+ * Start to deserialize binary 'data' of length 'data_l' from JSON format.
+ */
+void		begin_deserialization_json(JsonDeserializationState state, void *data, size_t data_l);
+
+/**
+ * Deserialize the next record into 'values' and 'nulls'.
+ *
+ * @return 'false' if there are no more records in the message
+ */
+bool		deserialize_next_json(JsonDeserializationState state, Datum *values, bool *nulls);
+
+
+/* Callbacks of the format */
+extern const DeserializationFormatRoutine JsonDeserializationFormat;
+
+#endif   /* //
+								 * KADB_FDW_DESERIALIZATION_JSON_DESERIALIZER_I
+								 * NCLUDED */
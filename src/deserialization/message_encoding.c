@@ -0,0 +1,104 @@
+#include "message_encoding.h"
+
+#include <catalog/namespace.h>
+#include <mb/pg_wchar.h>
+
+#include "settings.h"
+#include "utils/kadb_simd.h"
+
+
+/* Definition is in the header */
+struct MessageEncodingObject
+{
+	/* The encoding of messages */
+	int			source;
+	/* The database encoding */
+	int			target;
+};
+
+
+MessageEncoding
+prepare_message_encoding(List *options)
+{
+	DefElem    *option = get_option(options, KADB_SETTING_K_ENCODING);
+
+	if (!PointerIsValid(option))
+		return NULL;
+
+	MessageEncoding result = (MessageEncoding) palloc(sizeof(struct MessageEncodingObject));
+
+	/* The name of the encoding is validated when options are parsed */
+	result->source = pg_char_to_encoding(defGetString(option));
+	result->target = GetDatabaseEncoding();
+
+	if (
+		result->source != result->target
+		&& result->source != PG_SQL_ASCII
+		&& result->target != PG_SQL_ASCII
+		&& !OidIsValid(FindDefaultConversionProc(result->source, result->target))
+		)
+		ereport(ERROR, (errcode(ERRCODE_UNDEFINED_FUNCTION), errmsg("Kafka-ADB: Default conversion function for encoding \"%s\" to \"%s\" does not exist", pg_encoding_to_char(result->source), pg_encoding_to_char(result->target))));
+
+	return result;
+}
+
+/**
+ * Validate 'data' of length 'data_l' in 'encoding'.
+ */
+static void
+validate_encoding(int encoding, const char *data, size_t data_l)
+{
+	/* The error is reported by the generic function */
+	if (encoding != PG_UTF8 || !utf8_is_valid(data, data + data_l))
+		pg_verify_mbstr(encoding, data, (int) data_l, false);
+}
+
+bool
+is_validation_only(MessageEncoding encoding)
+{
+	return !PointerIsValid(encoding) ||
+		encoding->source == encoding->target ||
+		encoding->source == PG_SQL_ASCII ||
+		encoding->target == PG_SQL_ASCII;
+}
+
+void *
+to_database_encoding(MessageEncoding encoding, void *data, size_t *data_l)
+{
+	if (!PointerIsValid(encoding) || !PointerIsValid(data))
+		return data;
+
+	drop_terminating_nul(data, data_l);
+	if (*data_l == 0)
+		return data;
+
+	/*
+	 * Other NUL bytes are never valid in textual values. They are reported just as
+	 * 'pg_verify_mbstr()' reports them
+	 */
+	const char *nul = memchr(data, '\0', *data_l);
+
+	if (PointerIsValid(nul))
+		report_invalid_encoding(encoding->source, nul, (int) (*data_l - (nul - (const char *) data)));
+	if (*data_l > (size_t) (MaxAllocSize / MAX_CONVERSION_GROWTH))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: A message of size %zu is too large to convert its encoding", *data_l)));
+
+	/* No conversion is done from or to SQL_ASCII */
+	if (encoding->source == encoding->target || encoding->target == PG_SQL_ASCII)
+	{
+		validate_encoding(encoding->source, (const char *) data, *data_l);
+		return data;
+	}
+	if (encoding->source == PG_SQL_ASCII)
+	{
+		validate_encoding(encoding->target, (const char *) data, *data_l);
+		return data;
+	}
+
+	/* Conversion functions validate their input */
+	char	   *result = (char *) pg_do_encoding_conversion((unsigned char *) data, (int) *data_l, encoding->source, encoding->target);
+
+	if (result != (char *) data)
+		*data_l = strlen(result);
+	return result;
+}
@@ -0,0 +1,64 @@
+#ifndef KADB_FDW_DESERIALIZATION_MESSAGE_ENCODING_INCLUDED
+#define KADB_FDW_DESERIALIZATION_MESSAGE_ENCODING_INCLUDED
+
+/*
+ * Validation and conversion of the encoding of textual messages.
+ *
+ * When the encoding of messages is set by KADB_SETTING_K_ENCODING, the whole
+ * content of each message is validated, or converted to the database encoding,
+ * at once before it is parsed. Values taken from the message are then known
+ * to be valid in the database encoding.
+ */
+
+#include <postgres.h>
+
+#include <nodes/pg_list.h>
+
+
+/* An opaque struct to store the encoding of messages */
+typedef struct MessageEncodingObject *MessageEncoding;
+
+
+/**
+ * Prepare to process messages in the encoding set by FOREIGN TABLE 'options'.
+ *
+ * @return NULL if the encoding of messages is not set
+ */
+MessageEncoding prepare_message_encoding(List *options);
+
+/**
+ * Exclude a single trailing NUL byte from 'data' of length '*data_l'. Some
+ * producers send textual messages as C strings, with a terminating NUL byte;
+ * such a byte is not a part of the content.
+ */
+static inline void
+drop_terminating_nul(const void *data, size_t *data_l)
+{
+	if (PointerIsValid(data) && *data_l > 0 && ((const char *) data)[*data_l - 1] == '\0')
+		*data_l -= 1;
+}
+
+/**
+ * Validate 'data' of length '*data_l' in the encoding of messages, and convert
+ * it to the database encoding. A terminating NUL byte is excluded (see
+ * 'drop_terminating_nul()'); other NUL bytes are invalid in any encoding.
+ *
+ * Does nothing if 'encoding' is NULL.
+ *
+ * Invalid data is reported by 'ereport(ERROR)'.
+ *
+ * @return the data in the database encoding; '*data_l' is set to its length.
+ * It is 'data' itself, or a copy allocated by palloc in CurrentMemoryContext
+ */
+void	   *to_database_encoding(MessageEncoding encoding, void *data, size_t *data_l);
+
+/**
+ * Check whether 'to_database_encoding()' only validates data, i.e. never
+ * changes its bytes. 'true' if 'encoding' is NULL.
+ */
+bool		is_validation_only(MessageEncoding encoding);
+
+
+#endif   /* //
+								 * KADB_FDW_DESERIALIZATION_MESSAGE_ENCODING_IN
+								 * CLUDED */
@@ -0,0 +1,417 @@
+#include "payload_compression.h"
+
+#include <limits.h>
+
+#include <lz4frame.h>
+#include <snappy-c.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include <access/xact.h>
+#include <utils/builtins.h>
+#include <utils/faultinjector.h>
+#include <utils/memutils.h>
+
+#include "settings.h"
+
+
+#define STREQ(a, b) (strcmp(a, b) == 0)
+
+/* The initial size of the output buffer */
+#define PAYLOAD_BUFFER_MIN_SIZE 8192
+
+/* zlib: detect gzip and zlib headers automatically, with the maximum window */
+#define GZIP_WINDOW_BITS (15 + 32)
+
+/* Report invalid data compressed by 'decompressor' */
+#define DECOMPRESSION_ERROR(decompressor, message) ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Failed to decompress a payload compressed by '%s': %s", (decompressor)->name, (message))))
+
+
+typedef enum PayloadCompressionKind
+{
+	COMPRESSION_GZIP,
+	COMPRESSION_ZSTD,
+	COMPRESSION_LZ4,
+	COMPRESSION_SNAPPY
+}	PayloadCompressionKind;
+
+/* Definition is in the header */
+struct PayloadDecompressorObject
+{
+	PayloadCompressionKind kind;
+	/* The value of KADB_SETTING_PAYLOAD_COMPRESSION, to report errors */
+	const char *name;
+
+	/* Decompression contexts; only the one of 'kind' is created */
+	z_stream	gzip;
+	bool		gzip_is_initialized;
+	ZSTD_DCtx  *zstd;
+	LZ4F_dctx  *lz4;
+
+	/* The output buffer */
+	char	   *buffer;
+	size_t		buffer_size;
+
+#ifdef FAULT_INJECTOR
+	/* A compressed payload to use for tests */
+	char	   *inject_data;
+	size_t		inject_data_l;
+#endif
+
+	/* The next decompressor in 'LiveDecompressors' */
+	struct PayloadDecompressorObject *next;
+};
+
+
+/* Decompressors which are not destroyed yet */
+static PayloadDecompressor LiveDecompressors = NULL;
+/* Whether 'payload_decompressors_xact_callback()' is registered */
+static bool XactCallbackIsRegistered = false;
+
+
+/**
+ * Destroy decompressors left at the end of a transaction.
+ */
+static void
+payload_decompressors_xact_callback(XactEvent event, void *arg)
+{
+	if (event != XACT_EVENT_COMMIT && event != XACT_EVENT_ABORT)
+		return;
+
+	while (PointerIsValid(LiveDecompressors))
+		payload_decompressor_destroy(LiveDecompressors);
+}
+
+/**
+ * Free 'decompressor' which is not in 'LiveDecompressors'.
+ */
+static void
+free_decompressor(PayloadDecompressor decompressor)
+{
+	if (decompressor->gzip_is_initialized)
+		inflateEnd(&decompressor->gzip);
+	if (PointerIsValid(decompressor->zstd))
+		ZSTD_freeDCtx(decompressor->zstd);
+	if (PointerIsValid(decompressor->lz4))
+		LZ4F_freeDecompressionContext(decompressor->lz4);
+	free(decompressor->buffer);
+#ifdef FAULT_INJECTOR
+	free(decompressor->inject_data);
+#endif
+	free(decompressor);
+}
+
+/**
+ * Create the decompression context of 'decompressor'.
+ *
+ * @return 'false' if the library failed to allocate it
+ */
+static bool
+create_context(PayloadDecompressor decompressor)
+{
+	switch (decompressor->kind)
+	{
+		case COMPRESSION_GZIP:
+			decompressor->gzip_is_initialized = inflateInit2(&decompressor->gzip, GZIP_WINDOW_BITS) == Z_OK;
+			return decompressor->gzip_is_initialized;
+		case COMPRESSION_ZSTD:
+			decompressor->zstd = ZSTD_createDCtx();
+			return PointerIsValid(decompressor->zstd);
+		case COMPRESSION_LZ4:
+			return !LZ4F_isError(LZ4F_createDecompressionContext(&decompressor->lz4, LZ4F_VERSION));
+		case COMPRESSION_SNAPPY:
+			/* Snappy needs no context */
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Make the output buffer of 'decompressor' at least 'size' bytes long. The
+ * buffer grows geometrically, up to MaxAllocSize.
+ */
+static void
+reserve_buffer(PayloadDecompressor decompressor, size_t size)
+{
+	if (size <= decompressor->buffer_size)
+		return;
+	if (size > MaxAllocSize)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: A payload decompressed by '%s' exceeds %zu bytes", decompressor->name, (size_t) MaxAllocSize)));
+
+	size_t		new_size = Max(Max(decompressor->buffer_size * 2, size), PAYLOAD_BUFFER_MIN_SIZE);
+
+	new_size = Min(new_size, MaxAllocSize);
+
+	char	   *buffer = realloc(decompressor->buffer, new_size);
+
+	if (!PointerIsValid(buffer))
+		ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY), errmsg("out of memory")));
+	decompressor->buffer = buffer;
+	decompressor->buffer_size = new_size;
+}
+
+/**
+ * Decompress gzip (or zlib) 'data' of length 'data_l'. Concatenated gzip
+ * members are decompressed one after another.
+ *
+ * @return the length of the decompressed data
+ */
+static size_t
+decompress_gzip(PayloadDecompressor decompressor, const char *data, size_t data_l)
+{
+	z_stream   *stream = &decompressor->gzip;
+	size_t		result = 0;
+
+	if (data_l > UINT_MAX)
+		DECOMPRESSION_ERROR(decompressor, "the payload is too large");
+	if (inflateReset(stream) != Z_OK)
+		DECOMPRESSION_ERROR(decompressor, "failed to reset the stream");
+	stream->next_in = (Bytef *) data;
+	stream->avail_in = (uInt) data_l;
+
+	while (true)
+	{
+		if (result == decompressor->buffer_size)
+			reserve_buffer(decompressor, result + 1);
+		stream->next_out = (Bytef *) decompressor->buffer + result;
+		stream->avail_out = (uInt) Min(decompressor->buffer_size - result, UINT_MAX);
+
+		int			r = inflate(stream, Z_NO_FLUSH);
+
+		result = (char *) stream->next_out - decompressor->buffer;
+		if (r == Z_STREAM_END)
+		{
+			if (stream->avail_in == 0)
+				break;
+			if (inflateReset(stream) != Z_OK)
+				DECOMPRESSION_ERROR(decompressor, "failed to reset the stream");
+			continue;
+		}
+		/* No progress is possible with space in the buffer: no more input */
+		if (r == Z_BUF_ERROR && stream->avail_out > 0)
+			DECOMPRESSION_ERROR(decompressor, "unexpected end of data");
+		if (r != Z_OK && r != Z_BUF_ERROR)
+			DECOMPRESSION_ERROR(decompressor, PointerIsValid(stream->msg) ? stream->msg : "invalid data");
+	}
+
+	return result;
+}
+
+/**
+ * Decompress zstd 'data' of length 'data_l', which may consist of several
+ * frames.
+ *
+ * @return the length of the decompressed data
+ */
+static size_t
+decompress_zstd(PayloadDecompressor decompressor, const char *data, size_t data_l)
+{
+	ZSTD_inBuffer input = {data, data_l, 0};
+	size_t		result = 0;
+	size_t		r;
+
+	r = ZSTD_DCtx_reset(decompressor->zstd, ZSTD_reset_session_only);
+	if (ZSTD_isError(r))
+		DECOMPRESSION_ERROR(decompressor, ZSTD_getErrorName(r));
+
+	while (true)
+	{
+		if (result == decompressor->buffer_size)
+			reserve_buffer(decompressor, result + 1);
+
+		ZSTD_outBuffer output = {decompressor->buffer, decompressor->buffer_size, result};
+
+		r = ZSTD_decompressStream(decompressor->zstd, &output, &input);
+		if (ZSTD_isError(r))
+			DECOMPRESSION_ERROR(decompressor, ZSTD_getErrorName(r));
+		result = output.pos;
+
+		/* All data is flushed when there is space left in the buffer */
+		if (input.pos == input.size && output.pos < output.size)
+			break;
+	}
+
+	/* A non-zero hint means the last frame is incomplete */
+	if (r != 0)
+		DECOMPRESSION_ERROR(decompressor, "unexpected end of data");
+
+	return result;
+}
+
+/**
+ * Decompress LZ4 frames 'data' of length 'data_l'.
+ *
+ * @return the length of the decompressed data
+ */
+static size_t
+decompress_lz4(PayloadDecompressor decompressor, const char *data, size_t data_l)
+{
+	size_t		result = 0;
+
+	LZ4F_resetDecompressionContext(decompressor->lz4);
+
+	while (true)
+	{
+		if (result == decompressor->buffer_size)
+			reserve_buffer(decompressor, result + 1);
+
+		size_t		available = decompressor->buffer_size - result;
+		size_t		output_l = available;
+		size_t		input_l = data_l;
+		size_t		r = LZ4F_decompress(decompressor->lz4, decompressor->buffer + result, &output_l, data, &input_l, NULL);
+
+		if (LZ4F_isError(r))
+			DECOMPRESSION_ERROR(decompressor, LZ4F_getErrorName(r));
+		result += output_l;
+		data += input_l;
+		data_l -= input_l;
+
+		/* Zero means the end of a frame; another one may follow */
+		if (data_l == 0 && r == 0)
+			break;
+		if (data_l == 0 && output_l < available)
+			DECOMPRESSION_ERROR(decompressor, "unexpected end of data");
+	}
+
+	return result;
+}
+
+/**
+ * Decompress raw snappy 'data' of length 'data_l'.
+ *
+ * @return the length of the decompressed data
+ */
+static size_t
+decompress_snappy(PayloadDecompressor decompressor, const char *data, size_t data_l)
+{
+	size_t		result;
+
+	if (snappy_uncompressed_length(data, data_l, &result) != SNAPPY_OK)
+		DECOMPRESSION_ERROR(decompressor, "invalid length of data");
+	reserve_buffer(decompressor, Max(result, 1));
+	if (snappy_uncompress(data, data_l, decompressor->buffer, &result) != SNAPPY_OK)
+		DECOMPRESSION_ERROR(decompressor, "invalid data");
+
+	return result;
+}
+
+PayloadDecompressor
+payload_decompressor_create(List *options)
+{
+	DefElem    *option = get_option(options, KADB_SETTING_PAYLOAD_COMPRESSION);
+
+	if (!PointerIsValid(option) || STREQ(defGetString(option), KADB_PAYLOAD_COMPRESSION_NONE))
+		return NULL;
+
+	if (!XactCallbackIsRegistered)
+	{
+		RegisterXactCallback(payload_decompressors_xact_callback, NULL);
+		XactCallbackIsRegistered = true;
+	}
+
+	PayloadDecompressor result = (PayloadDecompressor) calloc(1, sizeof(struct PayloadDecompressorObject));
+
+	if (!PointerIsValid(result))
+		ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY), errmsg("out of memory")));
+
+	/* The value is validated when options are parsed */
+	const char *name = defGetString(option);
+
+	if (STREQ(name, KADB_PAYLOAD_COMPRESSION_GZIP))
+	{
+		result->kind = COMPRESSION_GZIP;
+		result->name = KADB_PAYLOAD_COMPRESSION_GZIP;
+	}
+	else if (STREQ(name, KADB_PAYLOAD_COMPRESSION_ZSTD))
+	{
+		result->kind = COMPRESSION_ZSTD;
+		result->name = KADB_PAYLOAD_COMPRESSION_ZSTD;
+	}
+	else if (STREQ(name, KADB_PAYLOAD_COMPRESSION_LZ4))
+	{
+		result->kind = COMPRESSION_LZ4;
+		result->name = KADB_PAYLOAD_COMPRESSION_LZ4;
+	}
+	else
+	{
+		result->kind = COMPRESSION_SNAPPY;
+		result->name = KADB_PAYLOAD_COMPRESSION_SNAPPY;
+	}
+
+	if (!create_context(result))
+	{
+		free_decompressor(result);
+		ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY), errmsg("out of memory"), errdetail("Kafka-ADB: Failed to create a '%s' decompression context", name)));
+	}
+
+	result->next = LiveDecompressors;
+	LiveDecompressors = result;
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_payload") == FaultInjectorTypeSkip)
+	{
+		bytea	   *inject_data = DatumGetByteaP(DirectFunctionCall2(binary_decode, CStringGetTextDatum(defGetString(get_option(options, KADB_SETTING_PAYLOAD_DATA_ON_INJECT))), CStringGetTextDatum("base64")));
+
+		result->inject_data_l = VARSIZE_ANY_EXHDR(inject_data);
+		result->inject_data = malloc(Max(result->inject_data_l, 1));
+		if (!PointerIsValid(result->inject_data))
+			ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY), errmsg("out of memory")));
+		memcpy(result->inject_data, VARDATA_ANY(inject_data), result->inject_data_l);
+	}
+#endif
+
+	return result;
+}
+
+void *
+payload_decompress(PayloadDecompressor decompressor, void *data, size_t *data_l)
+{
+	AssertArg(PointerIsValid(decompressor));
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_payload") == FaultInjectorTypeSkip)
+	{
+		data = decompressor->inject_data;
+		*data_l = decompressor->inject_data_l;
+	}
+#endif
+
+	/* Tombstones and empty payloads are not compressed */
+	if (!PointerIsValid(data) || *data_l == 0)
+		return data;
+
+	reserve_buffer(decompressor, Min(*data_l * 4, MaxAllocSize));
+
+	switch (decompressor->kind)
+	{
+		case COMPRESSION_GZIP:
+			*data_l = decompress_gzip(decompressor, (const char *) data, *data_l);
+			break;
+		case COMPRESSION_ZSTD:
+			*data_l = decompress_zstd(decompressor, (const char *) data, *data_l);
+			break;
+		case COMPRESSION_LZ4:
+			*data_l = decompress_lz4(decompressor, (const char *) data, *data_l);
+			break;
+		case COMPRESSION_SNAPPY:
+			*data_l = decompress_snappy(decompressor, (const char *) data, *data_l);
+			break;
+	}
+
+	return decompressor->buffer;
+}
+
+void
+payload_decompressor_destroy(PayloadDecompressor decompressor)
+{
+	AssertArg(PointerIsValid(decompressor));
+
+	PayloadDecompressor *link = &LiveDecompressors;
+
+	while (PointerIsValid(*link) && *link != decompressor)
+		link = &(*link)->next;
+	if (PointerIsValid(*link))
+		*link = decompressor->next;
+
+	free_decompressor(decompressor);
+}
@@ -0,0 +1,52 @@
+#ifndef KADB_FDW_DESERIALIZATION_PAYLOAD_COMPRESSION_INCLUDED
+#define KADB_FDW_DESERIALIZATION_PAYLOAD_COMPRESSION_INCLUDED
+
+/*
+ * Decompression of payloads compressed by producers.
+ *
+ * When KADB_SETTING_PAYLOAD_COMPRESSION is set, the payload of each message
+ * is decompressed before it is deserialized. This is independent of the
+ * compression of Kafka batches, which is handled by librdkafka.
+ *
+ * A decompressor reuses its decompression context and its output buffer for
+ * all messages of a scan. Both are allocated by malloc, as the libraries do;
+ * decompressors that are not destroyed by the end of the transaction (e.g.
+ * because of an ERROR) are destroyed then.
+ */
+
+#include <postgres.h>
+
+#include <nodes/pg_list.h>
+
+
+/* An opaque struct to store a decompressor of payloads */
+typedef struct PayloadDecompressorObject *PayloadDecompressor;
+
+
+/**
+ * Create a decompressor of payloads compressed as set by FOREIGN TABLE
+ * 'options'.
+ *
+ * @return NULL if payloads are not compressed
+ */
+PayloadDecompressor payload_decompressor_create(List *options);
+
+/**
+ * Decompress 'data' of length '*data_l'. NULL 'data' is returned as is.
+ *
+ * Invalid data is reported by 'ereport(ERROR)'.
+ *
+ * @return the decompressed data; '*data_l' is set to its length. It is owned
+ * by 'decompressor', and stays valid until the next call
+ */
+void	   *payload_decompress(PayloadDecompressor decompressor, void *data, size_t *data_l);
+
+/**
+ * Release the resources of 'decompressor' and free it.
+ */
+void		payload_decompressor_destroy(PayloadDecompressor decompressor);
+
+
+#endif   /* //
+								 * KADB_FDW_DESERIALIZATION_PAYLOAD_COMPRESSION
+								 * _INCLUDED */
@@ -0,0 +1,298 @@
+#include "pgbinary_deserializer.h"
+
+#include <arpa/inet.h>
+
+#include <lib/stringinfo.h>
+#include <utils/builtins.h>
+#include <utils/faultinjector.h>
+
+#include "settings.h"
+#include "deserialization/attribute_postgres.h"
+
+
+/* The signature at the start of the header of binary COPY format */
+static const char PgBinarySignature[11] = "PGCOPY\n\377\r\n\0";
+
+/* Header flags: OIDs are included in the data */
+#define PGBINARY_FLAG_OIDS (1 << 16)
+/* Header flags: the upper half are critical flags; unknown ones are errors */
+#define PGBINARY_CRITICAL_FLAGS_MASK 0xFFFF0000
+
+/* The field count which denotes the trailer */
+#define PGBINARY_TRAILER (-1)
+
+/* Report invalid data at the current position of 'state' */
+#define PGBINARY_ERROR(state, message) ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Invalid binary COPY data: %s (at byte %ld)", (message), (long) ((state)->p - (state)->start))))
+
+
+typedef struct PgBinaryDeserializationStateObject
+{
+	AttributeDeserializationInfo *adis;
+	TupleDesc	tupledesc;
+	/* The number of attributes that are not dropped, i.e. fields of a tuple */
+	int			fields_count;
+	/* A buffer to pass a field to a binary input function */
+	StringInfoData buffer;
+
+	/* The CURRENT message and the position in it */
+	const char *start;
+	const char *p;
+	const char *end;
+	/* Whether tuples of the CURRENT message include OIDs */
+	bool		has_oids;
+#ifdef FAULT_INJECTOR
+	/* Raw data to use for tests */
+	bytea	   *data;
+#endif
+}	PgBinaryDeserializationStateObject;
+
+
+/**
+ * Read a network-order 32-bit integer.
+ */
+static int32
+read_int32(PgBinaryDeserializationState state)
+{
+	uint32		result;
+
+	if (state->end - state->p < (long) sizeof(result))
+		PGBINARY_ERROR(state, "unexpected end of message");
+	memcpy(&result, state->p, sizeof(result));
+	state->p += sizeof(result);
+	return (int32) ntohl(result);
+}
+
+/**
+ * Read a network-order 16-bit integer.
+ */
+static int16
+read_int16(PgBinaryDeserializationState state)
+{
+	uint16		result;
+
+	if (state->end - state->p < (long) sizeof(result))
+		PGBINARY_ERROR(state, "unexpected end of message");
+	memcpy(&result, state->p, sizeof(result));
+	state->p += sizeof(result);
+	return (int16) ntohs(result);
+}
+
+/**
+ * Read the length of a field, and check the field is present in the message.
+ *
+ * @return the length, or -1 for a NULL field
+ */
+static int32
+read_field_length(PgBinaryDeserializationState state)
+{
+	int32		length = read_int32(state);
+
+	if (length < -1)
+		PGBINARY_ERROR(state, "invalid field length");
+	if (length > state->end - state->p)
+		PGBINARY_ERROR(state, "unexpected end of message");
+	return length;
+}
+
+/**
+ * Read the header of binary COPY format, if the CURRENT message starts with
+ * one.
+ */
+static void
+read_header(PgBinaryDeserializationState state)
+{
+	state->has_oids = false;
+
+	if (state->end - state->p < (long) sizeof(PgBinarySignature) || memcmp(state->p, PgBinarySignature, sizeof(PgBinarySignature)) != 0)
+		return;
+	state->p += sizeof(PgBinarySignature);
+
+	uint32		flags = (uint32) read_int32(state);
+
+	state->has_oids = (flags & PGBINARY_FLAG_OIDS) != 0;
+	if ((flags & ~PGBINARY_FLAG_OIDS & PGBINARY_CRITICAL_FLAGS_MASK) != 0)
+		PGBINARY_ERROR(state, "unrecognized critical flags in header");
+
+	int32		extension_l = read_int32(state);
+
+	if (extension_l < 0 || extension_l > state->end - state->p)
+		PGBINARY_ERROR(state, "invalid header extension length");
+	state->p += extension_l;
+}
+
+/**
+ * Convert a field of 'length' bytes at the current position by the binary
+ * input function of 'adi'.
+ */
+static Datum
+receive_field(PgBinaryDeserializationState state, AttributeDeserializationInfo * adi, int32 length)
+{
+	const char *value = state->p;
+	Datum		result;
+
+	state->p += length;
+	if (value_cache_lookup(adi->value_cache, value, (size_t) length, &result))
+		return result;
+
+	/* Input functions expect a null-terminated buffer they may modify */
+	resetStringInfo(&state->buffer);
+	appendBinaryStringInfo(&state->buffer, value, length);
+
+	result = ReceiveFunctionCall(&adi->io_fn_binary.iofunc, &state->buffer, adi->io_fn_binary.typioparam, adi->io_fn_binary.attypmod);
+	if (state->buffer.cursor != state->buffer.len)
+		PGBINARY_ERROR(state, "incorrect binary data format of a field");
+
+	value_cache_insert(adi->value_cache, value, (size_t) length, result);
+	return result;
+}
+
+PgBinaryDeserializationState
+prepare_deserialization_pgbinary(TupleDesc tupledesc, List *options)
+{
+	PgBinaryDeserializationState result = palloc(sizeof(PgBinaryDeserializationStateObject));
+
+	result->tupledesc = tupledesc;
+	result->adis = (AttributeDeserializationInfo *) palloc(sizeof(AttributeDeserializationInfo) * tupledesc->natts);
+	result->fields_count = 0;
+
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		AttributeDeserializationInfo *adi = &result->adis[i];
+
+		fill_attribute_deserialization_info(adi, tupledesc, i, options);
+		if (adi->is_dropped)
+			continue;
+		result->fields_count += 1;
+
+		if (!adi->is_skipped && !OidIsValid(adi->io_fn_binary.iofunc.fn_oid))
+			ereport(ERROR, (errcode(ERRCODE_FDW_ERROR), errmsg("Kafka-ADB: 'pgbinary' format cannot be applied to a column of type %s, which has no binary input function", format_type_be(tupledesc->attrs[i]->atttypid))));
+	}
+
+	initStringInfo(&result->buffer);
+
+	result->start = NULL;
+	result->p = NULL;
+	result->end = NULL;
+	result->has_oids = false;
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_pgbinary") == FaultInjectorTypeSkip)
+		result->data = DatumGetByteaP(DirectFunctionCall2(binary_decode, CStringGetTextDatum(defGetString(get_option(options, KADB_SETTING_PGBINARY_DATA_ON_INJECT))), CStringGetTextDatum("base64")));
+#endif
+
+	return result;
+}
+
+void
+begin_deserialization_pgbinary(PgBinaryDeserializationState state, void *data, size_t data_l)
+{
+	AssertArg(PointerIsValid(state));
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_pgbinary") == FaultInjectorTypeSkip)
+	{
+		data = VARDATA_ANY(state->data);
+		data_l = VARSIZE_ANY_EXHDR(state->data);
+	}
+#endif
+
+	if (!PointerIsValid(data))
+		data_l = 0;
+
+	state->start = (const char *) data;
+	state->p = state->start;
+	state->end = state->start + data_l;
+
+	read_header(state);
+}
+
+bool
+deserialize_next_pgbinary(PgBinaryDeserializationState state, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(state));
+
+	if (state->p >= state->end)
+		return false;
+
+	int16		fields_count = read_int16(state);
+
+	if (fields_count == PGBINARY_TRAILER)
+	{
+		if (state->p != state->end)
+			PGBINARY_ERROR(state, "data after the trailer");
+		return false;
+	}
+	if (fields_count != state->fields_count)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Invalid binary COPY data: a tuple has %d fields, but %d are expected (at byte %ld)", fields_count, state->fields_count, (long) (state->p - state->start))));
+
+	if (state->has_oids)
+	{
+		int32		oid_l = read_field_length(state);
+
+		state->p += Max(oid_l, 0);
+	}
+
+	for (int i = 0; i < state->tupledesc->natts; i++)
+	{
+		AttributeDeserializationInfo *adi = &state->adis[i];
+
+		nulls[i] = true;
+		if (adi->is_dropped)
+			continue;
+
+		int32		length = read_field_length(state);
+
+		if (length < 0)
+			continue;
+		if (adi->is_skipped)
+		{
+			state->p += length;
+			continue;
+		}
+
+		values[i] = receive_field(state, adi, length);
+		nulls[i] = false;
+	}
+
+	return true;
+}
+
+
+/*
+ * Callbacks of the format
+ */
+
+static void *
+prepare_pgbinary(TupleDesc tupledesc, List *options)
+{
+	return prepare_deserialization_pgbinary(tupledesc, options);
+}
+
+static void
+begin_pgbinary(void *state, void *data, size_t data_l)
+{
+	begin_deserialization_pgbinary((PgBinaryDeserializationState) state, data, data_l);
+}
+
+static bool
+next_pgbinary(void *state, Datum *values, bool *nulls)
+{
+	return deserialize_next_pgbinary((PgBinaryDeserializationState) state, values, nulls);
+}
+
+const DeserializationFormatRoutine PgBinaryDeserializationFormat = {
+	.api_version = KADB_DESERIALIZATION_FORMAT_API_VERSION,
+	.name = "pgbinary",
+	.options = NULL,
+	.column_options = NULL,
+	.validate_options = NULL,
+	.prepare = prepare_pgbinary,
+	.begin = begin_pgbinary,
+	.next = next_pgbinary,
+	.finish = NULL,
+	.estimate_cost = NULL,
+	.prepare_decode = NULL,
+	.decode = NULL,
+	.begin_decoded = NULL,
+	.discard_decoded = NULL
+};
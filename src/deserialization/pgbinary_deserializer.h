@@ -0,0 +1,53 @@
+#ifndef KADB_FDW_DESERIALIZATION_PGBINARY_DESERIALIZER_INCLUDED
+#define KADB_FDW_DESERIALIZATION_PGBINARY_DESERIALIZER_INCLUDED
+
+/*
+ * PostgreSQL binary COPY deserialization implementation.
+ *
+ * A message contains one or more tuples in the format of 'COPY ... WITH
+ * (FORMAT binary)', optionally preceded by the header of the format and
+ * followed by its trailer. Each tuple is a record.
+ *
+ * Fields of a tuple are mapped to attributes that are not dropped, in order.
+ * Each field is converted by the binary input ('typreceive') function of the
+ * type of its attribute.
+ */
+
+#include <postgres.h>
+
+#include <access/tupdesc.h>
+
+#include "deserialization/format.h"
+
+
+/* An opaque struct to store PGBINARY deserialization runtime state */
+typedef struct PgBinaryDeserializationStateObject *PgBinaryDeserializationState;
+
+
+/**
+ * Prepare to deserialize data in binary COPY format.
+ *
+ * An error is raised if a type of an attribute has no binary input function.
+ */
+PgBinaryDeserializationState prepare_deserialization_pgbinary(TupleDesc tupledesc, List *options);
+
+/**
+ * Start to deserialize binary 'data' of length 'data_l' from binary COPY
+ * format. A message with NULL 'data' or 'data_l' of 0 produces no records.
+ */
+void		begin_deserialization_pgbinary(PgBinaryDeserializationState state, void *data, size_t data_l);
+
+/**
+ * Deserialize the next record into 'values' and 'nulls'.
+ *
+ * @return 'false' if there are no more records in the message
+ */
+bool		deserialize_next_pgbinary(PgBinaryDeserializationState state, Datum *values, bool *nulls);
+
+/* Callbacks of the format */
+extern const DeserializationFormatRoutine PgBinaryDeserializationFormat;
+
+
+#endif   /* //
+								 * KADB_FDW_DESERIALIZATION_PGBINARY_DESERIALIZER_I
+								 * NCLUDED */
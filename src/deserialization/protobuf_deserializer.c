@@ -0,0 +1,1866 @@
+#include "protobuf_deserializer.h"
+
+#include <inttypes.h>
+#include <math.h>
+
+#include <catalog/pg_type.h>
+#include <mb/pg_wchar.h>
+#include <miscadmin.h>
+#include <storage/fd.h>
+#include <utils/array.h>
+#include <utils/builtins.h>
+#include <utils/datetime.h>
+#include <utils/faultinjector.h>
+#include <utils/jsonb.h>
+#include <utils/lsyscache.h>
+#include <utils/timestamp.h>
+
+#include "settings.h"
+#include "deserialization/attribute_postgres.h"
+
+
+/* Wire types */
+#define PB_WIRE_VARINT 0
+#define PB_WIRE_FIXED64 1
+#define PB_WIRE_LENGTH_DELIMITED 2
+#define PB_WIRE_START_GROUP 3
+#define PB_WIRE_END_GROUP 4
+#define PB_WIRE_FIXED32 5
+
+/* The maximum field number allowed by protobuf */
+#define PB_MAX_FIELD_NUMBER 536870911
+
+/*
+ * Fields of a message whose maximum field number does not exceed this value
+ * are looked up in a dense table, indexed by field number. Binary search is
+ * used otherwise.
+ */
+#define PB_DENSE_LOOKUP_MAX_FIELD_NUMBER 1024
+
+/* Initial capacity of 'ProtobufSlot' for repeated fields */
+#define PB_SLOT_INITIAL_CAPACITY 8
+
+/* The name of the well-known timestamp message type */
+#define PB_TIMESTAMP_MESSAGE "google.protobuf.Timestamp"
+
+/* Report invalid protobuf data at the current position of ProtobufReader 'r' */
+#define PROTOBUF_ERROR(r, message) ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: Invalid protobuf %s: %s (at byte %ld)", (r)->what, (message), (long) ((r)->p - (r)->start))))
+
+
+/**
+ * Field types, as defined by 'FieldDescriptorProto.Type'.
+ */
+typedef enum ProtobufFieldType
+{
+	PB_TYPE_DOUBLE = 1,
+	PB_TYPE_FLOAT = 2,
+	PB_TYPE_INT64 = 3,
+	PB_TYPE_UINT64 = 4,
+	PB_TYPE_INT32 = 5,
+	PB_TYPE_FIXED64 = 6,
+	PB_TYPE_FIXED32 = 7,
+	PB_TYPE_BOOL = 8,
+	PB_TYPE_STRING = 9,
+	PB_TYPE_GROUP = 10,
+	PB_TYPE_MESSAGE = 11,
+	PB_TYPE_BYTES = 12,
+	PB_TYPE_UINT32 = 13,
+	PB_TYPE_ENUM = 14,
+	PB_TYPE_SFIXED32 = 15,
+	PB_TYPE_SFIXED64 = 16,
+	PB_TYPE_SINT32 = 17,
+	PB_TYPE_SINT64 = 18
+}	ProtobufFieldType;
+
+/* 'FieldDescriptorProto.Label' of repeated fields */
+#define PB_LABEL_REPEATED 3
+
+/**
+ * A position in protobuf data being decoded.
+ */
+typedef struct ProtobufReader
+{
+	/* The start of the data, used to report errors */
+	const uint8 *start;
+	/* Current position */
+	const uint8 *p;
+	const uint8 *end;
+	/* What is being decoded, used to report errors */
+	const char *what;
+}	ProtobufReader;
+
+/**
+ * A single field value, as it is represented on the wire.
+ */
+typedef struct ProtobufWireValue
+{
+	int			wire_type;
+	/* PB_WIRE_VARINT, PB_WIRE_FIXED64, PB_WIRE_FIXED32 */
+	uint64		number;
+	/* PB_WIRE_LENGTH_DELIMITED */
+	const uint8 *data;
+	uint32		data_l;
+}	ProtobufWireValue;
+
+/**
+ * An enum type definition.
+ */
+typedef struct ProtobufEnum
+{
+	/* Fully-qualified name, without the leading dot */
+	char	   *full_name;
+	int			values_count;
+	int32	   *numbers;
+	char	  **names;
+}	ProtobufEnum;
+
+typedef struct ProtobufMessage ProtobufMessage;
+
+/**
+ * A field definition.
+ */
+typedef struct ProtobufField
+{
+	char	   *name;
+	int32		number;
+	ProtobufFieldType type;
+	bool		is_repeated;
+	/* Absence of the field is distinguishable from its default value */
+	bool		has_presence;
+	/* Fully-qualified name of a message or enum type, as in the descriptor */
+	char	   *type_name;
+	/* Resolved 'type_name' */
+	ProtobufMessage *message;
+	ProtobufEnum *enumeration;
+}	ProtobufField;
+
+/**
+ * A message type definition.
+ */
+struct ProtobufMessage
+{
+	/* Fully-qualified name, without the leading dot */
+	char	   *full_name;
+	/* The message is a synthetic entry of a map field */
+	bool		is_map_entry;
+	/* Fields, ordered by number */
+	ProtobufField *fields;
+	int			fields_count;
+	/* A dense table of 'max_number + 1' fields by number, or NULL */
+	ProtobufField **fields_by_number;
+	int32		max_number;
+};
+
+/**
+ * All types defined in a FileDescriptorSet.
+ */
+typedef struct ProtobufDescriptorPool
+{
+	List	   *messages;
+	List	   *enums;
+}	ProtobufDescriptorPool;
+
+/**
+ * A decoded scalar value.
+ */
+typedef struct ProtobufScalar
+{
+	enum
+	{
+		PB_SCALAR_INT,
+		PB_SCALAR_UINT,
+		PB_SCALAR_FLOAT,
+		PB_SCALAR_DOUBLE,
+		PB_SCALAR_BOOL,
+		PB_SCALAR_STRING,
+		PB_SCALAR_BYTES,
+		PB_SCALAR_ENUM
+	}			kind;
+	int64		i;
+	uint64		u;
+	double		d;
+	bool		b;
+	const char *s;
+	uint32		s_l;
+	/* PB_SCALAR_ENUM: the type of the value, whose number is in 'i' */
+	ProtobufEnum *enumeration;
+}	ProtobufScalar;
+
+/**
+ * A PostgreSQL type to convert values to.
+ */
+typedef struct ProtobufTarget
+{
+	Oid			typid;
+	FunctionCallCompleteData io;
+}	ProtobufTarget;
+
+/**
+ * Conversion instructions for a single attribute.
+ */
+typedef struct ProtobufColumn
+{
+	/* Index in 'slots' of the state */
+	int			slot;
+	ProtobufTarget target;
+	/* Array attributes: the type of elements ('typid' is InvalidOid otherwise) */
+	ProtobufTarget element;
+	int16		element_typlen;
+	bool		element_typbyval;
+	char		element_typalign;
+}	ProtobufColumn;
+
+/**
+ * Values of a single field of the CURRENT record. Only the fields referenced
+ * by attributes have slots.
+ */
+typedef struct ProtobufSlot
+{
+	ProtobufField *field;
+	/* For non-repeated fields, only the last value is kept */
+	ProtobufWireValue *values;
+	int			count;
+	int			capacity;
+}	ProtobufSlot;
+
+/* See definition in the header */
+struct ProtobufDeserializationStateObject
+{
+	TupleDesc	tupledesc;
+	/* Deserialization instructions for each attribute */
+	AttributeDeserializationInfo *adis;
+	ProtobufColumn *columns;
+	/* The message type of records */
+	ProtobufMessage *message;
+	/* Slots of the fields referenced by attributes */
+	ProtobufSlot *slots;
+	int			slots_count;
+	/* Slot of each field of 'message' (by index in 'message->fields'), or -1 */
+	int		   *slot_by_field;
+	/* The CURRENT message */
+	const uint8 *message_data;
+	size_t		message_data_l;
+	/* Whether the record of the CURRENT message is not yet returned */
+	bool		is_pending;
+#ifdef FAULT_INJECTOR
+	/* Raw data to use for tests */
+	bytea	   *data;
+#endif
+};
+
+
+/**
+ * Decode base64-encoded 'value' of an option.
+ */
+static bytea *
+decode_base64(const char *value)
+{
+	return DatumGetByteaP(DirectFunctionCall2(binary_decode, CStringGetTextDatum(value), CStringGetTextDatum("base64")));
+}
+
+/*
+ * Wire format
+ */
+
+static uint64
+read_varint(ProtobufReader * r)
+{
+	uint64		result = 0;
+
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		if (r->p >= r->end)
+			PROTOBUF_ERROR(r, "truncated varint");
+
+		uint8		byte = *r->p++;
+
+		result |= (uint64) (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return result;
+	}
+
+	PROTOBUF_ERROR(r, "varint is too long");
+	return 0;
+}
+
+/**
+ * Read a little-endian fixed-width integer of 'size' bytes.
+ */
+static uint64
+read_fixed(ProtobufReader * r, int size)
+{
+	uint64		result = 0;
+
+	if (r->end - r->p < size)
+		PROTOBUF_ERROR(r, "truncated fixed-width value");
+
+	for (int i = size - 1; i >= 0; i--)
+		result = (result << 8) | r->p[i];
+	r->p += size;
+
+	return result;
+}
+
+/**
+ * Read a value of 'wire_type' (except groups) into 'v'.
+ */
+static void
+read_wire_value(ProtobufReader * r, int wire_type, ProtobufWireValue * v)
+{
+	v->wire_type = wire_type;
+	switch (wire_type)
+	{
+		case PB_WIRE_VARINT:
+			v->number = read_varint(r);
+			break;
+		case PB_WIRE_FIXED64:
+			v->number = read_fixed(r, 8);
+			break;
+		case PB_WIRE_FIXED32:
+			v->number = read_fixed(r, 4);
+			break;
+		case PB_WIRE_LENGTH_DELIMITED:
+			{
+				uint64		length = read_varint(r);
+
+				if (length > (uint64) (r->end - r->p))
+					PROTOBUF_ERROR(r, "truncated length-delimited value");
+				v->data = r->p;
+				v->data_l = (uint32) length;
+				r->p += length;
+			}
+			break;
+		default:
+			PROTOBUF_ERROR(r, psprintf("invalid wire type %d", wire_type));
+	}
+}
+
+/**
+ * Skip a group (a deprecated encoding of nested messages) with the given
+ * field 'number', whose start tag has already been read.
+ */
+static void
+skip_group(ProtobufReader * r, uint64 number)
+{
+	ProtobufWireValue ignored;
+
+	check_stack_depth();
+
+	while (true)
+	{
+		if (r->p >= r->end)
+			PROTOBUF_ERROR(r, "unterminated group");
+
+		uint64		tag = read_varint(r);
+		int			wire_type = (int) (tag & 0x7);
+
+		if (wire_type == PB_WIRE_END_GROUP)
+		{
+			if ((tag >> 3) != number)
+				PROTOBUF_ERROR(r, "mismatched end of group");
+			return;
+		}
+		if (wire_type == PB_WIRE_START_GROUP)
+			skip_group(r, tag >> 3);
+		else
+			read_wire_value(r, wire_type, &ignored);
+	}
+}
+
+/**
+ * Read the next field. Groups are skipped; for them, only 'wire_type' of 'v'
+ * is set.
+ *
+ * @return false if there are no more fields
+ */
+static bool
+read_field(ProtobufReader * r, int32 *number, ProtobufWireValue * v)
+{
+	if (r->p >= r->end)
+		return false;
+
+	uint64		tag = read_varint(r);
+	uint64		field_number = tag >> 3;
+	int			wire_type = (int) (tag & 0x7);
+
+	if (field_number == 0 || field_number > PB_MAX_FIELD_NUMBER)
+		PROTOBUF_ERROR(r, "invalid field number");
+
+	if (wire_type == PB_WIRE_START_GROUP)
+	{
+		skip_group(r, field_number);
+		v->wire_type = wire_type;
+	}
+	else if (wire_type == PB_WIRE_END_GROUP)
+		PROTOBUF_ERROR(r, "unexpected end of group");
+	else
+		read_wire_value(r, wire_type, v);
+
+	*number = (int32) field_number;
+	return true;
+}
+
+/**
+ * Make a reader of a length-delimited value 'v', read by 'parent'.
+ */
+static inline ProtobufReader
+make_nested_reader(const ProtobufReader * parent, const ProtobufWireValue * v)
+{
+	ProtobufReader result = {
+		.start = parent->start,
+		.p = v->data,
+		.end = v->data + v->data_l,
+		.what = parent->what
+	};
+
+	return result;
+}
+
+/*
+ * Descriptor set
+ */
+
+static void
+expect_wire_type(ProtobufReader * r, const ProtobufWireValue * v, int wire_type)
+{
+	if (v->wire_type != wire_type)
+		PROTOBUF_ERROR(r, "unexpected wire type of a descriptor field");
+}
+
+static char *
+wire_value_to_cstring(ProtobufReader * r, const ProtobufWireValue * v)
+{
+	expect_wire_type(r, v, PB_WIRE_LENGTH_DELIMITED);
+	return pnstrdup((const char *) v->data, v->data_l);
+}
+
+static ProtobufWireValue *
+copy_wire_value(const ProtobufWireValue * v)
+{
+	ProtobufWireValue *result = palloc(sizeof(ProtobufWireValue));
+
+	*result = *v;
+	return result;
+}
+
+static char *
+make_full_name(const char *scope, const char *name)
+{
+	if (!PointerIsValid(scope) || scope[0] == '\0')
+		return pstrdup(name);
+	return psprintf("%s.%s", scope, name);
+}
+
+/**
+ * Parse an 'EnumDescriptorProto' in 'scope'.
+ */
+static void
+parse_enum(ProtobufDescriptorPool * pool, ProtobufReader * r, const char *scope)
+{
+	ProtobufEnum *result = palloc0(sizeof(ProtobufEnum));
+	char	   *name = NULL;
+	List	   *values = NIL;
+	int32		number;
+	ProtobufWireValue v;
+	ListCell   *it;
+
+	while (read_field(r, &number, &v))
+	{
+		if (number == 1)
+			name = wire_value_to_cstring(r, &v);
+		else if (number == 2)
+		{
+			expect_wire_type(r, &v, PB_WIRE_LENGTH_DELIMITED);
+			values = lappend(values, copy_wire_value(&v));
+		}
+	}
+	if (!PointerIsValid(name))
+		PROTOBUF_ERROR(r, "enum without a name");
+
+	result->full_name = make_full_name(scope, name);
+	result->numbers = palloc0(sizeof(int32) * Max(list_length(values), 1));
+	result->names = palloc0(sizeof(char *) * Max(list_length(values), 1));
+
+	foreach(it, values)
+	{
+		ProtobufReader value_r = make_nested_reader(r, (ProtobufWireValue *) lfirst(it));
+
+		while (read_field(&value_r, &number, &v))
+		{
+			if (number == 1)
+				result->names[result->values_count] = wire_value_to_cstring(&value_r, &v);
+			else if (number == 2)
+			{
+				expect_wire_type(&value_r, &v, PB_WIRE_VARINT);
+				result->numbers[result->values_count] = (int32) v.number;
+			}
+		}
+		if (!PointerIsValid(result->names[result->values_count]))
+			PROTOBUF_ERROR(&value_r, "enum value without a name");
+		result->values_count += 1;
+	}
+
+	pool->enums = lappend(pool->enums, result);
+}
+
+/**
+ * Parse a 'FieldDescriptorProto' into 'field'.
+ */
+static void
+parse_field(ProtobufReader * r, ProtobufField * field, bool is_proto3)
+{
+	int32		number;
+	ProtobufWireValue v;
+	bool		is_oneof_member = false;
+	bool		is_proto3_optional = false;
+
+	MemSet(field, 0, sizeof(ProtobufField));
+
+	while (read_field(r, &number, &v))
+	{
+		switch (number)
+		{
+			case 1:
+				field->name = wire_value_to_cstring(r, &v);
+				break;
+			case 3:
+				expect_wire_type(r, &v, PB_WIRE_VARINT);
+				field->number = (int32) v.number;
+				break;
+			case 4:
+				expect_wire_type(r, &v, PB_WIRE_VARINT);
+				field->is_repeated = v.number == PB_LABEL_REPEATED;
+				break;
+			case 5:
+				expect_wire_type(r, &v, PB_WIRE_VARINT);
+				if (v.number < PB_TYPE_DOUBLE || v.number > PB_TYPE_SINT64)
+					PROTOBUF_ERROR(r, "unknown field type");
+				field->type = (ProtobufFieldType) v.number;
+				break;
+			case 6:
+				field->type_name = wire_value_to_cstring(r, &v);
+				break;
+			case 9:
+				is_oneof_member = true;
+				break;
+			case 17:
+				expect_wire_type(r, &v, PB_WIRE_VARINT);
+				is_proto3_optional = v.number != 0;
+				break;
+			default:
+				break;
+		}
+	}
+	if (!PointerIsValid(field->name) || field->number < 1 || field->number > PB_MAX_FIELD_NUMBER || field->type == 0)
+		PROTOBUF_ERROR(r, "incomplete field definition");
+
+	field->has_presence = !is_proto3 || is_oneof_member || is_proto3_optional ||
+		field->type == PB_TYPE_MESSAGE || field->type == PB_TYPE_GROUP;
+}
+
+static int
+compare_fields_by_number(const void *a, const void *b)
+{
+	int32		a_number = ((const ProtobufField *) a)->number;
+	int32		b_number = ((const ProtobufField *) b)->number;
+
+	return (a_number > b_number) - (a_number < b_number);
+}
+
+/**
+ * Parse a 'DescriptorProto' (including nested types) in 'scope'.
+ */
+static void
+parse_message(ProtobufDescriptorPool * pool, ProtobufReader * r, const char *scope, bool is_proto3)
+{
+	ProtobufMessage *result = palloc0(sizeof(ProtobufMessage));
+	char	   *name = NULL;
+	List	   *fields = NIL;
+	List	   *nested_messages = NIL;
+	List	   *nested_enums = NIL;
+	int32		number;
+	ProtobufWireValue v;
+	ListCell   *it;
+
+	/* Nested types are parsed once the name of this message is known */
+	while (read_field(r, &number, &v))
+	{
+		switch (number)
+		{
+			case 1:
+				name = wire_value_to_cstring(r, &v);
+				break;
+			case 2:
+			case 3:
+			case 4:
+				expect_wire_type(r, &v, PB_WIRE_LENGTH_DELIMITED);
+				if (number == 2)
+					fields = lappend(fields, copy_wire_value(&v));
+				else if (number == 3)
+					nested_messages = lappend(nested_messages, copy_wire_value(&v));
+				else
+					nested_enums = lappend(nested_enums, copy_wire_value(&v));
+				break;
+			case 7:
+				{
+					/* MessageOptions */
+					ProtobufReader options_r;
+
+					expect_wire_type(r, &v, PB_WIRE_LENGTH_DELIMITED);
+					options_r = make_nested_reader(r, &v);
+					while (read_field(&options_r, &number, &v))
+					{
+						if (number == 7 && v.wire_type == PB_WIRE_VARINT)
+							result->is_map_entry = v.number != 0;
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	if (!PointerIsValid(name))
+		PROTOBUF_ERROR(r, "message without a name");
+
+	result->full_name = make_full_name(scope, name);
+	result->fields_count = list_length(fields);
+	result->fields = palloc0(sizeof(ProtobufField) * Max(result->fields_count, 1));
+
+	int			i = 0;
+
+	foreach(it, fields)
+	{
+		ProtobufReader field_r = make_nested_reader(r, (ProtobufWireValue *) lfirst(it));
+
+		parse_field(&field_r, &result->fields[i], is_proto3);
+		result->max_number = Max(result->max_number, result->fields[i].number);
+		i++;
+	}
+	qsort(result->fields, result->fields_count, sizeof(ProtobufField), compare_fields_by_number);
+
+	if (result->max_number <= PB_DENSE_LOOKUP_MAX_FIELD_NUMBER)
+	{
+		result->fields_by_number = palloc0(sizeof(ProtobufField *) * (result->max_number + 1));
+		for (i = 0; i < result->fields_count; i++)
+			result->fields_by_number[result->fields[i].number] = &result->fields[i];
+	}
+
+	pool->messages = lappend(pool->messages, result);
+
+	foreach(it, nested_messages)
+	{
+		ProtobufReader nested_r = make_nested_reader(r, (ProtobufWireValue *) lfirst(it));
+
+		check_stack_depth();
+		parse_message(pool, &nested_r, result->full_name, is_proto3);
+	}
+	foreach(it, nested_enums)
+	{
+		ProtobufReader nested_r = make_nested_reader(r, (ProtobufWireValue *) lfirst(it));
+
+		parse_enum(pool, &nested_r, result->full_name);
+	}
+}
+
+/**
+ * Parse a 'FileDescriptorProto'.
+ */
+static void
+parse_file(ProtobufDescriptorPool * pool, ProtobufReader * r)
+{
+	char	   *package = NULL;
+	bool		is_proto3 = false;
+	List	   *messages = NIL;
+	List	   *enums = NIL;
+	int32		number;
+	ProtobufWireValue v;
+	ListCell   *it;
+
+	/* 'syntax' follows the types, so they are parsed after the loop */
+	while (read_field(r, &number, &v))
+	{
+		switch (number)
+		{
+			case 2:
+				package = wire_value_to_cstring(r, &v);
+				break;
+			case 4:
+				expect_wire_type(r, &v, PB_WIRE_LENGTH_DELIMITED);
+				messages = lappend(messages, copy_wire_value(&v));
+				break;
+			case 5:
+				expect_wire_type(r, &v, PB_WIRE_LENGTH_DELIMITED);
+				enums = lappend(enums, copy_wire_value(&v));
+				break;
+			case 12:
+				is_proto3 = strcmp(wire_value_to_cstring(r, &v), "proto3") == 0;
+				break;
+			default:
+				break;
+		}
+	}
+
+	foreach(it, messages)
+	{
+		ProtobufReader message_r = make_nested_reader(r, (ProtobufWireValue *) lfirst(it));
+
+		parse_message(pool, &message_r, package, is_proto3);
+	}
+	foreach(it, enums)
+	{
+		ProtobufReader enum_r = make_nested_reader(r, (ProtobufWireValue *) lfirst(it));
+
+		parse_enum(pool, &enum_r, package);
+	}
+}
+
+static ProtobufMessage *
+find_message(ProtobufDescriptorPool * pool, const char *full_name)
+{
+	ListCell   *it;
+
+	if (full_name[0] == '.')
+		full_name++;
+
+	foreach(it, pool->messages)
+	{
+		if (strcmp(((ProtobufMessage *) lfirst(it))->full_name, full_name) == 0)
+			return (ProtobufMessage *) lfirst(it);
+	}
+	return NULL;
+}
+
+static ProtobufEnum *
+find_enum(ProtobufDescriptorPool * pool, const char *full_name)
+{
+	ListCell   *it;
+
+	if (full_name[0] == '.')
+		full_name++;
+
+	foreach(it, pool->enums)
+	{
+		if (strcmp(((ProtobufEnum *) lfirst(it))->full_name, full_name) == 0)
+			return (ProtobufEnum *) lfirst(it);
+	}
+	return NULL;
+}
+
+/**
+ * Parse a 'FileDescriptorSet' and resolve all type references in it.
+ */
+static ProtobufDescriptorPool *
+parse_descriptor_set(bytea *descriptor_set)
+{
+	ProtobufDescriptorPool *result = palloc0(sizeof(ProtobufDescriptorPool));
+	ProtobufReader r = {
+		.start = (const uint8 *) VARDATA_ANY(descriptor_set),
+		.p = (const uint8 *) VARDATA_ANY(descriptor_set),
+		.end = (const uint8 *) VARDATA_ANY(descriptor_set) + VARSIZE_ANY_EXHDR(descriptor_set),
+		.what = "descriptor set"
+	};
+	int32		number;
+	ProtobufWireValue v;
+	ListCell   *it;
+
+	while (read_field(&r, &number, &v))
+	{
+		if (number == 1)
+		{
+			ProtobufReader file_r;
+
+			expect_wire_type(&r, &v, PB_WIRE_LENGTH_DELIMITED);
+			file_r = make_nested_reader(&r, &v);
+			parse_file(result, &file_r);
+		}
+	}
+
+	foreach(it, result->messages)
+	{
+		ProtobufMessage *message = (ProtobufMessage *) lfirst(it);
+
+		for (int i = 0; i < message->fields_count; i++)
+		{
+			ProtobufField *field = &message->fields[i];
+
+			if (field->type != PB_TYPE_MESSAGE && field->type != PB_TYPE_GROUP && field->type != PB_TYPE_ENUM)
+				continue;
+
+			if (PointerIsValid(field->type_name))
+			{
+				if (field->type == PB_TYPE_ENUM)
+					field->enumeration = find_enum(result, field->type_name);
+				else
+					field->message = find_message(result, field->type_name);
+			}
+			if (!PointerIsValid(field->message) && !PointerIsValid(field->enumeration))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("Kafka-ADB: Invalid protobuf descriptor set: type of field '%s.%s' is not defined", message->full_name, field->name),
+						 errhint("Use 'protoc --include_imports' to include all dependencies in the descriptor set.")));
+		}
+	}
+
+	return result;
+}
+
+static ProtobufMessage *
+resolve_message(ProtobufDescriptorPool * pool, const char *message_name)
+{
+	ProtobufMessage *result = find_message(pool, message_name);
+
+	if (!PointerIsValid(result))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: Protobuf message type '%s' is not defined in the descriptor set", message_name)));
+	return result;
+}
+
+static ProtobufField *
+get_field_by_number(ProtobufMessage * message, int32 number)
+{
+	if (PointerIsValid(message->fields_by_number))
+		return number <= message->max_number ? message->fields_by_number[number] : NULL;
+
+	int			low = 0;
+	int			high = message->fields_count - 1;
+
+	while (low <= high)
+	{
+		int			middle = low + (high - low) / 2;
+		int32		middle_number = message->fields[middle].number;
+
+		if (middle_number == number)
+			return &message->fields[middle];
+		if (middle_number < number)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+	return NULL;
+}
+
+static ProtobufField *
+get_field_by_name(ProtobufMessage * message, const char *name)
+{
+	for (int i = 0; i < message->fields_count; i++)
+	{
+		if (strcmp(message->fields[i].name, name) == 0)
+			return &message->fields[i];
+	}
+	return NULL;
+}
+
+/**
+ * Parse a field reference (a name or a number).
+ *
+ * @return the field number, or 0 if 'reference' is a name
+ */
+static int32
+parse_field_reference(const char *reference)
+{
+	if (reference[0] == '\0')
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must not be empty", KADB_SETTING_PROTOBUF_FIELD)));
+
+	if (!isdigit((unsigned char) reference[0]))
+		return 0;
+
+	char	   *end;
+	long		result;
+
+	errno = 0;
+	result = strtol(reference, &end, 10);
+	if (errno != 0 || *end != '\0' || result < 1 || result > PB_MAX_FIELD_NUMBER)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION value '%s' is neither a field name nor a valid field number", KADB_SETTING_PROTOBUF_FIELD, reference)));
+
+	return (int32) result;
+}
+
+void
+validate_protobuf_descriptor_set(const char *descriptor_set, const char *message_name)
+{
+	ProtobufDescriptorPool *pool = parse_descriptor_set(decode_base64(descriptor_set));
+
+	resolve_message(pool, message_name);
+}
+
+void
+validate_protobuf_field_reference(const char *reference)
+{
+	parse_field_reference(reference);
+}
+
+char *
+read_protobuf_descriptor_set_file(const char *path)
+{
+	FILE	   *file = AllocateFile(path, PG_BINARY_R);
+	StringInfoData buff;
+	char		chunk[8192];
+	size_t		chunk_l;
+
+	if (!PointerIsValid(file))
+		ereport(ERROR, (errcode_for_file_access(), errmsg("Kafka-ADB: Failed to open protobuf descriptor set file \"%s\": %m", path)));
+
+	initStringInfo(&buff);
+	appendStringInfoSpaces(&buff, VARHDRSZ);
+	while ((chunk_l = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		appendBinaryStringInfo(&buff, chunk, chunk_l);
+	if (ferror(file))
+		ereport(ERROR, (errcode_for_file_access(), errmsg("Kafka-ADB: Failed to read protobuf descriptor set file \"%s\": %m", path)));
+	FreeFile(file);
+
+	SET_VARSIZE(buff.data, buff.len);
+
+	return TextDatumGetCString(DirectFunctionCall2(binary_encode, PointerGetDatum(buff.data), CStringGetTextDatum("base64")));
+}
+
+/*
+ * Conversion of values
+ */
+
+static int
+expected_wire_type(ProtobufFieldType type)
+{
+	switch (type)
+	{
+		case PB_TYPE_DOUBLE:
+		case PB_TYPE_FIXED64:
+		case PB_TYPE_SFIXED64:
+			return PB_WIRE_FIXED64;
+		case PB_TYPE_FLOAT:
+		case PB_TYPE_FIXED32:
+		case PB_TYPE_SFIXED32:
+			return PB_WIRE_FIXED32;
+		case PB_TYPE_STRING:
+		case PB_TYPE_BYTES:
+		case PB_TYPE_MESSAGE:
+			return PB_WIRE_LENGTH_DELIMITED;
+		case PB_TYPE_GROUP:
+			return PB_WIRE_START_GROUP;
+		default:
+			return PB_WIRE_VARINT;
+	}
+}
+
+/**
+ * Check that wire type of 'v' matches the type of 'field'.
+ */
+static void
+check_wire_type(ProtobufReader * r, const ProtobufField * field, const ProtobufWireValue * v)
+{
+	int			expected = expected_wire_type(field->type);
+
+	if (v->wire_type == expected)
+		return;
+	/* Packed repeated scalar values */
+	if (field->is_repeated && v->wire_type == PB_WIRE_LENGTH_DELIMITED && expected != PB_WIRE_LENGTH_DELIMITED && expected != PB_WIRE_START_GROUP)
+		return;
+
+	if (field->type == PB_TYPE_GROUP)
+		PROTOBUF_ERROR(r, psprintf("field '%s' is a group; groups are not supported", field->name));
+	PROTOBUF_ERROR(r, psprintf("unexpected wire type %d of field '%s'", v->wire_type, field->name));
+}
+
+/**
+ * Get the value of an absent 'field' without presence (proto3 default).
+ */
+static ProtobufWireValue
+default_wire_value(const ProtobufField * field)
+{
+	ProtobufWireValue result;
+
+	MemSet(&result, 0, sizeof(ProtobufWireValue));
+	result.wire_type = expected_wire_type(field->type);
+	result.data = (const uint8 *) "";
+	return result;
+}
+
+/**
+ * Expand values of a repeated 'field': packed values are unpacked.
+ *
+ * @return an array of 'count' values with no packed values in it
+ */
+static ProtobufWireValue *
+expand_repeated_values(ProtobufReader * r, const ProtobufField * field, ProtobufWireValue * values, int *count)
+{
+	int			expected = expected_wire_type(field->type);
+
+	if (expected == PB_WIRE_LENGTH_DELIMITED)
+		return values;
+
+	List	   *expanded = NIL;
+
+	for (int i = 0; i < *count; i++)
+	{
+		if (values[i].wire_type != PB_WIRE_LENGTH_DELIMITED)
+		{
+			expanded = lappend(expanded, &values[i]);
+			continue;
+		}
+
+		ProtobufReader packed_r = make_nested_reader(r, &values[i]);
+
+		while (packed_r.p < packed_r.end)
+		{
+			ProtobufWireValue *v = palloc(sizeof(ProtobufWireValue));
+
+			read_wire_value(&packed_r, expected, v);
+			expanded = lappend(expanded, v);
+		}
+	}
+
+	ProtobufWireValue *result = palloc(sizeof(ProtobufWireValue) * Max(list_length(expanded), 1));
+	ListCell   *it;
+	int			i = 0;
+
+	foreach(it, expanded)
+	{
+		result[i++] = *(ProtobufWireValue *) lfirst(it);
+	}
+	*count = i;
+	list_free(expanded);
+
+	return result;
+}
+
+static ProtobufScalar
+decode_scalar(const ProtobufField * field, const ProtobufWireValue * v)
+{
+	ProtobufScalar result;
+	uint64		raw = v->number;
+
+	MemSet(&result, 0, sizeof(ProtobufScalar));
+	switch (field->type)
+	{
+		case PB_TYPE_DOUBLE:
+			result.kind = PB_SCALAR_DOUBLE;
+			memcpy(&result.d, &raw, sizeof(double));
+			break;
+		case PB_TYPE_FLOAT:
+			{
+				uint32		raw32 = (uint32) raw;
+				float		f;
+
+				memcpy(&f, &raw32, sizeof(float));
+				result.kind = PB_SCALAR_FLOAT;
+				result.d = f;
+			}
+			break;
+		case PB_TYPE_INT32:
+		case PB_TYPE_SFIXED32:
+			result.kind = PB_SCALAR_INT;
+			result.i = (int32) (uint32) raw;
+			break;
+		case PB_TYPE_INT64:
+		case PB_TYPE_SFIXED64:
+			result.kind = PB_SCALAR_INT;
+			result.i = (int64) raw;
+			break;
+		case PB_TYPE_UINT32:
+		case PB_TYPE_FIXED32:
+			result.kind = PB_SCALAR_INT;
+			result.i = (uint32) raw;
+			break;
+		case PB_TYPE_UINT64:
+		case PB_TYPE_FIXED64:
+			if (raw <= (uint64) INT64_MAX)
+			{
+				result.kind = PB_SCALAR_INT;
+				result.i = (int64) raw;
+			}
+			else
+			{
+				result.kind = PB_SCALAR_UINT;
+				result.u = raw;
+			}
+			break;
+		case PB_TYPE_SINT32:
+			result.kind = PB_SCALAR_INT;
+			result.i = (int32) (((uint32) raw >> 1) ^ -((uint32) raw & 1));
+			break;
+		case PB_TYPE_SINT64:
+			result.kind = PB_SCALAR_INT;
+			result.i = (int64) ((raw >> 1) ^ -(raw & 1));
+			break;
+		case PB_TYPE_BOOL:
+			result.kind = PB_SCALAR_BOOL;
+			result.b = raw != 0;
+			break;
+		case PB_TYPE_ENUM:
+			result.kind = PB_SCALAR_ENUM;
+			result.i = (int32) (uint32) raw;
+			result.enumeration = field->enumeration;
+			break;
+		case PB_TYPE_STRING:
+		case PB_TYPE_BYTES:
+			result.kind = field->type == PB_TYPE_STRING ? PB_SCALAR_STRING : PB_SCALAR_BYTES;
+			result.s = (const char *) v->data;
+			result.s_l = v->data_l;
+			if (field->type == PB_TYPE_STRING)
+				pg_verify_mbstr(GetDatabaseEncoding(), result.s, result.s_l, false);
+			break;
+		default:
+			Assert(false);
+	}
+
+	return result;
+}
+
+static const char *
+get_enum_name(const ProtobufScalar * scalar)
+{
+	for (int i = 0; i < scalar->enumeration->values_count; i++)
+	{
+		if (scalar->enumeration->numbers[i] == scalar->i)
+			return scalar->enumeration->names[i];
+	}
+	return NULL;
+}
+
+static bytea *
+scalar_to_bytea(const ProtobufScalar * scalar)
+{
+	bytea	   *result = palloc(VARHDRSZ + scalar->s_l);
+
+	SET_VARSIZE(result, VARHDRSZ + scalar->s_l);
+	memcpy(VARDATA(result), scalar->s, scalar->s_l);
+	return result;
+}
+
+/**
+ * Represent 'scalar' in textual form, suitable for PostgreSQL input functions.
+ * Bytes are represented in 'BYTEA' format; enums are represented by names
+ * (by numbers for unknown values).
+ */
+static char *
+scalar_to_cstring(const ProtobufScalar * scalar)
+{
+	switch (scalar->kind)
+	{
+		case PB_SCALAR_INT:
+			return psprintf(INT64_FORMAT, scalar->i);
+		case PB_SCALAR_UINT:
+			return psprintf(UINT64_FORMAT, scalar->u);
+		case PB_SCALAR_FLOAT:
+			return DatumGetCString(DirectFunctionCall1(float4out, Float4GetDatum((float4) scalar->d)));
+		case PB_SCALAR_DOUBLE:
+			return DatumGetCString(DirectFunctionCall1(float8out, Float8GetDatum(scalar->d)));
+		case PB_SCALAR_BOOL:
+			return pstrdup(scalar->b ? "true" : "false");
+		case PB_SCALAR_STRING:
+			return pnstrdup(scalar->s, scalar->s_l);
+		case PB_SCALAR_BYTES:
+			return DatumGetCString(DirectFunctionCall1(byteaout, PointerGetDatum(scalar_to_bytea(scalar))));
+		case PB_SCALAR_ENUM:
+			{
+				const char *name = get_enum_name(scalar);
+
+				return PointerIsValid(name) ? pstrdup(name) : psprintf(INT64_FORMAT, scalar->i);
+			}
+	}
+	Assert(false);
+	return NULL;
+}
+
+static JsonbValue *
+push_scalar_to_jsonb(JsonbParseState **state, int token, const ProtobufScalar * scalar)
+{
+	JsonbValue	value;
+
+	switch (scalar->kind)
+	{
+		case PB_SCALAR_INT:
+			value.type = jbvNumeric;
+			value.val.numeric = DatumGetNumeric(DirectFunctionCall1(int8_numeric, Int64GetDatum(scalar->i)));
+			break;
+		case PB_SCALAR_FLOAT:
+		case PB_SCALAR_DOUBLE:
+			if (isnan(scalar->d) || isinf(scalar->d))
+			{
+				/* JSON has no representation of these numbers */
+				value.type = jbvString;
+				value.val.string.val = isnan(scalar->d) ? "NaN" : (scalar->d > 0 ? "Infinity" : "-Infinity");
+				value.val.string.len = strlen(value.val.string.val);
+				break;
+			}
+			value.type = jbvNumeric;
+			value.val.numeric = DatumGetNumeric(DirectFunctionCall1(float8_numeric, Float8GetDatum(scalar->d)));
+			break;
+		case PB_SCALAR_UINT:
+			value.type = jbvNumeric;
+			value.val.numeric = DatumGetNumeric(DirectFunctionCall3(numeric_in, CStringGetDatum(scalar_to_cstring(scalar)), ObjectIdGetDatum(InvalidOid), Int32GetDatum(-1)));
+			break;
+		case PB_SCALAR_BOOL:
+			value.type = jbvBool;
+			value.val.boolean = scalar->b;
+			break;
+		case PB_SCALAR_STRING:
+			value.type = jbvString;
+			value.val.string.val = (char *) scalar->s;
+			value.val.string.len = scalar->s_l;
+			break;
+		case PB_SCALAR_BYTES:
+		case PB_SCALAR_ENUM:
+			value.type = jbvString;
+			value.val.string.val = scalar_to_cstring(scalar);
+			value.val.string.len = strlen(value.val.string.val);
+			break;
+	}
+
+	if (!PointerIsValid(*state))
+	{
+		/* A scalar at the top level is represented by a raw scalar array */
+		JsonbValue	array;
+
+		array.type = jbvArray;
+		array.val.array.rawScalar = true;
+		array.val.array.nElems = 1;
+		pushJsonbValue(state, WJB_BEGIN_ARRAY, &array);
+		pushJsonbValue(state, WJB_ELEM, &value);
+		return pushJsonbValue(state, WJB_END_ARRAY, NULL);
+	}
+
+	return pushJsonbValue(state, token, &value);
+}
+
+static JsonbValue *push_values_to_jsonb(JsonbParseState **state, int token, ProtobufReader * r, const ProtobufField * field, ProtobufWireValue * values, int count);
+
+/**
+ * Push a message of type 'message', encoded in 'v', to JSONB as an object.
+ * Keys are field names. Only the fields present on the wire are pushed.
+ */
+static JsonbValue *
+push_message_to_jsonb(JsonbParseState **state, int token, ProtobufReader * parent, const ProtobufMessage * message, const ProtobufWireValue * v)
+{
+	ProtobufReader r = make_nested_reader(parent, v);
+	List	  **values = palloc0(sizeof(List *) * Max(message->fields_count, 1));
+	int32		number;
+	ProtobufWireValue field_v;
+
+	check_stack_depth();
+
+	while (read_field(&r, &number, &field_v))
+	{
+		ProtobufField *field = get_field_by_number((ProtobufMessage *) message, number);
+
+		if (!PointerIsValid(field) || field_v.wire_type == PB_WIRE_START_GROUP)
+			continue;
+		check_wire_type(&r, field, &field_v);
+		values[field - message->fields] = lappend(values[field - message->fields], copy_wire_value(&field_v));
+	}
+
+	pushJsonbValue(state, WJB_BEGIN_OBJECT, NULL);
+	for (int i = 0; i < message->fields_count; i++)
+	{
+		int			count = list_length(values[i]);
+
+		if (count == 0)
+			continue;
+
+		ProtobufWireValue *field_values = palloc(sizeof(ProtobufWireValue) * count);
+		ListCell   *it;
+		int			j = 0;
+		JsonbValue	key;
+
+		foreach(it, values[i])
+		{
+			field_values[j++] = *(ProtobufWireValue *) lfirst(it);
+		}
+
+		key.type = jbvString;
+		key.val.string.val = message->fields[i].name;
+		key.val.string.len = strlen(message->fields[i].name);
+		pushJsonbValue(state, WJB_KEY, &key);
+		push_values_to_jsonb(state, WJB_VALUE, &r, &message->fields[i], field_values, count);
+	}
+	return pushJsonbValue(state, WJB_END_OBJECT, NULL);
+}
+
+/**
+ * Push a single (non-repeated) value 'v' of 'field' to JSONB.
+ */
+static JsonbValue *
+push_value_to_jsonb(JsonbParseState **state, int token, ProtobufReader * r, const ProtobufField * field, const ProtobufWireValue * v)
+{
+	if (field->type == PB_TYPE_MESSAGE)
+		return push_message_to_jsonb(state, token, r, field->message, v);
+
+	ProtobufScalar scalar = decode_scalar(field, v);
+
+	return push_scalar_to_jsonb(state, token, &scalar);
+}
+
+/**
+ * Push a map entry 'v' of a map 'field' to JSONB as a key and a value.
+ */
+static void
+push_map_entry_to_jsonb(JsonbParseState **state, ProtobufReader * parent, const ProtobufField * field, const ProtobufWireValue * v)
+{
+	ProtobufReader r = make_nested_reader(parent, v);
+	ProtobufMessage *entry = field->message;
+	ProtobufField *key_field = get_field_by_number(entry, 1);
+	ProtobufField *value_field = get_field_by_number(entry, 2);
+	ProtobufWireValue key_v;
+	ProtobufWireValue value_v;
+	int32		number;
+	ProtobufWireValue field_v;
+	JsonbValue	key;
+
+	if (!PointerIsValid(key_field) || !PointerIsValid(value_field))
+		PROTOBUF_ERROR(&r, "invalid map entry type");
+
+	key_v = default_wire_value(key_field);
+	value_v = default_wire_value(value_field);
+	while (read_field(&r, &number, &field_v))
+	{
+		if (number == 1)
+		{
+			check_wire_type(&r, key_field, &field_v);
+			key_v = field_v;
+		}
+		else if (number == 2)
+		{
+			check_wire_type(&r, value_field, &field_v);
+			value_v = field_v;
+		}
+	}
+
+	ProtobufScalar key_scalar = decode_scalar(key_field, &key_v);
+
+	key.type = jbvString;
+	key.val.string.val = scalar_to_cstring(&key_scalar);
+	key.val.string.len = strlen(key.val.string.val);
+	pushJsonbValue(state, WJB_KEY, &key);
+	push_value_to_jsonb(state, WJB_VALUE, &r, value_field, &value_v);
+}
+
+/**
+ * Push 'count' values of 'field' to JSONB. Repeated fields are pushed as
+ * arrays (maps as objects); for other fields, the last value is pushed.
+ */
+static JsonbValue *
+push_values_to_jsonb(JsonbParseState **state, int token, ProtobufReader * r, const ProtobufField * field, ProtobufWireValue * values, int count)
+{
+	if (!field->is_repeated)
+		return push_value_to_jsonb(state, token, r, field, &values[count - 1]);
+
+	values = expand_repeated_values(r, field, values, &count);
+
+	if (PointerIsValid(field->message) && field->message->is_map_entry)
+	{
+		pushJsonbValue(state, WJB_BEGIN_OBJECT, NULL);
+		for (int i = 0; i < count; i++)
+			push_map_entry_to_jsonb(state, r, field, &values[i]);
+		return pushJsonbValue(state, WJB_END_OBJECT, NULL);
+	}
+
+	pushJsonbValue(state, WJB_BEGIN_ARRAY, NULL);
+	for (int i = 0; i < count; i++)
+		push_value_to_jsonb(state, WJB_ELEM, r, field, &values[i]);
+	return pushJsonbValue(state, WJB_END_ARRAY, NULL);
+}
+
+static Datum
+values_to_jsonb(ProtobufReader * r, const ProtobufField * field, ProtobufWireValue * values, int count)
+{
+	JsonbParseState *state = NULL;
+	JsonbValue *result = push_values_to_jsonb(&state, WJB_ELEM, r, field, values, count);
+
+	return PointerGetDatum(JsonbValueToJsonb(result));
+}
+
+/**
+ * Convert a single value 'v' of 'field' to JSONB, even if 'field' is repeated.
+ */
+static Datum
+value_to_jsonb(ProtobufReader * r, const ProtobufField * field, const ProtobufWireValue * v)
+{
+	JsonbParseState *state = NULL;
+	JsonbValue *result = push_value_to_jsonb(&state, WJB_ELEM, r, field, v);
+
+	return PointerGetDatum(JsonbValueToJsonb(result));
+}
+
+static Datum
+input_function_call(const ProtobufTarget * target, char *value)
+{
+	Datum		result;
+
+	if (fast_input_function_call(&target->io, value, strlen(value), &result))
+		return result;
+	return InputFunctionCall(
+							 (FmgrInfo *) &target->io.iofunc,
+							 value,
+							 target->io.typioparam,
+							 target->io.attypmod
+		);
+}
+
+/**
+ * Convert a message of the well-known type 'google.protobuf.Timestamp' to a
+ * 'TIMESTAMP' or 'TIMESTAMPTZ'. The value is in UTC.
+ */
+static Datum
+timestamp_message_to_datum(ProtobufReader * parent, const ProtobufMessage * message, const ProtobufWireValue * v, const ProtobufTarget * target)
+{
+	ProtobufReader r = make_nested_reader(parent, v);
+	int64		seconds = 0;
+	int32		nanos = 0;
+	int32		number;
+	ProtobufWireValue field_v;
+	Timestamp	result;
+
+	while (read_field(&r, &number, &field_v))
+	{
+		if (field_v.wire_type != PB_WIRE_VARINT)
+			continue;
+		if (number == 1)
+			seconds = (int64) field_v.number;
+		else if (number == 2)
+			nanos = (int32) (uint32) field_v.number;
+	}
+
+	seconds -= (int64) (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * SECS_PER_DAY;
+#ifdef HAVE_INT64_TIMESTAMP
+	result = seconds * USECS_PER_SEC + nanos / 1000;
+#else
+	result = seconds + nanos / 1000000000.0;
+#endif
+
+	if (target->io.attypmod < 0)
+		return TimestampGetDatum(result);
+	if (target->typid == TIMESTAMPOID)
+		return DirectFunctionCall2(timestamp_scale, TimestampGetDatum(result), Int32GetDatum(target->io.attypmod));
+	return DirectFunctionCall2(timestamptz_scale, TimestampGetDatum(result), Int32GetDatum(target->io.attypmod));
+}
+
+/**
+ * Convert a decoded 'scalar' to a Datum of 'target' type. Common types are
+ * converted directly; other types are converted by their input functions.
+ */
+static Datum
+scalar_to_datum(const ProtobufScalar * scalar, const ProtobufTarget * target)
+{
+	switch (target->typid)
+	{
+		case INT2OID:
+			if (scalar->kind == PB_SCALAR_INT && scalar->i >= INT16_MIN && scalar->i <= INT16_MAX)
+				return Int16GetDatum((int16) scalar->i);
+			break;
+		case INT4OID:
+			if (scalar->kind == PB_SCALAR_INT && scalar->i >= INT32_MIN && scalar->i <= INT32_MAX)
+				return Int32GetDatum((int32) scalar->i);
+			break;
+		case INT8OID:
+			if (scalar->kind == PB_SCALAR_INT)
+				return Int64GetDatum(scalar->i);
+			break;
+		case FLOAT4OID:
+			if (scalar->kind == PB_SCALAR_FLOAT)
+				return Float4GetDatum((float4) scalar->d);
+			if (scalar->kind == PB_SCALAR_INT)
+				return Float4GetDatum((float4) scalar->i);
+			break;
+		case FLOAT8OID:
+			if (scalar->kind == PB_SCALAR_FLOAT || scalar->kind == PB_SCALAR_DOUBLE)
+				return Float8GetDatum(scalar->d);
+			if (scalar->kind == PB_SCALAR_INT)
+				return Float8GetDatum((float8) scalar->i);
+			break;
+		case BOOLOID:
+			if (scalar->kind == PB_SCALAR_BOOL)
+				return BoolGetDatum(scalar->b);
+			break;
+		case NUMERICOID:
+			{
+				Datum		result;
+
+				if (scalar->kind == PB_SCALAR_INT)
+					result = DirectFunctionCall1(int8_numeric, Int64GetDatum(scalar->i));
+				else if (scalar->kind == PB_SCALAR_FLOAT || scalar->kind == PB_SCALAR_DOUBLE)
+					result = DirectFunctionCall1(float8_numeric, Float8GetDatum(scalar->d));
+				else
+					break;
+				if (target->io.attypmod >= 0)
+					result = DirectFunctionCall2(numeric, result, Int32GetDatum(target->io.attypmod));
+				return result;
+			}
+		case TEXTOID:
+			if (scalar->kind == PB_SCALAR_STRING)
+				return PointerGetDatum(cstring_to_text_with_len(scalar->s, scalar->s_l));
+			if (scalar->kind == PB_SCALAR_ENUM)
+				return CStringGetTextDatum(scalar_to_cstring(scalar));
+			break;
+		case BYTEAOID:
+			if (scalar->kind == PB_SCALAR_STRING || scalar->kind == PB_SCALAR_BYTES)
+				return PointerGetDatum(scalar_to_bytea(scalar));
+			break;
+		case JSONBOID:
+			{
+				JsonbParseState *state = NULL;
+
+				return PointerGetDatum(JsonbValueToJsonb(push_scalar_to_jsonb(&state, WJB_ELEM, scalar)));
+			}
+		default:
+			break;
+	}
+
+	return input_function_call(target, scalar_to_cstring(scalar));
+}
+
+/**
+ * Convert a single (non-repeated) value 'v' of 'field' to a Datum of 'target'
+ * type.
+ */
+static Datum
+value_to_datum(ProtobufReader * r, const ProtobufField * field, ProtobufWireValue * v, const ProtobufTarget * target)
+{
+	if (field->type != PB_TYPE_MESSAGE)
+	{
+		ProtobufScalar scalar = decode_scalar(field, v);
+
+		return scalar_to_datum(&scalar, target);
+	}
+
+	if ((target->typid == TIMESTAMPTZOID || target->typid == TIMESTAMPOID) && strcmp(field->message->full_name, PB_TIMESTAMP_MESSAGE) == 0)
+		return timestamp_message_to_datum(r, field->message, v, target);
+
+	Datum		jsonb = value_to_jsonb(r, field, v);
+
+	if (target->typid == JSONBOID)
+		return jsonb;
+	return input_function_call(target, DatumGetCString(DirectFunctionCall1(jsonb_out, jsonb)));
+}
+
+/**
+ * Convert values of a repeated field in 'slot' to a Datum of 'column' type.
+ */
+static Datum
+repeated_values_to_datum(ProtobufReader * r, ProtobufColumn * column, ProtobufSlot * slot)
+{
+	const ProtobufField *field = slot->field;
+
+	if (column->element.typid == InvalidOid || (PointerIsValid(field->message) && field->message->is_map_entry))
+	{
+		Datum		jsonb;
+
+		if (slot->count == 0)
+			jsonb = DirectFunctionCall1(jsonb_in, CStringGetDatum(field->message && field->message->is_map_entry ? "{}" : "[]"));
+		else
+			jsonb = values_to_jsonb(r, field, slot->values, slot->count);
+
+		if (column->target.typid == JSONBOID)
+			return jsonb;
+		return input_function_call(&column->target, DatumGetCString(DirectFunctionCall1(jsonb_out, jsonb)));
+	}
+
+	int			count = slot->count;
+	ProtobufWireValue *values = expand_repeated_values(r, field, slot->values, &count);
+
+	if (count == 0)
+		return PointerGetDatum(construct_empty_array(column->element.typid));
+
+	Datum	   *elements = palloc(sizeof(Datum) * count);
+	int			dims[1] = {count};
+	int			lbs[1] = {1};
+
+	for (int i = 0; i < count; i++)
+		elements[i] = value_to_datum(r, field, &values[i], &column->element);
+
+	return PointerGetDatum(construct_md_array(
+											  elements,
+											  NULL,
+											  1,
+											  dims,
+											  lbs,
+											  column->element.typid,
+											  column->element_typlen,
+											  column->element_typbyval,
+											  column->element_typalign
+											  ));
+}
+
+/*
+ * Deserialization
+ */
+
+/**
+ * Find the field of 'message' corresponding to the attribute 'i'.
+ */
+static ProtobufField *
+find_attribute_field(ProtobufMessage * message, TupleDesc tupledesc, int i, List *options)
+{
+	DefElem    *field_option = get_column_option(options, i + 1, KADB_SETTING_PROTOBUF_FIELD);
+	const char *reference = PointerIsValid(field_option) ? defGetString(field_option) : NameStr(tupledesc->attrs[i]->attname);
+	int32		number = PointerIsValid(field_option) ? parse_field_reference(reference) : 0;
+	ProtobufField *result = number > 0 ? get_field_by_number(message, number) : get_field_by_name(message, reference);
+
+	if (!PointerIsValid(result))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: Protobuf message type '%s' has no field '%s' for attribute \"%s\"", message->full_name, reference, NameStr(tupledesc->attrs[i]->attname))));
+	if (result->type == PB_TYPE_GROUP)
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED), errmsg("Kafka-ADB: Protobuf field '%s' is a group; groups are not supported", result->name)));
+
+	return result;
+}
+
+ProtobufDeserializationState
+prepare_deserialization_protobuf(TupleDesc tupledesc, List *options)
+{
+	ProtobufDeserializationState result = palloc0(sizeof(struct ProtobufDeserializationStateObject));
+
+	/* The descriptor set file is read on master and passed in an internal option */
+	DefElem    *descriptor_set_option = get_option(options, KADB_SETTING__PROTOBUF_DESCRIPTOR_SET);
+
+	if (!PointerIsValid(descriptor_set_option))
+		descriptor_set_option = get_option(options, KADB_SETTING_PROTOBUF_DESCRIPTOR_SET);
+
+	ProtobufDescriptorPool *pool = parse_descriptor_set(decode_base64(defGetString(descriptor_set_option)));
+
+	result->message = resolve_message(pool, defGetString(get_option(options, KADB_SETTING_PROTOBUF_MESSAGE)));
+	result->tupledesc = tupledesc;
+	result->adis = (AttributeDeserializationInfo *) palloc(sizeof(AttributeDeserializationInfo) * tupledesc->natts);
+	result->columns = (ProtobufColumn *) palloc0(sizeof(ProtobufColumn) * tupledesc->natts);
+	result->slots = (ProtobufSlot *) palloc0(sizeof(ProtobufSlot) * Max(tupledesc->natts, 1));
+	result->slot_by_field = (int *) palloc(sizeof(int) * Max(result->message->fields_count, 1));
+	result->message_data = NULL;
+	result->message_data_l = 0;
+	result->is_pending = false;
+
+	for (int i = 0; i < result->message->fields_count; i++)
+		result->slot_by_field[i] = -1;
+
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		fill_attribute_deserialization_info(&result->adis[i], tupledesc, i, options);
+		if (result->adis[i].is_dropped)
+			continue;
+
+		/* Mapping is checked for all attributes, to report errors early */
+		ProtobufField *field = find_attribute_field(result->message, tupledesc, i, options);
+
+		if (result->adis[i].is_skipped)
+			continue;
+
+		ProtobufColumn *column = &result->columns[i];
+		int			field_index = field - result->message->fields;
+
+		column->target.typid = tupledesc->attrs[i]->atttypid;
+		column->target.io = result->adis[i].io_fn_textual;
+
+		column->element.typid = field->is_repeated ? get_element_type(column->target.typid) : InvalidOid;
+		if (column->element.typid != InvalidOid)
+		{
+			Oid			element_input_fn;
+
+			get_typlenbyvalalign(column->element.typid, &column->element_typlen, &column->element_typbyval, &column->element_typalign);
+			getTypeInputInfo(column->element.typid, &element_input_fn, &column->element.io.typioparam);
+			fmgr_info(element_input_fn, &column->element.io.iofunc);
+			column->element.io.attypmod = tupledesc->attrs[i]->atttypmod;
+			set_fast_input_function(&column->element.io, column->element.typid);
+		}
+
+		if (result->slot_by_field[field_index] < 0)
+		{
+			ProtobufSlot *slot = &result->slots[result->slots_count];
+
+			slot->field = field;
+			slot->capacity = field->is_repeated ? PB_SLOT_INITIAL_CAPACITY : 1;
+			slot->values = palloc(sizeof(ProtobufWireValue) * slot->capacity);
+			result->slot_by_field[field_index] = result->slots_count;
+			result->slots_count += 1;
+		}
+		column->slot = result->slot_by_field[field_index];
+	}
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_protobuf") == FaultInjectorTypeSkip)
+		result->data = decode_base64(defGetString(get_option(options, KADB_SETTING_PROTOBUF_DATA_ON_INJECT)));
+#endif
+
+	return result;
+}
+
+void
+begin_deserialization_protobuf(ProtobufDeserializationState state, void *data, size_t data_l)
+{
+	AssertArg(PointerIsValid(state));
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_protobuf") == FaultInjectorTypeSkip)
+	{
+		data = VARDATA_ANY(state->data);
+		data_l = VARSIZE_ANY_EXHDR(state->data);
+	}
+#endif
+
+	state->message_data = (const uint8 *) data;
+	state->message_data_l = PointerIsValid(data) ? data_l : 0;
+	state->is_pending = true;
+}
+
+bool
+deserialize_next_protobuf(ProtobufDeserializationState state, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(state));
+
+	if (!state->is_pending)
+		return false;
+	state->is_pending = false;
+
+	/* An empty message is valid: all its fields are absent */
+	ProtobufReader r = {
+		.start = state->message_data,
+		.p = state->message_data,
+		.end = state->message_data + state->message_data_l,
+		.what = "message"
+	};
+	int32		number;
+	ProtobufWireValue v;
+
+	for (int i = 0; i < state->slots_count; i++)
+		state->slots[i].count = 0;
+
+	/* Collect values of the referenced fields */
+	while (read_field(&r, &number, &v))
+	{
+		ProtobufField *field = get_field_by_number(state->message, number);
+
+		if (!PointerIsValid(field))
+			continue;
+
+		int			slot_index = state->slot_by_field[field - state->message->fields];
+
+		if (slot_index < 0)
+			continue;
+
+		ProtobufSlot *slot = &state->slots[slot_index];
+
+		check_wire_type(&r, field, &v);
+		if (!field->is_repeated)
+		{
+			/* The last value wins */
+			slot->values[0] = v;
+			slot->count = 1;
+			continue;
+		}
+		if (slot->count == slot->capacity)
+		{
+			slot->capacity *= 2;
+			slot->values = repalloc(slot->values, sizeof(ProtobufWireValue) * slot->capacity);
+		}
+		slot->values[slot->count] = v;
+		slot->count += 1;
+	}
+
+	/* Convert values */
+	for (int i = 0; i < state->tupledesc->natts; i++)
+	{
+		nulls[i] = true;
+		if (state->adis[i].is_skipped)
+			continue;
+
+		ProtobufColumn *column = &state->columns[i];
+		ProtobufSlot *slot = &state->slots[column->slot];
+
+		if (slot->field->is_repeated)
+		{
+			values[i] = repeated_values_to_datum(&r, column, slot);
+			nulls[i] = false;
+			continue;
+		}
+
+		ProtobufWireValue value;
+
+		if (slot->count > 0)
+			value = slot->values[0];
+		else if (!slot->field->has_presence)
+			value = default_wire_value(slot->field);
+		else
+			continue;
+
+		values[i] = value_to_datum(&r, slot->field, &value, &column->target);
+		nulls[i] = false;
+	}
+
+	return true;
+}
+
+
+/*
+ * Callbacks of the format
+ */
+
+/**
+ * Parse (change types, if necessary) and validate settings for PROTOBUF
+ * deserialization format.
+ *
+ * @param check_required 'true' if the completeness of the set of 'options'
+ * must be checked, i.e. that all required options are provided.
+ */
+static void
+validate_options_protobuf(List *options, bool check_required)
+{
+	DefElem    *descriptor_set = get_option(options, KADB_SETTING_PROTOBUF_DESCRIPTOR_SET);
+	DefElem    *descriptor_set_file = get_option(options, KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE);
+	DefElem    *message = get_option(options, KADB_SETTING_PROTOBUF_MESSAGE);
+
+	if (PointerIsValid(descriptor_set) && PointerIsValid(descriptor_set_file))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' and '%s' OPTIONs cannot be set simultaneously", KADB_SETTING_PROTOBUF_DESCRIPTOR_SET, KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE)));
+
+	if (check_required)
+	{
+		if (!PointerIsValid(descriptor_set) && !PointerIsValid(descriptor_set_file))
+			ereport(ERROR, (errcode(ERRCODE_FDW_DYNAMIC_PARAMETER_VALUE_NEEDED), errmsg("Kafka-ADB: '%s' or '%s' is required", KADB_SETTING_PROTOBUF_DESCRIPTOR_SET, KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE)));
+		if (!PointerIsValid(message))
+			ereport(ERROR, (errcode(ERRCODE_FDW_DYNAMIC_PARAMETER_VALUE_NEEDED), errmsg("Kafka-ADB: '%s' is required", KADB_SETTING_PROTOBUF_MESSAGE)));
+	}
+
+	/* The descriptor set file is validated when it is read */
+	if (PointerIsValid(descriptor_set) && PointerIsValid(message))
+		validate_protobuf_descriptor_set(defGetString(descriptor_set), defGetString(message));
+}
+
+static void *
+prepare_protobuf(TupleDesc tupledesc, List *options)
+{
+	return prepare_deserialization_protobuf(tupledesc, options);
+}
+
+static void
+begin_protobuf(void *state, void *data, size_t data_l)
+{
+	begin_deserialization_protobuf((ProtobufDeserializationState) state, data, data_l);
+}
+
+static bool
+next_protobuf(void *state, Datum *values, bool *nulls)
+{
+	return deserialize_next_protobuf((ProtobufDeserializationState) state, values, nulls);
+}
+
+static const char *const ProtobufOptions[] = {
+	KADB_SETTING_PROTOBUF_DESCRIPTOR_SET,
+	KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE,
+	KADB_SETTING_PROTOBUF_MESSAGE,
+	NULL
+};
+
+static const char *const ProtobufColumnOptions[] = {
+	KADB_SETTING_PROTOBUF_FIELD,
+	NULL
+};
+
+const DeserializationFormatRoutine ProtobufDeserializationFormat = {
+	.api_version = KADB_DESERIALIZATION_FORMAT_API_VERSION,
+	.name = "protobuf",
+	.options = ProtobufOptions,
+	.column_options = ProtobufColumnOptions,
+	.validate_options = validate_options_protobuf,
+	.prepare = prepare_protobuf,
+	.begin = begin_protobuf,
+	.next = next_protobuf,
+	.finish = NULL,
+	.estimate_cost = NULL,
+	.prepare_decode = NULL,
+	.decode = NULL,
+	.begin_decoded = NULL,
+	.discard_decoded = NULL
+};
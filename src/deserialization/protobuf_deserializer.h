@@ -0,0 +1,74 @@
+#ifndef KADB_FDW_DESERIALIZATION_PROTOBUF_DESERIALIZER_INCLUDED
+#define KADB_FDW_DESERIALIZATION_PROTOBUF_DESERIALIZER_INCLUDED
+
+/*
+ * Protocol Buffers deserialization implementation.
+ *
+ * Each message is a single record (tuple), encoded in protobuf wire format.
+ * The structure of records is described by a compiled FileDescriptorSet
+ * (produced by 'protoc --include_imports --descriptor_set_out') and the name
+ * of a message type defined in it.
+ *
+ * Each attribute corresponds to a field of the message type (by default, the
+ * field with the same name as the attribute). The wire format is decoded
+ * directly, without any protobuf runtime library.
+ */
+
+#include <postgres.h>
+
+#include <access/tupdesc.h>
+
+#include "deserialization/format.h"
+
+
+/* An opaque struct to store protobuf deserialization runtime state */
+typedef struct ProtobufDeserializationStateObject *ProtobufDeserializationState;
+
+
+/**
+ * Check that base64-encoded 'descriptor_set' is a valid FileDescriptorSet,
+ * and that message type 'message_name' is defined in it.
+ *
+ * Errors are reported by 'ereport(ERROR)'.
+ */
+void		validate_protobuf_descriptor_set(const char *descriptor_set, const char *message_name);
+
+/**
+ * Validate a reference to a protobuf field: a field name or a field number.
+ *
+ * Errors are reported by 'ereport(ERROR)'.
+ */
+void		validate_protobuf_field_reference(const char *reference);
+
+/**
+ * Read a FileDescriptorSet from the file at 'path'.
+ *
+ * @return base64-encoded contents of the file
+ */
+char	   *read_protobuf_descriptor_set_file(const char *path);
+
+/**
+ * Prepare to deserialize protobuf data.
+ */
+ProtobufDeserializationState prepare_deserialization_protobuf(TupleDesc tupledesc, List *options);
+
+/**
+ * Start to deserialize binary 'data' of length 'data_l' from protobuf format.
+ * The message always produces exactly one record.
+ */
+void		begin_deserialization_protobuf(ProtobufDeserializationState state, void *data, size_t data_l);
+
+/**
+ * Deserialize the next record into 'values' and 'nulls'.
+ *
+ * @return 'false' if there are no more records in the message
+ */
+bool		deserialize_next_protobuf(ProtobufDeserializationState state, Datum *values, bool *nulls);
+
+
+/* Callbacks of the format */
+extern const DeserializationFormatRoutine ProtobufDeserializationFormat;
+
+#endif   /* //
+								 * KADB_FDW_DESERIALIZATION_PROTOBUF_DESERIALIZER_I
+								 * NCLUDED */
@@ -0,0 +1,187 @@
+#include "raw_deserializer.h"
+
+#include <catalog/pg_type.h>
+#include <mb/pg_wchar.h>
+#include <utils/memutils.h>
+
+#include "settings.h"
+#include "deserialization/attribute_postgres.h"
+#include "deserialization/message_encoding.h"
+
+
+typedef struct RawDeserializationStateObject
+{
+	AttributeDeserializationInfo adi;
+	TupleDesc	tupledesc;
+	/* Type of the only attribute */
+	Oid			typid;
+	/* A buffer to null-terminate values passed to the input function */
+	StringInfoData buffer;
+	/* The encoding of messages, or NULL if it is not set or not applicable */
+	MessageEncoding encoding;
+
+	/* The CURRENT message */
+	const char *message;
+	size_t		message_l;
+	/* Whether the record of the CURRENT message is not yet returned */
+	bool		is_pending;
+#ifdef FAULT_INJECTOR
+	/* Raw data to use for tests */
+	bytea	   *data;
+#endif
+}	RawDeserializationStateObject;
+
+
+RawDeserializationState
+prepare_deserialization_raw(TupleDesc tupledesc, List *options)
+{
+	RawDeserializationState result = palloc(sizeof(RawDeserializationStateObject));
+
+	/* Ensure the table definition contains exactly one attribute */
+	if (tupledesc->natts != 1)
+		ereport(ERROR, (errcode(ERRCODE_FDW_ERROR), errmsg("Kafka-ADB: 'raw' format can only be applied to a table with a single attribute (column)")));
+
+	fill_attribute_deserialization_info(&result->adi, tupledesc, 0, options);
+
+	if (result->adi.is_dropped)
+		ereport(ERROR, (errcode(ERRCODE_FDW_ERROR), errmsg("Kafka-ADB: 'raw' format can only be applied to a table with a single attribute (column)")));
+
+	result->tupledesc = tupledesc;
+	result->typid = tupledesc->attrs[0]->atttypid;
+
+	if (result->typid != BYTEAOID && result->typid != TEXTOID && result->typid != JSONBOID)
+		ereport(ERROR, (errcode(ERRCODE_FDW_ERROR), errmsg("Kafka-ADB: 'raw' format can only be applied to a column of type BYTEA, TEXT, or JSONB, not %s", format_type_be(result->typid))));
+
+	initStringInfo(&result->buffer);
+	/* BYTEA values are not text */
+	result->encoding = result->typid != BYTEAOID ? prepare_message_encoding(options) : NULL;
+
+	result->message = NULL;
+	result->message_l = 0;
+	result->is_pending = false;
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_raw") == FaultInjectorTypeSkip)
+		result->data = DatumGetByteaP(DirectFunctionCall2(binary_decode, CStringGetTextDatum(defGetString(get_option(options, KADB_SETTING_RAW_DATA_ON_INJECT))), CStringGetTextDatum("base64")));
+#endif
+
+	return result;
+}
+
+void
+begin_deserialization_raw(RawDeserializationState state, void *data, size_t data_l)
+{
+	AssertArg(PointerIsValid(state));
+
+#ifdef FAULT_INJECTOR
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_raw") == FaultInjectorTypeSkip)
+	{
+		data = VARDATA_ANY(state->data);
+		data_l = VARSIZE_ANY_EXHDR(state->data);
+	}
+#endif
+
+	state->message = (const char *) to_database_encoding(state->encoding, data, &data_l);
+	state->message_l = data_l;
+	state->is_pending = true;
+}
+
+bool
+deserialize_next_raw(RawDeserializationState state, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(state));
+
+	if (!state->is_pending)
+		return false;
+	state->is_pending = false;
+
+	const char *data = state->message;
+	size_t		data_l = state->message_l;
+
+	nulls[0] = true;
+	if (state->adi.is_skipped || !PointerIsValid(data))
+		return true;
+
+	/* The whole tuple must fit into a single allocation */
+	if (data_l > MaxAllocSize - HEAPTUPLESIZE - MAXALIGN(offsetof(HeapTupleHeaderData, t_bits) + sizeof(Oid)) - VARHDRSZ)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION), errmsg("Kafka-ADB: A message of size %zu is too large for 'raw' format", data_l)));
+
+	switch (state->typid)
+	{
+		case TEXTOID:
+			/* Also rejects NUL bytes, as 'to_database_encoding()' does when the encoding is set */
+			if (!PointerIsValid(state->encoding))
+			{
+				drop_terminating_nul(data, &data_l);
+				pg_verify_mbstr(GetDatabaseEncoding(), data, (int) data_l, false);
+			}
+			/* Fall through */
+		case BYTEAOID:
+			{
+				struct varlena *result = (struct varlena *) palloc(VARHDRSZ + data_l);
+
+				SET_VARSIZE(result, VARHDRSZ + data_l);
+				memcpy(VARDATA(result), data, data_l);
+				nulls[0] = false;
+				values[0] = PointerGetDatum(result);
+			}
+			return true;
+		case JSONBOID:
+			if (data_l > 0)
+			{
+				resetStringInfo(&state->buffer);
+				appendBinaryStringInfo(&state->buffer, data, data_l);
+				nulls[0] = false;
+				values[0] = InputFunctionCall(
+											  &state->adi.io_fn_textual.iofunc,
+											  state->buffer.data,
+											  state->adi.io_fn_textual.typioparam,
+											  state->adi.io_fn_textual.attypmod
+					);
+			}
+			return true;
+		default:
+			Assert(false);
+			return false;
+	}
+}
+
+
+/*
+ * Callbacks of the format
+ */
+
+static void *
+prepare_raw(TupleDesc tupledesc, List *options)
+{
+	return prepare_deserialization_raw(tupledesc, options);
+}
+
+static void
+begin_raw(void *state, void *data, size_t data_l)
+{
+	begin_deserialization_raw((RawDeserializationState) state, data, data_l);
+}
+
+static bool
+next_raw(void *state, Datum *values, bool *nulls)
+{
+	return deserialize_next_raw((RawDeserializationState) state, values, nulls);
+}
+
+const DeserializationFormatRoutine RawDeserializationFormat = {
+	.api_version = KADB_DESERIALIZATION_FORMAT_API_VERSION,
+	.name = "raw",
+	.options = NULL,
+	.column_options = NULL,
+	.validate_options = NULL,
+	.prepare = prepare_raw,
+	.begin = begin_raw,
+	.next = next_raw,
+	.finish = NULL,
+	.estimate_cost = NULL,
+	.prepare_decode = NULL,
+	.decode = NULL,
+	.begin_decoded = NULL,
+	.discard_decoded = NULL
+};
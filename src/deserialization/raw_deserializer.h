@@ -0,0 +1,52 @@
+#ifndef KADB_FDW_DESERIALIZATION_RAW_DESERIALIZER_INCLUDED
+#define KADB_FDW_DESERIALIZATION_RAW_DESERIALIZER_INCLUDED
+
+/*
+ * RAW deserialization implementation.
+ *
+ * 'raw' format maps the content of each Kafka message to a single attribute
+ * of a single tuple, without parsing it. A FOREIGN TABLE with such format must
+ * have exactly one attribute of type BYTEA, TEXT, or JSONB.
+ *
+ * For BYTEA and TEXT attributes, the value is copied from the message buffer
+ * as is. TEXT data is checked to be valid in the database encoding. JSONB data
+ * is passed to the JSONB input function.
+ *
+ * Messages with no content (NULL) are treated as NULLs. Empty messages are
+ * empty values, except for JSONB attributes, for which they are NULLs.
+ */
+
+#include <postgres.h>
+
+#include <access/tupdesc.h>
+
+#include "deserialization/format.h"
+
+
+/* An opaque struct to store RAW deserialization runtime state */
+typedef struct RawDeserializationStateObject *RawDeserializationState;
+
+
+/**
+ * Prepare to deserialize data in 'raw' format.
+ */
+RawDeserializationState prepare_deserialization_raw(TupleDesc tupledesc, List *options);
+
+/**
+ * Start to deserialize binary 'data' of length 'data_l' stored in 'raw'
+ * format. The message always produces exactly one record.
+ */
+void		begin_deserialization_raw(RawDeserializationState state, void *data, size_t data_l);
+
+/**
+ * Deserialize the next record into 'values' and 'nulls'.
+ *
+ * @return 'false' if there are no more records in the message
+ */
+bool		deserialize_next_raw(RawDeserializationState state, Datum *values, bool *nulls);
+
+
+/* Callbacks of the format */
+extern const DeserializationFormatRoutine RawDeserializationFormat;
+
+#endif   /* KADB_FDW_DESERIALIZATION_RAW_DESERIALIZER_INCLUDED */
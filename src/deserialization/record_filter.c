@@ -0,0 +1,207 @@
+#include "record_filter.h"
+
+#include <catalog/pg_proc.h>
+#include <fmgr.h>
+#include <nodes/nodeFuncs.h>
+#include <utils/lsyscache.h>
+
+#include "settings.h"
+
+
+/**
+ * A kind of a condition of a record filter.
+ */
+typedef enum RecordFilterConditionKind
+{
+	CONDITION_OPERATOR,			/* column OP constant, or constant OP column */
+	CONDITION_IS_NULL,
+	CONDITION_IS_NOT_NULL
+}	RecordFilterConditionKind;
+
+/**
+ * A single condition of a record filter.
+ */
+typedef struct RecordFilterCondition
+{
+	RecordFilterConditionKind kind;
+	/* The index of the attribute the condition checks */
+	int			attidx;
+
+	/*
+	 * For operators: the call of the operator function. The constant operand
+	 * is set once; the argument at 'attarg' is set for each record
+	 */
+	FmgrInfo	flinfo;
+	FunctionCallInfoData fcinfo;
+	int			attarg;
+	/* For operators: whether the constant operand is NULL */
+	bool		const_is_null;
+}	RecordFilterCondition;
+
+/* Definition is in the header */
+struct RecordFilterObject
+{
+	RecordFilterCondition *conditions;
+	int			conditions_count;
+};
+
+
+/**
+ * @return the attribute of the relation with the given 'varno' which 'node'
+ * is, looking through binary-compatible casts, or NULL if 'node' is not one
+ */
+static Var *
+get_attribute_var(Node *node, Index varno)
+{
+	while (IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+
+	if (!IsA(node, Var))
+		return NULL;
+
+	Var		   *var = (Var *) node;
+
+	if (var->varno != varno || var->varlevelsup != 0 || var->varattno <= 0)
+		return NULL;
+	return var;
+}
+
+bool
+is_record_filter_clause(Expr *clause, Index varno, AttrNumber *attnum)
+{
+	Var		   *var = NULL;
+
+	if (IsA(clause, OpExpr))
+	{
+		OpExpr	   *op = (OpExpr *) clause;
+
+		if (list_length(op->args) != 2)
+			return false;
+		set_opfuncid(op);
+		/* A strict function is not called for NULL operands, as the executor does */
+		if (!func_strict(op->opfuncid) || func_volatile(op->opfuncid) == PROVOLATILE_VOLATILE)
+			return false;
+
+		Node	   *left = (Node *) linitial(op->args);
+		Node	   *right = (Node *) lsecond(op->args);
+
+		if (IsA(right, Const))
+			var = get_attribute_var(left, varno);
+		else if (IsA(left, Const))
+			var = get_attribute_var(right, varno);
+	}
+	else if (IsA(clause, NullTest))
+	{
+		NullTest   *test = (NullTest *) clause;
+
+		/* Row-wise tests check each field of a composite value */
+		if (!test->argisrow)
+			var = get_attribute_var((Node *) test->arg, varno);
+	}
+
+	if (!PointerIsValid(var))
+		return false;
+	*attnum = var->varattno;
+	return true;
+}
+
+/**
+ * Fill 'condition' to evaluate 'clause', which is checked by
+ * 'is_record_filter_clause()'.
+ */
+static void
+prepare_condition(RecordFilterCondition * condition, Expr *clause)
+{
+	AttrNumber	attnum;
+
+	if (!is_record_filter_clause(clause, RECORD_FILTER_VARNO, &attnum))
+		elog(ERROR, "Kafka-ADB: Unsupported early qual: node type %d", (int) nodeTag(clause));
+	condition->attidx = attnum - 1;
+
+	if (IsA(clause, NullTest))
+	{
+		condition->kind = ((NullTest *) clause)->nulltesttype == IS_NULL ? CONDITION_IS_NULL : CONDITION_IS_NOT_NULL;
+		return;
+	}
+
+	OpExpr	   *op = (OpExpr *) clause;
+	Const	   *constant = IsA(linitial(op->args), Const) ? (Const *) linitial(op->args) : (Const *) lsecond(op->args);
+
+	condition->kind = CONDITION_OPERATOR;
+	condition->attarg = IsA(linitial(op->args), Const) ? 1 : 0;
+	condition->const_is_null = constant->constisnull;
+
+	fmgr_info(op->opfuncid, &condition->flinfo);
+	InitFunctionCallInfoData(condition->fcinfo, &condition->flinfo, 2, op->inputcollid, NULL, NULL);
+	condition->fcinfo.arg[1 - condition->attarg] = constant->constvalue;
+	condition->fcinfo.argnull[0] = false;
+	condition->fcinfo.argnull[1] = false;
+}
+
+RecordFilter
+prepare_record_filter(TupleDesc tupledesc, List *options)
+{
+	DefElem    *early_quals = get_option(options, KADB_SETTING__EARLY_QUALS);
+
+	if (!PointerIsValid(early_quals) || list_length((List *) early_quals->arg) == 0)
+		return NULL;
+
+	RecordFilter result = palloc(sizeof(struct RecordFilterObject));
+	ListCell   *it;
+	int			i = 0;
+
+	result->conditions_count = list_length((List *) early_quals->arg);
+	result->conditions = palloc0(sizeof(RecordFilterCondition) * result->conditions_count);
+
+	foreach(it, (List *) early_quals->arg)
+	{
+		prepare_condition(&result->conditions[i], (Expr *) lfirst(it));
+		if (result->conditions[i].attidx >= tupledesc->natts)
+			elog(ERROR, "Kafka-ADB: Early qual references attribute %d of %d", result->conditions[i].attidx + 1, tupledesc->natts);
+		i += 1;
+	}
+
+	return result;
+}
+
+bool
+record_filter_passes(RecordFilter filter, Datum *values, bool *nulls)
+{
+	if (!PointerIsValid(filter))
+		return true;
+
+	for (int i = 0; i < filter->conditions_count; i++)
+	{
+		RecordFilterCondition *condition = &filter->conditions[i];
+		bool		isnull = nulls[condition->attidx];
+
+		switch (condition->kind)
+		{
+			case CONDITION_IS_NULL:
+				if (!isnull)
+					return false;
+				break;
+			case CONDITION_IS_NOT_NULL:
+				if (isnull)
+					return false;
+				break;
+			case CONDITION_OPERATOR:
+				{
+					/* The result of a strict function of NULL is NULL, i.e. not 'true' */
+					if (isnull || condition->const_is_null)
+						return false;
+
+					condition->fcinfo.arg[condition->attarg] = values[condition->attidx];
+					condition->fcinfo.isnull = false;
+
+					Datum		result = FunctionCallInvoke(&condition->fcinfo);
+
+					if (condition->fcinfo.isnull || !DatumGetBool(result))
+						return false;
+				}
+				break;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,55 @@
+#ifndef KADB_FDW_DESERIALIZATION_RECORD_FILTER_INCLUDED
+#define KADB_FDW_DESERIALIZATION_RECORD_FILTER_INCLUDED
+
+/*
+ * Early evaluation of simple conditions of a query on deserialized records.
+ *
+ * The planner passes conditions of the forms 'column OP constant', 'constant
+ * OP column', 'column IS NULL', and 'column IS NOT NULL' (where 'OP' is a
+ * strict, non-volatile operator) to the deserializer instead of the executor.
+ * Records which do not satisfy them are discarded right after they are
+ * deserialized: no tuples are formed for them.
+ */
+
+#include <postgres.h>
+
+#include <access/tupdesc.h>
+#include <nodes/pg_list.h>
+#include <nodes/primnodes.h>
+
+
+/*
+ * 'varno' of Vars in conditions passed to the deserializer. Only attributes of
+ * the scanned relation are referenced by them
+ */
+#define RECORD_FILTER_VARNO 1
+
+
+/* An opaque struct to store a record filter */
+typedef struct RecordFilterObject *RecordFilter;
+
+
+/**
+ * Check whether 'clause' of a scan of the relation with the given 'varno' can
+ * be evaluated by a record filter.
+ *
+ * @param attnum set to the attribute number referenced by the clause
+ */
+bool		is_record_filter_clause(Expr *clause, Index varno, AttrNumber *attnum);
+
+/**
+ * Prepare to evaluate the conditions in the internal option
+ * 'KADB_SETTING__EARLY_QUALS' on records of 'tupledesc'.
+ *
+ * @return NULL if there are no such conditions
+ */
+RecordFilter prepare_record_filter(TupleDesc tupledesc, List *options);
+
+/**
+ * Check whether a record of 'values' and 'nulls' satisfies all conditions of
+ * 'filter' (which may be NULL).
+ */
+bool		record_filter_passes(RecordFilter filter, Datum *values, bool *nulls);
+
+
+#endif   /* KADB_FDW_DESERIALIZATION_RECORD_FILTER_INCLUDED */
@@ -4,12 +4,25 @@
 
 #include "settings.h"
 #include "deserialization/attribute_postgres.h"
+#include "deserialization/message_encoding.h"
 
 
 struct TextDeserializationState
 {
 	AttributeDeserializationInfo adi;
 	TupleDesc	tupledesc;
+	/* Each line of a message is a separate tuple */
+	bool		split_lines;
+	/* A buffer to null-terminate values passed to the generic input function */
+	StringInfoData buffer;
+	/* The encoding of messages, or NULL if it is not set */
+	MessageEncoding encoding;
+
+	/* The rest of the CURRENT message */
+	const char *p;
+	const char *end;
+	/* Whether the CURRENT message (not split into lines) is not yet returned */
+	bool		is_pending;
 #ifdef FAULT_INJECTOR
 	/* Raw data to use for tests */
 	char	   *data;
@@ -26,13 +39,23 @@ prepare_deserialization_text(TupleDesc tupledesc, List *options)
 	if (tupledesc->natts != 1)
 		ereport(ERROR, (errcode(ERRCODE_FDW_ERROR), errmsg("Kafka-ADB: 'text' format can only be applied to a table with a single attribute (column)")));
 
-	fill_attribute_deserialization_info(&result->adi, tupledesc, 0);
+	fill_attribute_deserialization_info(&result->adi, tupledesc, 0, options);
 
 	if (result->adi.is_dropped)
 		ereport(ERROR, (errcode(ERRCODE_FDW_ERROR), errmsg("Kafka-ADB: 'text' format can only be applied to a table with a single attribute (column)")));
 
 	result->tupledesc = tupledesc;
 
+	DefElem    *split_lines = get_option(options, KADB_SETTING_TEXT_LINES);
+
+	result->split_lines = PointerIsValid(split_lines) ? defGetBoolean(split_lines) : false;
+
+	initStringInfo(&result->buffer);
+	result->encoding = prepare_message_encoding(options);
+
+	result->p = result->end = NULL;
+	result->is_pending = false;
+
 #ifdef FAULT_INJECTOR
 	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_text") == FaultInjectorTypeSkip)
 	{
@@ -47,8 +70,44 @@ prepare_deserialization_text(TupleDesc tupledesc, List *options)
 	return result;
 }
 
-List *
-deserialize_text(TextDeserializationState state, void *data, size_t data_l)
+/**
+ * Convert a 'value' of length 'value_l' to the record 'values' and 'nulls'.
+ * 'value' need not be null-terminated; an empty value is NULL.
+ */
+static void
+input_text_value(TextDeserializationState state, const char *value, size_t value_l, Datum *values, bool *nulls)
+{
+	if (state->adi.is_skipped || value_l < 1)
+	{
+		nulls[0] = true;
+	}
+	else if (value_cache_lookup(state->adi.value_cache, value, value_l, &values[0]))
+	{
+		nulls[0] = false;
+	}
+	else if (fast_input_function_call(&state->adi.io_fn_textual, value, value_l, &values[0]))
+	{
+		nulls[0] = false;
+		value_cache_insert(state->adi.value_cache, value, value_l, values[0]);
+	}
+	else
+	{
+		nulls[0] = false;
+
+		resetStringInfo(&state->buffer);
+		appendBinaryStringInfo(&state->buffer, value, value_l);
+		values[0] = InputFunctionCall(
+									  &state->adi.io_fn_textual.iofunc,
+									  state->buffer.data,
+									  state->adi.io_fn_textual.typioparam,
+									  state->adi.io_fn_textual.attypmod
+			);
+		value_cache_insert(state->adi.value_cache, value, value_l, values[0]);
+	}
+}
+
+void
+begin_deserialization_text(TextDeserializationState state, void *data, size_t data_l)
 {
 	AssertArg(PointerIsValid(state));
 
@@ -60,28 +119,104 @@ deserialize_text(TextDeserializationState state, void *data, size_t data_l)
 	}
 #endif
 
-	Datum		values[1];
-	bool		nulls[1];
+	/* The data ends at the first NUL byte, if any */
+	if (PointerIsValid(data))
+		data_l = strnlen((const char *) data, data_l);
+	else
+		data_l = 0;
+	data = to_database_encoding(state->encoding, data, &data_l);
+
+	state->p = (const char *) data;
+	state->end = state->p + data_l;
+	state->is_pending = !state->split_lines;
+}
+
+bool
+deserialize_next_text(TextDeserializationState state, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(state));
 
-	if (!PointerIsValid(data) || data_l < 1 || strlen((char *) data) < 1)
+	if (!state->split_lines)
 	{
-		nulls[0] = true;
+		if (!state->is_pending)
+			return false;
+		state->is_pending = false;
+		input_text_value(state, state->p, state->end - state->p, values, nulls);
+		return true;
 	}
+
+	if (state->p >= state->end)
+		return false;
+
+	const char *p = state->p;
+	const char *line_end = memchr(p, '\n', state->end - p);
+
+	if (PointerIsValid(line_end))
+		state->p = line_end + 1;
 	else
-	{
-		nulls[0] = false;
-		StringInfo	buffer = makeStringInfo();
+		line_end = state->p = state->end;
 
-		appendStringInfoString(buffer, (char *) data);
-		values[0] = InputFunctionCall(
-									  &state->adi.io_fn_textual.iofunc,
-									  buffer->data,
-									  state->adi.io_fn_textual.typioparam,
-									  state->adi.io_fn_textual.attypmod
-			);
-		pfree(buffer->data);
-		pfree(buffer);
-	}
+	if (line_end > p && line_end[-1] == '\r')
+		line_end -= 1;
 
-	return list_make1(heap_form_tuple(state->tupledesc, values, nulls));
+	input_text_value(state, p, line_end - p, values, nulls);
+	return true;
 }
+
+
+/*
+ * Callbacks of the format
+ */
+
+/**
+ * Parse (change types, if necessary) and validate settings for TEXT
+ * deserialization format.
+ */
+static void
+validate_options_text(List *options, bool check_required)
+{
+	DefElem    *lines = get_option(options, KADB_SETTING_TEXT_LINES);
+
+	if (PointerIsValid(lines))
+		defGetBoolean(lines);
+}
+
+static void *
+prepare_text(TupleDesc tupledesc, List *options)
+{
+	return prepare_deserialization_text(tupledesc, options);
+}
+
+static void
+begin_text(void *state, void *data, size_t data_l)
+{
+	begin_deserialization_text((TextDeserializationState) state, data, data_l);
+}
+
+static bool
+next_text(void *state, Datum *values, bool *nulls)
+{
+	return deserialize_next_text((TextDeserializationState) state, values, nulls);
+}
+
+static const char *const TextOptions[] = {
+	KADB_SETTING_TEXT_LINES,
+	NULL
+};
+
+const DeserializationFormatRoutine TextDeserializationFormat = {
+	.api_version = KADB_DESERIALIZATION_FORMAT_API_VERSION,
+	.name = "text",
+	.options = TextOptions,
+	.column_options = NULL,
+	.validate_options = validate_options_text,
+	.prepare = prepare_text,
+	.begin = begin_text,
+	.next = next_text,
+	.finish = NULL,
+	.estimate_cost = NULL,
+	.prepare_decode = NULL,
+	.decode = NULL,
+	.begin_decoded = NULL,
+	.discard_decoded = NULL
+};
@@ -11,12 +11,20 @@
  *
  * Empty messages are treated as NULLs. This makes it possible for the user to
  * count them.
+ *
+ * If KADB_SETTING_TEXT_LINES is set, each line of a message (terminated by
+ * LF or CRLF) is a separate tuple instead. Empty lines are NULLs; an empty
+ * message produces no tuples.
+ *
+ * In both modes, the data of a message ends at the first NUL byte, if any.
  */
 
 #include <postgres.h>
 
 #include <access/tupdesc.h>
 
+#include "deserialization/format.h"
+
 
 typedef struct TextDeserializationState *TextDeserializationState;
 
@@ -26,16 +34,23 @@ typedef struct TextDeserializationState *TextDeserializationState;
 TextDeserializationState prepare_deserialization_text(TupleDesc tupledesc, List *options);
 
 /**
- * Deserialize 'data' of length 'data_l' stored in format TEXT and return the
- * resulting list of tuples.
+ * Start to deserialize 'data' of length 'data_l' stored in format TEXT.
  *
- * The resulting list always contains exactly one tuple.
+ * Unless lines are split, the message always produces exactly one record. If
+ * 'data' is NULL or an empty string, this record is NULL.
+ */
+void		begin_deserialization_text(TextDeserializationState state, void *data, size_t data_l);
+
+/**
+ * Deserialize the next record into 'values' and 'nulls'.
  *
- * If 'data' is NULL or an empty string, the only tuple in the result is a
- * NULL tuple.
+ * @return 'false' if there are no more records in the message
  */
-List	   *deserialize_text(TextDeserializationState state, void *data, size_t data_l);
+bool		deserialize_next_text(TextDeserializationState state, Datum *values, bool *nulls);
+
 
+/* Callbacks of the format */
+extern const DeserializationFormatRoutine TextDeserializationFormat;
 
 #endif   /* KADB_FDW_DESERIALIZATION_TEXT_DESERIALIZER_I
 								 * NCLUDED */
@@ -0,0 +1,170 @@
+#include "value_cache.h"
+
+#include <access/hash.h>
+#include <utils/datum.h>
+#include <utils/memutils.h>
+
+
+/* The number of lookups after which the share of hits is checked */
+#define VALUE_CACHE_CHECK_INTERVAL 1024
+/*
+ * A full cache is disabled if less than 1 / VALUE_CACHE_MIN_HIT_SHARE of
+ * lookups in the last VALUE_CACHE_CHECK_INTERVAL ones found a value
+ */
+#define VALUE_CACHE_MIN_HIT_SHARE 4
+
+
+/**
+ * A slot of the hash table of a cache. 'value' is NULL in empty slots.
+ */
+typedef struct ValueCacheEntry
+{
+	char	   *value;
+	size_t		value_l;
+	uint32		hash;
+	Datum		datum;
+}	ValueCacheEntry;
+
+/* Definition is in the header */
+struct ValueCacheObject
+{
+	/* A memory context for values and Datums */
+	MemoryContext mcxt;
+
+	AttrNumber	attnum;
+	bool		typbyval;
+	int16		typlen;
+
+	/* Open addressing hash table; its size is a power of 2 */
+	ValueCacheEntry *entries;
+	uint32		mask;
+	int			capacity;
+	int			count;
+
+	bool		is_disabled;
+	/* Statistics since the last check of the share of hits */
+	uint32		lookups;
+	uint32		hits;
+};
+
+
+ValueCache
+create_value_cache(int capacity, AttrNumber attnum, bool typbyval, int16 typlen)
+{
+	AssertArg(capacity > 0 && capacity <= VALUE_CACHE_MAX_ENTRIES);
+
+	ValueCache	result = (ValueCache) palloc(sizeof(struct ValueCacheObject));
+
+	result->mcxt = AllocSetContextCreate(
+										 CurrentMemoryContext,
+										 "kadb_fdw value cache",
+										 ALLOCSET_DEFAULT_MINSIZE,
+										 ALLOCSET_DEFAULT_INITSIZE,
+										 ALLOCSET_DEFAULT_MAXSIZE
+		);
+	result->attnum = attnum;
+	result->typbyval = typbyval;
+	result->typlen = typlen;
+
+	/* At least half of the slots are always empty */
+	uint32		size = 1;
+
+	while (size < (uint32) capacity * 2)
+		size <<= 1;
+	result->entries = (ValueCacheEntry *) MemoryContextAllocZero(result->mcxt, sizeof(ValueCacheEntry) * size);
+	result->mask = size - 1;
+	result->capacity = capacity;
+	result->count = 0;
+
+	result->is_disabled = false;
+	result->lookups = 0;
+	result->hits = 0;
+
+	return result;
+}
+
+/**
+ * Find the slot of 'value' of length 'value_l' with the given 'hash': either
+ * the one that holds it, or an empty one.
+ */
+static ValueCacheEntry *
+find_value_cache_entry(ValueCache cache, const char *value, size_t value_l, uint32 hash)
+{
+	for (uint32 i = hash & cache->mask;; i = (i + 1) & cache->mask)
+	{
+		ValueCacheEntry *entry = &cache->entries[i];
+
+		if (!PointerIsValid(entry->value))
+			return entry;
+		if (entry->hash == hash && entry->value_l == value_l && memcmp(entry->value, value, value_l) == 0)
+			return entry;
+	}
+}
+
+/**
+ * Update statistics of the 'cache' after a lookup, and disable the cache if it
+ * is full and few lookups find a value.
+ */
+static void
+account_value_cache_lookup(ValueCache cache, bool is_hit)
+{
+	cache->lookups += 1;
+	if (is_hit)
+		cache->hits += 1;
+
+	if (cache->lookups < VALUE_CACHE_CHECK_INTERVAL)
+		return;
+
+	if (cache->count >= cache->capacity && cache->hits < cache->lookups / VALUE_CACHE_MIN_HIT_SHARE)
+	{
+		/*
+		 * Datums returned earlier may still be referenced, thus the memory of
+		 * the cache is not released until the end of the scan
+		 */
+		cache->is_disabled = true;
+		elog(DEBUG1, "Kafka-ADB: Value cache of attribute %d is disabled: %u hits in the last %u lookups", cache->attnum, cache->hits, cache->lookups);
+	}
+	cache->lookups = 0;
+	cache->hits = 0;
+}
+
+bool
+value_cache_lookup(ValueCache cache, const char *value, size_t value_l, Datum *result)
+{
+	if (!PointerIsValid(cache) || cache->is_disabled)
+		return false;
+
+	uint32		hash = DatumGetUInt32(hash_any((const unsigned char *) value, (int) value_l));
+	ValueCacheEntry *entry = find_value_cache_entry(cache, value, value_l, hash);
+	bool		is_hit = PointerIsValid(entry->value);
+
+	if (is_hit)
+		*result = entry->datum;
+	account_value_cache_lookup(cache, is_hit);
+	return is_hit;
+}
+
+void
+value_cache_insert(ValueCache cache, const char *value, size_t value_l, Datum datum)
+{
+	if (!PointerIsValid(cache) || cache->is_disabled || cache->count >= cache->capacity)
+		return;
+
+	uint32		hash = DatumGetUInt32(hash_any((const unsigned char *) value, (int) value_l));
+	ValueCacheEntry *entry = find_value_cache_entry(cache, value, value_l, hash);
+
+	if (PointerIsValid(entry->value))
+		return;
+
+	MemoryContext old_mcxt = MemoryContextSwitchTo(cache->mcxt);
+
+	entry->datum = datumCopy(datum, cache->typbyval, cache->typlen);
+	entry->value = (char *) palloc(value_l + 1);
+	memcpy(entry->value, value, value_l);
+	entry->value[value_l] = '\0';
+	entry->value_l = value_l;
+	entry->hash = hash;
+	cache->count += 1;
+
+	MemoryContextSwitchTo(old_mcxt);
+}
@@ -0,0 +1,58 @@
+#ifndef KADB_FDW_DESERIALIZATION_VALUE_CACHE_INCLUDED
+#define KADB_FDW_DESERIALIZATION_VALUE_CACHE_INCLUDED
+
+/*
+ * A bounded cache of converted values of a single attribute.
+ *
+ * The cache maps textual representations of values (as passed to an input
+ * function) to Datums the input function returned for them. It is meant for
+ * columns with a few distinct values, which are then converted once.
+ *
+ * The cache holds at most a fixed number of entries; values not in the cache
+ * when it is full are not cached. The cache disables itself when the share of
+ * lookups that find a value is low.
+ */
+
+#include <postgres.h>
+
+
+/* The maximum number of entries of a single cache */
+#define VALUE_CACHE_MAX_ENTRIES 65536
+
+
+/* An opaque struct to store a value cache */
+typedef struct ValueCacheObject *ValueCache;
+
+
+/**
+ * Create a value cache of at most 'capacity' entries for the attribute
+ * 'attnum' of a type with the given 'typbyval' and 'typlen'.
+ *
+ * The cache is allocated by palloc in CurrentMemoryContext, and lives as long
+ * as the context does.
+ */
+ValueCache	create_value_cache(int capacity, AttrNumber attnum, bool typbyval, int16 typlen);
+
+/**
+ * Look up a textual 'value' of length 'value_l' (not necessarily
+ * null-terminated) in the 'cache'.
+ *
+ * @return 'false' if 'cache' is NULL or disabled, or the value is not cached
+ *
+ * @note A Datum passed by reference points to the memory of the cache. It must
+ * not be modified or freed
+ */
+bool		value_cache_lookup(ValueCache cache, const char *value, size_t value_l, Datum *result);
+
+/**
+ * Add a textual 'value' of length 'value_l' converted to 'datum' to the
+ * 'cache', if there is space in it. Both are copied.
+ *
+ * Does nothing if 'cache' is NULL or disabled.
+ */
+void		value_cache_insert(ValueCache cache, const char *value, size_t value_l, Datum datum);
+
+
+#endif   /* //
+								 * KADB_FDW_DESERIALIZATION_VALUE_CACHE_INCLUDED
+								 * */
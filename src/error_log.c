@@ -0,0 +1,141 @@
+#include "error_log.h"
+
+#include <access/heapam.h>
+#include <access/xact.h>
+#include <catalog/namespace.h>
+#include <cdb/cdbvars.h>
+#include <utils/builtins.h>
+#include <utils/lsyscache.h>
+
+#include "utils/kadb_gp_utils.h"
+#include "utils/kadb_assert.h"
+
+
+/* The namespace of tables of FDW extension */
+#define EXTENSION_NAMESPACE "kadb"
+/* Error log table name */
+#define ERROR_LOG_TABLE_NAME "error_log"
+
+/* The number of columns in the error log table */
+#define ERROR_LOG_COLUMNS 6
+
+
+RejectedMessage *
+make_rejected_message(int32_t partition, int64_t offset, const char *error, const void *data, size_t data_l)
+{
+	RejectedMessage *result = palloc(sizeof(RejectedMessage));
+
+	result->partition = partition;
+	result->offset = offset;
+	result->time = GetCurrentTimestamp();
+	result->error = pstrdup(PointerIsValid(error) ? error : "");
+
+	if (PointerIsValid(data))
+	{
+		size_t		length = Min(data_l, ERROR_LOG_DATA_MAX_LENGTH);
+
+		result->data = palloc(VARHDRSZ + length);
+		SET_VARSIZE(result->data, VARHDRSZ + length);
+		memcpy(VARDATA(result->data), data, length);
+	}
+	else
+		result->data = NULL;
+
+	return result;
+}
+
+void
+free_rejected_messages(List *rejected_messages)
+{
+	ListCell   *it;
+
+	foreach(it, rejected_messages)
+	{
+		RejectedMessage *rm = (RejectedMessage *) lfirst(it);
+
+		pfree(rm->error);
+		if (PointerIsValid(rm->data))
+			pfree(rm->data);
+		pfree(rm);
+	}
+	list_free(rejected_messages);
+}
+
+void
+write_error_log(Oid ftoid, List *rejected_messages)
+{
+	ASSERT_EXECUTOR();
+
+	if (list_length(rejected_messages) == 0)
+		return;
+
+	Oid			error_log_oid = get_relname_relid(ERROR_LOG_TABLE_NAME, get_namespace_oid(EXTENSION_NAMESPACE, false));
+
+	if (!OidIsValid(error_log_oid))
+		ereport(ERROR, (errcode(ERRCODE_UNDEFINED_TABLE), errmsg("Kafka-ADB: Error log table %s.%s does not exist", EXTENSION_NAMESPACE, ERROR_LOG_TABLE_NAME), errhint("Update the extension: ALTER EXTENSION kadb_fdw UPDATE")));
+
+	/*
+	 * 'heap_' direct access is used to bypass distribution policy
+	 * limitations, the same way as for the distributed offsets' table.
+	 */
+
+	/* 'heap_' methods leak memory */
+	MemoryContext temporary_insert_context = allocate_temporary_context_with_unique_name("error_log", gp_session_id);
+	MemoryContext oldcontext = MemoryContextSwitchTo(temporary_insert_context);
+
+	PG_TRY();
+	{
+		Relation	error_log = heap_open(error_log_oid, RowExclusiveLock);
+
+		PG_TRY();
+		{
+			HeapTuple  *tuples = (HeapTuple *) palloc(sizeof(HeapTuple) * list_length(rejected_messages));
+
+			ListCell   *it;
+			int			i;
+
+			foreach_with_count(it, rejected_messages, i)
+			{
+				RejectedMessage *rm = (RejectedMessage *) lfirst(it);
+
+				Datum		values[ERROR_LOG_COLUMNS] = {
+					ObjectIdGetDatum(ftoid),
+					Int32GetDatum(rm->partition),
+					Int64GetDatum(rm->offset),
+					TimestampTzGetDatum(rm->time),
+					CStringGetTextDatum(rm->error),
+					PointerGetDatum(rm->data)
+				};
+				bool		nulls[ERROR_LOG_COLUMNS] = {false, false, false, false, false, !PointerIsValid(rm->data)};
+
+				tuples[i] = heap_form_tuple(RelationGetDescr(error_log), values, nulls);
+			}
+
+			heap_multi_insert(
+							  error_log,
+							  tuples, list_length(rejected_messages),
+							  GetCurrentCommandId(true),
+							  0, NULL,
+							  GetCurrentTransactionId()
+				);
+
+			elog(DEBUG1, "Kafka-ADB: Wrote %d rejected messages to error log relation (OID %u)", list_length(rejected_messages), error_log_oid);
+		}
+		PG_CATCH();
+		{
+			heap_close(error_log, RowExclusiveLock);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+		heap_close(error_log, RowExclusiveLock);
+	}
+	PG_CATCH();
+	{
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextDelete(temporary_insert_context);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(temporary_insert_context);
+}
@@ -0,0 +1,59 @@
+#ifndef KADB_FDW_ERROR_LOG_INCLUDED
+#define KADB_FDW_ERROR_LOG_INCLUDED
+
+/*
+ * Error log for Kafka-ADB.
+ *
+ * Messages that fail to be deserialized can be rejected (skipped) instead of
+ * failing the whole SELECT. Rejected messages are recorded in the error log
+ * table: a 'DISTRIBUTED RANDOMLY' table created once when the FDW extension
+ * is installed. Each segment writes its own rejected messages.
+ */
+
+#include <postgres.h>
+
+#include <nodes/pg_list.h>
+#include <utils/timestamp.h>
+
+
+/* The maximum number of bytes of message content recorded in the error log */
+#define ERROR_LOG_DATA_MAX_LENGTH 8192
+/*
+ * The number of rejected messages kept in memory before they are written to
+ * the error log (at most 1 MB of content)
+ */
+#define ERROR_LOG_BATCH_SIZE 128
+
+
+typedef struct RejectedMessage
+{
+	int32_t		partition;
+	int64_t		offset;
+	TimestampTz time;
+	char	   *error;
+	/* Content of the message, truncated to ERROR_LOG_DATA_MAX_LENGTH. May be NULL */
+	bytea	   *data;
+}	RejectedMessage;
+
+
+/**
+ * Make a 'RejectedMessage' in 'CurrentMemoryContext'. 'error' and 'data' (of
+ * length 'data_l') are copied.
+ */
+RejectedMessage *make_rejected_message(int32_t partition, int64_t offset, const char *error, const void *data, size_t data_l);
+
+/**
+ * Free a list of 'RejectedMessage *'s, including their contents.
+ */
+void		free_rejected_messages(List *rejected_messages);
+
+/**
+ * Write rejected messages to the error log table.
+ *
+ * @param ftoid OID of the foreign table
+ * @param rejected_messages a list of 'RejectedMessage *'
+ */
+void		write_error_log(Oid ftoid, List *rejected_messages);
+
+
+#endif   /* KADB_FDW_ERROR_LOG_INCLUDED */
@@ -1,5 +1,7 @@
 #include "execution.h"
 
+#include <inttypes.h>
+
 #include <access/xact.h>
 #include <cdb/cdbvars.h>
 #include <executor/executor.h>
@@ -9,7 +11,9 @@
 #include <utils/memutils.h>
 #include <utils/rel.h>
 
+#include "error_log.h"
 #include "kafka_consumer.h"
+#include "message_metadata.h"
 #include "offsets.h"
 #include "settings.h"
 #include "deserialization/api.h"
@@ -25,6 +29,9 @@
 typedef struct KFdwScanStateSettings
 {
 	int64		timeout_ms;
+	/* -1 if messages are never rejected */
+	int64		reject_limit;
+	bool		log_errors;
 }	KFdwScanStateSettings;
 
 /**
@@ -36,16 +43,69 @@ typedef struct KFdwScanState
 	List	   *partition_offset_pairs_start;	/* At scan start */
 	List	   *partition_offset_pairs; /* Current */
 
+	/*
+	 * Elements of 'partition_offset_pairs' indexed by partition, so that the
+	 * offset of a message is updated in constant time. NULL for partitions
+	 * not assigned to the segment
+	 */
+	PartitionOffsetPair **partition_offset_index;
+	int32		partition_offset_index_size;
+
 	/* librdkafka internal state */
 	KafkaObjects kobj;
 
-	/* Deserialization metadata */
+	/* Deserialization metadata. NULL if all columns are metadata columns */
 	DeserializationMetadata ds_metadata;
+	/* Message metadata columns state. NULL if there are no such columns */
+	MessageMetadataState mm_state;
+	/* Descriptor of the columns filled from the content of messages */
+	TupleDesc	payload_tupledesc;
+
+	/* The message records are produced from; NULL if there is none */
+	rd_kafka_message_t *message;
+	/* The task decoding 'message' until it is opened; NULL if there is none */
+	DecodeTask	message_task;
+
+	/*
+	 * Messages fetched after 'message' to be decoded ahead by worker threads,
+	 * and their tasks. A ring buffer of 'ahead_capacity' entries starting at
+	 * 'ahead_first'; 'ahead_capacity' is 0 if messages are not decoded ahead
+	 */
+	rd_kafka_message_t **ahead_messages;
+	DecodeTask *ahead_tasks;
+	int			ahead_capacity;
+	int			ahead_first;
+	int			ahead_count;
+	/* 'fetch_message()' has no more messages to return */
+	bool		fetch_is_finished;
+	/* Whether the only record of a message with no payload columns is pending */
+	bool		message_record_is_pending;
 
-	/* A list of tuples produced by deserializer and corresponding objects */
-	List	   *prepared_tuples;
-	ListCell   *prepared_tuples_it;
-	MemoryContext prepared_tuples_mcxt;
+	/*
+	 * Records produced by deserializer from the whole message, and the next
+	 * one to return. Used when messages may be rejected, as a message is
+	 * rejected entirely. The array is allocated in 'prepared_records_arena',
+	 * which is reset together with 'message_mcxt'
+	 */
+	DeserializedRecords prepared_records;
+	int			prepared_records_i;
+	KadbArena	prepared_records_arena;
+	/* Memory of the CURRENT message, including values of 'prepared_records' */
+	MemoryContext message_mcxt;
+
+	/*
+	 * Values of payload columns of the CURRENT record. When messages may be
+	 * rejected, they point to an element of 'prepared_records'
+	 */
+	Datum	   *payload_values;
+	bool	   *payload_nulls;
+	/* Memory of the CURRENT record */
+	MemoryContext record_mcxt;
+
+	/* The number of messages rejected */
+	int64		rejected_count;
+	/* 'RejectedMessage *'s to write to the error log */
+	List	   *rejected_messages;
 
 	KFdwScanStateSettings settings;
 }	KFdwScanState;
@@ -59,6 +119,125 @@ typedef struct KFdwScanStateMaster
 }	KFdwScanStateMaster;
 
 
+/**
+ * Destroy a 'message' returned by 'fetch_message()'.
+ */
+static void
+destroy_message(rd_kafka_message_t * message)
+{
+#ifdef FAULT_INJECTOR
+	if (!(SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_tuples") == FaultInjectorTypeSkip))
+#endif
+		rd_kafka_message_destroy(message);
+}
+
+/**
+ * Destroy the message records are produced from, if there is one.
+ */
+static void
+release_message(KFdwScanState * ksstate)
+{
+	if (!PointerIsValid(ksstate->message))
+		return;
+
+	if (PointerIsValid(ksstate->message_task))
+		discard_decode_task(ksstate->ds_metadata, ksstate->message_task);
+	ksstate->message_task = NULL;
+	destroy_message(ksstate->message);
+	ksstate->message = NULL;
+}
+
+/**
+ * Destroy the messages fetched ahead, once their tasks are discarded.
+ */
+static void
+release_ahead_messages(KFdwScanState * ksstate)
+{
+	while (ksstate->ahead_count > 0)
+	{
+		int			i = ksstate->ahead_first;
+
+		discard_decode_task(ksstate->ds_metadata, ksstate->ahead_tasks[i]);
+		destroy_message(ksstate->ahead_messages[i]);
+		ksstate->ahead_first = (i + 1) % ksstate->ahead_capacity;
+		ksstate->ahead_count -= 1;
+	}
+	ksstate->ahead_first = 0;
+	ksstate->fetch_is_finished = false;
+}
+
+/**
+ * Get the next message to produce records from.
+ *
+ * When messages are decoded ahead, the window of messages fetched ahead is
+ * kept full, so that worker threads decode them while the backend processes
+ * the preceding ones. Messages are fetched from a batch consumed at once, so
+ * fetching ahead does not wait for Kafka.
+ *
+ * @param task set to the task decoding the message, or NULL
+ *
+ * @return NULL if there are no more messages
+ */
+static rd_kafka_message_t *
+next_message(KFdwScanState * ksstate, DecodeTask * task)
+{
+	*task = NULL;
+	if (ksstate->ahead_capacity == 0)
+		return fetch_message(ksstate->kobj);
+
+	while (!ksstate->fetch_is_finished && ksstate->ahead_count < ksstate->ahead_capacity)
+	{
+		rd_kafka_message_t *message = fetch_message(ksstate->kobj);
+
+		if (!PointerIsValid(message))
+		{
+			ksstate->fetch_is_finished = true;
+			break;
+		}
+
+		int			i = (ksstate->ahead_first + ksstate->ahead_count) % ksstate->ahead_capacity;
+
+		ksstate->ahead_messages[i] = message;
+		ksstate->ahead_tasks[i] = NULL;
+		ksstate->ahead_count += 1;
+		ksstate->ahead_tasks[i] = decode_ahead(ksstate->ds_metadata, message->payload, message->len);
+	}
+
+	if (ksstate->ahead_count == 0)
+		return NULL;
+
+	rd_kafka_message_t *result = ksstate->ahead_messages[ksstate->ahead_first];
+
+	*task = ksstate->ahead_tasks[ksstate->ahead_first];
+	ksstate->ahead_first = (ksstate->ahead_first + 1) % ksstate->ahead_capacity;
+	ksstate->ahead_count -= 1;
+	return result;
+}
+
+/**
+ * Index the elements of 'ksstate->partition_offset_pairs' by partition.
+ */
+static void
+index_partition_offset_pairs(KFdwScanState * ksstate)
+{
+	int32		max_partition = -1;
+	ListCell   *it;
+
+	foreach(it, ksstate->partition_offset_pairs)
+		max_partition = Max(max_partition, ((PartitionOffsetPair *) lfirst(it))->partition);
+
+	ksstate->partition_offset_index_size = max_partition + 1;
+	ksstate->partition_offset_index = (PartitionOffsetPair **) palloc0(sizeof(PartitionOffsetPair *) * Max(ksstate->partition_offset_index_size, 1));
+
+	foreach(it, ksstate->partition_offset_pairs)
+	{
+		PartitionOffsetPair *current = (PartitionOffsetPair *) lfirst(it);
+
+		if (current->partition >= 0 && !PointerIsValid(ksstate->partition_offset_index[current->partition]))
+			ksstate->partition_offset_index[current->partition] = current;
+	}
+}
+
 /**
  * Prepare the Kafka-ADB FDW scan state object for a new foreign scan.
  *
@@ -92,14 +271,46 @@ prepare_kfdw_scanstate(KFdwScanState * ksstate, bool is_new)
 			lfirst(it) = palloc(sizeof(PartitionOffsetPair));
 		*(PartitionOffsetPair *) lfirst(it) = *(PartitionOffsetPair *) lfirst(it_start);
 	}
+	if (is_new)
+		index_partition_offset_pairs(ksstate);
 
-	/* Prepare the storage for a batch of tuples */
-	ksstate->prepared_tuples = NIL;
-	ksstate->prepared_tuples_it = NULL;
+	ksstate->rejected_count = 0;
+	if (!is_new)
+		free_rejected_messages(ksstate->rejected_messages);
+	ksstate->rejected_messages = NIL;
+
+	/* Prepare the storage for records of a message */
+	if (is_new)
+	{
+		ksstate->message = NULL;
+		ksstate->message_task = NULL;
+		ksstate->ahead_messages = NULL;
+		ksstate->ahead_tasks = NULL;
+		ksstate->ahead_capacity = 0;
+		ksstate->ahead_first = 0;
+		ksstate->ahead_count = 0;
+		ksstate->fetch_is_finished = false;
+	}
+	else
+	{
+		release_message(ksstate);
+		release_ahead_messages(ksstate);
+	}
+	ksstate->message_record_is_pending = false;
+	ksstate->prepared_records.count = 0;
+	ksstate->prepared_records_i = 0;
 	if (is_new)
-		ksstate->prepared_tuples_mcxt = allocate_temporary_context_with_unique_name("prepared_tuples", (Oid) gp_session_id);
+	{
+		ksstate->prepared_records_arena = kadb_arena_create(CurrentMemoryContext);
+		ksstate->message_mcxt = allocate_temporary_context_with_unique_name("message", (Oid) gp_session_id);
+		ksstate->record_mcxt = allocate_temporary_context_with_unique_name("record", (Oid) gp_session_id);
+	}
 	else
-		MemoryContextReset(ksstate->prepared_tuples_mcxt);
+	{
+		kadb_arena_reset(ksstate->prepared_records_arena);
+		MemoryContextReset(ksstate->message_mcxt);
+		MemoryContextReset(ksstate->record_mcxt);
+	}
 }
 
 /**
@@ -160,9 +371,28 @@ kadbBeginForeignScanOnSegment(ForeignScanState *node, int eflags)
 	kobj_initialize_topic_connection(&ksstate->kobj, settings, ksstate->partition_offset_pairs);
 
 	elog(DEBUG1, "Kafka-ADB: Initializing deserialization...");
-	ksstate->ds_metadata = prepare_deserialization(TupleDescGetAttInMetadata(RelationGetDescr(node->ss.ss_currentRelation))->tupdesc, settings);
+	{
+		TupleDesc	payload_tupledesc;
+		List	   *payload_settings;
+
+		ksstate->mm_state = prepare_message_metadata(TupleDescGetAttInMetadata(RelationGetDescr(node->ss.ss_currentRelation))->tupdesc, settings, &payload_tupledesc, &payload_settings);
+		ksstate->ds_metadata = (PointerIsValid(ksstate->mm_state) && payload_tupledesc->natts == 0) ? NULL : prepare_deserialization(payload_tupledesc, payload_settings);
+		ksstate->payload_tupledesc = payload_tupledesc;
+		ksstate->payload_values = (Datum *) palloc(sizeof(Datum) * Max(payload_tupledesc->natts, 1));
+		ksstate->payload_nulls = (bool *) palloc(sizeof(bool) * Max(payload_tupledesc->natts, 1));
+
+		/* Each worker thread has up to 2 messages to decode ahead */
+		if (PointerIsValid(ksstate->ds_metadata) && get_decode_threads(ksstate->ds_metadata) > 0)
+		{
+			ksstate->ahead_capacity = 2 * get_decode_threads(ksstate->ds_metadata);
+			ksstate->ahead_messages = (rd_kafka_message_t **) palloc(sizeof(rd_kafka_message_t *) * ksstate->ahead_capacity);
+			ksstate->ahead_tasks = (DecodeTask *) palloc(sizeof(DecodeTask) * ksstate->ahead_capacity);
+		}
+	}
 
 	ksstate->settings.timeout_ms = defGetInt64(get_option(settings, KADB_SETTING_K_TIMEOUT_MS));
+	ksstate->settings.reject_limit = PointerIsValid(get_option(settings, KADB_SETTING_K_REJECT_LIMIT)) ? defGetInt64(get_option(settings, KADB_SETTING_K_REJECT_LIMIT)) : -1;
+	ksstate->settings.log_errors = PointerIsValid(get_option(settings, KADB_SETTING_K_LOG_ERRORS)) ? defGetBoolean(get_option(settings, KADB_SETTING_K_LOG_ERRORS)) : false;
 
 	node->fdw_state = ksstate;
 }
@@ -187,14 +417,14 @@ kadbBeginForeignScan(ForeignScanState *node, int eflags)
 }
 
 /**
- * Update offset for the partition in 'partition_offset_pairs', taking into
- * account the given 'message'.
+ * Update offset for the partition in 'ksstate->partition_offset_pairs',
+ * taking into account the given 'message'.
  *
- * Currently, this method simply iterates through all 'partition_offset_pairs'
- * and compares the offsets and partitions found with the ones in 'message'.
+ * The pair of the partition of 'message' is found by
+ * 'ksstate->partition_offset_index'.
  */
 static void
-update_offset(List *partition_offset_pairs, rd_kafka_message_t * message)
+update_offset(KFdwScanState * ksstate, rd_kafka_message_t * message)
 {
 	Assert(PointerIsValid(message));
 
@@ -217,9 +447,9 @@ update_offset(List *partition_offset_pairs, rd_kafka_message_t * message)
 		/*
 		 * For testing, offset of the first partition only is increased.
 		 */
-		if (list_length(partition_offset_pairs) > 0)
+		if (list_length(ksstate->partition_offset_pairs) > 0)
 		{
-			PartitionOffsetPair *to_update = (PartitionOffsetPair *) lfirst(list_head(partition_offset_pairs));
+			PartitionOffsetPair *to_update = (PartitionOffsetPair *) lfirst(list_head(ksstate->partition_offset_pairs));
 
 			to_update->offset += 1;
 		}
@@ -227,18 +457,138 @@ update_offset(List *partition_offset_pairs, rd_kafka_message_t * message)
 	}
 #endif
 
-	ListCell   *it;
+	if (updated.partition < 0 || updated.partition >= ksstate->partition_offset_index_size)
+		return;
+
+	PartitionOffsetPair *current = ksstate->partition_offset_index[updated.partition];
+
+	if (PointerIsValid(current) && current->offset < updated.offset)
+		current->offset = updated.offset;
+}
+
+/**
+ * Check whether an error with code 'sqlerrcode' is caused by the content of a
+ * message. Only data exceptions are; deserializers report malformed messages
+ * with such codes.
+ *
+ * Other errors (e.g. query cancellation, lack of resources, or internal
+ * errors) are never rejected: the scan continues with no subtransaction, so
+ * it is only safe to proceed after errors that leave no state behind.
+ */
+static bool
+is_rejectable_error(int sqlerrcode)
+{
+	return ERRCODE_TO_CATEGORY(sqlerrcode) == ERRCODE_DATA_EXCEPTION;
+}
+
+/**
+ * Reject the 'message' which failed to be deserialized with the error that is
+ * currently being handled, if rejection is enabled and the error permits it.
+ *
+ * Must be called in 'PG_CATCH()' block, in a memory context other than
+ * 'ErrorContext'. If the message is rejected, the error is flushed.
+ *
+ * @return a copy of the error, or NULL if the message is not rejected
+ */
+static ErrorData *
+reject_message(KFdwScanState * ksstate, rd_kafka_message_t * message)
+{
+	if (ksstate->settings.reject_limit < 0)
+		return NULL;
+
+	ErrorData  *edata = CopyErrorData();
 
-	foreach(it, partition_offset_pairs)
+	if (!is_rejectable_error(edata->sqlerrcode))
 	{
-		PartitionOffsetPair *current = (PartitionOffsetPair *) lfirst(it);
+		FreeErrorData(edata);
+		return NULL;
+	}
+	FlushErrorState();
+
+	ksstate->rejected_count += 1;
+	if (ksstate->settings.log_errors)
+		ksstate->rejected_messages = lappend(ksstate->rejected_messages, make_rejected_message(message->partition, message->offset, edata->message, message->payload, message->len));
+
+	return edata;
+}
+
+/**
+ * Start to produce records from 'ksstate->message'.
+ *
+ * When messages may be rejected, the message is deserialized completely, so
+ * that no records are produced from a message which is rejected.
+ */
+static void
+open_message(KFdwScanState * ksstate)
+{
+	rd_kafka_message_t *message = ksstate->message;
+	DecodeTask	task = ksstate->message_task;
 
-		if ((current->partition == updated.partition) && (current->offset < updated.offset))
+	kadb_arena_reset(ksstate->prepared_records_arena);
+	MemoryContextReset(ksstate->message_mcxt);
+	MemoryContext oldcontext = MemoryContextSwitchTo(ksstate->message_mcxt);
+
+	if (PointerIsValid(ksstate->mm_state))
+		fill_message_metadata(ksstate->mm_state, message);
+
+	/*
+	 * When all columns are metadata columns, each message is a single record
+	 * with no content-based attributes
+	 */
+	if (!PointerIsValid(ksstate->ds_metadata))
+		ksstate->message_record_is_pending = true;
+	else
+	{
+		/* The deserializer owns the task from now on */
+		ksstate->message_task = NULL;
+		if (ksstate->settings.reject_limit >= 0)
 		{
-			current->offset = updated.offset;
-			break;
+			deserialize(ksstate->ds_metadata, message->payload, message->len, task, ksstate->prepared_records_arena, &ksstate->prepared_records);
+			ksstate->prepared_records_i = 0;
 		}
+		else
+			begin_deserialization(ksstate->ds_metadata, message->payload, message->len, task);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Update offset by the processed message */
+	update_offset(ksstate, message);
+}
+
+/**
+ * Produce the next record of 'ksstate->message' into
+ * 'ksstate->payload_values' and 'ksstate->payload_nulls'.
+ *
+ * @return 'false' if there are no more records in the message
+ */
+static bool
+next_record(KFdwScanState * ksstate)
+{
+	if (!PointerIsValid(ksstate->ds_metadata))
+	{
+		bool		result = ksstate->message_record_is_pending;
+
+		ksstate->message_record_is_pending = false;
+		return result;
+	}
+
+	if (ksstate->settings.reject_limit >= 0)
+	{
+		if (ksstate->prepared_records_i >= ksstate->prepared_records.count)
+			return false;
+		ksstate->payload_values = DESERIALIZED_RECORD_VALUES(&ksstate->prepared_records, ksstate->prepared_records_i);
+		ksstate->payload_nulls = DESERIALIZED_RECORD_NULLS(&ksstate->prepared_records, ksstate->prepared_records_i);
+		ksstate->prepared_records_i += 1;
+		return true;
 	}
+
+	MemoryContextReset(ksstate->record_mcxt);
+	MemoryContext oldcontext = MemoryContextSwitchTo(ksstate->record_mcxt);
+	bool		result = deserialize_next(ksstate->ds_metadata, ksstate->payload_values, ksstate->payload_nulls);
+
+	MemoryContextSwitchTo(oldcontext);
+	return result;
 }
 
 TupleTableSlot *
@@ -255,60 +605,101 @@ kadbIterateForeignScan(ForeignScanState *node)
 
 	KFdwScanState *ksstate = node->fdw_state;
 
-	while (!PointerIsValid(ksstate->prepared_tuples_it))
+	while (true)
 	{
-		rd_kafka_message_t *message = fetch_message(ksstate->kobj);
+		if (!PointerIsValid(ksstate->message))
+		{
+			DecodeTask	task;
+			rd_kafka_message_t *message = next_message(ksstate, &task);
 
-		/* Check if the loop must be finished */
-		if (!PointerIsValid(message))
-			return ExecClearTuple(slot);
+			/* Check if the loop must be finished */
+			if (!PointerIsValid(message))
+				return ExecClearTuple(slot);
 
-		PG_TRY();
-		{
+			MemoryContext scancontext = CurrentMemoryContext;
+			ErrorData  *volatile rejection = NULL;
+
+			ksstate->message = message;
+			ksstate->message_task = task;
+			PG_TRY();
+			{
+				open_message(ksstate);
+			}
+			PG_CATCH();
 			{
-				MemoryContextReset(ksstate->prepared_tuples_mcxt);
-				MemoryContext oldcontext = MemoryContextSwitchTo(ksstate->prepared_tuples_mcxt);
+				MemoryContextSwitchTo(scancontext);
+				rejection = reject_message(ksstate, message);
+
+				if (!PointerIsValid(rejection))
+				{
+					release_message(ksstate);
+					PG_RE_THROW();
+				}
+
+				/* The rejected message is skipped */
+				kadb_arena_reset(ksstate->prepared_records_arena);
+				MemoryContextReset(ksstate->message_mcxt);
+				ksstate->prepared_records.count = 0;
+				ksstate->prepared_records_i = 0;
+				update_offset(ksstate, message);
+			}
+			PG_END_TRY();
 
-				ksstate->prepared_tuples = deserialize(ksstate->ds_metadata, message->payload, message->len);
-				MemoryContextSwitchTo(oldcontext);
+			if (PointerIsValid(rejection))
+			{
+				release_message(ksstate);
+				if (ksstate->rejected_count > ksstate->settings.reject_limit)
+					ereport(ERROR, (errcode(rejection->sqlerrcode), errmsg("Kafka-ADB: Segment reject limit (%" PRId64 ") exceeded. Last error was: %s", ksstate->settings.reject_limit, rejection->message)));
+				FreeErrorData(rejection);
+
+				/*
+				 * Rejected messages are written in batches, so that the
+				 * memory kept for them does not grow with their number. The
+				 * rows are discarded with the transaction if the SELECT fails
+				 */
+				if (list_length(ksstate->rejected_messages) >= ERROR_LOG_BATCH_SIZE)
+				{
+					write_error_log(RelationGetRelid(node->ss.ss_currentRelation), ksstate->rejected_messages);
+					free_rejected_messages(ksstate->rejected_messages);
+					ksstate->rejected_messages = NIL;
+				}
+				continue;
 			}
-			if (list_length(ksstate->prepared_tuples) > 0)
-				ksstate->prepared_tuples_it = list_head(ksstate->prepared_tuples);
+		}
 
-			/* Update offset by the processed message */
-			update_offset(ksstate->partition_offset_pairs, message);
+		bool		has_record;
+
+		PG_TRY();
+		{
+			has_record = next_record(ksstate);
 		}
 		PG_CATCH();
 		{
-#ifdef FAULT_INJECTOR
-			if (!(SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_tuples") == FaultInjectorTypeSkip))
-#endif
-				rd_kafka_message_destroy(message);
-
+			release_message(ksstate);
 			PG_RE_THROW();
 		}
 		PG_END_TRY();
 
-#ifdef FAULT_INJECTOR
-		if (!(SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_tuples") == FaultInjectorTypeSkip))
-#endif
-			rd_kafka_message_destroy(message);
+		if (has_record)
+			break;
+		release_message(ksstate);
 	}
 
-	MemoryContext oldcontext = MemoryContextSwitchTo(PortalContext);
-
 	/*
-	 * We use 'heap_copytuple()' in order to safely reset context which
-	 * contains "original" parsed values. 'ExecStoreHeapTuple()' is called
-	 * with last parameter set, thus GPDB is taking ownership of the returned
-	 * tuple.
+	 * The record is returned as a virtual tuple: its values are not copied.
+	 * They are allocated in the memory of the CURRENT message or record, and
+	 * stay valid until the next call, when that memory is reset.
 	 */
-	ExecStoreHeapTuple(heap_copytuple(lfirst(ksstate->prepared_tuples_it)), slot, InvalidBuffer, true);
-	MemoryContextSwitchTo(oldcontext);
-
-	ksstate->prepared_tuples_it = lnext(ksstate->prepared_tuples_it);
+	ExecClearTuple(slot);
+	if (PointerIsValid(ksstate->mm_state))
+		fill_record_with_message_metadata(ksstate->mm_state, ksstate->payload_values, ksstate->payload_nulls, slot_get_values(slot), slot_get_isnull(slot));
+	else
+	{
+		memcpy(slot_get_values(slot), ksstate->payload_values, sizeof(Datum) * ksstate->payload_tupledesc->natts);
+		memcpy(slot_get_isnull(slot), ksstate->payload_nulls, sizeof(bool) * ksstate->payload_tupledesc->natts);
+	}
 
-	return slot;
+	return ExecStoreVirtualTuple(slot);
 }
 
 void
@@ -364,6 +755,8 @@ kadbEndForeignScanOnSegment(ForeignScanState *node)
 {
 	KFdwScanState *ksstate = node->fdw_state;
 
+	release_message(ksstate);
+	release_ahead_messages(ksstate);
 	if (PointerIsValid(ksstate->kobj))
 	{
 		elog(DEBUG1, "Kafka-ADB: Destroying Kafka connection...");
@@ -375,6 +768,8 @@ kadbEndForeignScanOnSegment(ForeignScanState *node)
 		elog(DEBUG1, "Kafka-ADB: Finishing deserialization...");
 		finish_deserialization(ksstate->ds_metadata);
 	}
+	kadb_arena_report_stats(ksstate->prepared_records_arena, "prepared records", DEBUG1);
+	kadb_arena_destroy(ksstate->prepared_records_arena);
 
 	if (!IsTransactionState())
 		return;
@@ -383,6 +778,14 @@ kadbEndForeignScanOnSegment(ForeignScanState *node)
 
 	elog(DEBUG1, "Kafka-ADB: Writing updated partition-offset pairs to local offsets relation...");
 	write_distributed_offsets(defGetInt64(get_option(settings, KADB_SETTING__DISTRIBUTED_TABLE)), ksstate->partition_offset_pairs);
+
+	if (ksstate->rejected_count > 0)
+	{
+		ereport(NOTICE, (errmsg("Kafka-ADB: %" PRId64 " messages were rejected because of deserialization errors", ksstate->rejected_count)));
+
+		elog(DEBUG1, "Kafka-ADB: Writing rejected messages to error log relation...");
+		write_error_log(RelationGetRelid(node->ss.ss_currentRelation), ksstate->rejected_messages);
+	}
 }
 
 void
@@ -2,20 +2,67 @@
 
 #include <inttypes.h>
 
+#include <access/heapam.h>
 #include <access/reloptions.h>
 #include <cdb/cdbvars.h>
+#include <executor/spi.h>
 #include <foreign/fdwapi.h>
 #include <funcapi.h>
+#include <miscadmin.h>
 #include <nodes/nodes.h>
+#include <utils/acl.h>
+#include <utils/builtins.h>
+#include <utils/lsyscache.h>
+#include <utils/rel.h>
 
 #include "kafka_consumer.h"
 #include "kafka_functions.h"
 #include "offsets.h"
 #include "settings.h"
+#include "deserialization/debezium_deserializer.h"
 #include "utils/kadb_assert.h"
 #include "utils/kadb_gp_utils.h"
 
 
+#define STREQ(a, b) (strcmp(a, b) == 0)
+
+/* The name of the column of row numbers in the table of changes */
+#define CHANGES_ROW_NUMBER_COLUMN "_kadb_rn"
+
+
+/**
+ * Get the name of the temporary table of changes of the given 'ftoid'.
+ */
+static inline char *
+changes_table_name(Oid ftoid)
+{
+	char	   *name = palloc(NAMEDATALEN);
+
+	snprintf(name, NAMEDATALEN, "_kadb_changes_%u", ftoid);
+	return name;
+}
+
+/**
+ * @return the schema-qualified and quoted name of relation 'relid'
+ */
+static char *
+qualified_relation_name(Oid relid)
+{
+	return quote_qualified_identifier(get_namespace_name(get_rel_namespace(relid)), get_rel_name(relid));
+}
+
+/**
+ * Append quoted 'name' to a comma-separated list 'str'.
+ */
+static void
+append_column_name(StringInfo str, const char *name)
+{
+	if (str->len > 0)
+		appendStringInfoString(str, ", ");
+	appendStringInfoString(str, quote_identifier(name));
+}
+
+
 Datum
 kadb_partitions_obtain(PG_FUNCTION_ARGS)
 {
@@ -178,3 +225,172 @@ kadb_offsets_to_committed(PG_FUNCTION_ARGS)
 
 	PG_RETURN_VOID();
 }
+
+Datum
+kadb_apply_changes(PG_FUNCTION_ARGS)
+{
+	ASSERT_CONTROLLER();
+
+	Oid			ftoid = PG_GETARG_OID(0);
+	Oid			target = PG_GETARG_OID(1);
+
+	List	   *ftoptions = get_and_validate_options(ftoid);
+	DefElem    *format = get_option(ftoptions, KADB_SETTING_FORMAT);
+
+	if (!PointerIsValid(format) || pg_strcasecmp(defGetString(format), DebeziumDeserializationFormat.name) != 0)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: Changes can only be applied from a FOREIGN TABLE with '%s' '%s'", KADB_SETTING_FORMAT, DebeziumDeserializationFormat.name)));
+
+	/*
+	 * Privileges are checked before 'target' is locked, so that a user cannot
+	 * block a table it has no access to. 'pg_class_aclcheck()' succeeds when
+	 * any of the given privileges is held, thus each one is checked apart
+	 */
+	AclResult	aclresult = pg_class_aclcheck(target, GetUserId(), ACL_INSERT);
+
+	if (aclresult == ACLCHECK_OK)
+		aclresult = pg_class_aclcheck(target, GetUserId(), ACL_DELETE);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, ACL_KIND_CLASS, get_rel_name(target));
+
+	/*
+	 * The lock on 'target' is kept until the end of the transaction, so that
+	 * it cannot be dropped or altered before the changes are applied
+	 */
+	Relation	target_rel = try_relation_open(target, RowExclusiveLock);
+
+	if (!PointerIsValid(target_rel))
+		ereport(ERROR, (errcode(ERRCODE_UNDEFINED_TABLE), errmsg("Kafka-ADB: Relation with OID %u does not exist", target)));
+	if (target_rel->rd_rel->relkind != RELKIND_RELATION)
+		ereport(ERROR, (errcode(ERRCODE_WRONG_OBJECT_TYPE), errmsg("Kafka-ADB: Changes can only be applied to a table, and \"%s\" is not a table", RelationGetRelationName(target_rel))));
+
+	char	   *target_name = qualified_relation_name(target);
+
+	relation_close(target_rel, NoLock);
+
+	/*
+	 * Find the columns of the operation, the offset, and the key, and the
+	 * columns to copy into 'target' (the key and the row image)
+	 */
+	List	   *column_options = get_and_validate_column_options(ftoid);
+	Relation	ft = heap_open(ftoid, AccessShareLock);
+	TupleDesc	tupledesc = RelationGetDescr(ft);
+	char	   *op_column = NULL;
+	char	   *offset_column = NULL;
+	StringInfoData key_columns;
+	StringInfoData columns;
+	StringInfoData key_condition;
+	StringInfoData null_key_condition;
+
+	initStringInfo(&key_columns);
+	initStringInfo(&columns);
+	initStringInfo(&key_condition);
+	initStringInfo(&null_key_condition);
+
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		if (tupledesc->attrs[i]->attisdropped)
+			continue;
+
+		const char *name = NameStr(tupledesc->attrs[i]->attname);
+		List	   *options = (List *) list_nth(column_options, i);
+		DefElem    *metadata = get_option(options, KADB_SETTING_KAFKA_METADATA);
+		DefElem    *debezium_column = get_option(options, KADB_SETTING_DEBEZIUM_COLUMN);
+
+		if (PointerIsValid(metadata))
+		{
+			if (STREQ(defGetString(metadata), KADB_KAFKA_METADATA_OFFSET))
+				offset_column = pstrdup(quote_identifier(name));
+			continue;
+		}
+		if (PointerIsValid(debezium_column) && STREQ(defGetString(debezium_column), KADB_DEBEZIUM_COLUMN_OP))
+		{
+			op_column = pstrdup(quote_identifier(name));
+			continue;
+		}
+		if (PointerIsValid(debezium_column) && STREQ(defGetString(debezium_column), KADB_DEBEZIUM_COLUMN_KEY))
+		{
+			append_column_name(&key_columns, name);
+			if (key_condition.len > 0)
+			{
+				appendStringInfoString(&key_condition, " AND ");
+				appendStringInfoString(&null_key_condition, " OR ");
+			}
+			appendStringInfo(&key_condition, "t.%s = c.%s", quote_identifier(name), quote_identifier(name));
+			appendStringInfo(&null_key_condition, "%s IS NULL", quote_identifier(name));
+		}
+		append_column_name(&columns, name);
+	}
+
+	heap_close(ft, AccessShareLock);
+
+	if (!PointerIsValid(op_column))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: Changes can only be applied from a FOREIGN TABLE with a column with '%s' '%s'", KADB_SETTING_DEBEZIUM_COLUMN, KADB_DEBEZIUM_COLUMN_OP)));
+	if (key_columns.len == 0)
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: Changes can only be applied from a FOREIGN TABLE with a column with '%s' '%s'", KADB_SETTING_DEBEZIUM_COLUMN, KADB_DEBEZIUM_COLUMN_KEY)));
+	if (!PointerIsValid(offset_column))
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: Changes can only be applied from a FOREIGN TABLE with a column with '%s' '%s'", KADB_SETTING_KAFKA_METADATA, KADB_KAFKA_METADATA_OFFSET)));
+
+	/*
+	 * Changes of a batch are staged in a temporary table distributed by the
+	 * key, and collapsed to the last change of each key. All changes of a key
+	 * are in the same partition, so the last one has the greatest offset.
+	 * Truncations ('t') have no key, and are not applied. Keys are compared by
+	 * '=', so that the DELETE can be a hash join; thus no key may be NULL
+	 */
+	char	   *changes = quote_identifier(changes_table_name(ftoid));
+	StringInfoData query_stage;
+	StringInfoData query_count;
+	StringInfoData query_delete;
+	StringInfoData query_insert;
+	StringInfoData query_drop;
+
+	initStringInfo(&query_stage);
+	appendStringInfo(&query_stage, "CREATE TEMPORARY TABLE %s ON COMMIT DROP AS SELECT %s, %s, %s FROM %s WHERE %s IN ('c', 'r', 'u', 'd') DISTRIBUTED BY (%s);", changes, op_column, offset_column, columns.data, qualified_relation_name(ftoid), op_column, key_columns.data);
+	initStringInfo(&query_count);
+	appendStringInfo(&query_count, "SELECT count(*), count(CASE WHEN %s THEN 1 END) FROM %s;", null_key_condition.data, changes);
+	initStringInfo(&query_delete);
+	appendStringInfo(&query_delete, "DELETE FROM %s AS t USING (SELECT DISTINCT %s FROM %s) AS c WHERE %s;", target_name, key_columns.data, changes, key_condition.data);
+	initStringInfo(&query_insert);
+	appendStringInfo(&query_insert, "INSERT INTO %s (%s) SELECT %s FROM (SELECT *, row_number() OVER (PARTITION BY %s ORDER BY %s DESC) AS %s FROM %s) AS c WHERE %s = 1 AND %s <> 'd';", target_name, columns.data, columns.data, key_columns.data, offset_column, CHANGES_ROW_NUMBER_COLUMN, changes, CHANGES_ROW_NUMBER_COLUMN, op_column);
+	initStringInfo(&query_drop);
+	appendStringInfo(&query_drop, "DROP TABLE %s;", changes);
+
+	int64		result = 0;
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		ereport(ERROR, (errcode(ERRCODE_SQL_ROUTINE_EXCEPTION), errmsg("Kafka-ADB: Failed to connect to SPI")));
+
+	PG_TRY();
+	{
+		execute_spi_or_error(query_stage.data, false, 0);
+
+		execute_spi_or_error(query_count.data, false, 0);
+		if (SPI_tuptable == NULL || SPI_processed != 1)
+			ereport(ERROR, (errcode(ERRCODE_SQL_ROUTINE_EXCEPTION), errmsg("Kafka-ADB: Failed to count changes via SPI")));
+
+		bool		is_null;
+
+		result = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &is_null));
+		if (DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 2, &is_null)) > 0)
+			ereport(ERROR, (errcode(ERRCODE_NOT_NULL_VIOLATION), errmsg("Kafka-ADB: Changes cannot be applied, as some change events have NULL keys")));
+
+		execute_spi_or_error(query_delete.data, false, 0);
+		execute_spi_or_error(query_insert.data, false, 0);
+		execute_spi_or_error(query_drop.data, false, 0);
+	}
+	PG_CATCH();
+	{
+		SPI_finish();
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	SPI_finish();
+
+	pfree(query_stage.data);
+	pfree(query_count.data);
+	pfree(query_delete.data);
+	pfree(query_insert.data);
+	pfree(query_drop.data);
+
+	PG_RETURN_INT64(result);
+}
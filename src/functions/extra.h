@@ -50,5 +50,11 @@ Datum		kadb_offsets_to_latest(PG_FUNCTION_ARGS);
  */
 Datum		kadb_offsets_to_committed(PG_FUNCTION_ARGS);
 
+/**
+ * Read change events from a FOREIGN TABLE of 'debezium' format, and apply the
+ * last change of each key to the target table by a single DELETE and INSERT.
+ */
+Datum		kadb_apply_changes(PG_FUNCTION_ARGS);
+
 
 #endif   /* KADB_FDW_FUNCTIONS_EXTRA_INCLUDED */
@@ -5,8 +5,10 @@
 #include <postgres.h>
 
 #include <access/reloptions.h>
+#include <catalog/pg_attribute.h>
 #include <cdb/cdbvars.h>
 #include <foreign/fdwapi.h>
+#include <miscadmin.h>
 #include <nodes/nodes.h>
 
 #include "execution.h"
@@ -54,8 +56,17 @@ kadb_fdw_validator(PG_FUNCTION_ARGS)
 		PG_RETURN_VOID();
 
 	List	   *options = untransformRelOptions(PG_GETARG_DATUM(0));
-
-	validate_options(&options, false);
+	Oid			catalog = PG_GETARG_OID(1);
+
+	if (catalog == AttributeRelationId)
+		validate_column_options(options);
+	else
+	{
+		/* The file is read by the server process, with its privileges */
+		if (!superuser() && PointerIsValid(get_option(options, KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE)))
+			ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE), errmsg("Kafka-ADB: Only superuser can set '%s' OPTION", KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE)));
+		validate_options(&options, false);
+	}
 	PG_RETURN_VOID();
 }
 
@@ -74,3 +85,4 @@ PG_FUNCTION_INFO_V1(kadb_offsets_to_timestamp);
 PG_FUNCTION_INFO_V1(kadb_offsets_to_earliest);
 PG_FUNCTION_INFO_V1(kadb_offsets_to_latest);
 PG_FUNCTION_INFO_V1(kadb_offsets_to_committed);
+PG_FUNCTION_INFO_V1(kadb_apply_changes);
@@ -0,0 +1,436 @@
+#include "message_metadata.h"
+
+#include <limits.h>
+
+#include <access/htup_details.h>
+#include <catalog/pg_type.h>
+#include <mb/pg_wchar.h>
+#include <nodes/makefuncs.h>
+#include <rewrite/rewriteManip.h>
+#include <utils/builtins.h>
+#include <utils/faultinjector.h>
+#include <utils/jsonb.h>
+#include <utils/lsyscache.h>
+#include <utils/timestamp.h>
+
+#include "settings.h"
+#include "deserialization/attribute_postgres.h"
+#include "deserialization/record_filter.h"
+
+
+#define STREQ(a, b) (strcmp(a, b) == 0)
+
+/* Milliseconds between Unix and Postgres epochs */
+#define UNIX_EPOCH_TO_POSTGRES_EPOCH_MS ((int64) (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * SECS_PER_DAY * 1000)
+
+
+typedef enum MessageMetadataKind
+{
+	METADATA_NONE,
+	METADATA_PARTITION,
+	METADATA_OFFSET,
+	METADATA_TIMESTAMP,
+	METADATA_KEY,
+	METADATA_HEADERS
+}	MessageMetadataKind;
+
+typedef struct MessageMetadataColumn
+{
+	MessageMetadataKind kind;
+	/* The column is referenced by the query */
+	bool		is_required;
+	/* METADATA_KEY: the key is converted by the textual input function */
+	bool		key_is_text;
+	/* METADATA_KEY: the type of the column */
+	Oid			typid;
+	FunctionCallCompleteData io;
+}	MessageMetadataColumn;
+
+typedef struct MessageMetadataStateObject
+{
+	TupleDesc	tupledesc;
+	/* Metadata of each attribute of 'tupledesc' */
+	MessageMetadataColumn *columns;
+
+	TupleDesc	payload_tupledesc;
+	/* Attribute (index in 'tupledesc') for each payload attribute */
+	int		   *payload_attributes;
+
+	/* Values of metadata attributes of the CURRENT message */
+	Datum	   *values;
+	bool	   *nulls;
+
+	/* A buffer to null-terminate keys passed to the input function */
+	StringInfoData buffer;
+}	MessageMetadataStateObject;
+
+
+/**
+ * Resolve the value of KADB_SETTING_KAFKA_METADATA column option.
+ */
+static MessageMetadataKind
+resolve_metadata_kind(const char *name)
+{
+	if (STREQ(name, KADB_KAFKA_METADATA_PARTITION))
+		return METADATA_PARTITION;
+	if (STREQ(name, KADB_KAFKA_METADATA_OFFSET))
+		return METADATA_OFFSET;
+	if (STREQ(name, KADB_KAFKA_METADATA_TIMESTAMP))
+		return METADATA_TIMESTAMP;
+	if (STREQ(name, KADB_KAFKA_METADATA_KEY))
+		return METADATA_KEY;
+	if (STREQ(name, KADB_KAFKA_METADATA_HEADERS))
+		return METADATA_HEADERS;
+	/* Column options are validated */
+	Assert(false);
+	return METADATA_NONE;
+}
+
+/**
+ * Check the type of the metadata column 'i' of 'tupledesc', and set up its
+ * conversion.
+ */
+static void
+prepare_metadata_column(MessageMetadataColumn * column, TupleDesc tupledesc, int i, List *options)
+{
+	Form_pg_attribute attribute = tupledesc->attrs[i];
+	const char *kind = defGetString(get_column_option(options, i + 1, KADB_SETTING_KAFKA_METADATA));
+	bool		valid_type = false;
+
+	column->typid = attribute->atttypid;
+
+	switch (column->kind)
+	{
+		case METADATA_PARTITION:
+			valid_type = column->typid == INT4OID || column->typid == INT8OID;
+			break;
+		case METADATA_OFFSET:
+			valid_type = column->typid == INT8OID;
+			break;
+		case METADATA_TIMESTAMP:
+			valid_type = column->typid == TIMESTAMPTZOID || column->typid == INT8OID;
+			break;
+		case METADATA_KEY:
+			{
+				DefElem    *key_format = get_column_option(options, i + 1, KADB_SETTING_KAFKA_KEY_FORMAT);
+
+				column->key_is_text = PointerIsValid(key_format) ?
+					STREQ(defGetString(key_format), KADB_KAFKA_KEY_FORMAT_TEXT) :
+					column->typid != BYTEAOID;
+				valid_type = column->key_is_text || column->typid == BYTEAOID || column->typid == TEXTOID;
+				if (!valid_type)
+					ereport(ERROR, (errcode(ERRCODE_FDW_ERROR), errmsg("Kafka-ADB: Column \"%s\" with '%s' '%s' must be of type BYTEA or TEXT, not %s", NameStr(attribute->attname), KADB_SETTING_KAFKA_KEY_FORMAT, KADB_KAFKA_KEY_FORMAT_RAW, format_type_be(column->typid))));
+				if (column->key_is_text)
+				{
+					Oid			input_fn;
+
+					getTypeInputInfo(column->typid, &input_fn, &column->io.typioparam);
+					fmgr_info(input_fn, &column->io.iofunc);
+					column->io.attypmod = attribute->atttypmod;
+					set_fast_input_function(&column->io, column->typid);
+				}
+			}
+			break;
+		case METADATA_HEADERS:
+			valid_type = column->typid == JSONBOID;
+			break;
+		default:
+			Assert(false);
+	}
+
+	if (!valid_type)
+		ereport(ERROR, (errcode(ERRCODE_FDW_ERROR), errmsg("Kafka-ADB: Column \"%s\" with '%s' '%s' cannot be of type %s", NameStr(attribute->attname), KADB_SETTING_KAFKA_METADATA, kind, format_type_be(column->typid))));
+}
+
+MessageMetadataState
+prepare_message_metadata(TupleDesc tupledesc, List *options, TupleDesc *payload_tupledesc, List **payload_options)
+{
+	MessageMetadataColumn *columns = palloc0(sizeof(MessageMetadataColumn) * tupledesc->natts);
+	DefElem    *attributes_required = get_option(options, KADB_SETTING__ATTRIBUTES_REQUIRED);
+	int			payload_natts = 0;
+
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		DefElem    *kind = get_column_option(options, i + 1, KADB_SETTING_KAFKA_METADATA);
+
+		if (tupledesc->attrs[i]->attisdropped || !PointerIsValid(kind))
+		{
+			payload_natts += 1;
+			continue;
+		}
+		columns[i].kind = resolve_metadata_kind(defGetString(kind));
+		columns[i].is_required = !PointerIsValid(attributes_required) || list_member_int((List *) attributes_required->arg, i + 1);
+		prepare_metadata_column(&columns[i], tupledesc, i, options);
+	}
+
+	if (payload_natts == tupledesc->natts)
+	{
+		pfree(columns);
+		*payload_tupledesc = tupledesc;
+		*payload_options = options;
+		return NULL;
+	}
+
+	MessageMetadataState result = palloc(sizeof(MessageMetadataStateObject));
+
+	result->tupledesc = tupledesc;
+	result->columns = columns;
+	result->payload_tupledesc = CreateTemplateTupleDesc(payload_natts, false);
+	result->payload_attributes = palloc(sizeof(int) * Max(payload_natts, 1));
+	result->values = palloc0(sizeof(Datum) * tupledesc->natts);
+	result->nulls = palloc(sizeof(bool) * tupledesc->natts);
+	initStringInfo(&result->buffer);
+
+	/*
+	 * Column options, required attributes, and early quals are identified by
+	 * attribute numbers, so they are renumbered for the payload tuple
+	 * descriptor
+	 */
+	List	   *payload_column_options = NIL;
+	List	   *payload_attributes_required = NIL;
+	AttrNumber *payload_attnums = palloc0(sizeof(AttrNumber) * tupledesc->natts);
+	int			j = 0;
+
+	for (int i = 0; i < tupledesc->natts; i++)
+	{
+		result->nulls[i] = true;
+		if (columns[i].kind != METADATA_NONE)
+			continue;
+
+		TupleDescCopyEntry(result->payload_tupledesc, j + 1, tupledesc, i + 1);
+		result->payload_attributes[j] = i;
+		payload_attnums[i] = j + 1;
+
+		DefElem    *column_options = get_option(options, KADB_SETTING__COLUMN_OPTIONS);
+
+		if (PointerIsValid(column_options) && i < list_length((List *) column_options->arg))
+			payload_column_options = lappend(payload_column_options, list_nth((List *) column_options->arg, i));
+		else
+			payload_column_options = lappend(payload_column_options, NIL);
+		if (PointerIsValid(attributes_required) && list_member_int((List *) attributes_required->arg, i + 1))
+			payload_attributes_required = lappend_int(payload_attributes_required, j + 1);
+		j += 1;
+	}
+	result->payload_tupledesc->tdtypeid = tupledesc->tdtypeid;
+	result->payload_tupledesc->tdtypmod = tupledesc->tdtypmod;
+
+	*payload_options = NIL;
+
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+
+		if (STREQ(option->defname, KADB_SETTING__COLUMN_OPTIONS) || STREQ(option->defname, KADB_SETTING__ATTRIBUTES_REQUIRED) || STREQ(option->defname, KADB_SETTING__EARLY_QUALS))
+			continue;
+		*payload_options = lappend(*payload_options, option);
+	}
+	*payload_options = lappend(*payload_options, makeDefElem(KADB_SETTING__COLUMN_OPTIONS, (Node *) payload_column_options));
+	if (PointerIsValid(attributes_required))
+		*payload_options = lappend(*payload_options, makeDefElem(KADB_SETTING__ATTRIBUTES_REQUIRED, (Node *) payload_attributes_required));
+
+	/* Early quals never reference metadata columns */
+	DefElem    *early_quals = get_option(options, KADB_SETTING__EARLY_QUALS);
+
+	if (PointerIsValid(early_quals))
+	{
+		bool		found_whole_row;
+
+		*payload_options = lappend(*payload_options, makeDefElem(KADB_SETTING__EARLY_QUALS, map_variable_attnos(early_quals->arg, RECORD_FILTER_VARNO, 0, payload_attnums, tupledesc->natts, &found_whole_row)));
+	}
+	pfree(payload_attnums);
+
+	*payload_tupledesc = result->payload_tupledesc;
+
+	return result;
+}
+
+/**
+ * Convert a Kafka message timestamp (milliseconds since Unix epoch) to
+ * 'TimestampTz'.
+ */
+static TimestampTz
+kafka_timestamp_to_timestamptz(int64 timestamp_ms)
+{
+#ifdef HAVE_INT64_TIMESTAMP
+	return (timestamp_ms - UNIX_EPOCH_TO_POSTGRES_EPOCH_MS) * 1000;
+#else
+	return (timestamp_ms - UNIX_EPOCH_TO_POSTGRES_EPOCH_MS) / 1000.0;
+#endif
+}
+
+/**
+ * Convert the key of a message to a value of 'column'.
+ */
+static Datum
+convert_key(MessageMetadataState state, MessageMetadataColumn * column, const char *key, size_t key_l)
+{
+	Datum		result;
+
+	if (!column->key_is_text)
+	{
+		if (column->typid == TEXTOID)
+			pg_verify_mbstr(GetDatabaseEncoding(), key, (int) key_l, false);
+
+		bytea	   *value = palloc(VARHDRSZ + key_l);
+
+		SET_VARSIZE(value, VARHDRSZ + key_l);
+		memcpy(VARDATA(value), key, key_l);
+		return PointerGetDatum(value);
+	}
+
+	if (fast_input_function_call(&column->io, key, key_l, &result))
+		return result;
+
+	resetStringInfo(&state->buffer);
+	appendBinaryStringInfo(&state->buffer, key, key_l);
+	return InputFunctionCall(&column->io.iofunc, state->buffer.data, column->io.typioparam, column->io.attypmod);
+}
+
+/**
+ * Make 'v' a JSONB string of 'data' of length 'data_l'.
+ *
+ * Headers are byte arrays; data which is not valid text in the database
+ * encoding (including data with NUL bytes) is stored in the hex format of
+ * BYTEA instead: '\x' followed by two hex digits per byte.
+ */
+static void
+make_header_string(JsonbValue *v, const char *data, size_t data_l)
+{
+	v->type = jbvString;
+	if (data_l <= INT_MAX && pg_verify_mbstr(GetDatabaseEncoding(), data, (int) data_l, true))
+	{
+		v->val.string.val = (char *) data;
+		v->val.string.len = data_l;
+		return;
+	}
+
+	char	   *hex = palloc(2 + data_l * 2);
+
+	hex[0] = '\\';
+	hex[1] = 'x';
+	v->val.string.val = hex;
+	v->val.string.len = 2 + hex_encode(data, (unsigned) data_l, hex + 2);
+}
+
+/**
+ * Convert the headers of a message to a JSONB object. Header values are
+ * strings, or nulls.
+ */
+static Datum
+convert_headers(rd_kafka_headers_t * headers)
+{
+	JsonbParseState *jb = NULL;
+	JsonbValue *result;
+	const char *name;
+	const void *value;
+	size_t		value_l;
+
+	pushJsonbValue(&jb, WJB_BEGIN_OBJECT, NULL);
+	for (size_t i = 0; rd_kafka_header_get_all(headers, i, &name, &value, &value_l) == RD_KAFKA_RESP_ERR_NO_ERROR; i++)
+	{
+		JsonbValue	v;
+
+		make_header_string(&v, name, strlen(name));
+		pushJsonbValue(&jb, WJB_KEY, &v);
+
+		if (PointerIsValid(value))
+			make_header_string(&v, (const char *) value, value_l);
+		else
+			v.type = jbvNull;
+		pushJsonbValue(&jb, WJB_VALUE, &v);
+	}
+	result = pushJsonbValue(&jb, WJB_END_OBJECT, NULL);
+
+	return PointerGetDatum(JsonbValueToJsonb(result));
+}
+
+void
+fill_message_metadata(MessageMetadataState state, rd_kafka_message_t * message)
+{
+	AssertArg(PointerIsValid(state));
+
+	/*
+	 * Timestamp and headers are stored in the internal part of a message,
+	 * which injected messages do not have
+	 */
+	bool		is_injected = false;
+
+#ifdef FAULT_INJECTOR
+	is_injected = SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_tuples") == FaultInjectorTypeSkip;
+#endif
+
+	for (int i = 0; i < state->tupledesc->natts; i++)
+	{
+		MessageMetadataColumn *column = &state->columns[i];
+
+		if (column->kind == METADATA_NONE)
+			continue;
+
+		state->nulls[i] = true;
+		if (!column->is_required)
+			continue;
+
+		switch (column->kind)
+		{
+			case METADATA_PARTITION:
+				state->nulls[i] = false;
+				state->values[i] = column->typid == INT4OID ? Int32GetDatum(message->partition) : Int64GetDatum((int64) message->partition);
+				break;
+			case METADATA_OFFSET:
+				state->nulls[i] = false;
+				state->values[i] = Int64GetDatum(message->offset);
+				break;
+			case METADATA_TIMESTAMP:
+				if (!is_injected)
+				{
+					int64		timestamp_ms = rd_kafka_message_timestamp(message, NULL);
+
+					if (timestamp_ms >= 0)
+					{
+						state->nulls[i] = false;
+						state->values[i] = column->typid == INT8OID ? Int64GetDatum(timestamp_ms) : TimestampTzGetDatum(kafka_timestamp_to_timestamptz(timestamp_ms));
+					}
+				}
+				break;
+			case METADATA_KEY:
+				if (PointerIsValid(message->key))
+				{
+					state->values[i] = convert_key(state, column, (const char *) message->key, message->key_len);
+					state->nulls[i] = false;
+				}
+				break;
+			case METADATA_HEADERS:
+				if (!is_injected)
+				{
+					rd_kafka_headers_t *headers;
+
+					if (rd_kafka_message_headers(message, &headers) == RD_KAFKA_RESP_ERR_NO_ERROR)
+					{
+						state->values[i] = convert_headers(headers);
+						state->nulls[i] = false;
+					}
+				}
+				break;
+			default:
+				Assert(false);
+		}
+	}
+}
+
+void
+fill_record_with_message_metadata(MessageMetadataState state, Datum *payload_values, bool *payload_nulls, Datum *values, bool *nulls)
+{
+	AssertArg(PointerIsValid(state));
+
+	memcpy(values, state->values, sizeof(Datum) * state->tupledesc->natts);
+	memcpy(nulls, state->nulls, sizeof(bool) * state->tupledesc->natts);
+	for (int j = 0; j < state->payload_tupledesc->natts; j++)
+	{
+		int			i = state->payload_attributes[j];
+
+		values[i] = payload_values[j];
+		nulls[i] = payload_nulls[j];
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef KADB_FDW_MESSAGE_METADATA_INCLUDED
+#define KADB_FDW_MESSAGE_METADATA_INCLUDED
+
+/*
+ * Kafka message metadata columns.
+ *
+ * A column with KADB_SETTING_KAFKA_METADATA column option is filled with
+ * metadata of a Kafka message (partition, offset, timestamp, key, or headers)
+ * instead of a value from the message content. Such columns are excluded from
+ * the tuple descriptor passed to the deserializer, so for any format the
+ * content of messages is mapped to the other columns only.
+ */
+
+#include <postgres.h>
+
+#include <librdkafka/rdkafka.h>
+
+#include <access/htup.h>
+#include <access/tupdesc.h>
+#include <nodes/pg_list.h>
+
+
+/* An opaque struct to store message metadata runtime state */
+typedef struct MessageMetadataStateObject *MessageMetadataState;
+
+
+/**
+ * Prepare to fill message metadata columns of a table with 'tupledesc' and
+ * 'options'.
+ *
+ * @param payload_tupledesc the resulting tuple descriptor of the columns
+ * filled from the content of messages. May be of zero attributes
+ * @param payload_options the resulting options for 'payload_tupledesc'
+ *
+ * @return NULL if there are no metadata columns; 'payload_tupledesc' and
+ * 'payload_options' are set to 'tupledesc' and 'options' then
+ */
+MessageMetadataState prepare_message_metadata(TupleDesc tupledesc, List *options, TupleDesc *payload_tupledesc, List **payload_options);
+
+/**
+ * Extract metadata of 'message'. The values are allocated in
+ * 'CurrentMemoryContext', and are used for all subsequent tuples until this
+ * function is called again.
+ */
+void		fill_message_metadata(MessageMetadataState state, rd_kafka_message_t * message);
+
+/**
+ * Fill 'values' and 'nulls' (of a record of the table) from 'payload_values'
+ * and 'payload_nulls' (of a record of 'payload_tupledesc') and the metadata
+ * extracted last. Values are not copied.
+ */
+void		fill_record_with_message_metadata(MessageMetadataState state, Datum *payload_values, bool *payload_nulls, Datum *values, bool *nulls);
+
+
+#endif   /* KADB_FDW_MESSAGE_METADATA_INCLUDED */
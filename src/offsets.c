@@ -7,7 +7,6 @@
 #include <cdb/cdbvars.h>
 #include <executor/spi.h>
 #include <nodes/makefuncs.h>
-#include <tcop/tcopprot.h>
 #include <utils/memutils.h>
 
 #include "utils/kadb_gp_utils.h"
@@ -51,39 +50,6 @@ temporary_namespace_name(void)
 	return name;
 }
 
-/**
- * A wrapper around 'SPI_execute()' which fails with 'ereport(ERROR)' if an
- * error happens.
- *
- * @note Unexpected errors may happen if 'read_only' is set. In addition,
- * 'tcount' imposes a hard limit on the number of tuples processed. Use these
- * parameters cautiously.
- */
-static inline void
-execute_spi_or_error(const char *query, bool read_only, int64 tcount)
-{
-	const char *old_debug_query_string = debug_query_string;
-
-	debug_query_string = query;
-
-	int			r;
-
-	PG_TRY();
-	{
-		r = SPI_execute(query, read_only, tcount);
-	}
-	PG_CATCH();
-	{
-		debug_query_string = old_debug_query_string;
-		PG_RE_THROW();
-	}
-	PG_END_TRY();
-	debug_query_string = old_debug_query_string;
-
-	if (r < 0)
-		ereport(ERROR, (errcode(ERRCODE_SQL_ROUTINE_EXCEPTION), errmsg("Kafka-ADB: Failed to execute '%s' via SPI: %s [%d]", query, SPI_result_code_string(r), r)));
-}
-
 Oid
 create_distributed_table(Oid ftoid)
 {
@@ -1,5 +1,6 @@
 #include "planning.h"
 
+#include <access/sysattr.h>
 #include <cdb/cdbutil.h>
 #include <nodes/makefuncs.h>
 #include <nodes/value.h>
@@ -7,12 +8,18 @@
 #include <optimizer/pathnode.h>
 #include <optimizer/planmain.h>
 #include <optimizer/restrictinfo.h>
+#include <optimizer/var.h>
+#include <rewrite/rewriteManip.h>
 #include <utils/faultinjector.h>
 
 #include "kafka_consumer.h"
 #include "offsets.h"
 #include "settings.h"
 
+#include "deserialization/format.h"
+#include "deserialization/protobuf_deserializer.h"
+#include "deserialization/record_filter.h"
+
 
 /**
  * A state used during query planning.
@@ -274,6 +281,14 @@ kadbGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid
 	options = lappend(options, makeDefElem(KADB_SETTING__PARTITION_DISTRIBUTION, (Node *) get_partition_distribution(partitions)));
 	options = lappend(options, makeDefElem(KADB_SETTING__PARTITIONS_ABSENT, (Node *) get_absent_partitions(foreigntableid, partitions)));
 
+	options = lappend(options, makeDefElem(KADB_SETTING__COLUMN_OPTIONS, (Node *) get_and_validate_column_options(foreigntableid)));
+
+	/* Segments may not have access to the file; send its contents instead */
+	DefElem    *protobuf_descriptor_set_file = get_option(options, KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE);
+
+	if (PointerIsValid(protobuf_descriptor_set_file))
+		options = lappend(options, makeDefElem(KADB_SETTING__PROTOBUF_DESCRIPTOR_SET, (Node *) makeString(read_protobuf_descriptor_set_file(defGetString(protobuf_descriptor_set_file)))));
+
 	/* CREATE a distributed offsets' table */
 	options = lappend(options, makeDefElem(KADB_SETTING__DISTRIBUTED_TABLE, (Node *) makeInteger(create_distributed_table(foreigntableid))));
 
@@ -294,9 +309,19 @@ kadbGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
 	Cost		run_cost;
 	Cost		total_cost;
 
+	/* Deserialization format is validated when options are parsed */
+	List	   *options = pstate->execution_data;
+	const DeserializationFormatRoutine *format = resolve_deserialization_format(defGetString(get_option(options, KADB_SETTING_FORMAT)));
+	Cost		record_cost;
+
+	if (PointerIsValid(format->estimate_cost))
+		record_cost = format->estimate_cost(options, baserel->max_attr);
+	else
+		record_cost = cpu_operator_cost * baserel->max_attr;
+
 	/* TODO: Improve cost calculation */
 	startup_cost = baserel->baserestrictcost.startup;
-	run_cost = random_page_cost * pstate->partitions * 10;
+	run_cost = random_page_cost * pstate->partitions * 10 + record_cost * baserel->rows;
 	total_cost = startup_cost + run_cost;
 
 	add_path(baserel, (Path *) create_foreignscan_path(
@@ -311,14 +336,131 @@ kadbGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid)
 													   ));
 }
 
+/**
+ * Get a list of attributes of 'baserel' referenced by the query, i.e. present
+ * in its target list or in its restriction clauses.
+ *
+ * @param all_required set to 'true' if the query requires all attributes (a
+ * whole-row reference is present). The result is NIL in this case.
+ *
+ * @return a list of Int: attribute numbers (starting at 1)
+ */
+static List *
+get_required_attributes(RelOptInfo *baserel, bool *all_required)
+{
+	Bitmapset  *attrs_used = NULL;
+	List	   *result = NIL;
+	ListCell   *it;
+	int			attidx;
+
+	*all_required = false;
+
+	pull_varattnos((Node *) baserel->reltargetlist, baserel->relid, &attrs_used);
+	foreach(it, baserel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(it);
+
+		pull_varattnos((Node *) rinfo->clause, baserel->relid, &attrs_used);
+	}
+
+	/* 'bms_first_member()' consumes 'attrs_used' */
+	while ((attidx = bms_first_member(attrs_used)) >= 0)
+	{
+		/* 'attidx' is offset by 'FirstLowInvalidHeapAttributeNumber' */
+		AttrNumber	attnum = attidx + FirstLowInvalidHeapAttributeNumber;
+
+		if (attnum == 0)
+		{
+			/* Whole-row reference */
+			*all_required = true;
+			list_free(result);
+			result = NIL;
+			break;
+		}
+		/* System attributes are not deserialized */
+		if (attnum < 0)
+			continue;
+
+		result = lappend_int(result, attnum);
+	}
+
+	bms_free(attrs_used);
+	return result;
+}
+
+/**
+ * Split 'scan_clauses' (a list of RestrictInfo) of 'baserel' into the ones
+ * evaluated by the deserializer and the ones evaluated by the executor.
+ *
+ * Clauses referencing message metadata columns are left to the executor, as
+ * the deserializer does not produce their values.
+ *
+ * @param early_quals set to the clauses for the deserializer, with Vars of
+ * 'RECORD_FILTER_VARNO'
+ *
+ * @return the clauses for the executor
+ */
+static List *
+split_scan_clauses(RelOptInfo *baserel, List *scan_clauses, List *options, List **early_quals)
+{
+	List	   *result = NIL;
+	ListCell   *it;
+
+	*early_quals = NIL;
+
+	foreach(it, scan_clauses)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(it);
+		AttrNumber	attnum;
+
+		Assert(IsA(rinfo, RestrictInfo));
+		/* The same as 'extract_actual_clauses()' does */
+		if (rinfo->pseudoconstant)
+			continue;
+
+		if (
+			is_record_filter_clause(rinfo->clause, baserel->relid, &attnum)
+			&& !PointerIsValid(get_column_option(options, attnum, KADB_SETTING_KAFKA_METADATA))
+			)
+		{
+			Expr	   *clause = copyObject(rinfo->clause);
+
+			ChangeVarNodes((Node *) clause, baserel->relid, RECORD_FILTER_VARNO, 0);
+			*early_quals = lappend(*early_quals, clause);
+		}
+		else
+			result = lappend(result, rinfo->clause);
+	}
+
+	return result;
+}
+
 ForeignScan *
 kadbGetForeignPlan(PlannerInfo *root, RelOptInfo *baserel, Oid foreigntableid, ForeignPath *best_path, List *tlist, List *scan_clauses)
 {
+	List	   *execution_data = list_copy(best_path->fdw_private);
+	bool		all_attributes_required;
+	List	   *attributes_required = get_required_attributes(baserel, &all_attributes_required);
+
+	/*
+	 * When the option is absent, all attributes are deserialized. An empty
+	 * list means no attribute is required (e.g. in 'SELECT count(*)').
+	 */
+	if (!all_attributes_required)
+		execution_data = lappend(execution_data, makeDefElem(KADB_SETTING__ATTRIBUTES_REQUIRED, (Node *) attributes_required));
+
+	/* Records that fail simple conditions are discarded before tuples are formed */
+	List	   *early_quals;
+	List	   *local_clauses = split_scan_clauses(baserel, scan_clauses, execution_data, &early_quals);
+
+	if (early_quals != NIL)
+		execution_data = lappend(execution_data, makeDefElem(KADB_SETTING__EARLY_QUALS, (Node *) early_quals));
+
 	return make_foreignscan(
 							tlist,
-							extract_actual_clauses(scan_clauses, false),
+							local_clauses,
 							baserel->relid,
 							NIL,
-							best_path->fdw_private
+							execution_data
 		);
 }
@@ -1,10 +1,17 @@
 #include "settings.h"
 
 #include <foreign/fdwapi.h>
+#include <foreign/foreign.h>
+#include <mb/pg_wchar.h>
 #include <nodes/makefuncs.h>
 #include <utils/faultinjector.h>
+#include <utils/lsyscache.h>
 
 #include "deserialization/format.h"
+#include "deserialization/json_deserializer.h"
+#include "deserialization/protobuf_deserializer.h"
+#include "deserialization/value_cache.h"
+#include "utils/kadb_decode_pool.h"
 
 
 #define STREQ(a, b) (strcmp(a, b) == 0)
@@ -14,7 +21,8 @@
 
 /**
  * A list of all valid options' identifiers. Currently used only by
- * 'validate_options()'.
+ * 'validate_options()'. Options of deserialization formats are listed by the
+ * formats.
  *
  * NOTE: All new options must be added here.
  */
@@ -27,11 +35,19 @@ static const char *ValidOptions[] = {
 	KADB_SETTING_K_AUTOMATIC_OFFSETS,
 	KADB_SETTING_K_SEG_BATCH,
 	KADB_SETTING_K_TIMEOUT_MS,
+	KADB_SETTING_K_REJECT_LIMIT,
+	KADB_SETTING_K_LOG_ERRORS,
 	KADB_SETTING_K_SECURITY_PROTOCOL,
+	KADB_SETTING_K_ENCODING,
+	KADB_SETTING_K_DECODE_THREADS,
+	KADB_SETTING_PAYLOAD_COMPRESSION,
 
 #ifdef FAULT_INJECTOR
 	KADB_SETTING_K_TUPLES_PER_PARTITION_ON_INJECT,
 #endif
+#ifdef FAULT_INJECTOR
+	KADB_SETTING_PAYLOAD_DATA_ON_INJECT,
+#endif
 
 	KADB_SETTING_KERBEROS_KEYTAB,
 	KADB_SETTING_KERBEROS_PRINCIPAL,
@@ -40,25 +56,46 @@ static const char *ValidOptions[] = {
 
 	KADB_SETTING_FORMAT,
 
-	KADB_SETTING_AVRO_SCHEMA,
 	KADB_SETTING_AVRO_SCHEMA_HISTORICAL,
 
-	KADB_SETTING_CSV_QUOTE,
-	KADB_SETTING_CSV_DELIMITER,
-	KADB_SETTING_CSV_NULL_STRING,
-	KADB_SETTING_CSV_IGNORE_HEADER,
-	KADB_SETTING_CSV_ATTRIBUTE_TRIM_WHITESPACE,
-
 #ifdef FAULT_INJECTOR
 	KADB_SETTING_CSV_DATA_ON_INJECT,
 #endif
 #ifdef FAULT_INJECTOR
 	KADB_SETTING_TEXT_DATA_ON_INJECT,
 #endif
+#ifdef FAULT_INJECTOR
+	KADB_SETTING_JSON_DATA_ON_INJECT,
+#endif
+#ifdef FAULT_INJECTOR
+	KADB_SETTING_PROTOBUF_DATA_ON_INJECT,
+#endif
+#ifdef FAULT_INJECTOR
+	KADB_SETTING_RAW_DATA_ON_INJECT,
+#endif
+#ifdef FAULT_INJECTOR
+	KADB_SETTING_PGBINARY_DATA_ON_INJECT,
+#endif
 
 	KADB_SETTING__PARTITION_DISTRIBUTION,
 	KADB_SETTING__PARTITIONS_ABSENT,
-	KADB_SETTING__DISTRIBUTED_TABLE
+	KADB_SETTING__DISTRIBUTED_TABLE,
+	KADB_SETTING__ATTRIBUTES_REQUIRED,
+	KADB_SETTING__COLUMN_OPTIONS,
+	KADB_SETTING__PROTOBUF_DESCRIPTOR_SET,
+	KADB_SETTING__EARLY_QUALS
+};
+
+/**
+ * A list of all valid column options' identifiers. Column options of
+ * deserialization formats are listed by the formats.
+ *
+ * NOTE: All new column options must be added here.
+ */
+static const char *ValidColumnOptions[] = {
+	KADB_SETTING_KAFKA_METADATA,
+	KADB_SETTING_KAFKA_KEY_FORMAT,
+	KADB_SETTING_VALUE_CACHE
 };
 
 
@@ -254,43 +291,6 @@ parse_authentication_options(List *options, bool check_required)
 		ereport(ERROR, (errcode(ERRCODE_FDW_DYNAMIC_PARAMETER_VALUE_NEEDED), errmsg("Kafka-ADB: '%s' OPTION is required to enable Kerberos authentication", KADB_SETTING_K_SECURITY_PROTOCOL)));
 }
 
-/**
- * Parse (change types, if necessary) and validate settings for CSV
- * deserialization format.
- */
-static void
-parse_csv_options(List *options)
-{
-	ListCell   *it;
-
-	foreach(it, options)
-	{
-		DefElem    *option = (DefElem *) lfirst(it);
-		const char *key = option->defname;
-
-		if (
-			STREQ(key, KADB_SETTING_CSV_DELIMITER)
-			|| STREQ(key, KADB_SETTING_CSV_QUOTE)
-			)
-		{
-			char	   *value = defGetString(option);
-
-			if (strnlen(value, 2) != 1)
-			{
-				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be a single character", key)));
-			}
-		}
-		else if (STREQ(key, KADB_SETTING_CSV_IGNORE_HEADER))
-		{
-			defGetBoolean(option);
-		}
-		else if (STREQ(key, KADB_SETTING_CSV_ATTRIBUTE_TRIM_WHITESPACE))
-		{
-			defGetBoolean(option);
-		}
-	}
-}
-
 #ifdef FAULT_INJECTOR
 /**
  * Parse (change types, if necessary) and validate fault injector settings in
@@ -357,6 +357,56 @@ parse_inject_csv_options(List *options, bool check_required)
 	}
 }
 
+static void
+parse_inject_json_options(List *options, bool check_required)
+{
+	bool		provided_json_data_on_inject = false;
+
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+		const char *key = option->defname;
+
+		if (STREQ(key, KADB_SETTING_JSON_DATA_ON_INJECT))
+		{
+			provided_json_data_on_inject = true;
+		}
+	}
+
+	if (check_required)
+	{
+		if (!provided_json_data_on_inject)
+			ERROR_SETTING_REQUIRED(KADB_SETTING_JSON_DATA_ON_INJECT);
+	}
+}
+
+static void
+parse_inject_protobuf_options(List *options, bool check_required)
+{
+	bool		provided_protobuf_data_on_inject = false;
+
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+		const char *key = option->defname;
+
+		if (STREQ(key, KADB_SETTING_PROTOBUF_DATA_ON_INJECT))
+		{
+			provided_protobuf_data_on_inject = true;
+		}
+	}
+
+	if (check_required)
+	{
+		if (!provided_protobuf_data_on_inject)
+			ERROR_SETTING_REQUIRED(KADB_SETTING_PROTOBUF_DATA_ON_INJECT);
+	}
+}
+
 static void
 parse_inject_text_options(List *options, bool check_required)
 {
@@ -381,6 +431,81 @@ parse_inject_text_options(List *options, bool check_required)
 			ERROR_SETTING_REQUIRED(KADB_SETTING_TEXT_DATA_ON_INJECT);
 	}
 }
+
+static void
+parse_inject_raw_options(List *options, bool check_required)
+{
+	bool		provided_raw_data_on_inject = false;
+
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+		const char *key = option->defname;
+
+		if (STREQ(key, KADB_SETTING_RAW_DATA_ON_INJECT))
+		{
+			provided_raw_data_on_inject = true;
+		}
+	}
+
+	if (check_required)
+	{
+		if (!provided_raw_data_on_inject)
+			ERROR_SETTING_REQUIRED(KADB_SETTING_RAW_DATA_ON_INJECT);
+	}
+}
+
+static void
+parse_inject_pgbinary_options(List *options, bool check_required)
+{
+	bool		provided_pgbinary_data_on_inject = false;
+
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+		const char *key = option->defname;
+
+		if (STREQ(key, KADB_SETTING_PGBINARY_DATA_ON_INJECT))
+		{
+			provided_pgbinary_data_on_inject = true;
+		}
+	}
+
+	if (check_required)
+	{
+		if (!provided_pgbinary_data_on_inject)
+			ERROR_SETTING_REQUIRED(KADB_SETTING_PGBINARY_DATA_ON_INJECT);
+	}
+}
+
+static void
+parse_inject_payload_options(List *options, bool check_required)
+{
+	bool		provided_payload_data_on_inject = false;
+
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+		const char *key = option->defname;
+
+		if (STREQ(key, KADB_SETTING_PAYLOAD_DATA_ON_INJECT))
+		{
+			provided_payload_data_on_inject = true;
+		}
+	}
+
+	if (check_required)
+	{
+		if (!provided_payload_data_on_inject)
+			ERROR_SETTING_REQUIRED(KADB_SETTING_PAYLOAD_DATA_ON_INJECT);
+	}
+}
 #endif
 
 /**
@@ -399,6 +524,8 @@ parse_options(List *options, bool check_required)
 	bool		provided_k_seg_batch = false;
 	bool		provided_k_timeout_ms = false;
 	bool		provided_k_automatic_offsets = false;
+	bool		provided_k_reject_limit = false;
+	bool		log_errors = false;
 	bool		provided_format = false;
 
 	ListCell   *it;
@@ -442,10 +569,39 @@ parse_options(List *options, bool check_required)
 			provided_k_timeout_ms = true;
 			def_string_to_int64(&option->arg, key);
 		}
+		else if (STREQ(key, KADB_SETTING_K_REJECT_LIMIT))
+		{
+			provided_k_reject_limit = true;
+			def_string_to_int64(&option->arg, key);
+			if (defGetInt64(option) < 1)
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be a positive integer value", key)));
+		}
+		else if (STREQ(key, KADB_SETTING_K_LOG_ERRORS))
+		{
+			log_errors = defGetBoolean(option);
+		}
+		else if (STREQ(key, KADB_SETTING_K_DECODE_THREADS))
+		{
+			def_string_to_int64(&option->arg, key);
+			if (defGetInt64(option) < 0 || defGetInt64(option) > DECODE_POOL_MAX_THREADS)
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be an integer between 0 and %d", key, DECODE_POOL_MAX_THREADS)));
+		}
+		else if (STREQ(key, KADB_SETTING_K_ENCODING))
+		{
+			if (pg_char_to_encoding(defGetString(option)) < 0)
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION is set to unknown encoding '%s'", key, defGetString(option))));
+		}
+		else if (STREQ(key, KADB_SETTING_PAYLOAD_COMPRESSION))
+		{
+			const char *value = defGetString(option);
+
+			if (!STREQ(value, KADB_PAYLOAD_COMPRESSION_NONE) && !STREQ(value, KADB_PAYLOAD_COMPRESSION_GZIP) && !STREQ(value, KADB_PAYLOAD_COMPRESSION_ZSTD) && !STREQ(value, KADB_PAYLOAD_COMPRESSION_LZ4) && !STREQ(value, KADB_PAYLOAD_COMPRESSION_SNAPPY))
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be one of '%s', '%s', '%s', '%s', '%s'", key, KADB_PAYLOAD_COMPRESSION_NONE, KADB_PAYLOAD_COMPRESSION_GZIP, KADB_PAYLOAD_COMPRESSION_ZSTD, KADB_PAYLOAD_COMPRESSION_LZ4, KADB_PAYLOAD_COMPRESSION_SNAPPY)));
+		}
 		else if (STREQ(key, KADB_SETTING_FORMAT))
 		{
 			provided_format = true;
-			if (resolve_deserialization_format(defGetString(option)) == DESERIALIZATION_FORMAT_INVALID)
+			if (!PointerIsValid(resolve_deserialization_format(defGetString(option))))
 				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION is set to unknown value '%s'", key, strVal(option->arg))));
 		}
 	}
@@ -468,6 +624,8 @@ parse_options(List *options, bool check_required)
 			ERROR_SETTING_REQUIRED(KADB_SETTING_K_TIMEOUT_MS);
 		if (!provided_format)
 			ERROR_SETTING_REQUIRED(KADB_SETTING_FORMAT);
+		if (log_errors && !provided_k_reject_limit)
+			ereport(ERROR, (errcode(ERRCODE_FDW_DYNAMIC_PARAMETER_VALUE_NEEDED), errmsg("Kafka-ADB: '%s' OPTION is required to log errors", KADB_SETTING_K_REJECT_LIMIT)));
 	}
 
 	/*
@@ -477,18 +635,10 @@ parse_options(List *options, bool check_required)
 	 */
 	if (PointerIsValid(get_option(options, KADB_SETTING_FORMAT)))
 	{
-		switch (resolve_deserialization_format(defGetString(get_option(options, KADB_SETTING_FORMAT))))
-		{
-			case AVRO:
-				break;
-			case CSV:
-				parse_csv_options(options);
-				break;
-			case TEXT:
-				break;
-			default:
-				Assert(false);
-		}
+		const DeserializationFormatRoutine *format = resolve_deserialization_format(defGetString(get_option(options, KADB_SETTING_FORMAT)));
+
+		if (PointerIsValid(format->validate_options))
+			format->validate_options(options, check_required);
 	}
 
 #ifdef FAULT_INJECTOR
@@ -498,18 +648,32 @@ parse_options(List *options, bool check_required)
 		parse_inject_csv_options(options, check_required);
 	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_text") == FaultInjectorTypeSkip)
 		parse_inject_text_options(options, check_required);
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_json") == FaultInjectorTypeSkip)
+		parse_inject_json_options(options, check_required);
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_protobuf") == FaultInjectorTypeSkip)
+		parse_inject_protobuf_options(options, check_required);
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_raw") == FaultInjectorTypeSkip)
+		parse_inject_raw_options(options, check_required);
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_pgbinary") == FaultInjectorTypeSkip)
+		parse_inject_pgbinary_options(options, check_required);
+	if (SIMPLE_FAULT_INJECTOR("kadb_fdw_inject_payload") == FaultInjectorTypeSkip)
+		parse_inject_payload_options(options, check_required);
 #endif
 
 	parse_authentication_options(options, check_required);
 }
 
 /**
- * Report unknown options by 'ereport(WARNING)'.
+ * Report options unknown to 'valid_options' (of size 'valid_options_l') and to
+ * deserialization formats by 'ereport(WARNING)'.
  *
- * This method requires a complete set of supported options in
+ * This method requires a complete set of supported options (except the ones of
+ * formats) in 'valid_options'.
+ *
+ * @param is_column_option whether 'options' are column options
  */
 static void
-report_unknown_options(List *options)
+report_unknown_options(List *options, const char **valid_options, size_t valid_options_l, bool is_column_option)
 {
 	ListCell   *it;
 
@@ -519,14 +683,16 @@ report_unknown_options(List *options)
 		size_t		i;
 		bool		option_found = false;
 
-		for (i = 0; i < sizeof(ValidOptions) / sizeof(ValidOptions[0]); i++)
+		for (i = 0; i < valid_options_l; i++)
 		{
-			if (STREQ(option, ValidOptions[i]))
+			if (STREQ(option, valid_options[i]))
 			{
 				option_found = true;
 				break;
 			}
 		}
+		if (!option_found)
+			option_found = is_deserialization_format_option(option, is_column_option);
 		if (!option_found)
 		{
 			ereport(WARNING,
@@ -570,6 +736,94 @@ validate_options(List **options, bool check_required)
 {
 	collate_options(options);
 	convert_historical_options(options);
-	report_unknown_options(*options);
+	report_unknown_options(*options, ValidOptions, sizeof(ValidOptions) / sizeof(ValidOptions[0]), false);
 	parse_options(*options, check_required);
 }
+
+List *
+get_and_validate_column_options(Oid foreigntableid)
+{
+	List	   *result = NIL;
+	int			natts = get_relnatts(foreigntableid);
+
+	for (AttrNumber attnum = 1; attnum <= natts; attnum++)
+	{
+		List	   *column_options = GetForeignColumnOptions(foreigntableid, attnum);
+
+		validate_column_options(column_options);
+		result = lappend(result, column_options);
+	}
+
+	return result;
+}
+
+DefElem *
+get_column_option(List *options, AttrNumber attnum, const char *key)
+{
+	DefElem    *column_options = get_option(options, KADB_SETTING__COLUMN_OPTIONS);
+
+	if (!PointerIsValid(column_options) || attnum < 1 || attnum > list_length((List *) column_options->arg))
+		return NULL;
+
+	return get_option((List *) list_nth((List *) column_options->arg, attnum - 1), key);
+}
+
+void
+validate_column_options(List *options)
+{
+	report_unknown_options(options, ValidColumnOptions, sizeof(ValidColumnOptions) / sizeof(ValidColumnOptions[0]), true);
+
+	ListCell   *it;
+
+	foreach(it, options)
+	{
+		DefElem    *option = (DefElem *) lfirst(it);
+		const char *key = option->defname;
+
+		if (STREQ(key, KADB_SETTING_JSON_PATH))
+		{
+			/* Errors are reported by the parser */
+			parse_json_path(defGetString(option));
+		}
+		else if (STREQ(key, KADB_SETTING_PROTOBUF_FIELD))
+		{
+			validate_protobuf_field_reference(defGetString(option));
+		}
+		else if (STREQ(key, KADB_SETTING_DEBEZIUM_COLUMN))
+		{
+			char	   *value = defGetString(option);
+
+			if (!STREQ(value, KADB_DEBEZIUM_COLUMN_OP) && !STREQ(value, KADB_DEBEZIUM_COLUMN_KEY))
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be one of '%s', '%s'", key, KADB_DEBEZIUM_COLUMN_OP, KADB_DEBEZIUM_COLUMN_KEY)));
+		}
+		else if (STREQ(key, KADB_SETTING_KAFKA_METADATA))
+		{
+			char	   *value = defGetString(option);
+
+			if (
+				!STREQ(value, KADB_KAFKA_METADATA_PARTITION)
+				&& !STREQ(value, KADB_KAFKA_METADATA_OFFSET)
+				&& !STREQ(value, KADB_KAFKA_METADATA_TIMESTAMP)
+				&& !STREQ(value, KADB_KAFKA_METADATA_KEY)
+				&& !STREQ(value, KADB_KAFKA_METADATA_HEADERS)
+				)
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be one of '%s', '%s', '%s', '%s', '%s'", key, KADB_KAFKA_METADATA_PARTITION, KADB_KAFKA_METADATA_OFFSET, KADB_KAFKA_METADATA_TIMESTAMP, KADB_KAFKA_METADATA_KEY, KADB_KAFKA_METADATA_HEADERS)));
+		}
+		else if (STREQ(key, KADB_SETTING_KAFKA_KEY_FORMAT))
+		{
+			char	   *value = defGetString(option);
+			DefElem    *metadata = get_option(options, KADB_SETTING_KAFKA_METADATA);
+
+			if (!STREQ(value, KADB_KAFKA_KEY_FORMAT_RAW) && !STREQ(value, KADB_KAFKA_KEY_FORMAT_TEXT))
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be one of '%s', '%s'", key, KADB_KAFKA_KEY_FORMAT_RAW, KADB_KAFKA_KEY_FORMAT_TEXT)));
+			if (!PointerIsValid(metadata) || !STREQ(defGetString(metadata), KADB_KAFKA_METADATA_KEY))
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION can only be set for a column with '%s' '%s'", key, KADB_SETTING_KAFKA_METADATA, KADB_KAFKA_METADATA_KEY)));
+		}
+		else if (STREQ(key, KADB_SETTING_VALUE_CACHE))
+		{
+			def_string_to_int64(&option->arg, key);
+			if (defGetInt64(option) < 1 || defGetInt64(option) > VALUE_CACHE_MAX_ENTRIES)
+				ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE), errmsg("Kafka-ADB: '%s' OPTION must be an integer between 1 and %d", key, VALUE_CACHE_MAX_ENTRIES)));
+		}
+	}
+}
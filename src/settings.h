@@ -32,14 +32,43 @@
 #define KADB_SETTING_K_SEG_BATCH "k_seg_batch"
 /* Kafka request timeout */
 #define KADB_SETTING_K_TIMEOUT_MS "k_timeout_ms"
+/*
+ * Maximum number of messages rejected (skipped) by one segment in a single
+ * SELECT because they failed to be deserialized. If not set, such messages
+ * are not rejected, and the SELECT fails
+ */
+#define KADB_SETTING_K_REJECT_LIMIT "k_reject_limit"
+/* Record rejected messages in the error log table */
+#define KADB_SETTING_K_LOG_ERRORS "k_log_errors"
 /* Security protocol to use with Kafka (supported values: 'sasl_plaintext', 'sasl_ssl') */
 #define KADB_SETTING_K_SECURITY_PROTOCOL "k_security_protocol"
+/* Encoding of textual messages; they are converted to the database encoding */
+#define KADB_SETTING_K_ENCODING "k_encoding"
+/* The number of worker threads decoding messages ahead on each segment */
+#define KADB_SETTING_K_DECODE_THREADS "k_decode_threads"
+/* Compression of message payloads applied by producers */
+#define KADB_SETTING_PAYLOAD_COMPRESSION "payload_compression"
+/* KADB_SETTING_PAYLOAD_COMPRESSION value: payloads are not compressed (default) */
+#define KADB_PAYLOAD_COMPRESSION_NONE "none"
+/* KADB_SETTING_PAYLOAD_COMPRESSION value: gzip (or zlib) */
+#define KADB_PAYLOAD_COMPRESSION_GZIP "gzip"
+/* KADB_SETTING_PAYLOAD_COMPRESSION value: zstd frames */
+#define KADB_PAYLOAD_COMPRESSION_ZSTD "zstd"
+/* KADB_SETTING_PAYLOAD_COMPRESSION value: LZ4 frames */
+#define KADB_PAYLOAD_COMPRESSION_LZ4 "lz4"
+/* KADB_SETTING_PAYLOAD_COMPRESSION value: raw snappy (no framing) */
+#define KADB_PAYLOAD_COMPRESSION_SNAPPY "snappy"
 
 #ifdef FAULT_INJECTOR
 /* Number of tuples for fault injector to return for each partition */
 #define KADB_SETTING_K_TUPLES_PER_PARTITION_ON_INJECT "k_tuples_per_partition_on_inject"
 #endif
 
+#ifdef FAULT_INJECTOR
+/* A base64-encoded compressed payload to inject as the payload of each message */
+#define KADB_SETTING_PAYLOAD_DATA_ON_INJECT "payload_data_on_inject"
+#endif
+
 /*
  * Kerberos keytab file location. If this setting is given, Kerberos
  * authentication is assumed.
@@ -59,6 +88,12 @@
 #define KADB_SETTING_AVRO_SCHEMA "avro_schema"
 /* AVRO: Historical name for KADB_SETTING_AVRO_SCHEMA */
 #define KADB_SETTING_AVRO_SCHEMA_HISTORICAL "schema"
+/* AVRO: How attributes are mapped to AVRO fields */
+#define KADB_SETTING_AVRO_MAPPING "avro_mapping"
+/* AVRO: KADB_SETTING_AVRO_MAPPING value: map by position (default) */
+#define KADB_AVRO_MAPPING_POSITION "position"
+/* AVRO: KADB_SETTING_AVRO_MAPPING value: map by name */
+#define KADB_AVRO_MAPPING_NAME "name"
 
 /* CSV: Quote character */
 #define KADB_SETTING_CSV_QUOTE "csv_quote"
@@ -76,17 +111,90 @@
 #define KADB_SETTING_CSV_DATA_ON_INJECT "csv_data_on_inject"
 #endif
 
+/* TEXT: Each line of a message is a separate record */
+#define KADB_SETTING_TEXT_LINES "text_lines"
+
 #ifdef FAULT_INJECTOR
 /* A string to inject as parser input (for each "message") to test 'text' format */
 #define KADB_SETTING_TEXT_DATA_ON_INJECT "text_data_on_inject"
 #endif
 
+#ifdef FAULT_INJECTOR
+/* A string to inject as parser input (for each "message") to test 'json' format */
+#define KADB_SETTING_JSON_DATA_ON_INJECT "json_data_on_inject"
+#endif
+
+#ifdef FAULT_INJECTOR
+/* A base64-encoded message to inject as parser input to test 'protobuf' format */
+#define KADB_SETTING_PROTOBUF_DATA_ON_INJECT "protobuf_data_on_inject"
+#endif
+
+#ifdef FAULT_INJECTOR
+/* A base64-encoded message to inject as parser input to test 'raw' format */
+#define KADB_SETTING_RAW_DATA_ON_INJECT "raw_data_on_inject"
+#endif
+
+#ifdef FAULT_INJECTOR
+/* A base64-encoded message to inject as parser input to test 'pgbinary' format */
+#define KADB_SETTING_PGBINARY_DATA_ON_INJECT "pgbinary_data_on_inject"
+#endif
+
+/* JSON: Path to the value of a column in a JSON record. Column option */
+#define KADB_SETTING_JSON_PATH "json_path"
+
+/* PROTOBUF: A base64-encoded FileDescriptorSet */
+#define KADB_SETTING_PROTOBUF_DESCRIPTOR_SET "protobuf_descriptor_set"
+/* PROTOBUF: A file containing a FileDescriptorSet (read on master) */
+#define KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE "protobuf_descriptor_set_file"
+/* PROTOBUF: Fully-qualified name of the message type of records */
+#define KADB_SETTING_PROTOBUF_MESSAGE "protobuf_message"
+/* PROTOBUF: Name or number of the field of a column. Column option */
+#define KADB_SETTING_PROTOBUF_FIELD "protobuf_field"
+
+/* DEBEZIUM: Change events are wrapped into Kafka Connect schema envelopes */
+#define KADB_SETTING_DEBEZIUM_SCHEMAS "debezium_schemas"
+/* DEBEZIUM: The part of a change event to fill a column with. Column option */
+#define KADB_SETTING_DEBEZIUM_COLUMN "debezium_column"
+/* KADB_SETTING_DEBEZIUM_COLUMN value: the operation ('c', 'u', 'd', 'r', 't') */
+#define KADB_DEBEZIUM_COLUMN_OP "op"
+/* KADB_SETTING_DEBEZIUM_COLUMN value: a key column, taken from 'before' image of deletions */
+#define KADB_DEBEZIUM_COLUMN_KEY "key"
+
+/* Kafka message metadata to fill a column with. Column option */
+#define KADB_SETTING_KAFKA_METADATA "kafka_metadata"
+/* KADB_SETTING_KAFKA_METADATA value: partition */
+#define KADB_KAFKA_METADATA_PARTITION "partition"
+/* KADB_SETTING_KAFKA_METADATA value: offset */
+#define KADB_KAFKA_METADATA_OFFSET "offset"
+/* KADB_SETTING_KAFKA_METADATA value: timestamp */
+#define KADB_KAFKA_METADATA_TIMESTAMP "timestamp"
+/* KADB_SETTING_KAFKA_METADATA value: key */
+#define KADB_KAFKA_METADATA_KEY "key"
+/* KADB_SETTING_KAFKA_METADATA value: headers */
+#define KADB_KAFKA_METADATA_HEADERS "headers"
+/* Maximum number of distinct converted values to cache. Column option */
+#define KADB_SETTING_VALUE_CACHE "value_cache"
+/* Format of the key of Kafka messages. Column option */
+#define KADB_SETTING_KAFKA_KEY_FORMAT "kafka_key_format"
+/* KADB_SETTING_KAFKA_KEY_FORMAT value: the key is stored as is */
+#define KADB_KAFKA_KEY_FORMAT_RAW "raw"
+/* KADB_SETTING_KAFKA_KEY_FORMAT value: the key is converted by the input function */
+#define KADB_KAFKA_KEY_FORMAT_TEXT "text"
+
 /* Distribution of partitions across segments. Internal option */
 #define KADB_SETTING__PARTITION_DISTRIBUTION "_partition_distribution"
 /* Partitions absent in the offsets table. Internal option */
 #define KADB_SETTING__PARTITIONS_ABSENT "_partitions_absent"
 /* Distributed table name. Internal option */
 #define KADB_SETTING__DISTRIBUTED_TABLE "_distributed_table"
+/* Attributes referenced by the query (absent if all are). Internal option */
+#define KADB_SETTING__ATTRIBUTES_REQUIRED "_attributes_required"
+/* Options of each column, in order of attributes. Internal option */
+#define KADB_SETTING__COLUMN_OPTIONS "_column_options"
+/* Contents of KADB_SETTING_PROTOBUF_DESCRIPTOR_SET_FILE, base64-encoded. Internal option */
+#define KADB_SETTING__PROTOBUF_DESCRIPTOR_SET "_protobuf_descriptor_set"
+/* Conditions evaluated on records by the deserializer (a list of Expr). Internal option */
+#define KADB_SETTING__EARLY_QUALS "_early_quals"
 
 
 /**
@@ -113,5 +221,30 @@ DefElem    *get_option(List *options, const char *key);
  */
 void		validate_options(List **options, bool check_required);
 
+/**
+ * Get column options of all columns of a foreign table with the given
+ * 'foreigntableid'.
+ *
+ * @return a list (one element for each attribute, including dropped ones) of
+ * lists of options
+ */
+List	   *get_and_validate_column_options(Oid foreigntableid);
+
+/**
+ * Get a column option by key for the attribute 'attnum' (starting at 1) from
+ * KADB_SETTING__COLUMN_OPTIONS in 'options'.
+ *
+ * @return NULL if an option is not found
+ */
+DefElem    *get_column_option(List *options, AttrNumber attnum, const char *key);
+
+/**
+ * Validate column 'options' (of a single column).
+ *
+ * Invalid options are reported by 'ereport(ERROR)'.
+ * Unknown options are reported by 'ereport(WARNING)'.
+ */
+void		validate_column_options(List *options);
+
 
 #endif   /* KADB_FDW_SETTINGS_INCLUDED */
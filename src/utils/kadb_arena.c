@@ -0,0 +1,233 @@
+#include "kadb_arena.h"
+
+#include <inttypes.h>
+
+#include <utils/memutils.h>
+
+
+/* The size of the first chunk of an arena */
+#define ARENA_INITIAL_CHUNK_SIZE ((Size) 8 * 1024)
+/* The maximum size chunks grow to (larger allocations get their own chunks) */
+#define ARENA_MAX_CHUNK_SIZE ((Size) 1024 * 1024)
+/* The maximum size of a chunk retained on reset */
+#define ARENA_MAX_RETAINED_CHUNK_SIZE ARENA_MAX_CHUNK_SIZE
+
+#define ARENA_CHUNK_HEADER_SIZE MAXALIGN(sizeof(ArenaChunk))
+#define ARENA_CHUNK_DATA(chunk) ((char *) (chunk) + ARENA_CHUNK_HEADER_SIZE)
+#define ARENA_CHUNK_END(chunk) (ARENA_CHUNK_DATA(chunk) + (chunk)->size)
+
+
+typedef struct ArenaChunk
+{
+	struct ArenaChunk *next;
+	/* The number of bytes available for allocations */
+	Size		size;
+}	ArenaChunk;
+
+/* Definition is in the header */
+struct KadbArenaObject
+{
+	MemoryContext mcxt;
+
+	/* Chunks, the current one first */
+	ArenaChunk *chunks;
+	/* The start of free space in the current chunk */
+	char	   *free;
+	/* The last allocation in the current chunk, or NULL */
+	char	   *last;
+	/* The size of the next chunk to allocate */
+	Size		next_chunk_size;
+
+	/* The number of bytes allocated since the last reset */
+	Size		bytes;
+	KadbArenaStats stats;
+};
+
+
+KadbArena
+kadb_arena_create(MemoryContext mcxt)
+{
+	KadbArena	result = (KadbArena) MemoryContextAllocZero(mcxt, sizeof(struct KadbArenaObject));
+
+	result->mcxt = mcxt;
+	result->next_chunk_size = ARENA_INITIAL_CHUNK_SIZE;
+	return result;
+}
+
+/**
+ * Add a new chunk with at least 'size' bytes available, and make it the
+ * current one.
+ */
+static void
+add_chunk(KadbArena arena, Size size)
+{
+	Size		chunk_size = Max(arena->next_chunk_size, size);
+	ArenaChunk *chunk = (ArenaChunk *) MemoryContextAlloc(arena->mcxt, ARENA_CHUNK_HEADER_SIZE + chunk_size);
+
+	chunk->size = chunk_size;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->free = ARENA_CHUNK_DATA(chunk);
+	arena->last = NULL;
+
+	arena->next_chunk_size = Min(arena->next_chunk_size * 2, ARENA_MAX_CHUNK_SIZE);
+	arena->stats.chunks_allocated += 1;
+}
+
+void *
+kadb_arena_alloc(KadbArena arena, Size size)
+{
+	AssertArg(PointerIsValid(arena));
+
+	size = MAXALIGN(Max(size, 1));
+	if (!PointerIsValid(arena->chunks) || (Size) (ARENA_CHUNK_END(arena->chunks) - arena->free) < size)
+		add_chunk(arena, size);
+
+	char	   *result = arena->free;
+
+	arena->free += size;
+	arena->last = result;
+
+	arena->bytes += size;
+	arena->stats.peak_bytes = Max(arena->stats.peak_bytes, arena->bytes);
+	arena->stats.allocations += 1;
+
+	return result;
+}
+
+void *
+kadb_arena_realloc(KadbArena arena, void *ptr, Size old_size, Size new_size)
+{
+	AssertArg(PointerIsValid(arena));
+
+	if (!PointerIsValid(ptr))
+		return kadb_arena_alloc(arena, new_size);
+
+	arena->stats.reallocations += 1;
+	old_size = MAXALIGN(Max(old_size, 1));
+	new_size = MAXALIGN(Max(new_size, 1));
+
+	if ((char *) ptr == arena->last && (Size) (ARENA_CHUNK_END(arena->chunks) - arena->last) >= new_size)
+	{
+		/* The last allocation is grown (or shrunk) in place */
+		arena->free = arena->last + new_size;
+		arena->bytes = arena->bytes - old_size + new_size;
+		arena->stats.peak_bytes = Max(arena->stats.peak_bytes, arena->bytes);
+		arena->stats.reallocations_in_place += 1;
+		return ptr;
+	}
+	if (new_size <= old_size)
+	{
+		arena->stats.reallocations_in_place += 1;
+		return ptr;
+	}
+
+	void	   *result = kadb_arena_alloc(arena, new_size);
+
+	/* 'kadb_arena_alloc()' is not a reallocation */
+	arena->stats.allocations -= 1;
+	memcpy(result, ptr, old_size);
+	return result;
+}
+
+void
+kadb_arena_free(KadbArena arena, void *ptr, Size size)
+{
+	AssertArg(PointerIsValid(arena));
+
+	if (!PointerIsValid(ptr) || (char *) ptr != arena->last)
+		return;
+
+	arena->free = arena->last;
+	arena->last = NULL;
+	arena->bytes -= Min(arena->bytes, MAXALIGN(Max(size, 1)));
+}
+
+bool
+kadb_arena_contains(KadbArena arena, const void *ptr)
+{
+	AssertArg(PointerIsValid(arena));
+
+	for (ArenaChunk *chunk = arena->chunks; PointerIsValid(chunk); chunk = chunk->next)
+	{
+		if ((const char *) ptr >= ARENA_CHUNK_DATA(chunk) && (const char *) ptr < ARENA_CHUNK_END(chunk))
+			return true;
+	}
+	return false;
+}
+
+void
+kadb_arena_reset(KadbArena arena)
+{
+	AssertArg(PointerIsValid(arena));
+
+	ArenaChunk *retained = arena->chunks;
+
+	if (PointerIsValid(retained) && retained->size > ARENA_MAX_RETAINED_CHUNK_SIZE)
+		retained = NULL;
+
+	ArenaChunk *chunk = PointerIsValid(retained) ? retained->next : arena->chunks;
+
+	while (PointerIsValid(chunk))
+	{
+		ArenaChunk *next = chunk->next;
+
+		pfree(chunk);
+		chunk = next;
+	}
+
+	arena->chunks = retained;
+	if (PointerIsValid(retained))
+	{
+		retained->next = NULL;
+		arena->free = ARENA_CHUNK_DATA(retained);
+	}
+	else
+	{
+		arena->free = NULL;
+		arena->next_chunk_size = ARENA_INITIAL_CHUNK_SIZE;
+	}
+	arena->last = NULL;
+	arena->bytes = 0;
+	arena->stats.resets += 1;
+}
+
+void
+kadb_arena_report_stats(KadbArena arena, const char *name, int elevel)
+{
+	AssertArg(PointerIsValid(arena));
+
+	elog(elevel, "Kafka-ADB: Arena '%s': %" PRIu64 " allocations, %" PRIu64 " reallocations (%" PRIu64 " in place), %" PRIu64 " resets, %" PRIu64 " chunks allocated, %lu bytes at peak",
+		 name,
+		 arena->stats.allocations,
+		 arena->stats.reallocations,
+		 arena->stats.reallocations_in_place,
+		 arena->stats.resets,
+		 arena->stats.chunks_allocated,
+		 (unsigned long) arena->stats.peak_bytes);
+}
+
+const KadbArenaStats *
+kadb_arena_get_stats(KadbArena arena)
+{
+	AssertArg(PointerIsValid(arena));
+
+	return &arena->stats;
+}
+
+void
+kadb_arena_destroy(KadbArena arena)
+{
+	AssertArg(PointerIsValid(arena));
+
+	ArenaChunk *chunk = arena->chunks;
+
+	while (PointerIsValid(chunk))
+	{
+		ArenaChunk *next = chunk->next;
+
+		pfree(chunk);
+		chunk = next;
+	}
+	pfree(arena);
+}
@@ -0,0 +1,90 @@
+#ifndef KADB_FDW_UTILS_KADB_ARENA_INCLUDED
+#define KADB_FDW_UTILS_KADB_ARENA_INCLUDED
+
+/*
+ * A bump (arena) allocator for short-living allocations made by third-party
+ * libraries.
+ *
+ * Memory is handed out sequentially from large chunks, allocated in a memory
+ * context. Individual allocations are not freed (except for the last one);
+ * instead, all of them are released at once by 'kadb_arena_reset()'. The last
+ * allocation can be grown or shrunk in place.
+ *
+ * The caller must pass the size of an allocation to 'kadb_arena_realloc()'
+ * and 'kadb_arena_free()' (the allocator does not store it).
+ */
+
+#include <postgres.h>
+
+
+/* An opaque arena */
+typedef struct KadbArenaObject *KadbArena;
+
+/**
+ * Arena statistics, accumulated since the arena is created.
+ */
+typedef struct KadbArenaStats
+{
+	uint64		allocations;
+	uint64		reallocations;
+	/* Reallocations which did not move the allocation */
+	uint64		reallocations_in_place;
+	uint64		resets;
+	/* Chunks allocated in the memory context */
+	uint64		chunks_allocated;
+	/* The maximum number of bytes allocated between two resets */
+	Size		peak_bytes;
+}	KadbArenaStats;
+
+
+/**
+ * Create an arena allocating chunks in 'mcxt'.
+ */
+KadbArena	kadb_arena_create(MemoryContext mcxt);
+
+/**
+ * Allocate 'size' bytes (MAXALIGNed).
+ */
+void	   *kadb_arena_alloc(KadbArena arena, Size size);
+
+/**
+ * Resize an allocation 'ptr' of 'old_size' bytes to 'new_size' bytes. The
+ * allocation is resized in place if possible; otherwise, its contents are
+ * copied to a new allocation.
+ */
+void	   *kadb_arena_realloc(KadbArena arena, void *ptr, Size old_size, Size new_size);
+
+/**
+ * Free an allocation 'ptr' of 'size' bytes. The memory is only reused if
+ * 'ptr' is the last allocation.
+ */
+void		kadb_arena_free(KadbArena arena, void *ptr, Size size);
+
+/**
+ * Check whether 'ptr' is allocated in 'arena'.
+ */
+bool		kadb_arena_contains(KadbArena arena, const void *ptr);
+
+/**
+ * Release all allocations made in 'arena'. A single chunk is retained for
+ * reuse, unless it is too large.
+ */
+void		kadb_arena_reset(KadbArena arena);
+
+/**
+ * Report statistics of 'arena' named 'name' by 'elog(elevel)'.
+ */
+void		kadb_arena_report_stats(KadbArena arena, const char *name, int elevel);
+
+/**
+ * Get statistics of 'arena'.
+ */
+const KadbArenaStats *kadb_arena_get_stats(KadbArena arena);
+
+/**
+ * Free all memory allocated by 'arena', including 'arena' itself.
+ */
+void		kadb_arena_destroy(KadbArena arena);
+
+
+#endif   /* // KADB_FDW_UTILS_KADB_ARENA_INCLUDED */
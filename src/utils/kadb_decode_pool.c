@@ -0,0 +1,311 @@
+#include "kadb_decode_pool.h"
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <access/xact.h>
+
+
+/* Definition is in the header */
+struct DecodeTaskObject
+{
+	DecodeTaskFunction decode;
+	DecodeTaskFunction discard;
+	void	   *arg;
+	/* Whether 'decode' has been started, and whether it has returned */
+	bool		is_started;
+	bool		is_done;
+
+	/* The next task in the queue of tasks not yet started */
+	struct DecodeTaskObject *queue_next;
+	/* Neighbours in the list of all tasks of the pool */
+	struct DecodeTaskObject *prev;
+	struct DecodeTaskObject *next;
+};
+
+/* Definition is in the header */
+struct DecodePoolObject
+{
+	pthread_mutex_t mutex;
+	/* Signalled when a task is submitted, and when the pool is stopped */
+	pthread_cond_t task_submitted;
+	/* Signalled when a task is done */
+	pthread_cond_t task_done;
+
+	/* Tasks not yet started, in order of submission */
+	DecodeTask queue_head;
+	DecodeTask queue_tail;
+	/* All tasks which are not released */
+	DecodeTask tasks;
+	/* Worker threads are to exit */
+	bool		is_stopping;
+
+	pthread_t  *threads;
+	int			threads_count;
+
+	/* The next pool in 'LivePools' */
+	struct DecodePoolObject *next;
+};
+
+
+/* Pools which are not destroyed yet */
+static DecodePool LivePools = NULL;
+/* Whether 'decode_pools_xact_callback()' is registered */
+static bool XactCallbackIsRegistered = false;
+
+
+/**
+ * Remove the first task from the queue of 'pool'. The mutex must be held.
+ */
+static DecodeTask
+dequeue_task(DecodePool pool)
+{
+	DecodeTask	result = pool->queue_head;
+
+	pool->queue_head = result->queue_next;
+	if (!PointerIsValid(pool->queue_head))
+		pool->queue_tail = NULL;
+	result->queue_next = NULL;
+	result->is_started = true;
+	return result;
+}
+
+/**
+ * The main function of a worker thread.
+ */
+static void *
+worker_main(void *arg)
+{
+	DecodePool	pool = (DecodePool) arg;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;)
+	{
+		while (!PointerIsValid(pool->queue_head) && !pool->is_stopping)
+			pthread_cond_wait(&pool->task_submitted, &pool->mutex);
+		if (pool->is_stopping)
+			break;
+
+		DecodeTask	task = dequeue_task(pool);
+
+		pthread_mutex_unlock(&pool->mutex);
+		task->decode(task->arg);
+		pthread_mutex_lock(&pool->mutex);
+
+		task->is_done = true;
+		pthread_cond_broadcast(&pool->task_done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+/**
+ * Stop and join all worker threads of 'pool'.
+ */
+static void
+stop_workers(DecodePool pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->is_stopping = true;
+	pthread_cond_broadcast(&pool->task_submitted);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (int i = 0; i < pool->threads_count; i++)
+		pthread_join(pool->threads[i], NULL);
+	pool->threads_count = 0;
+}
+
+/**
+ * Free 'pool' and all of its tasks. Worker threads must be stopped.
+ */
+static void
+free_pool(DecodePool pool)
+{
+	while (PointerIsValid(pool->tasks))
+	{
+		DecodeTask	task = pool->tasks;
+
+		pool->tasks = task->next;
+		task->discard(task->arg);
+		free(task);
+	}
+
+	pthread_cond_destroy(&pool->task_done);
+	pthread_cond_destroy(&pool->task_submitted);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+}
+
+/**
+ * Destroy pools left at the end of a transaction.
+ */
+static void
+decode_pools_xact_callback(XactEvent event, void *arg)
+{
+	if (event != XACT_EVENT_COMMIT && event != XACT_EVENT_ABORT)
+		return;
+
+	while (PointerIsValid(LivePools))
+		decode_pool_destroy(LivePools);
+}
+
+DecodePool
+decode_pool_create(int threads)
+{
+	AssertArg(threads > 0 && threads <= DECODE_POOL_MAX_THREADS);
+
+	if (!XactCallbackIsRegistered)
+	{
+		RegisterXactCallback(decode_pools_xact_callback, NULL);
+		XactCallbackIsRegistered = true;
+	}
+
+	DecodePool	result = (DecodePool) calloc(1, sizeof(struct DecodePoolObject));
+	pthread_t  *result_threads = (pthread_t *) calloc(threads, sizeof(pthread_t));
+
+	if (!PointerIsValid(result) || !PointerIsValid(result_threads))
+	{
+		free(result);
+		free(result_threads);
+		ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY), errmsg("out of memory")));
+	}
+
+	pthread_mutex_init(&result->mutex, NULL);
+	pthread_cond_init(&result->task_submitted, NULL);
+	pthread_cond_init(&result->task_done, NULL);
+	result->threads = result_threads;
+
+	/* Threads inherit the signal mask */
+	sigset_t	all_signals;
+	sigset_t	old_signals;
+	int			error = 0;
+
+	sigfillset(&all_signals);
+	pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+	for (int i = 0; i < threads && error == 0; i++)
+	{
+		error = pthread_create(&result->threads[i], NULL, worker_main, result);
+		if (error == 0)
+			result->threads_count += 1;
+	}
+	pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+	if (error != 0)
+	{
+		stop_workers(result);
+		free_pool(result);
+		ereport(ERROR, (errcode(ERRCODE_INSUFFICIENT_RESOURCES), errmsg("Kafka-ADB: Failed to create a decode worker thread: %s", strerror(error))));
+	}
+
+	result->next = LivePools;
+	LivePools = result;
+
+	return result;
+}
+
+DecodeTask
+decode_pool_submit(DecodePool pool, DecodeTaskFunction decode, DecodeTaskFunction discard, void *arg)
+{
+	AssertArg(PointerIsValid(pool));
+
+	DecodeTask	task = (DecodeTask) calloc(1, sizeof(struct DecodeTaskObject));
+
+	if (!PointerIsValid(task))
+	{
+		discard(arg);
+		ereport(ERROR, (errcode(ERRCODE_OUT_OF_MEMORY), errmsg("out of memory")));
+	}
+	task->decode = decode;
+	task->discard = discard;
+	task->arg = arg;
+
+	pthread_mutex_lock(&pool->mutex);
+	task->next = pool->tasks;
+	if (PointerIsValid(pool->tasks))
+		pool->tasks->prev = task;
+	pool->tasks = task;
+
+	if (PointerIsValid(pool->queue_tail))
+		pool->queue_tail->queue_next = task;
+	else
+		pool->queue_head = task;
+	pool->queue_tail = task;
+	pthread_cond_signal(&pool->task_submitted);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return task;
+}
+
+void *
+decode_pool_wait(DecodePool pool, DecodeTask task)
+{
+	AssertArg(PointerIsValid(pool) && PointerIsValid(task));
+
+	pthread_mutex_lock(&pool->mutex);
+	if (!task->is_started)
+	{
+		/* Remove the task from the queue and run it here */
+		DecodeTask *link = &pool->queue_head;
+		DecodeTask	previous = NULL;
+
+		while (*link != task)
+		{
+			previous = *link;
+			link = &(*link)->queue_next;
+		}
+		*link = task->queue_next;
+		if (pool->queue_tail == task)
+			pool->queue_tail = previous;
+		task->queue_next = NULL;
+		task->is_started = true;
+		pthread_mutex_unlock(&pool->mutex);
+
+		task->decode(task->arg);
+
+		pthread_mutex_lock(&pool->mutex);
+		task->is_done = true;
+	}
+	while (!task->is_done)
+		pthread_cond_wait(&pool->task_done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return task->arg;
+}
+
+void
+decode_pool_release(DecodePool pool, DecodeTask task)
+{
+	AssertArg(PointerIsValid(pool) && PointerIsValid(task));
+
+	decode_pool_wait(pool, task);
+
+	pthread_mutex_lock(&pool->mutex);
+	if (PointerIsValid(task->prev))
+		task->prev->next = task->next;
+	else
+		pool->tasks = task->next;
+	if (PointerIsValid(task->next))
+		task->next->prev = task->prev;
+	pthread_mutex_unlock(&pool->mutex);
+
+	task->discard(task->arg);
+	free(task);
+}
+
+void
+decode_pool_destroy(DecodePool pool)
+{
+	AssertArg(PointerIsValid(pool));
+
+	DecodePool *link = &LivePools;
+
+	while (PointerIsValid(*link) && *link != pool)
+		link = &(*link)->next;
+	if (PointerIsValid(*link))
+		*link = pool->next;
+
+	stop_workers(pool);
+	free_pool(pool);
+}
@@ -0,0 +1,71 @@
+#ifndef KADB_FDW_UTILS_KADB_DECODE_POOL_INCLUDED
+#define KADB_FDW_UTILS_KADB_DECODE_POOL_INCLUDED
+
+/*
+ * A pool of worker threads decoding messages ahead of the backend.
+ *
+ * A task is a function called in a worker thread with an argument allocated
+ * by malloc. Neither may call any PostgreSQL functions (including palloc and
+ * ereport) or access memory allocated by palloc: the backend is not
+ * thread-safe, and its memory may be released while a worker is running.
+ *
+ * The pool owns its tasks, including their arguments, until they are
+ * released. Pools that are not destroyed by the end of the transaction (e.g.
+ * because of an ERROR) are destroyed then, and their tasks are discarded.
+ */
+
+#include <postgres.h>
+
+
+/* The maximum number of threads of a pool */
+#define DECODE_POOL_MAX_THREADS 64
+
+
+/* An opaque pool of worker threads */
+typedef struct DecodePoolObject *DecodePool;
+
+/* An opaque task of a pool */
+typedef struct DecodeTaskObject *DecodeTask;
+
+/**
+ * A function run by a worker thread, or to release the argument of a task.
+ */
+typedef void (*DecodeTaskFunction) (void *arg);
+
+
+/**
+ * Create a pool of 'threads' worker threads.
+ *
+ * Worker threads block all signals, so that signals are handled by the
+ * backend thread only.
+ */
+DecodePool	decode_pool_create(int threads);
+
+/**
+ * Submit a task running 'decode' with 'arg' in a worker thread.
+ *
+ * @param discard a function to release 'arg' when the task is released or
+ * discarded. It is called in an arbitrary thread
+ */
+DecodeTask	decode_pool_submit(DecodePool pool, DecodeTaskFunction decode, DecodeTaskFunction discard, void *arg);
+
+/**
+ * Wait until 'task' is done. A task which is not yet started by a worker is
+ * run by the calling thread.
+ *
+ * @return the argument of 'task', which is still owned by the pool
+ */
+void	   *decode_pool_wait(DecodePool pool, DecodeTask task);
+
+/**
+ * Wait until 'task' is done, and release it together with its argument.
+ */
+void		decode_pool_release(DecodePool pool, DecodeTask task);
+
+/**
+ * Stop worker threads of 'pool', discard all of its tasks, and free it.
+ */
+void		decode_pool_destroy(DecodePool pool);
+
+
+#endif   /* // KADB_FDW_UTILS_KADB_DECODE_POOL_INCLUDED */
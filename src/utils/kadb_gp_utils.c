@@ -1,6 +1,8 @@
 #include "kadb_gp_utils.h"
 
 #include <cdb/cdbutil.h>
+#include <executor/spi.h>
+#include <tcop/tcopprot.h>
 #include <utils/memutils.h>
 
 
@@ -22,3 +24,28 @@ allocate_temporary_context_with_unique_name(const char *prefix, Oid uoid)
 	pfree(temporary_insert_context_name.data);
 	return result;
 }
+
+void
+execute_spi_or_error(const char *query, bool read_only, int64 tcount)
+{
+	const char *old_debug_query_string = debug_query_string;
+
+	debug_query_string = query;
+
+	int			r;
+
+	PG_TRY();
+	{
+		r = SPI_execute(query, read_only, tcount);
+	}
+	PG_CATCH();
+	{
+		debug_query_string = old_debug_query_string;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	debug_query_string = old_debug_query_string;
+
+	if (r < 0)
+		ereport(ERROR, (errcode(ERRCODE_SQL_ROUTINE_EXCEPTION), errmsg("Kafka-ADB: Failed to execute '%s' via SPI: %s [%d]", query, SPI_result_code_string(r), r)));
+}
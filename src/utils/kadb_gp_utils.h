@@ -14,5 +14,15 @@
  */
 MemoryContext allocate_temporary_context_with_unique_name(const char *prefix, Oid uoid);
 
+/**
+ * A wrapper around 'SPI_execute()' which fails with 'ereport(ERROR)' if an
+ * error happens. SPI must be connected.
+ *
+ * @note Unexpected errors may happen if 'read_only' is set. In addition,
+ * 'tcount' imposes a hard limit on the number of tuples processed. Use these
+ * parameters cautiously.
+ */
+void		execute_spi_or_error(const char *query, bool read_only, int64 tcount);
+
 
 #endif   /* // KADB_FDW_KADB_GP_UTILS_INCLUDED */
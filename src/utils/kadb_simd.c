@@ -0,0 +1,182 @@
+#include "kadb_simd.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/* The number of bytes processed at once by the vectorized implementation */
+#define SIMD_WIDTH 16
+
+
+void
+byte_set_init(ByteSet * set, const char *bytes, int size)
+{
+	AssertArg(size > 0 && size <= BYTE_SET_MAX_SIZE);
+
+	set->size = size;
+	MemSet(set->table, 0, sizeof(set->table));
+	for (int i = 0; i < size; i++)
+	{
+		set->bytes[i] = (unsigned char) bytes[i];
+		set->table[(unsigned char) bytes[i]] = true;
+	}
+}
+
+/**
+ * Portable implementation of 'byte_set_find()'.
+ */
+static inline const char *
+byte_set_find_scalar(const ByteSet * set, const char *start, const char *end)
+{
+	for (; start < end; start++)
+	{
+		if (set->table[(unsigned char) *start])
+			break;
+	}
+	return start;
+}
+
+#ifdef __SSE2__
+const char *
+byte_set_find(const ByteSet * set, const char *start, const char *end)
+{
+	__m128i		needles[BYTE_SET_MAX_SIZE];
+
+	for (int i = 0; i < set->size; i++)
+		needles[i] = _mm_set1_epi8((char) set->bytes[i]);
+
+	while (end - start >= SIMD_WIDTH)
+	{
+		__m128i		chunk = _mm_loadu_si128((const __m128i *) start);
+		__m128i		matches = _mm_cmpeq_epi8(chunk, needles[0]);
+
+		for (int i = 1; i < set->size; i++)
+			matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, needles[i]));
+
+		int			mask = _mm_movemask_epi8(matches);
+
+		if (mask != 0)
+			return start + __builtin_ctz((unsigned int) mask);
+		start += SIMD_WIDTH;
+	}
+
+	return byte_set_find_scalar(set, start, end);
+}
+#else
+const char *
+byte_set_find(const ByteSet * set, const char *start, const char *end)
+{
+	return byte_set_find_scalar(set, start, end);
+}
+#endif
+
+/**
+ * Check a single (multibyte) UTF-8 character at 'p', before 'end'.
+ *
+ * @return the length of the character, or 0 if it is not valid
+ */
+static inline int
+utf8_char_length(const unsigned char *p, const unsigned char *end)
+{
+	unsigned char lead = p[0];
+	int			length;
+	unsigned char second_min = 0x80;
+	unsigned char second_max = 0xBF;
+
+	if (lead >= 0x01 && lead <= 0x7F)
+		return 1;
+	else if (lead >= 0xC2 && lead <= 0xDF)
+		length = 2;
+	else if (lead >= 0xE0 && lead <= 0xEF)
+	{
+		length = 3;
+		/* Overlong forms and surrogates */
+		if (lead == 0xE0)
+			second_min = 0xA0;
+		else if (lead == 0xED)
+			second_max = 0x9F;
+	}
+	else if (lead >= 0xF0 && lead <= 0xF4)
+	{
+		length = 4;
+		/* Overlong forms and code points above U+10FFFF */
+		if (lead == 0xF0)
+			second_min = 0x90;
+		else if (lead == 0xF4)
+			second_max = 0x8F;
+	}
+	else
+		return 0;
+
+	if (end - p < length || p[1] < second_min || p[1] > second_max)
+		return 0;
+	for (int i = 2; i < length; i++)
+	{
+		if (p[i] < 0x80 || p[i] > 0xBF)
+			return 0;
+	}
+	return length;
+}
+
+/**
+ * Portable implementation of 'utf8_is_valid()', starting at 'p'.
+ */
+static inline bool
+utf8_is_valid_scalar(const unsigned char *p, const unsigned char *end)
+{
+	while (p < end)
+	{
+		int			length = utf8_char_length(p, end);
+
+		if (length == 0)
+			return false;
+		p += length;
+	}
+	return true;
+}
+
+#ifdef __SSE2__
+bool
+utf8_is_valid(const char *start, const char *end)
+{
+	const unsigned char *p = (const unsigned char *) start;
+	const unsigned char *e = (const unsigned char *) end;
+	__m128i		zero = _mm_setzero_si128();
+
+	while (e - p >= SIMD_WIDTH)
+	{
+		__m128i		chunk = _mm_loadu_si128((const __m128i *) p);
+
+		/* Bytes with the high bit set, or NUL bytes */
+		int			mask = _mm_movemask_epi8(chunk) | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+
+		if (mask == 0)
+		{
+			p += SIMD_WIDTH;
+			continue;
+		}
+
+		/* Check characters one by one up to the end of the chunk */
+		const unsigned char *chunk_end = p + SIMD_WIDTH;
+
+		p += __builtin_ctz((unsigned int) mask);
+		while (p < chunk_end)
+		{
+			int			length = utf8_char_length(p, e);
+
+			if (length == 0)
+				return false;
+			p += length;
+		}
+	}
+
+	return utf8_is_valid_scalar(p, e);
+}
+#else
+bool
+utf8_is_valid(const char *start, const char *end)
+{
+	return utf8_is_valid_scalar((const unsigned char *) start, (const unsigned char *) end);
+}
+#endif
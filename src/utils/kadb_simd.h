@@ -0,0 +1,54 @@
+#ifndef KADB_FDW_UTILS_KADB_SIMD_INCLUDED
+#define KADB_FDW_UTILS_KADB_SIMD_INCLUDED
+
+/*
+ * Vectorized byte scanning and UTF-8 validation used by text-based
+ * deserializers.
+ *
+ * SSE2 (the x86-64 baseline) is used when available; otherwise, a portable
+ * table-driven implementation is used. Both give identical results.
+ */
+
+#include <postgres.h>
+
+
+/* The maximum number of bytes in a 'ByteSet' */
+#define BYTE_SET_MAX_SIZE 8
+
+/**
+ * A small set of bytes to search for.
+ */
+typedef struct ByteSet
+{
+	int			size;
+	unsigned char bytes[BYTE_SET_MAX_SIZE];
+	/* 'true' for each byte in the set; used by the portable implementation */
+	bool		table[256];
+}	ByteSet;
+
+
+/**
+ * Initialize 'set' with 'size' bytes from 'bytes'.
+ *
+ * 'size' must not exceed BYTE_SET_MAX_SIZE.
+ */
+void		byte_set_init(ByteSet * set, const char *bytes, int size);
+
+/**
+ * Find the first byte in the range ['start', 'end') which belongs to 'set'.
+ *
+ * @return a pointer to the byte found, or 'end' if there is no such byte
+ */
+const char *byte_set_find(const ByteSet * set, const char *start, const char *end);
+
+/**
+ * Check whether the range ['start', 'end') is valid UTF-8 by the rules of
+ * PostgreSQL: well-formed, with no surrogates, code points above U+10FFFF, or
+ * NUL bytes.
+ *
+ * Runs of ASCII bytes are checked a vector at a time.
+ */
+bool		utf8_is_valid(const char *start, const char *end);
+
+
+#endif   /* KADB_FDW_UTILS_KADB_SIMD_INCLUDED */